@@ -10,6 +10,21 @@ ServerConfig serverConfig;
 std::atomic configChanged(false);
 std::string configDirectory;
 
+int defaultNetworkThreads() {
+    // A few event loops are plenty, leave the remaining cores to chunk work and ticking
+    return static_cast<int>(std::clamp(std::thread::hardware_concurrency() / 4, 1u, 4u));
+}
+
+int defaultChunkLoaderThreads() {
+    // Chunk loading is the bulk of the work when players move, but the tick and network threads need cores too
+    return static_cast<int>(std::max(1u, std::thread::hardware_concurrency() / 2));
+}
+
+int defaultLoginCryptoThreads() {
+    // RSA decryption is CPU bound, a login storm must not take every core
+    return static_cast<int>(std::clamp(std::thread::hardware_concurrency() / 4, 1u, 2u));
+}
+
 void loadConfig() {
     std::string configFilePath = "../config.json";
     std::ifstream configFile(configFilePath);
@@ -28,6 +43,9 @@ void loadConfig() {
         serverConfig.enableEncryption = true;
         serverConfig.enableCompression = true;
         serverConfig.compressionThreshold = 256;
+        serverConfig.compressionLevel = 6;
+        serverConfig.chunkCompressionLevel = 4;
+        serverConfig.movementCompressionLevel = 1;
         serverConfig.enableSecureChat = true;
         if (serverConfig.serverId.empty()) {
             serverConfig.serverId = generateServerID();
@@ -38,6 +56,21 @@ void loadConfig() {
         serverConfig.enableRcon = false;
         serverConfig.ticksPerSecond = 20;
         serverConfig.consoleLang = "en_us";
+        serverConfig.networkThreads = defaultNetworkThreads();
+        serverConfig.maxOutboundBacklog = 16 * 1024 * 1024;
+        serverConfig.loginCryptoThreads = defaultLoginCryptoThreads();
+        serverConfig.maxPendingKeyExchanges = 256;
+        serverConfig.keyRotationMinutes = 0;
+        serverConfig.sessionServerURL = "https://sessionserver.mojang.com";
+        serverConfig.maxConcurrentAuthRequests = 8;
+        serverConfig.profileCacheTTL = 300;
+        serverConfig.mojangKeyRefreshMinutes = 60;
+        serverConfig.chunkLoaderThreads = defaultChunkLoaderThreads();
+        serverConfig.chunkUnloadDelay = 30;
+        serverConfig.chunkMemoryBudget = 512 * 1024 * 1024;
+        serverConfig.regionFileCacheSize = 64;
+        serverConfig.regionCompressionLevel = 6;
+        serverConfig.autosaveInterval = 300;
         logMessage("Failed to open config file: " + configFilePath, LOG_ERROR);
         return;
     }
@@ -67,6 +100,9 @@ void loadConfig() {
     serverConfig.enableEncryption = (jsonConfig.value("enable_encryption", true) || serverConfig.onlineMode);
     serverConfig.enableCompression = jsonConfig.value("enable_compression", true);
     serverConfig.compressionThreshold = jsonConfig.value("compression_threshold", 256);
+    serverConfig.compressionLevel = jsonConfig.value("compression_level", 6);
+    serverConfig.chunkCompressionLevel = jsonConfig.value("chunk_compression_level", 4);
+    serverConfig.movementCompressionLevel = jsonConfig.value("movement_compression_level", 1);
     serverConfig.enableSecureChat = jsonConfig.value("enable_secure_chat", true) && serverConfig.enableEncryption;
     if (serverConfig.serverId.empty()) {
         serverConfig.serverId = generateServerID();
@@ -175,5 +211,33 @@ void loadConfig() {
 
     serverConfig.ticksPerSecond = jsonConfig.value("ticks_per_second", 20);
     serverConfig.consoleLang = jsonConfig.value("console_language", "en_us");
+    serverConfig.networkThreads = jsonConfig.value("network_threads", 0);
+    if (serverConfig.networkThreads <= 0) {
+        serverConfig.networkThreads = defaultNetworkThreads();
+    }
+    serverConfig.maxOutboundBacklog = static_cast<size_t>(jsonConfig.value("max_outbound_backlog_kb", 16384)) * 1024;
+    serverConfig.loginCryptoThreads = jsonConfig.value("login_crypto_threads", 0);
+    if (serverConfig.loginCryptoThreads <= 0) {
+        serverConfig.loginCryptoThreads = defaultLoginCryptoThreads();
+    }
+    serverConfig.maxPendingKeyExchanges = std::max(1, jsonConfig.value("max_pending_key_exchanges", 256));
+    serverConfig.keyRotationMinutes = std::max(0, jsonConfig.value("key_rotation_minutes", 0));
+    serverConfig.sessionServerURL = jsonConfig.value("session_server_url", "https://sessionserver.mojang.com");
+    // Paths are appended to the base URL
+    while (!serverConfig.sessionServerURL.empty() && serverConfig.sessionServerURL.back() == '/') {
+        serverConfig.sessionServerURL.pop_back();
+    }
+    serverConfig.maxConcurrentAuthRequests = std::max(1, jsonConfig.value("max_concurrent_auth_requests", 8));
+    serverConfig.profileCacheTTL = std::max(0, jsonConfig.value("profile_cache_ttl_seconds", 300));
+    serverConfig.mojangKeyRefreshMinutes = std::max(0, jsonConfig.value("mojang_key_refresh_minutes", 60));
+    serverConfig.chunkLoaderThreads = jsonConfig.value("chunk_loader_threads", 0);
+    if (serverConfig.chunkLoaderThreads <= 0) {
+        serverConfig.chunkLoaderThreads = defaultChunkLoaderThreads();
+    }
+    serverConfig.chunkUnloadDelay = std::max(0, jsonConfig.value("chunk_unload_delay_seconds", 30));
+    serverConfig.chunkMemoryBudget = static_cast<size_t>(std::max(1, jsonConfig.value("chunk_memory_budget_mb", 512))) * 1024 * 1024;
+    serverConfig.regionFileCacheSize = std::max(1, jsonConfig.value("region_file_cache_size", 64));
+    serverConfig.regionCompressionLevel = std::clamp(jsonConfig.value("region_compression_level", 6), 0, 9);
+    serverConfig.autosaveInterval = std::max(0, jsonConfig.value("autosave_interval_seconds", 300));
 }
 
@@ -41,6 +41,10 @@ struct ServerConfig {
     bool enableEncryption;
     bool enableCompression;
     int compressionThreshold;
+    // zlib levels (0-9) for regular packets, chunk data and entity movement
+    int compressionLevel;
+    int chunkCompressionLevel;
+    int movementCompressionLevel;
     bool enableSecureChat;
     std::string serverId{};
     int opPermissionLevel;
@@ -57,6 +61,35 @@ struct ServerConfig {
     WorldBorderConfig worldBorder;
     int ticksPerSecond;
     std::string consoleLang;
+    // Number of network event loop threads
+    int networkThreads;
+    // Clients with more unsent data queued than this are disconnected
+    size_t maxOutboundBacklog;
+    // Threads decrypting login shared secrets, and how many logins may wait for them
+    int loginCryptoThreads;
+    int maxPendingKeyExchanges;
+    // Minutes between server key pair rotations, 0 keeps the key generated at startup
+    int keyRotationMinutes;
+    // Base URL of the session server (hasJoined and profiles), e.g. a local stand-in for load tests
+    std::string sessionServerURL;
+    // Session server requests running at the same time, further logins queue up
+    int maxConcurrentAuthRequests;
+    // Seconds a player's skin textures are cached, 0 disables the cache
+    int profileCacheTTL;
+    // Minutes between refreshes of Mojang's public keys (secure chat), 0 only loads them once
+    int mojangKeyRefreshMinutes;
+    // Threads loading, generating and encoding the chunks players need
+    int chunkLoaderThreads;
+    // Seconds a chunk no player views stays loaded before it is saved and unloaded
+    int chunkUnloadDelay;
+    // Memory loaded chunks may use before the least recently used unviewed ones are unloaded early
+    size_t chunkMemoryBudget;
+    // Region files kept open between chunk loads and saves
+    int regionFileCacheSize;
+    // zlib level (0-9) chunks are compressed with in region files
+    int regionCompressionLevel;
+    // Seconds between saves of the changed chunks, 0 only saves when chunks are unloaded
+    int autosaveInterval;
 };
 
 extern ServerConfig serverConfig;
@@ -1,17 +1,23 @@
 #include "server.h"
 #include "networking/network.h"
 #include "networking/client.h"
+#include "networking/event_loop.h"
 #include "config.h"
 #include <iostream>
 #include <thread>
 
 #include "commands/CommandBuilder.h"
 #include "data/crafting_recipes.h"
+#include "encryption/rsa_key.h"
 #include "entities/item_entity.h"
 #include "networking/clientbound_packets.h"
 #include "server/query_server.h"
 #include "server/rcon_server.h"
 #include "utils/translation.h"
+#include "world/chunk.h"
+#include "world/chunk_loader.h"
+#include "world/block_changes.h"
+#include "world/light_engine.h"
 #include "world/world.h"
 
 void tickingSystem() {
@@ -26,6 +32,7 @@ void tickingSystem() {
     auto tickInterval = duration<double, std::milli>(millisecondsPerTick);
 
     auto nextTick = steady_clock::now() + tickInterval;
+    static std::atomic<bool> autosaveRunning = false;
 
     while (true) {
         // Wait until the next tick
@@ -42,6 +49,40 @@ void tickingSystem() {
                     sendTimeUpdatePacket(*existingClient);
                 }
             }
+
+            // Unload the chunks nobody looks at anymore
+            unloadChunks();
+        }
+        if (serverConfig.autosaveInterval > 0 && tickCount > 0 &&
+            tickCount % (serverConfig.ticksPerSecond * serverConfig.autosaveInterval) == 0 && !autosaveRunning.exchange(true)) {
+            // Converting and writing the chunks happens on the pool, a save still running skips this one
+            threadPool.enqueue([] {
+                World::save();
+                autosaveRunning = false;
+            });
+        }
+        if (serverConfig.enableEncryption && serverConfig.keyRotationMinutes > 0 && tickCount > 0 &&
+            tickCount % (serverConfig.ticksPerSecond * 60 * serverConfig.keyRotationMinutes) == 0) {
+            // Key generation takes a while, keep it off the tick thread
+            threadPool.enqueue(rotateServerKeyPair);
+        }
+        if (serverConfig.enableSecureChat && serverConfig.mojangKeyRefreshMinutes > 0 && tickCount > 0 &&
+            tickCount % (serverConfig.ticksPerSecond * 60 * serverConfig.mojangKeyRefreshMinutes) == 0) {
+            threadPool.enqueue([] { mojangKeyStore.refresh(); });
+        } else if (serverConfig.enableSecureChat && tickCount % serverConfig.ticksPerSecond == 0 && mojangKeyStore.claimRetry()) {
+            // Nothing to verify session keys with yet, try again once the backoff ran out
+            threadPool.enqueue([] { mojangKeyStore.refresh(); });
+        }
+        if (tickCount > 0 && tickCount % (serverConfig.ticksPerSecond * 60 * 5) == 0) {
+            // Every 5 minutes
+            reportChunkPacketCache();
+        }
+        if (tickCount % (serverConfig.ticksPerSecond * 15) == 0) {
+            // Every 15 seconds, send Keep Alive packets
+            std::lock_guard lock(connectedClientsMutex);
+            for (auto &existingClient: connectedClients | std::views::values) {
+                sendKeepAlivePacket(*existingClient);
+            }
         }
 
         // Update weather
@@ -223,6 +264,13 @@ void tickingSystem() {
             }
         }
 
+        // Send the blocks changed this tick, then relight around them
+        blockChanges.flush();
+        lightEngine.flush();
+
+        // Write out everything the tick produced
+        flushEventLoops();
+
         // Schedule the next tick
         nextTick += tickInterval;
         tickCount++;
@@ -250,6 +298,18 @@ void runServer() {
     manageResourcePacks();
     buildAllCommands();
 
+    if (serverConfig.enableEncryption) {
+        // One key pair for every login instead of generating one per connection
+        rotateServerKeyPair();
+        loginCryptoPool = std::make_unique<thread_pool>(serverConfig.loginCryptoThreads);
+    }
+    authPool = std::make_unique<thread_pool>(serverConfig.maxConcurrentAuthRequests);
+    chunkLoader = std::make_unique<ChunkLoader>(serverConfig.chunkLoaderThreads);
+    if (serverConfig.enableSecureChat) {
+        // Load the keys before the first player session needs them, later fetches never block a verification
+        mojangKeyStore.refresh();
+    }
+
 #ifdef _WIN32
     // Initialize Winsock
     WSADATA wsaData;
@@ -315,6 +375,8 @@ void runServer() {
     }
 
     blocks = loadBlocks("../resources/blocks.json");
+    blockStateIndex.build(blocks);
+    lightEngine.build(blocks);
     biomes = loadBiomes("../resources/biomes.json");
     items = loadItems("../resources/items.json");
     itemIDs = loadItemIDs("../resources/items.json");
@@ -323,6 +385,9 @@ void runServer() {
     craftingRecipes = loadCraftingRecipes("../resources/recipes/crafting.json");
     blockTags = loadBlockTags(blocks, "../resources/block_tags.json");
     itemTags = loadItemTags(items, "../resources/item_tags.json");
+    if (!buildConfigurationPackets()) {
+        logMessage("Failed to build the configuration packets.", LOG_ERROR);
+    }
 
     auto endTime = std::chrono::system_clock::now();
     std::chrono::duration<double> elapsedSeconds = endTime - startTime;
@@ -359,6 +424,8 @@ void runServer() {
     // Detach the thread to allow it to run independently
     consoleThread.detach();
 
+    startEventLoops(serverConfig.networkThreads);
+
     std::thread tickThread(tickingSystem);
 	set_thread_name(tickThread, "TickThread");
     tickThread.detach();
@@ -376,10 +443,14 @@ void runServer() {
             continue;
         }
 
-        std::thread(handleClient, clientSock).detach();
+        dispatchClient(clientSock);
     }
 
+    stopEventLoops();
     stopMiningScheduler();
+    // No worker may still be loading into the chunk map while it is saved
+    chunkLoader->stop();
+    World::save();
 
     if (serverConfig.enableRcon) {
         rconServer->stop();
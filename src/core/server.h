@@ -8,6 +8,8 @@
 #include "data/data.h"
 #include "entities/entity.h"
 #include "entities/entity_manager.h"
+#include "entities/entity_tracker.h"
+#include "encryption/mojang_keys.h"
 #include "world/flatworld.h"
 #include "server/rcon_server.h"
 #include "utils/thread_pool.h"
@@ -48,6 +50,7 @@ inline std::unordered_map<std::string, FlatWorldSettings> flatWorldPresets = loa
             "../resources/flatworld_presets.json");
 
 inline EntityManager entityManager;
+inline EntityTracker entityTracker;
 
 inline std::unordered_map<std::string, BiomeData> biomes;
 inline std::unordered_map<std::string, BlockData> blocks;
@@ -73,9 +76,15 @@ inline std::unordered_map<std::string, ClientConnection*> connectedClients;
 inline std::mutex connectedClientsMutex;
 
 inline thread_pool threadPool(std::thread::hardware_concurrency());
+// Small pool for the RSA work of logins and secure chat, created at startup when encryption is enabled
+inline std::unique_ptr<thread_pool> loginCryptoPool;
+// Runs the session server requests of logins, its size is the limit of concurrent requests
+inline std::unique_ptr<thread_pool> authPool;
 
 inline std::unique_ptr<RCONServer> rconServer;
 
+inline MojangKeyStore mojangKeyStore;
+
 // TODO: Create a world class to hold all world data
 inline WorldBorder worldBorder;
 inline WorldTime worldTime;
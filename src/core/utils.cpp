@@ -1,5 +1,6 @@
 #include "utils.h"
 
+#include <algorithm>
 #include <array>
 #include <atomic>
 #include <fstream>
@@ -211,37 +212,53 @@ nbt::tag_compound jsonToTagCompound(const nlohmann::json& j) {
     return compound;
 }
 
-std::vector<uint8_t> serializeNBT(const nbt::tag& compound, bool excludeName, const std::string &name) {
-    std::ostringstream os(std::ios::binary);
+namespace {
+    // Output stream buffer appending to a byte vector, so tags are written without an intermediate string
+    class ByteVectorStreamBuffer : public std::streambuf {
+    public:
+        explicit ByteVectorStreamBuffer(std::vector<uint8_t>& out) : out(out) {}
 
-    if (excludeName) {
-        // Serialize the compound without the type ID and name
-        // The write_tag function typically writes: [Type ID][Name Length][Name][Payload]
-        // For Protocol >=764, we need to omit the [Type ID][Name Length][Name]
-        // We'll serialize normally and then strip the first two bytes
+    protected:
+        int_type overflow(int_type character) override {
+            if (!traits_type::eq_int_type(character, traits_type::eof())) {
+                out.push_back(static_cast<uint8_t>(character));
+            }
+            return traits_type::not_eof(character);
+        }
 
-        nbt::io::write_tag("", compound, os, endian::big); // Write with empty name
+        std::streamsize xsputn(const char* data, std::streamsize size) override {
+            out.insert(out.end(), reinterpret_cast<const uint8_t*>(data), reinterpret_cast<const uint8_t*>(data) + size);
+            return size;
+        }
 
-        // Extract the data from the stream
-        std::string serializedData = os.str();
+    private:
+        std::vector<uint8_t>& out;
+    };
+}
 
-        // Verify that the first byte is TAG_Compound (0x0a) and name length is 0x00
-        if (serializedData.size() >= 2 &&
-            static_cast<uint8_t>(serializedData[0]) == 0x0a &&
-            static_cast<uint8_t>(serializedData[1]) == 0x00) {
-            // Remove the first two bytes
-            serializedData.erase(1, 2);
-            }
+void appendNBT(std::vector<uint8_t>& out, const nbt::tag& tag, const std::string& name) {
+    ByteVectorStreamBuffer buffer(out);
+    std::ostream os(&buffer);
+    nbt::io::write_tag(name, tag, os, endian::big);
+}
 
-        // Convert to byte vector
-        std::vector<uint8_t> data(serializedData.begin(), serializedData.end());
+std::vector<uint8_t> serializeNBT(const nbt::tag& compound, bool excludeName, const std::string &name) {
+    std::vector<uint8_t> data;
+    if (excludeName) {
+        // Serialize the compound without the name
+        // The write_tag function typically writes: [Type ID][Name Length][Name][Payload]
+        // For Protocol >=764, we need to omit the [Name Length][Name]
+        appendNBT(data, compound, ""); // Write with empty name
+
+        // Verify that the first byte is TAG_Compound (0x0a) and name length is 0x00, then remove the name length
+        if (data.size() >= 3 && data[0] == 0x0a && data[1] == 0x00) {
+            data.erase(data.begin() + 1, data.begin() + 3);
+        }
         return data;
     }
 
     // Serialize normally (including type ID and name)
-    nbt::io::write_tag(name, compound, os, endian::big);
-    std::string serializedData = os.str();
-    std::vector<uint8_t> data(serializedData.begin(), serializedData.end());
+    appendNBT(data, compound, name);
     return data;
 }
 
@@ -405,73 +422,143 @@ std::vector<uint8_t> decompressGZip(const std::vector<uint8_t>& compressedData)
     return decompressedData;
 }
 
-std::vector<uint8_t> compressData(const std::vector<uint8_t>& data) {
-    z_stream zs = {};
+namespace {
+    // zlib streams are expensive to set up (deflate allocates ~256 KiB of state), so every thread keeps
+    // one stream per compression level and one inflate stream and resets them between packets
+    struct DeflateStream {
+        z_stream stream{};
+        bool initialized = false;
 
-    if (deflateInit(&zs, Z_DEFAULT_COMPRESSION) != Z_OK) {
-        throw std::runtime_error("deflateInit failed while compressing.");
+        ~DeflateStream() {
+            if (initialized) {
+                deflateEnd(&stream);
+            }
+        }
+    };
+
+    struct InflateStream {
+        z_stream stream{};
+        bool initialized = false;
+
+        ~InflateStream() {
+            if (initialized) {
+                inflateEnd(&stream);
+            }
+        }
+    };
+
+    z_stream& acquireDeflateStream(int level) {
+        if (level < Z_NO_COMPRESSION || level > Z_BEST_COMPRESSION) {
+            level = 6; // What Z_DEFAULT_COMPRESSION maps to
+        }
+        thread_local std::array<DeflateStream, Z_BEST_COMPRESSION + 1> streams;
+        DeflateStream& deflater = streams[level];
+        if (!deflater.initialized) {
+            if (deflateInit(&deflater.stream, level) != Z_OK) {
+                throw std::runtime_error("deflateInit failed while compressing.");
+            }
+            deflater.initialized = true;
+        } else {
+            deflateReset(&deflater.stream);
+        }
+        return deflater.stream;
     }
 
-    zs.next_in = const_cast<Bytef*>(data.data());
-    zs.avail_in = data.size();
+    z_stream& acquireInflateStream() {
+        thread_local InflateStream inflater;
+        if (!inflater.initialized) {
+            if (inflateInit(&inflater.stream) != Z_OK) {
+                throw std::runtime_error("inflateInit failed while decompressing.");
+            }
+            inflater.initialized = true;
+        } else {
+            inflateReset(&inflater.stream);
+        }
+        return inflater.stream;
+    }
+}
 
-    int ret;
+std::vector<uint8_t> compressData(const std::vector<uint8_t>& data) {
     std::vector<uint8_t> out;
+    compressData(data.data(), data.size(), out);
+    return out;
+}
 
-    do {
-        char outbuffer[32768];
-        zs.next_out = reinterpret_cast<Bytef*>(outbuffer);
-        zs.avail_out = sizeof(outbuffer);
-
-        ret = deflate(&zs, Z_FINISH);
+void compressData(const uint8_t* data, size_t size, std::vector<uint8_t>& out, int level) {
+    z_stream& zs = acquireDeflateStream(level);
+    zs.next_in = const_cast<Bytef*>(data);
+    zs.avail_in = size;
 
-        if (out.size() < zs.total_out) {
-            out.insert(out.end(), outbuffer, outbuffer + sizeof(outbuffer) - zs.avail_out);
-        }
-    } while (ret == Z_OK);
+    // deflateBound is an upper bound for the stream's settings, so a single Z_FINISH call always completes
+    size_t start = out.size();
+    out.resize(start + deflateBound(&zs, size));
+    zs.next_out = out.data() + start;
+    zs.avail_out = out.size() - start;
 
-    deflateEnd(&zs);
+    int ret = deflate(&zs, Z_FINISH);
+    out.resize(start + zs.total_out);
 
     if (ret != Z_STREAM_END) { // an error occurred that was not EOF
         throw std::runtime_error("Exception during zlib compression.");
     }
+}
 
-    return out;
+size_t compressedSizeBound(size_t size) {
+    return compressBound(static_cast<uLong>(size));
 }
 
-// Decompress data using zlib (inflate)
-std::vector<uint8_t> decompressData(const std::vector<uint8_t>& data) {
-    z_stream zs = {};
+size_t compressData(const uint8_t* data, size_t size, uint8_t* out, size_t capacity, int level) {
+    z_stream& zs = acquireDeflateStream(level);
+    zs.next_in = const_cast<Bytef*>(data);
+    zs.avail_in = size;
+    zs.next_out = out;
+    zs.avail_out = capacity;
 
-    if (inflateInit(&zs) != Z_OK) {
-        throw std::runtime_error("inflateInit failed while decompressing.");
+    if (deflate(&zs, Z_FINISH) != Z_STREAM_END) {
+        throw std::runtime_error("Exception during zlib compression.");
     }
+    return zs.total_out;
+}
+
+void decompressData(const uint8_t* data, size_t size, size_t uncompressedSize, std::vector<uint8_t>& out) {
+    z_stream& zs = acquireInflateStream();
+    zs.next_in = const_cast<Bytef*>(data);
+    zs.avail_in = size;
+
+    out.resize(uncompressedSize);
+    zs.next_out = out.data();
+    zs.avail_out = uncompressedSize;
+
+    int ret = inflate(&zs, Z_FINISH);
+    if (ret != Z_STREAM_END || zs.total_out != uncompressedSize) {
+        throw std::runtime_error("Decompressed data doesn't match the announced length.");
+    }
+}
 
+// Decompress data using zlib (inflate)
+std::vector<uint8_t> decompressData(const std::vector<uint8_t>& data) {
+    z_stream& zs = acquireInflateStream();
     zs.next_in = const_cast<Bytef*>(data.data());
     zs.avail_in = data.size();
 
+    // The size isn't known, start with a guess and double the output until the stream ends
+    std::vector<uint8_t> out(std::max<size_t>(data.size() * 4, 256));
     int ret;
-    std::vector<uint8_t> out;
-
     do {
-        char outbuffer[32768];
-        zs.next_out = reinterpret_cast<Bytef*>(outbuffer);
-        zs.avail_out = sizeof(outbuffer);
-
-        ret = inflate(&zs, 0);
-
-        if (out.size() < zs.total_out) {
-            out.insert(out.end(), outbuffer, outbuffer + sizeof(outbuffer) - zs.avail_out);
+        if (zs.total_out == out.size()) {
+            out.resize(out.size() * 2);
         }
+        zs.next_out = out.data() + zs.total_out;
+        zs.avail_out = out.size() - zs.total_out;
 
+        ret = inflate(&zs, Z_NO_FLUSH);
     } while (ret == Z_OK);
 
-    inflateEnd(&zs);
-
     if (ret != Z_STREAM_END) { // an error occurred that was not EOF
         throw std::runtime_error("Exception during zlib decompression.");
     }
 
+    out.resize(zs.total_out);
     return out;
 }
 
@@ -100,6 +100,8 @@ std::array<uint8_t, 16> generateUUID();
 std::string uuidToString(const std::array<uint8_t, 16>& uuidBytes);
 nbt::tag_compound jsonToTagCompound(const nlohmann::json& j);
 std::vector<uint8_t> serializeNBT(const nbt::tag& compound, bool excludeName, const std::string &name = "");
+// Appends the named tag to out
+void appendNBT(std::vector<uint8_t>& out, const nbt::tag& tag, const std::string& name);
 int32_t generateUniqueTeleportID();
 int32_t getChunkCoordinate(double position);
 std::string bytesToUUIDString(const std::array<uint8_t, 16>& uuidBytes);
@@ -110,6 +112,14 @@ void decodePosition(uint64_t val, int32_t &x, int32_t &y, int32_t &z);
 std::vector<uint8_t> compressGZip(const std::vector<uint8_t>& data);
 std::vector<uint8_t> decompressGZip(const std::vector<uint8_t>& compressedData);
 std::vector<uint8_t> compressData(const std::vector<uint8_t>& data);
+// Appends the compressed data to out. level is a zlib level (0-9, -1 for the default).
+void compressData(const uint8_t* data, size_t size, std::vector<uint8_t>& out, int level = -1);
+// Largest size compressData can produce for size bytes
+size_t compressedSizeBound(size_t size);
+// Compresses into out, which holds at least compressedSizeBound(size) bytes, returns the compressed size
+size_t compressData(const uint8_t* data, size_t size, uint8_t* out, size_t capacity, int level = -1);
+// Inflates data whose size is known up front (e.g. the Data Length of a packet) into out
+void decompressData(const uint8_t* data, size_t size, size_t uncompressedSize, std::vector<uint8_t>& out);
 std::vector<uint8_t> decompressData(const std::vector<uint8_t>& data);
 std::string computeServerHash(const std::string& serverId, const std::array<uint8_t, 16>& sharedSecret, const std::vector<uint8_t>& serverPublicKey);
 std::string getClientIPAddress(const ClientConnection& client);
@@ -0,0 +1,75 @@
+#include "mojang_keys.h"
+#include <algorithm>
+#include <openssl/x509.h>
+
+#include "core/utils.h"
+#include "networking/fetch.h"
+
+MojangKeyStore::Keys::~Keys() {
+    for (EVP_PKEY* key : keys) {
+        EVP_PKEY_free(key);
+    }
+}
+
+std::shared_ptr<const MojangKeyStore::Keys> MojangKeyStore::getKeys() {
+    std::lock_guard lock(mutex);
+    return keys ? keys : std::make_shared<const Keys>();
+}
+
+bool MojangKeyStore::claimRetry() {
+    std::lock_guard lock(mutex);
+    if (keys || refreshing || std::chrono::steady_clock::now() < nextRetry) {
+        return false;
+    }
+    refreshing = true;
+    return true;
+}
+
+bool MojangKeyStore::refresh() {
+    std::lock_guard refreshLock(refreshMutex);
+    {
+        std::lock_guard lock(mutex);
+        refreshing = true;
+    }
+    // Cleared however the refresh ends, claimRetry() never hands out another retry while it is set
+    struct RefreshingGuard {
+        MojangKeyStore& store;
+        ~RefreshingGuard() {
+            std::lock_guard lock(store.mutex);
+            store.refreshing = false;
+        }
+    } refreshingGuard{*this};
+
+    // A malformed response counts as a failed fetch
+    std::vector<std::string> keysBase64;
+    try {
+        keysBase64 = fetchMojangPublicKeys();
+    } catch (const std::exception& e) {
+        logMessage("Invalid Mojang public keys response: " + std::string(e.what()), LOG_ERROR);
+    }
+    auto fetched = std::make_shared<Keys>();
+    for (const auto& keyBase64 : keysBase64) {
+        std::vector<uint8_t> der = base64Decode(keyBase64);
+        const unsigned char* data = der.data();
+        if (EVP_PKEY* key = d2i_PUBKEY(nullptr, &data, static_cast<long>(der.size()))) {
+            fetched->keys.push_back(key);
+        } else {
+            logMessage("Failed to parse a Mojang public key.", LOG_WARNING);
+        }
+    }
+
+    std::lock_guard lock(mutex);
+    if (fetched->keys.empty()) {
+        // Keep using the keys we have, and don't ask again before the backoff ran out
+        nextRetry = std::chrono::steady_clock::now() + retryDelay;
+        logMessage("Failed to refresh Mojang public keys, retrying in "
+                   + std::to_string(std::chrono::duration_cast<std::chrono::seconds>(retryDelay).count()) + " s.", LOG_ERROR);
+        retryDelay = std::min<std::chrono::steady_clock::duration>(retryDelay * 2, MAX_RETRY_DELAY);
+        return false;
+    }
+
+    logMessage("Loaded " + std::to_string(fetched->keys.size()) + " Mojang public keys.", LOG_DEBUG);
+    keys = std::move(fetched);
+    retryDelay = MIN_RETRY_DELAY;
+    return true;
+}
@@ -0,0 +1,48 @@
+#ifndef MOJANG_KEYS_H
+#define MOJANG_KEYS_H
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <openssl/evp.h>
+
+// Mojang's public keys used to verify player session keys (secure chat).
+// They are fetched once, parsed once and shared by every verification. refresh() replaces them
+// without disturbing verifications that still hold the previous set.
+// Failed fetches are remembered: the next attempt waits a backoff that doubles up to MAX_RETRY_DELAY,
+// so an unreachable endpoint costs one timeout per retry instead of one per verification.
+class MojangKeyStore {
+public:
+    struct Keys {
+        Keys() = default;
+        ~Keys();
+        Keys(const Keys&) = delete;
+        Keys& operator=(const Keys&) = delete;
+
+        std::vector<EVP_PKEY*> keys;
+    };
+
+    // The current keys, empty if none could be fetched yet. Never fetches, so it doesn't block.
+    std::shared_ptr<const Keys> getKeys();
+    // Fetches the keys again and swaps them in if that worked. Blocking, run it off the tick thread
+    // (except for the load at startup).
+    bool refresh();
+    // True if there are no keys, no fetch is running and the backoff after the last failure ran out.
+    // The retry counts as started then, the caller has to run refresh().
+    bool claimRetry();
+
+private:
+    static constexpr std::chrono::seconds MIN_RETRY_DELAY{5};
+    static constexpr std::chrono::seconds MAX_RETRY_DELAY{300};
+
+    std::mutex mutex;
+    // Only one fetch at a time
+    std::mutex refreshMutex;
+    std::shared_ptr<const Keys> keys;
+    bool refreshing = false;
+    std::chrono::steady_clock::duration retryDelay = MIN_RETRY_DELAY;
+    std::chrono::steady_clock::time_point nextRetry;
+};
+
+#endif //MOJANG_KEYS_H
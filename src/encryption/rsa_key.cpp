@@ -1,8 +1,14 @@
 #include "rsa_key.h"
+#include <mutex>
 #include <openssl/err.h>
 #include <stdexcept>
 #include <openssl/x509.h>
 
+namespace {
+    std::mutex serverKeyPairMutex;
+    std::shared_ptr<const RSAKeyPair> serverKeyPair;
+}
+
 RSAKeyPair::RSAKeyPair()
     : pkey_(nullptr, EVP_PKEY_free)
 {
@@ -23,6 +29,7 @@ RSAKeyPair::RSAKeyPair()
     }
 
     pkey_.reset(generated_pkey);
+    publicKeyDER_ = encodePublicKeyDER();
 }
 
 RSAKeyPair::~RSAKeyPair() {
@@ -33,7 +40,7 @@ EVP_PKEY* RSAKeyPair::getPublicKey() const {
     return pkey_.get();
 }
 
-std::vector<uint8_t> RSAKeyPair::getPublicKeyDER() const {
+std::vector<uint8_t> RSAKeyPair::encodePublicKeyDER() const {
     std::vector<uint8_t> der;
 
     // Create a memory BIO to hold the DER-encoded public key
@@ -92,4 +99,19 @@ std::vector<uint8_t> RSAKeyPair::decrypt(const std::vector<uint8_t>& encryptedDa
     decrypted.resize(decryptedLen);
     EVP_PKEY_CTX_free(ctx);
     return decrypted;
+}
+
+std::shared_ptr<const RSAKeyPair> getServerKeyPair() {
+    std::lock_guard lock(serverKeyPairMutex);
+    if (!serverKeyPair) {
+        serverKeyPair = std::make_shared<const RSAKeyPair>();
+    }
+    return serverKeyPair;
+}
+
+void rotateServerKeyPair() {
+    // Generate outside the lock, logins in the meantime still get the current key
+    auto keyPair = std::make_shared<const RSAKeyPair>();
+    std::lock_guard lock(serverKeyPairMutex);
+    serverKeyPair = std::move(keyPair);
 }
\ No newline at end of file
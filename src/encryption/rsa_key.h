@@ -12,15 +12,23 @@ public:
 
     EVP_PKEY *getPublicKey() const;
 
-    // Returns the public key in DER format
-    std::vector<uint8_t> getPublicKeyDER() const;
+    // Returns the public key in DER format, encoded once when the key is generated
+    const std::vector<uint8_t>& getPublicKeyDER() const { return publicKeyDER_; }
 
     // Decrypts data using the private key
     std::vector<uint8_t> decrypt(const std::vector<uint8_t>& encryptedData) const;
 
 private:
+    std::vector<uint8_t> encodePublicKeyDER() const;
+
     // Using EVP_PKEY for better abstraction
     std::unique_ptr<EVP_PKEY, decltype(&EVP_PKEY_free)> pkey_;
+    std::vector<uint8_t> publicKeyDER_;
 };
 
+// The key pair used by every login, generated on first use
+std::shared_ptr<const RSAKeyPair> getServerKeyPair();
+// Generates a new server key pair. Logins that already received the old public key keep using it.
+void rotateServerKeyPair();
+
 #endif //RSA_KEY_H
@@ -3,7 +3,7 @@
 #include <functional>
 
 #include "entity.h"
-#include "networking/clientbound_packets.h"
+#include "core/server.h"
 
 int32_t EntityManager::generateUniqueEntityID() {
     return nextEntityID.fetch_add(1);
@@ -22,7 +22,7 @@ void EntityManager::removeEntity(const std::string& uuidString) {
     auto it = uuidToEntityID.find(uuidString);
     if (it != uuidToEntityID.end()) {
         int32_t entityID = it->second;
-        sendRemoveEntityPacket(entityID);
+        entityTracker.removeEntity(entityID);
         entitiesByID.erase(entityID);
         uuidToEntityID.erase(it);
     }
@@ -0,0 +1,162 @@
+#include "entity_tracker.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <ranges>
+
+#include "item_entity.h"
+#include "player.h"
+#include "networking/clientbound_packets.h"
+#include "networking/network.h"
+
+int32_t getTrackingRange(EntityType type) {
+    // Vanilla client tracking ranges
+    switch (type) {
+        case EntityType::Player:
+            return 32;
+        case EntityType::Item:
+            return 6;
+        default:
+            return 8;
+    }
+}
+
+namespace {
+    // Everything a client needs to show an entity it didn't know about
+    void spawnFor(ClientConnection& client, const std::shared_ptr<Entity>& entity) {
+        if (entity->type == EntityType::Item) {
+            auto item = std::static_pointer_cast<Item>(entity);
+            sendBundleDelimiter(client);
+            sendSpawnEntityPacket(client, entity);
+            sendEntityMetadataPacket(client, item->getMetadata(), item->entityID);
+            sendBundleDelimiter(client);
+            return;
+        }
+        sendSpawnEntityPacket(client, entity);
+    }
+}
+
+bool EntityTracker::canSee(const Player& viewer, const TrackedEntity& tracked) const {
+    if (viewer.entityID == tracked.entity->entityID || viewer.client == nullptr) {
+        return false;
+    }
+    // The chunk view is the square of view distance chunks around the player's chunk, only entities in chunks the
+    // client was sent are shown
+    int32_t range = std::min(getTrackingRange(tracked.entity->type), viewer.effectiveViewDistance());
+    return std::abs(tracked.chunkX - viewer.currentChunkX) <= range &&
+           std::abs(tracked.chunkZ - viewer.currentChunkZ) <= range;
+}
+
+void EntityTracker::addEntity(const std::shared_ptr<Entity>& entity) {
+    std::lock_guard lock(mutex);
+    TrackedEntity& tracked = entities[entity->entityID];
+    tracked.entity = entity;
+    tracked.chunkX = getChunkCoordinate(entity->position.x);
+    tracked.chunkZ = getChunkCoordinate(entity->position.z);
+    tracked.viewers.clear();
+
+    for (const auto& player : players | std::views::values) {
+        if (canSee(*player, tracked)) {
+            tracked.viewers.push_back(player);
+            spawnFor(*player->client, entity);
+        }
+    }
+}
+
+void EntityTracker::removeEntity(int32_t entityID) {
+    std::lock_guard lock(mutex);
+    auto it = entities.find(entityID);
+    if (it == entities.end()) {
+        return;
+    }
+    for (const auto& viewer : it->second.viewers) {
+        if (viewer->client) {
+            sendRemoveEntityPacket(*viewer->client, entityID);
+        }
+    }
+    entities.erase(it);
+}
+
+std::vector<std::shared_ptr<Player>> EntityTracker::refreshViewers(TrackedEntity& tracked) {
+    std::vector<std::shared_ptr<Player>> added;
+    int32_t chunkX = getChunkCoordinate(tracked.entity->position.x);
+    int32_t chunkZ = getChunkCoordinate(tracked.entity->position.z);
+    if (chunkX == tracked.chunkX && chunkZ == tracked.chunkZ) {
+        return added;
+    }
+    tracked.chunkX = chunkX;
+    tracked.chunkZ = chunkZ;
+
+    // Drop the players that can't see the entity anymore
+    std::erase_if(tracked.viewers, [&](const std::shared_ptr<Player>& viewer) {
+        if (canSee(*viewer, tracked)) {
+            return false;
+        }
+        if (viewer->client) {
+            sendRemoveEntityPacket(*viewer->client, tracked.entity->entityID);
+        }
+        return true;
+    });
+
+    // And spawn it for the ones that now can
+    for (const auto& player : players | std::views::values) {
+        if (canSee(*player, tracked) && std::ranges::find(tracked.viewers, player) == tracked.viewers.end()) {
+            spawnFor(*player->client, tracked.entity);
+            tracked.viewers.push_back(player);
+            added.push_back(player);
+        }
+    }
+    return added;
+}
+
+void EntityTracker::broadcast(int32_t entityID, const PacketWriter& packet) {
+    std::lock_guard lock(mutex);
+    auto it = entities.find(entityID);
+    if (it == entities.end()) {
+        return;
+    }
+
+    // Players the entity was just spawned for already got its current state
+    std::vector<std::shared_ptr<Player>> added = refreshViewers(it->second);
+
+    EncodedPacket encoded(packet);
+    for (const auto& viewer : it->second.viewers) {
+        if (viewer->client && std::ranges::find(added, viewer) == added.end()) {
+            sendEncodedPacket(*viewer->client, encoded);
+        }
+    }
+}
+
+void EntityTracker::updateViewer(const std::shared_ptr<Player>& player) {
+    std::lock_guard lock(mutex);
+    players[player->entityID] = player;
+
+    for (auto& tracked : entities | std::views::values) {
+        auto viewer = std::ranges::find(tracked.viewers, player);
+        bool wasViewing = viewer != tracked.viewers.end();
+        bool canView = canSee(*player, tracked);
+        if (canView && !wasViewing) {
+            tracked.viewers.push_back(player);
+            spawnFor(*player->client, tracked.entity);
+        } else if (!canView && wasViewing) {
+            tracked.viewers.erase(viewer);
+            if (player->client) {
+                sendRemoveEntityPacket(*player->client, tracked.entity->entityID);
+            }
+        }
+    }
+}
+
+void EntityTracker::removeViewer(const std::shared_ptr<Player>& player) {
+    std::lock_guard lock(mutex);
+    players.erase(player->entityID);
+    for (auto& tracked : entities | std::views::values) {
+        std::erase(tracked.viewers, player);
+    }
+}
+
+size_t EntityTracker::getViewerCount(int32_t entityID) {
+    std::lock_guard lock(mutex);
+    auto it = entities.find(entityID);
+    return it != entities.end() ? it->second.viewers.size() : 0;
+}
@@ -0,0 +1,55 @@
+#ifndef ENTITY_TRACKER_H
+#define ENTITY_TRACKER_H
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "entity.h"
+
+struct Player;
+class PacketWriter;
+
+// Maximum distance in chunks at which clients are told about an entity (capped by the view distance)
+int32_t getTrackingRange(EntityType type);
+
+// Keeps track of which players can see which entity.
+// A player sees an entity when the entity's chunk is within both the player's chunk view and the
+// entity type's tracking range. Spawn and remove packets are sent as viewers come and go, so
+// per-entity updates only go to players that actually have the entity loaded.
+class EntityTracker {
+public:
+    // Starts tracking an entity and spawns it for everyone who can see it
+    void addEntity(const std::shared_ptr<Entity>& entity);
+    // Stops tracking an entity and removes it from its viewers' worlds
+    void removeEntity(int32_t entityID);
+    // Sends a packet about the entity to its viewers. If the entity moved to another chunk the viewers
+    // are re-evaluated first; players that only now see it get a spawn packet instead.
+    void broadcast(int32_t entityID, const PacketWriter& packet);
+    // Re-evaluates which entities the player sees, call after the player's chunk view changed
+    void updateViewer(const std::shared_ptr<Player>& player);
+    // Forgets a disconnected player as a viewer
+    void removeViewer(const std::shared_ptr<Player>& player);
+
+    size_t getViewerCount(int32_t entityID);
+
+private:
+    struct TrackedEntity {
+        std::shared_ptr<Entity> entity;
+        int32_t chunkX;
+        int32_t chunkZ;
+        std::vector<std::shared_ptr<Player>> viewers;
+    };
+
+    bool canSee(const Player& viewer, const TrackedEntity& tracked) const;
+    // Updates the viewers of an entity that changed chunk, returns the players it was spawned for
+    std::vector<std::shared_ptr<Player>> refreshViewers(TrackedEntity& tracked);
+
+    std::mutex mutex;
+    std::unordered_map<int32_t, TrackedEntity> entities;
+    // Players in the play state, keyed by entity ID
+    std::unordered_map<int32_t, std::shared_ptr<Player>> players;
+};
+
+#endif //ENTITY_TRACKER_H
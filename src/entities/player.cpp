@@ -1,14 +1,20 @@
 #include "player.h"
 
+#include <algorithm>
 #include <nlohmann/json.hpp>
 #include <nlohmann/json_fwd.hpp>
 
+#include "core/config.h"
 #include "networking/clientbound_packets.h"
 
 bool Player::operator==(const std::shared_ptr<Player> &shared) const {
     return uuid == shared->uuid;
 }
 
+int Player::effectiveViewDistance() const {
+    return viewDistance > 0 ? std::min(viewDistance, serverConfig.viewDistance) : serverConfig.viewDistance;
+}
+
 Player::Player(const std::array<uint8_t, 16>& uuidBytes, const std::string& playerName, EntityType entityType) : Entity(
         uuidBytes, entityType, 0.09, 0.02, {-0.3, 0, -0.3, 0.3, 1.8, 0.3}), uuid(uuidBytes), name(playerName),
     gameMode(), listed(false), ping(0),
@@ -56,6 +56,9 @@ struct Player : Entity {
         return flags & 0x02;
     }
 
+    // View distance the client is sent chunks and entities for: what it asked for, at most what the server allows
+    int effectiveViewDistance() const;
+
     bool operator==(const std::shared_ptr<Player> & shared) const;
 
     Player(const std::array<uint8_t, 16>& uuidBytes, const std::string& playerName, EntityType entityType = EntityType::Player);
@@ -1,6 +1,12 @@
+#include <cstring>
+
 #include "core/server.h"
+#include "utils/benchmark.h"
 
-int main() {
+int main(int argc, char* argv[]) {
+    if (argc >= 2 && std::strcmp(argv[1], "--benchmark") == 0) {
+        return runBenchmark(argc >= 3 ? argv[2] : "all") ? 0 : 1;
+    }
     runServer();
     return 0;
 }
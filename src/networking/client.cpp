@@ -1,4 +1,5 @@
 #include "client.h"
+#include "event_loop.h"
 #include "network.h"
 #include "core/utils.h"
 #include "core/config.h"
@@ -20,28 +21,28 @@
 #include "entities/player.h"
 #include "registries/registry_manager.h"
 #include "core/server.h"
+#include "encryption/rsa_key.h"
 #include "entities/entity_factory.h"
 #include "entities/item_entity.h"
 #include "entities/slot_data.h"
 #include "inventories/crafting_table_inventory.h"
 #include "utils/translation.h"
+#include "world/chunk_loader.h"
+#include "world/block_changes.h"
 
 // TODO: Make sure EntityManager and connectedClients are thread-safe
 
 // Global player count
 std::atomic<int> playerCount(0);
+// Encryption Responses waiting for the login crypto pool
+std::atomic<int> pendingKeyExchanges(0);
 
 // Function to disconnect client
 void disconnectClient(const std::shared_ptr<Player>& player, const std::string& reason, bool disconnectPacket) {
     if (disconnectPacket) {
         sendDisconnectionPacket(*player->client, reason);
         logMessage("Player " + player->name + " disconnected. Reason: " + reason, LOG_INFO);
-        // Close the socket
-#ifdef _WIN32
-        closesocket(player->client->socket);
-#else
-        close(player->client->socket);
-#endif
+        closeConnection(*player->client);
     }
     player->client->connectionClosed = true;
     playersMutex.lock();
@@ -55,7 +56,7 @@ void disconnectClient(const std::shared_ptr<Player>& player, const std::string&
 
     sendPlayerInfoRemove(player);
 
-    std::lock_guard lock(chunkMapMutex);
+    std::lock_guard lock(chunkViewersMutex);
     for (auto it = chunkViewersMap.begin(); it != chunkViewersMap.end(); )
     {
         // Remove the player from the vector
@@ -75,72 +76,45 @@ void disconnectClient(const std::shared_ptr<Player>& player, const std::string&
     }
 
     sendTranslatedChatMessage("multiplayer.player.left", false, "yellow", nullptr, true, player->name);
+    entityTracker.removeViewer(player);
+    chunkLoader->removePlayer(player);
     entityManager.removeEntity(player->uuidString);
 }
 
-void handleStatusRequest(ClientConnection& client) {
-    // Read Status Request packet
-    std::vector<uint8_t> packetData;
-    // Read and respond to Ping packet
-    if (readUnencryptedPacket(client, packetData)) {
-        size_t index = 0;
-        int32_t packetID = parseVarInt(packetData, index);
-        if (packetID == STATUS_REQUEST) {
-            // Build JSON response using serverConfig
-            nlohmann::json responseJson = {
-                {"version", {{"name", serverConfig.server_version}, {"protocol", serverConfig.protocol_version}}},
-                {"players", {{"max", serverConfig.maxPlayers}, {"online", playerCount.load()}, {"sample", nlohmann::json::array()}}},
-                {"description", {{"text", serverConfig.motd}}}
-            };
-
-            // Add favicon if available
-            std::vector<uint8_t> faviconData = readFile(serverConfig.icon);
-            if (!faviconData.empty()) {
-                std::string faviconBase64 = base64Encode(faviconData);
-                responseJson["favicon"] = "data:image/png;base64," + faviconBase64;
-            }
-
-            std::string jsonResponse = responseJson.dump();
-
-            // Build response packet
-            std::vector<uint8_t> responseData;
-            responseData.push_back(STATUS_RESPONSE);
-            writeVarInt(responseData, static_cast<int32_t>(jsonResponse.size()));
-            responseData.insert(responseData.end(), jsonResponse.begin(), jsonResponse.end());
-
-            // Send response
-            sendUnencryptedPacket(client, responseData);
-
-            if (readPacketTimeout(client, packetData, 5000, true)) {
-                // Read Ping packet
-                index = 0;
-                packetID = parseVarInt(packetData, index);
-                if (packetID == PING_REQUEST) {
-                    // Ping packet
-                    std::vector<uint8_t> pongData;
-                    pongData.push_back(PONG_RESPONSE);
-                    pongData.insert(pongData.end(), packetData.begin() + index, packetData.end());
-                    sendUnencryptedPacket(client, pongData);
-                }
-            }
-        } else if (packetID == PING_REQUEST) {
-            // Ping packet
-            std::vector<uint8_t> pongData;
-            pongData.push_back(PONG_RESPONSE);
-            pongData.insert(pongData.end(), packetData.begin() + index, packetData.end());
-            sendUnencryptedPacket(client, pongData);
+bool handleStatusPacket(ClientConnection& client, const std::vector<uint8_t>& packetData, size_t index, int32_t packetID) {
+    if (packetID == STATUS_REQUEST) {
+        // Build JSON response using serverConfig
+        nlohmann::json responseJson = {
+            {"version", {{"name", serverConfig.server_version}, {"protocol", serverConfig.protocol_version}}},
+            {"players", {{"max", serverConfig.maxPlayers}, {"online", playerCount.load()}, {"sample", nlohmann::json::array()}}},
+            {"description", {{"text", serverConfig.motd}}}
+        };
+
+        // Add favicon if available
+        std::vector<uint8_t> faviconData = readFile(serverConfig.icon);
+        if (!faviconData.empty()) {
+            std::string faviconBase64 = base64Encode(faviconData);
+            responseJson["favicon"] = "data:image/png;base64," + faviconBase64;
         }
-    }
-}
 
-void startKeepAliveLoop(ClientConnection& client) {
-    // Send Keep Alive packets every 15 seconds
-    while (true) {
-        std::this_thread::sleep_for(std::chrono::seconds(15));
-        if (client.connectionClosed || !sendKeepAlivePacket(client)) {
-            break;
-        }
+        std::string jsonResponse = responseJson.dump();
+
+        // Build response packet
+        PacketWriter responseData(STATUS_RESPONSE);
+        writeVarInt(responseData, static_cast<int32_t>(jsonResponse.size()));
+        responseData.append(jsonResponse.begin(), jsonResponse.end());
+
+        // Send response
+        return sendUnencryptedPacket(client, std::move(responseData));
+    }
+    if (packetID == PING_REQUEST) {
+        // Ping packet
+        PacketWriter pongData(PONG_RESPONSE);
+        pongData.append(packetData.begin() + index, packetData.end());
+        sendUnencryptedPacket(client, std::move(pongData));
     }
+    // The status exchange is over after the ping (or on anything unexpected)
+    return false;
 }
 
 void handleKeepAliveResponse(SocketType clientSock, const std::vector<uint8_t>& packetData, size_t index) {
@@ -205,7 +179,14 @@ bool handleZeroPacket(ClientConnection& client, const std::vector<uint8_t>& pack
         handleTeleportConfirm(client, packetData, index, teleportID);
         return false;
     }
-    return handleClientInformation(*player, packetData, unchangedIndex);
+    int oldViewDistance = player->viewDistance;
+    if (!handleClientInformation(*player, packetData, unchangedIndex)) {
+        return false;
+    }
+    if (player->viewDistance != oldViewDistance) {
+        chunkLoader->updatePlayer(player);
+    }
+    return true;
 }
 
 void handleClientSettings(SocketType clientSock, const std::vector<uint8_t>& packetData, size_t index) {
@@ -258,27 +239,8 @@ void handlePlayerPositionAndRotationPacket(ClientConnection& client, const std::
         // Send Set Center Chunk packet to the client
         sendSetCenterChunkPacket(client, newChunkX, newChunkZ);
 
-        // Update chunk viewers
+        // Update chunk viewers, the chunk loader sends the chunks that came into view
         updatePlayerChunkView(player, oldChunkX, oldChunkZ, newChunkX, newChunkZ);
-
-        std::vector<ChunkCoordinates> chunksToLoad = getChunksInView(newChunkX, newChunkZ, std::min(player->viewDistance, serverConfig.viewDistance));
-
-        // Remove chunks that are already loaded
-        for (auto it = chunksToLoad.begin(); it != chunksToLoad.end();) {
-            if (player->loadedChunks.contains(*it)) {
-                it = chunksToLoad.erase(it);
-            } else {
-                ++it;
-            }
-        }
-
-        for(auto chunkCoord : chunksToLoad) {
-            player->loadedChunks.insert(chunkCoord);
-            // TODO: Remove unloaded chunks
-            if (auto chunk = getOrLoadChunk(chunkCoord.chunkX, chunkCoord.chunkZ)) {
-                sendChunkDataToPlayer(client, chunk);
-            }
-        }
     }
 
     // Calculate deltas
@@ -348,27 +310,8 @@ void handlePlayerPosition(ClientConnection& client, const std::vector<uint8_t>&
         // Send Set Center Chunk packet to the client
         sendSetCenterChunkPacket(client, newChunkX, newChunkZ);
 
-        // Update chunk viewers
+        // Update chunk viewers, the chunk loader sends the chunks that came into view
         updatePlayerChunkView(player, oldChunkX, oldChunkZ, newChunkX, newChunkZ);
-
-        std::vector<ChunkCoordinates> chunksToLoad = getChunksInView(newChunkX, newChunkZ, std::min(player->viewDistance, serverConfig.viewDistance));
-
-        // Remove chunks that are already loaded
-        for (auto it = chunksToLoad.begin(); it != chunksToLoad.end();) {
-            if (player->loadedChunks.contains(*it)) {
-                it = chunksToLoad.erase(it);
-            } else {
-                ++it;
-            }
-        }
-
-        for(auto chunkCoord : chunksToLoad) {
-            auto chunk = getOrLoadChunk(chunkCoord.chunkX, chunkCoord.chunkZ);
-            player->loadedChunks.insert(chunkCoord);
-            if (chunk) {
-                sendChunkDataToPlayer(client, chunk);
-            }
-        }
     }
 
     // Calculate deltas
@@ -491,11 +434,8 @@ void spawnBlockDrops(int32_t x, int32_t y, int32_t z, int16_t blockState) {
 
         item->setCooldown(10); // 10 ticks before item can be picked up
 
-        // Send spawn packet with velocity
-        sendBundleDelimiter();
-        sendSpawnEntityPacket(item);
-        sendEntityMetadataPacket(item->getMetadata(), item->entityID);
-        sendBundleDelimiter();
+        // Spawn it for the players in range, with velocity
+        entityTracker.addEntity(item);
     }
 }
 
@@ -523,8 +463,8 @@ void handleFinishedDigging(ClientConnection& client, const std::shared_ptr<Playe
     // Notify all players viewing this chunk about the block change
     notifyChunkUpdate(chunk, x, y, z);
 
-    // Acknowledge the block change
-    sendAcknowledgeBlockChange(client, sequence);
+    // Acknowledged once the viewers got the change, at the end of the tick
+    blockChanges.acknowledge(player, sequence);
 
     // Send world event packet to all viewers
     {
@@ -962,8 +902,8 @@ void handleUseItemOn(ClientConnection& client, const std::vector<uint8_t> & pack
     // 7. Notify Relevant Clients About the Block Change
     notifyChunkUpdate(chunk, static_cast<int32_t>(targetPosition.x), static_cast<int32_t>(targetPosition.y), static_cast<int32_t>(targetPosition.z));
 
-    // Acknowledge the block change
-    sendAcknowledgeBlockChange(client, sequence);
+    // Acknowledged once the viewers got the change, at the end of the tick
+    blockChanges.acknowledge(player, sequence);
 
     // 8. Update the Player's Inventory
     // In Creative Mode, items are not consumed. If in Survival, decrease item count
@@ -977,6 +917,42 @@ void handleUseItemOn(ClientConnection& client, const std::vector<uint8_t> & pack
     }
 }
 
+// Runs work on the pool while the connection's packets wait, then hands its result to finish on the
+// connection's event loop. finish returns false to close the connection. Without an event loop both
+// run right away.
+template<typename Work, typename Finish>
+bool runOffLoop(ClientConnection& client, thread_pool& pool, Work work, Finish finish) {
+    if (!client.loop) {
+        return finish(client, work());
+    }
+
+    std::shared_ptr<ClientConnection> clientRef = client.shared_from_this();
+    client.dispatchPaused = true;
+    pool.enqueue([clientRef, work, finish]() {
+        auto result = work();
+        clientRef->loop->post([clientRef, result, finish]() {
+            if (clientRef->connectionClosed) {
+                return;
+            }
+            // finish may pause the connection again
+            clientRef->dispatchPaused = false;
+            if (!finish(*clientRef, result)) {
+                closeConnection(*clientRef);
+                return;
+            }
+            if (!clientRef->dispatchPaused) {
+                clientRef->loop->resumeDispatch(clientRef);
+            }
+        });
+    });
+    return true;
+}
+
+// Pool for signature checks and key exchanges, the login crypto pool when there is one
+thread_pool& cryptoPool() {
+    return loginCryptoPool ? *loginCryptoPool : threadPool;
+}
+
 EVP_PKEY* parsePublicKey(const std::vector<uint8_t>& pubKeyBytes) {
     const unsigned char* data = pubKeyBytes.data();
     EVP_PKEY* publicKey = d2i_PUBKEY(nullptr, &data, pubKeyBytes.size());
@@ -1051,37 +1027,30 @@ void handlePlayerSession(ClientConnection & client, const std::vector<uint8_t> &
             return;
         }
 
-        // Fetch Mojang's public keys
-        std::vector<std::string> mojangPublicKeyPEMs = fetchMojangPublicKeys();
-        if (mojangPublicKeyPEMs.empty()) {
-            // Handle error
-            disconnectClient(player, "Unable to fetch Mojang public keys.", true);
-            return;
-        }
-
-        // Load and decode the public keys
-        std::vector<EVP_PKEY *> mojangPublicKeys;
-        for (const auto &keyBase64 : mojangPublicKeyPEMs) {
-            if (EVP_PKEY *pubKey = parsePublicKey(base64Decode(keyBase64))) {
-                mojangPublicKeys.push_back(pubKey);
+        // Verifying happens off the connection's thread, Mojang's keys are fetched in the background
+        auto verify = [player]() -> std::string {
+            std::shared_ptr<const MojangKeyStore::Keys> mojangPublicKeys = mojangKeyStore.getKeys();
+            if (mojangPublicKeys->keys.empty()) {
+                return "Unable to fetch Mojang public keys.";
             }
-        }
-
-        // Verify the player's session key
-        if (mojangPublicKeys.empty()) {
-            disconnectClient(player, "Failed to load Mojang public keys.", true);
-            return;
-        }
 
-        // TODO: Fix key verification
-        if (!verifySessionKeySignature(player, player->sessionKey.expiresAt, player->sessionKey.pubKey, player->sessionKey.keySig, mojangPublicKeys)) {
-            logMessage("Player: " + player->name + " failed to verify session key signature.", LOG_ERROR);
-            disconnectClient(player, "Invalid session key signature.", true);
-            return;
-        }
+            // TODO: Fix key verification
+            if (!verifySessionKeySignature(player, player->sessionKey.expiresAt, player->sessionKey.pubKey, player->sessionKey.keySig, mojangPublicKeys->keys)) {
+                logMessage("Player: " + player->name + " failed to verify session key signature.", LOG_ERROR);
+                return "Invalid session key signature.";
+            }
+            return "";
+        };
 
-        std::vector<std::shared_ptr<Player>> playerInfo = {player};
-        sendPlayerInfoUpdate(client, playerInfo, 0x02);
+        runOffLoop(client, cryptoPool(), verify, [player](ClientConnection& client, const std::string& error) {
+            if (!error.empty()) {
+                disconnectClient(player, error, true);
+                return true;
+            }
+            std::vector<std::shared_ptr<Player>> playerInfo = {player};
+            sendPlayerInfoUpdate(client, playerInfo, 0x02);
+            return true;
+        });
     }
 }
 
@@ -1164,7 +1133,7 @@ bool verifyChatSignature(const std::shared_ptr<Player>& player, const std::strin
     return result;
 }
 
-void handleChatMessage(const ClientConnection & client, const std::vector<uint8_t> & packetData, size_t index, const std::shared_ptr<Player> & player, const RegistryManager& registryManager) {
+void handleChatMessage(ClientConnection & client, const std::vector<uint8_t> & packetData, size_t index, const std::shared_ptr<Player> & player, const RegistryManager& registryManager) {
     // Message (String)
     std::string message = parseString(packetData, index);
 
@@ -1189,13 +1158,23 @@ void handleChatMessage(const ClientConnection & client, const std::vector<uint8_
     // Acknowledged (Fixed Bit Set) // TODO: Implement
 
     if (hasSignature && serverConfig.enableSecureChat) {
-        // Verify the signature
-        std::vector<std::vector<uint8_t>> previousSignatures;
-        if (!verifyChatSignature(player, message, timestamp, salt, 0, signature, previousSignatures)) {
-            // Signature is invalid
-            logMessage("Player " + player->name + " sent an invalid chat message signature", LOG_ERROR);
-            return;
-        }
+        // Verify the signature on the crypto pool. The player's later packets wait for it, which keeps
+        // their messages in order.
+        auto verify = [player, message, timestamp, salt, signature]() {
+            std::vector<std::vector<uint8_t>> previousSignatures;
+            return verifyChatSignature(player, message, timestamp, salt, 0, signature, previousSignatures);
+        };
+        const RegistryManager* registries = &registryManager;
+        runOffLoop(client, cryptoPool(), verify, [player, message, timestamp, salt, signature, registries](ClientConnection&, bool valid) {
+            if (!valid) {
+                // Signature is invalid
+                logMessage("Player " + player->name + " sent an invalid chat message signature", LOG_ERROR);
+                return true;
+            }
+            broadcastPlayerChatMessage(player, message, timestamp, salt, &signature, *registries);
+            return true;
+        });
+        return;
     }
 
     // Broadcast the chat message to all players
@@ -1423,7 +1402,7 @@ void handleClientPacket(ClientConnection& client, const std::vector<uint8_t>& pa
     }
 }
 
-void handlePlayState(ClientConnection& client, const std::shared_ptr<Player>& newPlayer, const RegistryManager& registryManager) {
+void enterPlayState(ClientConnection& client, const std::shared_ptr<Player>& newPlayer) {
     // Send Join Game packet
     sendJoinGamePacket(client, newPlayer->entityID);
 
@@ -1472,30 +1451,15 @@ void handlePlayState(ClientConnection& client, const std::shared_ptr<Player>& ne
     sendPlayerInfoUpdate(client, newPlayerInfo, 0x09); // 0x01: Add Player, 0x08: Update Listed
 
     // Send Spawn Entity packets
-    // Send to the new client about existing players
-    for (const auto &entity: existingEntities | std::views::values) {
-        if (entity->uuidString != newPlayer->uuidString && entity->type == EntityType::Player) {
-            sendSpawnEntityPacket(client, entity);
-        }
-    }
-
-    // Send to existing clients about the new player
-    {
-        std::lock_guard lock(connectedClientsMutex);
-        for (auto& [uuid, existingClient] : connectedClients) {
-            if (uuid != newPlayer->uuidString) {
-                sendSpawnEntityPacket(*existingClient, newPlayer);
-            }
-        }
-    }
+    // Spawn the new player for the players in range, the entities in range are spawned for the
+    // new player once its chunk view is set up
+    entityTracker.addEntity(newPlayer);
     {
         std::lock_guard lock(connectedClientsMutex);
         connectedClients[newPlayer->uuidString] = &client;
     }
 
-
-    // Start Keep Alive loop in a separate thread
-    std::thread keepAliveLoop(startKeepAliveLoop, std::ref(client));
+    // Keep Alive packets are sent by the ticking system to every connected client
 
     // Send Game Event: Start waiting for level chunks
     // According to the protocol, the value depends on the event
@@ -1506,287 +1470,188 @@ void handlePlayState(ClientConnection& client, const std::shared_ptr<Player>& ne
     // Send Set Center Chunk packet with initial chunk coordinates
     sendSetCenterChunkPacket(client, newPlayer->currentChunkX, newPlayer->currentChunkZ);
 
-    // Send Chunk Data Packets
-    // Determine which chunks to send based on view distance
-    int viewDistance = serverConfig.viewDistance; // TODO: Send to player
-    int centerChunkX = newPlayer->currentChunkX;
-    int centerChunkZ = newPlayer->currentChunkZ;
-
-
-    // TODO: Use getChunksInView
-    // Load and send chunks within view distance
-    auto sendChunks = [&](int centerX, int centerZ, const std::shared_ptr<Player>& player) {
-        // Measure time
-        auto startTime = std::chrono::steady_clock::now();
-
-        // Define the chunks to load and already loaded
-        std::vector<ChunkCoordinates> chunksToLoad;
-        std::vector<ChunkCoordinates> chunksAlreadyLoaded; {
-            int chunkCount = 0;
-            std::lock_guard lock(chunkMapMutex);
-            for (int dx = -viewDistance; dx <= viewDistance; ++dx) {
-                for (int dz = -viewDistance; dz <= viewDistance; ++dz) {
-                    // Skip the current chunk if needed
-                    chunkCount++;
-                    if (dx == 0 && dz == 0) continue;
-
-                    int chunkX = centerX + dx;
-                    int chunkZ = centerZ + dz;
-                    ChunkCoordinates coords{chunkX, chunkZ};
-                    auto it = globalChunkMap.find(coords);
-                    if (it != globalChunkMap.end()) {
-                        chunksAlreadyLoaded.emplace_back(coords);
-                    } else {
-                        chunksToLoad.emplace_back(coords);
-                    }
-                }
-            }
-        }
-
-        // Vector to hold futures for loaded chunks
-        std::vector<std::future<std::shared_ptr<Chunk>>> loadFutures;
-        loadFutures.reserve(chunksToLoad.size());
-
-        // Enqueue load/generate tasks
-        for (const auto& coords : chunksToLoad) {
-            loadFutures.emplace_back(
-                threadPool.enqueue([coords]() -> std::shared_ptr<Chunk> {
-                    // Attempt to load the chunk from disk
-                    auto loadedChunk = loadChunkFromDisk(coords.chunkX, coords.chunkZ);
-                    if (!loadedChunk) {
-                        // Generate the chunk if loading failed
-                        if (serverConfig.worldType == "flat") {
-                            FlatWorldSettings settings = flatWorldPresets[serverConfig.flatWorldPreset];
-                            int highestY;
-                            loadedChunk = generateFlatChunk(settings, coords.chunkX, coords.chunkZ, highestY);
-                        }
-                    }
-                    return loadedChunk;
-                })
-            );
-        }
-
-        // Vector to hold chunks to send (already loaded and newly loaded)
-        std::vector<std::shared_ptr<Chunk>> chunksToSend;
-        chunksToSend.reserve(chunksAlreadyLoaded.size() + chunksToLoad.size());
-
-        // Collect already loaded chunks
-        {
-            std::lock_guard lock(chunkMapMutex);
-            for (const auto& coords : chunksAlreadyLoaded) {
-                auto it = globalChunkMap.find(coords);
-                if (it != globalChunkMap.end()) {
-                    chunksToSend.emplace_back(it->second);
-                }
-            }
-        }
-
-        // Collect loaded/generated chunks and update globalChunkMap
-        for (size_t i = 0; i < loadFutures.size(); ++i) {
-            if (std::shared_ptr<Chunk> chunk = loadFutures[i].get()) {
-                {
-                    std::lock_guard lock(chunkMapMutex);
-                    globalChunkMap[chunksToLoad[i]] = chunk;
-                }
-                chunksToSend.emplace_back(chunk);
-            }
-        }
-
-        // Vector to hold futures for sending chunks
-        std::vector<std::future<void>> sendFutures;
-        sendFutures.reserve(chunksToSend.size());
-
-        // Enqueue send tasks
-        for (const auto& chunk : chunksToSend) {
-            sendFutures.emplace_back(
-                threadPool.enqueue([chunk, &client]() -> void {
-                    sendChunkDataToPlayer(client, chunk);
-                })
-            );
-        }
-
-        for (const auto& chunk : chunksToSend) {
-            player->loadedChunks.insert({chunk->chunkX, chunk->chunkZ});
-        }
-
-        // Wait for all sends to complete
-        for (auto& future : sendFutures) {
-            future.get();
-        }
-
-        auto chunkCreationTime = std::chrono::duration_cast<std::chrono::milliseconds>(
-            std::chrono::steady_clock::now() - startTime
-        ).count();
-
-        logMessage("Loaded and Sent " + std::to_string(chunksToSend.size()) + " chunks in " + std::to_string(chunkCreationTime) + " ms", LOG_DEBUG);
-
-    };
-
     // Initialize the world border
     worldBorder.initialize(serverConfig.worldBorder);
     sendInitializeWorldBorder(client, worldBorder);
 
-    // Send current chunk to the player
-    sendCurrentChunkToPlayer(client, centerChunkX, centerChunkZ);
-
-    updatePlayerChunkView(newPlayer, -1, -1, centerChunkX, centerChunkZ);
-
-    // Asynchronously send chunks to avoid blocking
-    std::thread(sendChunks, newPlayer->currentChunkX, newPlayer->currentChunkZ, newPlayer).detach();
+    // Send the chunks around the player, the chunk loader streams them nearest first
+    updatePlayerChunkView(newPlayer, -1, -1, newPlayer->currentChunkX, newPlayer->currentChunkZ);
 
     // Send Resource Packs
     sendResourcePacks(client);
+}
 
-    // Receive and handle client packets
-    try {
-        while (true) {
-            std::vector<uint8_t> packetData;
-            if (!readPacket(client, packetData)) {
-                disconnectClient(newPlayer, "Player disconnected", false);
-                break;
+bool handleConfigurationPacket(ClientConnection& client, const std::vector<uint8_t>& packetData, size_t index, int32_t packetID) {
+    Player& player = *client.player;
+
+    switch (packetID) {
+        case CLIENT_INFORMATION: // Client Information
+            if (!handleClientInformation(player, packetData, index)) {
+                return false;
             }
+            sendServerPluginMessages(client);
+            sendFeatureFlags(client, {"minecraft:vanilla"});
+            sendKnownPacksPacket(client);
+            return true;
+        case LOGIN_PLUGIN_RESPONSE: // Serverbound Plugin Message
+            handlePluginMessage(client, packetData, index, player);
+            return true;
+        case SERVERBOUND_KNOWN_PACKS: { // Serverbound Known Packs
+            size_t packCount = parseVarInt(packetData, index);
 
-            // Process incoming packets (e.g., Keep Alive Response)
-            handleClientPacket(client, packetData, newPlayer, registryManager);
+            // Send Registry Data packet
+            sendRegistryDataPacket(client, *client.registryManager);
 
-            std::this_thread::sleep_for(std::chrono::nanoseconds(100)); // Avoid high CPU usage
-        }
-    } catch (const std::exception& e) {
-        disconnectClient(newPlayer, "Player disconnected", false);
-        logMessage("Client disconnected with error: " + std::string(e.what()), LOG_ERROR);
-    }
+            // Update tags
+            sendUpdateTagsPacket(client);
 
-    // Clean up
-    keepAliveLoop.join();
-}
+            // Send server links
+            sendServerLinksPacket(client);
 
-bool waitForAcknowledgeFinishConfiguration(const ClientConnection& client) {
-    std::vector<uint8_t> packetData;
-    if (!readPacket(client, packetData)) {
-        return false;
-    }
+            // Send Finish Configuration packet
+            sendFinishConfigurationPacket(client);
+            return true;
+        }
+        case ACKNOWLEDGE_FINISH_CONFIGURATION: // Acknowledge Finish Configuration
+            sendTranslatedChatMessage("multiplayer.player.joined", false, "yellow", nullptr, true, player.name);
 
-    size_t index = 0;
-    int32_t packetID = parseVarInt(packetData, index);
-    if (packetID != ACKNOWLEDGE_FINISH_CONFIGURATION) {
-        // Expected Acknowledge Finish Configuration packet
-        std::stringstream stringstream;
-        stringstream << "Expected Acknowledge Finish Configuration packet. Instead received: 0x" << std::hex << packetID << std::dec;
-        std::string formattedMessage = stringstream.str();
-        logMessage(formattedMessage, LOG_ERROR);
-        return false;
+            // Now in Play state
+            client.state = ClientState::Play;
+            enterPlayState(client, client.player);
+            return true;
+        default:
+            std::stringstream stringstream;
+            stringstream << "Ignoring configuration packet ID: 0x" << std::hex << packetID << std::dec;
+            logMessage(stringstream.str(), LOG_DEBUG);
+            return true;
     }
-
-    // No fields to parse
-
-    return true;
 }
 
-bool waitForClientKnownPacks(const ClientConnection& client) {
-    std::vector<uint8_t> packetData;
-    if (!readPacket(client, packetData)) {
-        return false;
-    }
-
-    size_t index = 0;
-    int32_t packetID = parseVarInt(packetData, index);
-    if (packetID != SERVERBOUND_KNOWN_PACKS) {
-        // Expected Known Packs packet
-        return false;
-    }
-    size_t packCount = parseVarInt(packetData, index);
-
-    return true;
-}
+// Resolved identity of a player that is logging in
+struct LoginProfile {
+    std::string uuid;
+    std::pair<std::string, std::string> textures;
+};
 
-bool waitForClientPluginMessage(const ClientConnection & client, Player& player) {
-    std::vector<uint8_t> packetData;
-    if (!readPacketTimeout(client, packetData, 2, false)) {
-        return false;
-    }
+bool finishLogin(ClientConnection& client, const LoginProfile& profile) {
+    std::array<uint8_t, 16> uuidBytes = stringUUIDToBytes(profile.uuid);
 
-    size_t index = 0;
-    int32_t packetID = parseVarInt(packetData, index);
-    if (packetID != LOGIN_PLUGIN_RESPONSE) {
-        // Expected Plugin Message packet
-        return false;
+    if (serverConfig.enableCompression) {
+        sendSetCompressionPacket(client, serverConfig.compressionThreshold);
+        client.compressionEnabled = true;
     }
 
-    handlePluginMessage(client, packetData, index, player);
-
-    return true;
-}
+    // Create a new Player instance
+    std::shared_ptr<Player> newPlayer = EntityFactory::createPlayer(uuidBytes, client.loginName);
 
-bool waitforClientInfo(const ClientConnection & client, Player& player) {
-    std::vector<uint8_t> packetData;
-    if (!readPacket(client, packetData)) {
-        return false;
+    // Assign a unique Entity ID
+    newPlayer->uuidString = profile.uuid;
+    newPlayer->properties = {}; // Populate as needed
+    newPlayer->gameMode = CREATIVE;
+    newPlayer->listed = true;
+    newPlayer->ping = -1; // Unknown initially
+    newPlayer->setClient(&client);
+    if (!profile.textures.first.empty() && !profile.textures.second.empty()) {
+        newPlayer->properties["textures"] = { profile.textures.first, profile.textures.second };
+    } else {
+        // Assign a default skin if fetching fails
+        std::string defaultSkin = "eyJ0aW1lc3RhbXAiOjE1OTA0ODEyMDAwMDAsInByb2ZpbGVJZCI6InV1aWQiLCJwcm9maWxlTmFtZSI6InBsYXllck5hbWUiLCJ0ZXh0dXJlcyI6eyJTS0lOIjp7InVybCI6Imh0dHA6Ly90ZXh0dXJlcy5taW5lY3JhZnQubmV0L3RleHR1cmUvczg2YzIyYjYyMmY2Y2E3ZTJmZjhkNTYyN2FkNDMxMDgyMjYyYzE5ZTM5MjMxYjI1YjczNGNiZDI0N2EwMjA4ZCJ9fX0=";
+        newPlayer->properties["textures"] = { defaultSkin, "" };
     }
+    client.player = newPlayer;
 
-    size_t index = 0;
-    int32_t packetID = parseVarInt(packetData, index);
-    if (packetID != CLIENT_INFORMATION) {
-        // Expected Client Info packet
-        return false;
+    // Add the new player to the global player list
+    {
+        std::lock_guard lock(playersMutex);
+        globalPlayers[profile.uuid] = newPlayer;
+        globalPlayersName[client.loginName] = newPlayer;
     }
 
-    return handleClientInformation(player, packetData, index);
-}
-
-bool handleConfigurationState(ClientConnection& client, RegistryManager& registryManager, Player& player) {
+    // Increase player count
+    ++playerCount;
 
-    waitForClientPluginMessage(client, player);
+    // Send Login Success packet
+    PacketWriter responseData(LOGIN_SUCCESS);
 
-    if (!waitforClientInfo(client, player)) {
-        // Handle error or disconnection
-        return false;
-    }
+    // Append UUID (16 bytes)
+    responseData.append(uuidBytes.begin(), uuidBytes.end());
 
-    sendServerPluginMessages(client);
+    // Append Username (String)
+    writeString(responseData, newPlayer->name);
 
-    sendFeatureFlags(client, {"minecraft:vanilla"});
+    // Number Of Properties (VarInt)
+    writeVarInt(responseData, 0); // For now no properties
 
-    sendKnownPacksPacket(client);
+    // Strict Error Handling (Boolean)
+    responseData.push_back(0x00); // TODO: Only in versions before 1.21.2 and 1.20.5+
 
-    if (!waitForClientKnownPacks(client)) {
-        // Handle error or disconnection
-        return false;
-    }
+    // Build and send the packet
+    return sendPacket(client, std::move(responseData));
+}
 
-    // Send Registry Data packet
-    sendRegistryDataPacket(client, registryManager);
+// Authenticates the player with Mojang (online mode) and fetches the skin. Both are blocking HTTP
+// requests, so on an event loop they run on the auth pool while the connection's packets wait.
+bool resolveLoginProfile(ClientConnection& client) {
+    std::shared_ptr<ClientConnection> clientRef = client.shared_from_this();
 
-    // Update tags
-    sendUpdateTagsPacket(client);
+    std::string serverHash;
+    std::string clientIP;
+    if (serverConfig.onlineMode) {
+        // Compute Server Hash
+        std::string serverId = serverConfig.serverId; // Ensure you have initialized server_id
+        serverHash = computeServerHash(serverId, client.sharedSecret, client.keyPair->getPublicKeyDER());
+        // Get Client's IP Address
+        clientIP = getClientIPAddress(client);
+    }
+
+    auto resolve = [clientRef, serverHash, clientIP]() -> std::optional<LoginProfile> {
+        LoginProfile profile;
+        profile.uuid = clientRef->loginUUID;
+        if (serverConfig.onlineMode) {
+            // Authenticate with Mojang
+            std::string authenticatedUUID;
+            std::string authenticatedName;
+            bool authSuccess = authenticatePlayer(clientRef->loginName, serverHash, clientIP, authenticatedUUID, authenticatedName, profile.textures);
+
+            if (!authSuccess) {
+                sendDisconnectionPacket(*clientRef, "Authentication with Mojang failed. Disconnecting.");
+                return std::nullopt;
+            }
 
-    // Send server links
-    sendServerLinksPacket(client);
+            // Verify that the authenticatedName matches the provided playerName
+            if (authenticatedName != clientRef->loginName) {
+                logMessage("Player name mismatch: " + authenticatedName + " != " + clientRef->loginName, LOG_ERROR);
+                sendDisconnectionPacket(*clientRef, "Player name mismatch. Disconnecting.");
+                return std::nullopt;
+            }
 
-    // Send Finish Configuration packet
-    sendFinishConfigurationPacket(client);
+            profile.uuid = authenticatedUUID;
+            logMessage("Player authenticated: " + authenticatedName + " (" + authenticatedUUID + ")", LOG_DEBUG);
+        } else {
+            // Offline Mode: Use the client-provided UUID
+            logMessage("Offline Mode: Using client-provided UUID: " + profile.uuid, LOG_DEBUG);
+        }
 
-    // Wait for Acknowledge Finish Configuration from the client
-    if (!waitForAcknowledgeFinishConfiguration(client)) {
-        logMessage("Failed to receive Acknowledge Finish Configuration packet", LOG_ERROR);
-        return false;
-    }
+        if (profile.textures.first.empty() || profile.textures.second.empty()) {
+            profile.textures = fetchPlayerSkin(profile.uuid);
+        }
+        return profile;
+    };
 
-    return true;
+    thread_pool& pool = authPool ? *authPool : threadPool;
+    auto queuedAt = std::chrono::steady_clock::now();
+    auto timedResolve = [clientRef, resolve, queuedAt]() {
+        std::optional<LoginProfile> profile = resolve();
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - queuedAt);
+        logMessage("Resolved login profile of " + clientRef->loginName + " in " + std::to_string(elapsed.count()) + " ms", LOG_DEBUG);
+        return profile;
+    };
+    return runOffLoop(client, pool, timedResolve, [](ClientConnection& client, const std::optional<LoginProfile>& profile) {
+        return profile && finishLogin(client, *profile);
+    });
 }
 
-void handleLoginRequest(ClientConnection& client, RegistryManager& registryManager) {
-    // Read Login Start packet
-    std::vector<uint8_t> packetData;
-    if (!readUnencryptedPacket(client, packetData)) {
-        return;
-    }
-
-    size_t index = 0;
-    int32_t packetID = parseVarInt(packetData, index);
-    if (packetID != 0x00) {
-        return;
-    }
-
+bool handleLoginStart(ClientConnection& client, const std::vector<uint8_t>& packetData, size_t index) {
     std::string playerName = parseString(packetData, index);
     // Set UUID for the new player
     std::vector<uint8_t> uuidBytesVec = parseBytes(packetData, index, 16);
@@ -1796,299 +1661,310 @@ void handleLoginRequest(ClientConnection& client, RegistryManager& registryManag
     std::string playerUUID = bytesToUUIDString(uuidBytes);
     // Remove '-' characters from UUID string
     std::erase(playerUUID, '-');
-    uuidBytes = stringUUIDToBytes(playerUUID);
 
     if (playerUUID.empty()) {
         playerUUID = fetchPlayerUUID(playerName);
         if (playerUUID.empty()) {
             logMessage("Failed to fetch player UUID for: " + playerName, LOG_ERROR);
-            return;
+            return false;
         }
-        uuidBytes = stringUUIDToBytes(playerUUID);
     }
 
-     // ************ Encryption Start ************
-    if (serverConfig.enableEncryption) {
-        // Step 1: Generate a random verify token (16 bytes recommended)
-        std::array<uint8_t, 16> verifyToken{};
-        if (RAND_bytes(verifyToken.data(), verifyToken.size()) != 1) {
-            logMessage("Failed to generate verify token", LOG_ERROR);
-            return;
-        }
+    client.loginName = playerName;
+    client.loginUUID = playerUUID;
 
-        // Step 2: Get server's public key in DER format
-        std::vector<uint8_t> serverPublicKeyDER = registryManager.getRSAKeyPair().getPublicKeyDER();
-
-        // Step 3: Construct Encryption Request packet
-        std::vector<uint8_t> encryptionRequestPacket;
+    if (!serverConfig.enableEncryption) {
+        return resolveLoginProfile(client);
+    }
 
-        // Packet ID for Encryption Request
-        writeVarInt(encryptionRequestPacket, 0x01);
+    // ************ Encryption Start ************
+    // Step 1: Generate a random verify token (16 bytes recommended)
+    if (RAND_bytes(client.verifyToken.data(), client.verifyToken.size()) != 1) {
+        logMessage("Failed to generate verify token", LOG_ERROR);
+        return false;
+    }
 
-        // Server ID (empty string for modern versions)
-        writeString(encryptionRequestPacket, serverConfig.serverId);
+    // Step 2: Get server's public key in DER format
+    client.keyPair = getServerKeyPair();
+    const std::vector<uint8_t>& serverPublicKeyDER = client.keyPair->getPublicKeyDER();
 
-        // Public Key Length and Public Key
-        writeVarInt(encryptionRequestPacket, static_cast<int32_t>(serverPublicKeyDER.size()));
-        encryptionRequestPacket.insert(encryptionRequestPacket.end(), serverPublicKeyDER.begin(), serverPublicKeyDER.end());
+    // Step 3: Construct Encryption Request packet
+    PacketWriter encryptionRequestPacket;
 
-        // Verify Token Length and Verify Token
-        writeVarInt(encryptionRequestPacket, verifyToken.size());
-        encryptionRequestPacket.insert(encryptionRequestPacket.end(), verifyToken.begin(), verifyToken.end());
+    // Packet ID for Encryption Request
+    writeVarInt(encryptionRequestPacket, ENCRYPTION_REQUEST);
 
-        // Should authenticate (boolean)
-        writeByte(encryptionRequestPacket, serverConfig.onlineMode);
+    // Server ID (empty string for modern versions)
+    writeString(encryptionRequestPacket, serverConfig.serverId);
 
-        // Send Encryption Request packet
-        if (!sendUnencryptedPacket(client, encryptionRequestPacket)) {
-            logMessage("Failed to send Encryption Request packet", LOG_ERROR);
-            return;
-        }
+    // Public Key Length and Public Key
+    writeVarInt(encryptionRequestPacket, static_cast<int32_t>(serverPublicKeyDER.size()));
+    encryptionRequestPacket.append(serverPublicKeyDER.begin(), serverPublicKeyDER.end());
 
-        // Step 4: Receive Encryption Response packet
-        std::vector<uint8_t> encryptionResponseData;
-        if (!readUnencryptedPacket(client, encryptionResponseData)) {
-            logMessage("Failed to read Encryption Response packet", LOG_ERROR);
-            return;
-        }
+    // Verify Token Length and Verify Token
+    writeVarInt(encryptionRequestPacket, client.verifyToken.size());
+    encryptionRequestPacket.append(client.verifyToken.begin(), client.verifyToken.end());
 
-        size_t respIndex = 0;
-        int32_t respPacketID = parseVarInt(encryptionResponseData, respIndex);
-        if (respPacketID != 0x01) {
-            logMessage("Invalid Encryption Response packet ID: " + std::to_string(respPacketID) + " (expected 0x01)", LOG_ERROR);
-            return;
-        }
+    // Should authenticate (boolean)
+    writeByte(encryptionRequestPacket, serverConfig.onlineMode);
 
-        // Parse Encryption Response
-        // Encrypted Shared Secret
-        int32_t encryptedSharedSecretLength = parseVarInt(encryptionResponseData, respIndex);
-        std::vector<uint8_t> encryptedSharedSecret = parseBytes(encryptionResponseData, respIndex, encryptedSharedSecretLength);
+    // Send Encryption Request packet
+    if (!sendUnencryptedPacket(client, std::move(encryptionRequestPacket))) {
+        logMessage("Failed to send Encryption Request packet", LOG_ERROR);
+        return false;
+    }
 
-        // Encrypted Verify Token
-        int32_t encryptedVerifyTokenLength = parseVarInt(encryptionResponseData, respIndex);
-        std::vector<uint8_t> encryptedVerifyToken = parseBytes(encryptionResponseData, respIndex, encryptedVerifyTokenLength);
+    // The Encryption Response arrives as a separate packet
+    return true;
+}
 
-        // Step 5: Decrypt Shared Secret and Verify Token using server's private key
-        std::vector<uint8_t> decryptedSharedSecret = registryManager.getRSAKeyPair().decrypt(encryptedSharedSecret);
-        std::vector<uint8_t> decryptedVerifyToken = registryManager.getRSAKeyPair().decrypt(encryptedVerifyToken);
+// Steps 6 to 8 of the key exchange, once the shared secret and verify token are decrypted
+bool completeKeyExchange(ClientConnection& client, const std::vector<uint8_t>& decryptedSharedSecret, const std::vector<uint8_t>& decryptedVerifyToken) {
+    // Step 6: Verify that the decrypted verify token matches the original
+    if (decryptedVerifyToken.size() != client.verifyToken.size() ||
+        std::memcmp(decryptedVerifyToken.data(), client.verifyToken.data(), client.verifyToken.size()) != 0) {
+        logMessage("Verify token mismatch", LOG_ERROR);
+        return false;
+    }
 
-        // Step 6: Verify that the decrypted verify token matches the original
-        if (decryptedVerifyToken.size() != verifyToken.size() ||
-            std::memcmp(decryptedVerifyToken.data(), verifyToken.data(), verifyToken.size()) != 0) {
-            logMessage("Verify token mismatch", LOG_ERROR);
-            return;
-            }
+    // Step 7: Store the shared secret
+    if (decryptedSharedSecret.size() < 16) { // AES-128 requires at least 16 bytes
+        logMessage("Invalid shared secret size", LOG_ERROR);
+        return false;
+    }
+    std::copy_n(decryptedSharedSecret.begin(), 16, client.sharedSecret.begin());
 
-        // Step 7: Store the shared secret
-        if (decryptedSharedSecret.size() < 16) { // AES-128 requires at least 16 bytes
-            logMessage("Invalid shared secret size", LOG_ERROR);
-            return;
-        }
-        std::copy_n(decryptedSharedSecret.begin(), 16, client.sharedSecret.begin());
-
-        // Step 8: Initialize AES/CFB8 encryption and decryption contexts
-        client.encryptCtx = EVP_CIPHER_CTX_new();
-        client.decryptCtx = EVP_CIPHER_CTX_new();
-        if (!client.encryptCtx || !client.decryptCtx) {
-            logMessage("Failed to create AES cipher contexts", LOG_ERROR);
-            sendDisconnectionPacket(client, "Failed to create AES cipher contexts");
-            return;
-        }
+    // Step 8: Initialize AES/CFB8 encryption and decryption contexts
+    EVP_CIPHER_CTX* encryptCtx = EVP_CIPHER_CTX_new();
+    EVP_CIPHER_CTX* decryptCtx = EVP_CIPHER_CTX_new();
+    if (!encryptCtx || !decryptCtx) {
+        logMessage("Failed to create AES cipher contexts", LOG_ERROR);
+        EVP_CIPHER_CTX_free(encryptCtx);
+        EVP_CIPHER_CTX_free(decryptCtx);
+        sendDisconnectionPacket(client, "Failed to create AES cipher contexts");
+        return false;
+    }
 
-        // Initialize encryption context (AES-128-CFB8)
-        if (EVP_EncryptInit_ex(client.encryptCtx, EVP_aes_128_cfb8(), nullptr, client.sharedSecret.data(), client.sharedSecret.data()) != 1) {
-            logMessage("Failed to initialize AES encryption context", LOG_ERROR);
-            sendDisconnectionPacket(client, "Failed to initialize AES encryption context");
-            return;
-        }
+    // Initialize encryption context (AES-128-CFB8)
+    if (EVP_EncryptInit_ex(encryptCtx, EVP_aes_128_cfb8(), nullptr, client.sharedSecret.data(), client.sharedSecret.data()) != 1) {
+        logMessage("Failed to initialize AES encryption context", LOG_ERROR);
+        EVP_CIPHER_CTX_free(encryptCtx);
+        EVP_CIPHER_CTX_free(decryptCtx);
+        sendDisconnectionPacket(client, "Failed to initialize AES encryption context");
+        return false;
+    }
 
-        // Initialize decryption context (AES-128-CFB8)
-        if (EVP_DecryptInit_ex(client.decryptCtx, EVP_aes_128_cfb8(), nullptr, client.sharedSecret.data(), client.sharedSecret.data()) != 1) {
-            logMessage("Failed to initialize AES decryption context", LOG_ERROR);
-            sendDisconnectionPacket(client, "Failed to initialize AES decryption context");
-            return;
-        }
+    // Initialize decryption context (AES-128-CFB8)
+    if (EVP_DecryptInit_ex(decryptCtx, EVP_aes_128_cfb8(), nullptr, client.sharedSecret.data(), client.sharedSecret.data()) != 1) {
+        logMessage("Failed to initialize AES decryption context", LOG_ERROR);
+        EVP_CIPHER_CTX_free(encryptCtx);
+        EVP_CIPHER_CTX_free(decryptCtx);
+        sendDisconnectionPacket(client, "Failed to initialize AES decryption context");
+        return false;
     }
 
+    {
+        std::lock_guard lock(client.sendMutex);
+        client.encryptCtx = encryptCtx;
+    }
+    client.decryptCtx = decryptCtx;
+    // Anything the client sent after this packet is already encrypted
+    if (!client.receiveBuffer.decryptUnread(client.decryptCtx)) {
+        return false;
+    }
     // ************ Encryption Setup Complete ************
 
-    // ************ Step 3: Online Mode Authentication ************
-    std::pair<std::string, std::string> texturesPair;
-    if (serverConfig.onlineMode) {
-        // Step 3.1: Compute Server Hash
-        std::string serverId = serverConfig.serverId; // Ensure you have initialized server_id
-        std::string serverHash = computeServerHash(serverId, client.sharedSecret, registryManager.getRSAKeyPair().getPublicKeyDER());
+    return resolveLoginProfile(client);
+}
 
-        // Step 3.2: Get Client's IP Address
-        std::string clientIP = getClientIPAddress(client);
+bool handleEncryptionResponse(ClientConnection& client, const std::vector<uint8_t>& packetData, size_t index) {
+    if (!serverConfig.enableEncryption || client.loginName.empty() || client.decryptCtx || !client.keyPair) {
+        logMessage("Unexpected Encryption Response packet", LOG_ERROR);
+        return false;
+    }
 
-        // Step 3.3: Authenticate with Mojang
-        std::string authenticatedUUID;
-        std::string authenticatedName;
-        bool authSuccess = authenticatePlayer(playerName, serverHash, clientIP, authenticatedUUID, authenticatedName, texturesPair);
+    // Parse Encryption Response
+    // Encrypted Shared Secret
+    int32_t encryptedSharedSecretLength = parseVarInt(packetData, index);
+    std::vector<uint8_t> encryptedSharedSecret = parseBytes(packetData, index, encryptedSharedSecretLength);
 
-        if (!authSuccess) {
-            sendDisconnectionPacket(client, "Authentication with Mojang failed. Disconnecting.");
-            return;
-        }
+    // Encrypted Verify Token
+    int32_t encryptedVerifyTokenLength = parseVarInt(packetData, index);
+    std::vector<uint8_t> encryptedVerifyToken = parseBytes(packetData, index, encryptedVerifyTokenLength);
 
-        // Verify that the authenticatedName matches the provided playerName
-        if (authenticatedName != playerName) {
-            logMessage("Player name mismatch: " + authenticatedName + " != " + playerName, LOG_ERROR);
-            sendDisconnectionPacket(client, "Player name mismatch. Disconnecting.");
-            return;
+    // Step 5: Decrypt Shared Secret and Verify Token using server's private key
+    std::shared_ptr<const RSAKeyPair> keyPair = client.keyPair;
+    auto decrypt = [keyPair, encryptedSharedSecret, encryptedVerifyToken]() -> std::optional<std::pair<std::vector<uint8_t>, std::vector<uint8_t>>> {
+        try {
+            return std::make_pair(keyPair->decrypt(encryptedSharedSecret), keyPair->decrypt(encryptedVerifyToken));
+        } catch (const std::exception& e) {
+            logMessage(std::string("Failed to decrypt Encryption Response: ") + e.what(), LOG_ERROR);
+            return std::nullopt;
         }
+    };
 
-        playerUUID = authenticatedUUID;
-        logMessage("Player authenticated: " + authenticatedName + " (" + authenticatedUUID + ")", LOG_DEBUG);
-    } else {
-        // Offline Mode: Use the client-provided UUID
-        logMessage("Offline Mode: Using client-provided UUID: " + playerUUID, LOG_DEBUG);
+    if (!client.loop || !loginCryptoPool) {
+        auto decrypted = decrypt();
+        return decrypted && completeKeyExchange(client, decrypted->first, decrypted->second);
     }
 
-
-    if (serverConfig.enableCompression) {
-        sendSetCompressionPacket(client, serverConfig.compressionThreshold);
-        client.compressionEnabled = true;
+    // RSA decryption is expensive, it runs on the bounded login pool instead of the event loop
+    if (pendingKeyExchanges.fetch_add(1) >= serverConfig.maxPendingKeyExchanges) {
+        pendingKeyExchanges.fetch_sub(1);
+        logMessage("Too many pending logins, rejecting " + client.loginName, LOG_WARNING);
+        sendDisconnectionPacket(client, "Server is busy, try again later.");
+        return false;
     }
 
-    // Create a new Player instance
-    std::shared_ptr<Player> newPlayer = EntityFactory::createPlayer(uuidBytes, playerName);
+    auto countedDecrypt = [decrypt]() {
+        auto decrypted = decrypt();
+        pendingKeyExchanges.fetch_sub(1);
+        return decrypted;
+    };
+    return runOffLoop(client, *loginCryptoPool, countedDecrypt, [](ClientConnection& client, const auto& decrypted) {
+        return decrypted && completeKeyExchange(client, decrypted->first, decrypted->second);
+    });
+}
 
-    // Assign a unique Entity ID
-    newPlayer->uuidString = playerUUID;
-    newPlayer->properties = {}; // Populate as needed
-    newPlayer->gameMode = CREATIVE;
-    newPlayer->listed = true;
-    newPlayer->ping = -1; // Unknown initially
-    newPlayer->setClient(&client);
-    if (texturesPair.first.empty() || texturesPair.second.empty()) {
-        texturesPair = fetchPlayerSkin(newPlayer->uuidString);
-        if (!texturesPair.first.empty() && !texturesPair.second.empty()) {
-            newPlayer->properties["textures"] = { texturesPair.first, texturesPair.second };
-        } else {
-            // Assign a default skin if fetching fails
-            std::string defaultSkin = "eyJ0aW1lc3RhbXAiOjE1OTA0ODEyMDAwMDAsInByb2ZpbGVJZCI6InV1aWQiLCJwcm9maWxlTmFtZSI6InBsYXllck5hbWUiLCJ0ZXh0dXJlcyI6eyJTS0lOIjp7InVybCI6Imh0dHA6Ly90ZXh0dXJlcy5taW5lY3JhZnQubmV0L3RleHR1cmUvczg2YzIyYjYyMmY2Y2E3ZTJmZjhkNTYyN2FkNDMxMDgyMjYyYzE5ZTM5MjMxYjI1YjczNGNiZDI0N2EwMjA4ZCJ9fX0=";
-            newPlayer->properties["textures"] = { defaultSkin, "" };
+bool handleLoginPacket(ClientConnection& client, const std::vector<uint8_t>& packetData, size_t index, int32_t packetID) {
+    if (client.player) {
+        // Only the Login Acknowledged packet is expected after Login Success
+        if (packetID != LOGIN_ACKNOWLEDGE) {
+            logMessage("Expected Login Acknowledged packet (ID 0x03), but received packet ID: " + std::to_string(packetID), LOG_ERROR);
+            return false;
         }
-    } else {
-        newPlayer->properties["textures"] = { texturesPair.first, texturesPair.second };
+        // Now in Configuration state
+        client.state = ClientState::Configuration;
+        return true;
     }
 
-    // Add the new player to the global player list
-    {
-        std::lock_guard lock(playersMutex);
-        globalPlayers[playerUUID] = newPlayer;
-        globalPlayersName[playerName] = newPlayer;
+    switch (packetID) {
+        case LOGIN_START:
+            return handleLoginStart(client, packetData, index);
+        case ENCRYPTION_RESPONSE:
+            return handleEncryptionResponse(client, packetData, index);
+        default:
+            logMessage("Unexpected login packet ID: " + std::to_string(packetID), LOG_ERROR);
+            return false;
     }
+}
 
-    // Increase player count
-    ++playerCount;
-
-    // Send Login Success packet
-    std::vector<uint8_t> responseData;
-    responseData.push_back(LOGIN_SUCCESS);
-
-    // Append UUID (16 bytes)
-    responseData.insert(responseData.end(), uuidBytes.begin(), uuidBytes.end());
+bool handleHandshake(ClientConnection& client, const std::vector<uint8_t>& packetData, size_t index, int32_t packetID) {
+    if (packetID != HANDSHAKE) {
+        logMessage("Invalid Handshake packet ID: " + std::to_string(packetID), LOG_ERROR);
+        return false;
+    }
 
-    // Append Username (String)
-    writeString(responseData, newPlayer->name);
+    // Handshake packet
+    int32_t protocolVersion = parseVarInt(packetData, index);
+    std::string serverAddress = parseString(packetData, index);
+    uint16_t serverPort = (packetData[index] << 8) | packetData[index + 1];
+    index += 2;
+    int32_t nextState = parseVarInt(packetData, index);
 
-    // Number Of Properties (VarInt)
-    writeVarInt(responseData, 0); // For now no properties
+    if (nextState == 1) {
+        // Status Request
+        client.state = ClientState::Status;
+        return true;
+    }
+    if (nextState == 2) {
+        // Login Request
+        client.registryManager = std::make_unique<RegistryManager>();
+        client.state = ClientState::Login;
+        return true;
+    }
+    return false;
+}
 
-    // Strict Error Handling (Boolean)
-    responseData.push_back(0x00); // TODO: Only in versions before 1.21.2 and 1.20.5+
+bool handleIncomingPacket(ClientConnection& client, const std::vector<uint8_t>& packetData) {
+    size_t index = 0;
+    int32_t packetID = parseVarInt(packetData, index);
 
-    // Build and send the packet
-    sendPacket(client, responseData);
+    switch (client.state) {
+        case ClientState::Handshake:
+            return handleHandshake(client, packetData, index, packetID);
+        case ClientState::Status:
+            return handleStatusPacket(client, packetData, index, packetID);
+        case ClientState::Login:
+            return handleLoginPacket(client, packetData, index, packetID);
+        case ClientState::Configuration:
+            return handleConfigurationPacket(client, packetData, index, packetID);
+        case ClientState::Play:
+        case ClientState::AwaitingTeleportConfirm:
+            handleClientPacket(client, packetData, client.player, *client.registryManager);
+            return true;
+    }
+    return false;
+}
 
-    // ************ Wait for Login Acknowledged Packet ************
-    std::vector<uint8_t> ackPacket;
-    if (!readPacket(client, ackPacket)) {
-        logMessage("Failed to read Login Acknowledged packet", LOG_ERROR);
+void handleConnectionClosed(ClientConnection& client) {
+    if (client.connectionClosed || !client.player) {
+        client.connectionClosed = true;
         return;
     }
 
-    size_t ackIndex = 0;
-    int32_t ackPacketID = parseVarInt(ackPacket, ackIndex);
-    if (ackPacketID != LOGIN_ACKNOWLEDGE) {
-        logMessage("Expected Login Acknowledged packet (ID 0x03), but received packet ID: " + std::to_string(ackPacketID), LOG_ERROR);
+    if (client.state == ClientState::Play || client.state == ClientState::AwaitingTeleportConfirm) {
+        disconnectClient(client.player, "Player disconnected", false);
         return;
     }
 
-    // Now in Configuration state
-    client.state = ClientState::Configuration;
-    if(!handleConfigurationState(client, registryManager, *newPlayer)) {
-        return;
+    // The player never finished joining, only undo the login bookkeeping
+    client.connectionClosed = true;
+    {
+        std::lock_guard lock(playersMutex);
+        globalPlayersName.erase(client.player->name);
+        globalPlayers.erase(client.player->uuidString);
     }
+    --playerCount;
+    entityManager.removeEntity(client.player->uuidString);
+}
 
-    sendTranslatedChatMessage("multiplayer.player.joined", false, "yellow", nullptr, true, newPlayer->name);
+ClientConnection::ClientConnection() = default;
 
-    // Now in Play state
-    client.state = ClientState::Play;
-    handlePlayState(client, newPlayer, registryManager);
+ClientConnection::~ClientConnection() {
+    EVP_CIPHER_CTX_free(encryptCtx);
+    EVP_CIPHER_CTX_free(decryptCtx);
 }
 
+// Thread-per-connection fallback for platforms without an event loop
 void handleClient(SocketType clientSocket) {
-    ClientConnection client;
-    client.socket = clientSocket;
-    client.state = ClientState::Handshake;
+    auto client = std::make_shared<ClientConnection>();
+    client->socket = clientSocket;
+    client->state = ClientState::Handshake;
 
     // Set a timeout for the socket
 #ifdef _WIN32
-    DWORD timeout = 5000; // 5 seconds
+    DWORD timeout = CLIENT_TIMEOUT_SECONDS * 1000;
     setsockopt(clientSocket, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char *>(&timeout), sizeof(timeout));
 #else
     struct timeval tv;
-    tv.tv_sec = 5;
+    tv.tv_sec = CLIENT_TIMEOUT_SECONDS;
     tv.tv_usec = 0;
     setsockopt(clientSocket, SOL_SOCKET, SO_RCVTIMEO, (const char*)&tv, sizeof(tv));
 #endif
 
     try {
-        // Read initial packet (Handshake)
-        std::vector<uint8_t> packetData;
-        if (!readUnencryptedPacket(client, packetData)) {
-            // Close socket and return
-            return;
-        }
-
-        size_t index = 0;
-        int32_t packetID = parseVarInt(packetData, index);
-
-        if (packetID == HANDSHAKE) {
-            // Handshake packet
-            int32_t protocolVersion = parseVarInt(packetData, index);
-            std::string serverAddress = parseString(packetData, index);
-            uint16_t serverPort = (packetData[index] << 8) | packetData[index + 1];
-            index += 2;
-            int32_t nextState = parseVarInt(packetData, index);
-
-            if (nextState == 1) {
-                // Status Request
-                handleStatusRequest(client);
-            } else if (nextState == 2) {
-                RegistryManager registryManager;
-                // Login Request
-                handleLoginRequest(client, registryManager);
+        while (!client->connectionClosed) {
+            std::vector<uint8_t> packetData;
+            if (!readPacket(*client, packetData)) {
+                break;
+            }
+            if (!handleIncomingPacket(*client, packetData)) {
+                break;
             }
-        } else {
-            logMessage("Invalid Handshake packet ID: " + std::to_string(packetID), LOG_ERROR);
-            return;
         }
     } catch (const std::exception& e) {
         logMessage("Client disconnected with error: " + std::string(e.what()), LOG_ERROR);
-        sendDisconnectionPacket(client, "Disconnected with error");
+        sendDisconnectionPacket(*client, "Disconnected with error");
     }
 
+    handleConnectionClosed(*client);
+
     // Close socket
+    std::lock_guard lock(client->sendMutex);
 #ifdef _WIN32
     closesocket(clientSocket);
 #else
     close(clientSocket);
 #endif
 }
-
-
@@ -2,6 +2,8 @@
 #define CLIENT_H
 
 #include <array>
+#include <atomic>
+#include <chrono>
 #include <memory>
 #include <mutex>
 #include <unordered_map>
@@ -9,8 +11,13 @@
 #include <openssl/types.h>
 
 #include "network.h"
+#include "outbound_queue.h"
+#include "receive_buffer.h"
 
 struct Player;
+class EventLoop;
+class RegistryManager;
+class RSAKeyPair;
 
 enum class ClientState {
     Handshake,
@@ -21,26 +28,50 @@ enum class ClientState {
     AwaitingTeleportConfirm,
 };
 
-struct ClientConnection {
-    SocketType socket;
-    ClientState state;
+struct ClientConnection : std::enable_shared_from_this<ClientConnection> {
+    SocketType socket = INVALID_SOCKET;
+    ClientState state = ClientState::Handshake;
 
-    EVP_CIPHER_CTX* encryptCtx;
-    EVP_CIPHER_CTX* decryptCtx;
+    EVP_CIPHER_CTX* encryptCtx = nullptr;
+    EVP_CIPHER_CTX* decryptCtx = nullptr;
     // Shared secret
-    std::array<uint8_t, 16> sharedSecret;
+    std::array<uint8_t, 16> sharedSecret{};
 
-    bool compressionEnabled = false;
+    std::atomic<bool> compressionEnabled = false;
     std::mutex sendMutex;
 
     // For teleport confirmation tracking
     std::mutex mutex;
     std::unordered_set<int32_t> pendingTeleportIDs;
-    bool connectionClosed = false;
+    std::atomic<bool> connectionClosed = false;
     int64_t keepAliveID = 0;
+
+    // Event loop owning the socket (nullptr when the connection runs on its own thread)
+    EventLoop* loop = nullptr;
+    // Received bytes that haven't been framed into packets yet
+    ReceiveBuffer receiveBuffer;
+    // Encoded packets waiting for the event loop to write them
+    OutboundQueue outbound;
+    // Set while an asynchronous step (e.g. authentication) is running, buffered packets wait for it
+    bool dispatchPaused = false;
+    std::chrono::steady_clock::time_point lastPacketTime = std::chrono::steady_clock::now();
+
+    // Login state, kept between the Login Start and Encryption Response packets
+    std::string loginName;
+    std::string loginUUID;
+    std::array<uint8_t, 16> verifyToken{};
+    // Server key pair whose public key was sent in the Encryption Request
+    std::shared_ptr<const RSAKeyPair> keyPair;
+    std::unique_ptr<RegistryManager> registryManager;
+    std::shared_ptr<Player> player;
+
+    ClientConnection();
+    ~ClientConnection();
 };
 
 void disconnectClient(const std::shared_ptr<Player>& player, const std::string& reason, bool disconnectPacket);
+bool handleIncomingPacket(ClientConnection& client, const std::vector<uint8_t>& packetData);
+void handleConnectionClosed(ClientConnection& client);
 void handleClient(SocketType clientSock);
 void handleConsoleCommand(const std::string & command);
 void miningScheduler(std::unordered_map<std::string, std::shared_ptr<Player>> &players, std::atomic<bool> &running);
@@ -1,5 +1,8 @@
 #include "clientbound_packets.h"
 
+#include <algorithm>
+#include <optional>
+
 #include "registries/biome.h"
 #include "core/config.h"
 #include "registries/damage_type.h"
@@ -16,9 +19,22 @@
 #include "utils/translation.h"
 #include "world/boss_bar.h"
 
-void sendRemoveEntityPacket(const int32_t& entityID) {
-    std::vector<uint8_t> packetData;
-    packetData.push_back(REMOVE_ENTITIES);
+namespace {
+    // Configuration phase packets, the same for every connection. Built once by buildConfigurationPackets.
+    struct ConfigurationPackets {
+        std::vector<CachedPacket> registryData;
+        // Chat types in registry order
+        std::vector<std::string> chatTypes;
+        std::optional<CachedPacket> updateTags;
+        std::optional<CachedPacket> commands;
+        std::optional<CachedPacket> knownPacks;
+    };
+
+    ConfigurationPackets configurationPackets;
+}
+
+void sendRemoveEntityPacket(ClientConnection& client, int32_t entityID) {
+    PacketWriter packetData(REMOVE_ENTITIES);
 
     // Number of Entities (VarInt)
     writeVarInt(packetData, 1);
@@ -26,30 +42,25 @@ void sendRemoveEntityPacket(const int32_t& entityID) {
     // Entity IDs (VarInt)
     writeVarInt(packetData, entityID);
 
-    // Build and send the packet to all clients
-    broadcastToOthers(packetData);
+    // Build and send the packet
+    sendPacket(client, std::move(packetData));
 }
 
 void sendPlayerInfoRemove(const std::shared_ptr<Player>& player) {
-    std::vector<uint8_t> packetData;
-    packetData.push_back(PLAYER_INFO_REMOVE);
+    PacketWriter packetData(PLAYER_INFO_REMOVE);
 
     // Number Of Players (VarInt)
     writeVarInt(packetData, 1); // Removing one player
 
     // Player UUID (16 bytes)
-    packetData.insert(packetData.end(), player->uuid.begin(), player->uuid.end());
+    packetData.append(player->uuid.begin(), player->uuid.end());
 
     // Send to all connected clients
-    std::lock_guard lock(connectedClientsMutex);
-    for (auto &existingClient: connectedClients | std::views::values) {
-        sendPacket(*existingClient, packetData);
-    }
+    broadcastToOthers(packetData);
 }
 
-void sendRegistryDataPacket(ClientConnection& client, RegistryManager& registryManager) {
-    std::vector<uint8_t> packetData;
-    packetData.push_back(REGISTRY_DATA);
+bool buildRegistryDataPackets(std::vector<PacketWriter>& packets, std::vector<std::string>& chatTypeIdentifiers) {
+    PacketWriter packetData(REGISTRY_DATA);
 
     // --- Registry 1: dimension_type ---
     writeString(packetData, "minecraft:dimension_type"); // Registry Identifier
@@ -58,7 +69,7 @@ void sendRegistryDataPacket(ClientConnection& client, RegistryManager& registryM
     std::vector<DimensionType> dimensions;
     if (!loadDimensionTypesFromCompoundFile("../resources/registry_data.json", dimensions)) {
         logMessage("Failed to load dimension data.", LOG_ERROR);
-        return;
+        return false;
     }
 
     // Number of entries in dimension_type
@@ -77,11 +88,10 @@ void sendRegistryDataPacket(ClientConnection& client, RegistryManager& registryM
         std::vector<uint8_t> nbtDimenionTypeData = serializeNBT(nbtDimenionType, true);
 
         // Append the NBT data
-        packetData.insert(packetData.end(), nbtDimenionTypeData.begin(), nbtDimenionTypeData.end());
+        packetData.append(nbtDimenionTypeData.begin(), nbtDimenionTypeData.end());
     }
 
-    // Build and send the packet
-    sendPacket(client, packetData);
+    packets.push_back(packetData);
 
     // --- Registry 2: biome ---
     packetData.clear();
@@ -92,7 +102,7 @@ void sendRegistryDataPacket(ClientConnection& client, RegistryManager& registryM
     std::vector<BiomeRegistryEntry> biomeEntries;
     if (!loadBiomesFromCompoundFile("../resources/registry_data.json", biomeEntries)) {
         logMessage("Failed to load biomes from registry_data.json.", LOG_ERROR);
-        return;
+        return false;
     }
 
     // Number of entries in biome
@@ -119,7 +129,7 @@ void sendRegistryDataPacket(ClientConnection& client, RegistryManager& registryM
             nbt::tag_compound nbtBiome = biome.serialize();
             std::vector<uint8_t> nbtBiomeData = serializeNBT(nbtBiome, true);
             // Append the NBT data
-            packetData.insert(packetData.end(), nbtBiomeData.begin(), nbtBiomeData.end());
+            packetData.append(nbtBiomeData.begin(), nbtBiomeData.end());
         } else if (entry.type == BiomeRegistryEntry::Type::Tag && entry.tag.has_value()) {
             continue;
         } else {
@@ -128,8 +138,7 @@ void sendRegistryDataPacket(ClientConnection& client, RegistryManager& registryM
         }
     }
 
-    // Build and send the packet
-    sendPacket(client, packetData);
+    packets.push_back(packetData);
 
     // --- Registry 3: painting_variant ---
     packetData.clear();
@@ -140,7 +149,7 @@ void sendRegistryDataPacket(ClientConnection& client, RegistryManager& registryM
     std::vector<PaintingVariant> paintingVariants;
     if (!loadPaintingVariantsFromCompoundFile("../resources/registry_data.json", paintingVariants)) {
         logMessage("Failed to load painting variants from registry_data.json.", LOG_ERROR);
-        return;
+        return false;
     }
 
     // Number of entries in painting_variant
@@ -159,11 +168,10 @@ void sendRegistryDataPacket(ClientConnection& client, RegistryManager& registryM
         std::vector<uint8_t> nbtPaintingVariantData = serializeNBT(nbtPaintingVariant, true);
 
         // Append the NBT data
-        packetData.insert(packetData.end(), nbtPaintingVariantData.begin(), nbtPaintingVariantData.end());
+        packetData.append(nbtPaintingVariantData.begin(), nbtPaintingVariantData.end());
     }
 
-    // Build and send the packet
-    sendPacket(client, packetData);
+    packets.push_back(packetData);
 
     // --- Registry 4: wolf_variant ---
     packetData.clear();
@@ -174,7 +182,7 @@ void sendRegistryDataPacket(ClientConnection& client, RegistryManager& registryM
     std::vector<WolfVariant> wolfVariants;
     if (!loadWolfVariantsFromCompoundFile("../resources/registry_data.json", wolfVariants)) {
         logMessage("Failed to load wolf variants from registry_data.json.", LOG_ERROR);
-        return;
+        return false;
     }
 
     // Number of entries in wolf_variant
@@ -193,11 +201,10 @@ void sendRegistryDataPacket(ClientConnection& client, RegistryManager& registryM
         std::vector<uint8_t> nbtWolfVariantData = serializeNBT(nbtWolfVariant, true);
 
         // Append the NBT data
-        packetData.insert(packetData.end(), nbtWolfVariantData.begin(), nbtWolfVariantData.end());
+        packetData.append(nbtWolfVariantData.begin(), nbtWolfVariantData.end());
     }
 
-    // Build and send the packet
-    sendPacket(client, packetData);
+    packets.push_back(packetData);
 
     // --- Registry 5: damage_type ---
     packetData.clear();
@@ -208,7 +215,7 @@ void sendRegistryDataPacket(ClientConnection& client, RegistryManager& registryM
     std::vector<DamageType> damageTypes;
     if (!loadDamageTypesFromCompoundFile("../resources/registry_data.json", damageTypes)) {
         logMessage("Failed to load damage types from registry_data.json.", LOG_ERROR);
-        return;
+        return false;
     }
 
     // Number of entries in damage_type
@@ -227,11 +234,10 @@ void sendRegistryDataPacket(ClientConnection& client, RegistryManager& registryM
         std::vector<uint8_t> nbtDamageTypeData = serializeNBT(nbtDamageType, true);
 
         // Append the NBT data
-        packetData.insert(packetData.end(), nbtDamageTypeData.begin(), nbtDamageTypeData.end());
+        packetData.append(nbtDamageTypeData.begin(), nbtDamageTypeData.end());
     }
 
-    // Build and send the packet
-    sendPacket(client, packetData);
+    packets.push_back(packetData);
 
     // --- Registry 6: chat_type ---
     packetData.clear();
@@ -272,18 +278,27 @@ void sendRegistryDataPacket(ClientConnection& client, RegistryManager& registryM
         std::vector<uint8_t> nbtChatTypeData = serializeNBT(nbtChatType, true);
 
         // Append the NBT data
-        packetData.insert(packetData.end(), nbtChatTypeData.begin(), nbtChatTypeData.end());
+        packetData.append(nbtChatTypeData.begin(), nbtChatTypeData.end());
 
-        registryManager.addRegistryEntry("minecraft:chat_type", chatType.identifier);
+        chatTypeIdentifiers.push_back(chatType.identifier);
     }
 
-    // Build and send the packet
-    sendPacket(client, packetData);
+    packets.push_back(packetData);
+    return true;
+}
+
+void sendRegistryDataPacket(ClientConnection& client, RegistryManager& registryManager) {
+    for (const auto& packet : configurationPackets.registryData) {
+        sendCachedPacket(client, packet);
+    }
+    // The chat type IDs are the order they were sent in
+    for (const auto& identifier : configurationPackets.chatTypes) {
+        registryManager.addRegistryEntry("minecraft:chat_type", identifier);
+    }
 }
 
 void sendWorldEventPacket(ClientConnection& client, const int& worldEvent, const Position& position, const int& data) {
-    std::vector<uint8_t> packetData;
-    packetData.push_back(WORLD_EVENT);
+    PacketWriter packetData(WORLD_EVENT);
 
     // World Event (Int)
     writeInt(packetData, worldEvent);
@@ -302,12 +317,11 @@ void sendWorldEventPacket(ClientConnection& client, const int& worldEvent, const
     }
 
     // Build and send the packet
-    sendPacket(client, packetData);
+    sendPacket(client, std::move(packetData));
 }
 
-bool sendUpdateTagsPacket(ClientConnection& client) {
-    std::vector<uint8_t> packetData;
-    packetData.push_back(UPDATE_TAGS);
+bool buildUpdateTagsPacket(PacketWriter& packetData) {
+    packetData = PacketWriter(UPDATE_TAGS);
 
     // Number of Tags to update
     writeVarInt(packetData, 2);
@@ -361,15 +375,15 @@ bool sendUpdateTagsPacket(ClientConnection& client) {
         }
     }
 
-    // Build and send the packet
-    sendPacket(client, packetData);
-
     return true;
 }
 
+bool sendUpdateTagsPacket(ClientConnection& client) {
+    return configurationPackets.updateTags && sendCachedPacket(client, *configurationPackets.updateTags);
+}
+
 void sendJoinGamePacket(ClientConnection& client, int32_t entityID) {
-    std::vector<uint8_t> packetData;
-    packetData.push_back(LOGIN);
+    PacketWriter packetData(LOGIN);
 
     // 1. Entity ID (Int)
     writeInt(packetData, entityID);
@@ -434,12 +448,11 @@ void sendJoinGamePacket(ClientConnection& client, int32_t entityID) {
     //packetData.push_back(0x00); // 0 (unused, required in 1.21.3)
 
     // Build and send the packet
-    sendPacket(client, packetData);
+    sendPacket(client, std::move(packetData));
 }
 
 void sendSynchronizePlayerPositionPacket(ClientConnection& client, const std::shared_ptr<Player> &player) {
-    std::vector<uint8_t> packetData;
-    packetData.push_back(SYNCHRONIZE_PLAYER_POSITION);
+    PacketWriter packetData(SYNCHRONIZE_PLAYER_POSITION);
 
     if(player->newSpawn) {
         // If the player's position is not set, use the spawn position
@@ -480,15 +493,15 @@ void sendSynchronizePlayerPositionPacket(ClientConnection& client, const std::sh
     }
 
     // Build and send the packet
-    sendPacket(client, packetData);
+    sendPacket(client, std::move(packetData));
 
     // Update client state to AwaitingTeleportConfirm
     client.state = ClientState::AwaitingTeleportConfirm;
 }
 
 void sendEntityRelativeMovePacket(const std::shared_ptr<Entity>& entity, short deltaX, short deltaY, short deltaZ) {
-    std::vector<uint8_t> packetData;
-    packetData.push_back(UPDATE_ENTITY_POSITION);
+    PacketWriter packetData(UPDATE_ENTITY_POSITION);
+    packetData.compressionClass = CompressionClass::Movement;
 
     // Entity ID (VarInt)
     writeVarInt(packetData, entity->entityID);
@@ -500,13 +513,13 @@ void sendEntityRelativeMovePacket(const std::shared_ptr<Entity>& entity, short d
     // On Ground (Boolean)
     packetData.push_back(entity->onGround ? 0x01 : 0x00);
 
-    // Broadcast to all other clients
-    broadcastToOthers(packetData);
+    // Send to the players tracking the entity
+    entityTracker.broadcast(entity->entityID, packetData);
 }
 
 void sendPlayerRelativeMovePacket(const std::shared_ptr<Player>& player, short deltaX, short deltaY, short deltaZ) {
-    std::vector<uint8_t> packetData;
-    packetData.push_back(UPDATE_ENTITY_POSITION);
+    PacketWriter packetData(UPDATE_ENTITY_POSITION);
+    packetData.compressionClass = CompressionClass::Movement;
 
     // Entity ID (VarInt)
     writeVarInt(packetData, player->entityID);
@@ -518,13 +531,13 @@ void sendPlayerRelativeMovePacket(const std::shared_ptr<Player>& player, short d
     // On Ground (Boolean)
     packetData.push_back(player->onGround ? 0x01 : 0x00);
 
-    // Broadcast to all other clients
-    broadcastToOthers(packetData, player->uuidString);
+    // Send to the players tracking the entity
+    entityTracker.broadcast(player->entityID, packetData);
 }
 
 void sendEntityLookAndRelativeMovePacket(const std::shared_ptr<Player>& player, short deltaX, short deltaY, short deltaZ, float yaw, float pitch) {
-    std::vector<uint8_t> packetData;
-    packetData.push_back(UPDATE_ENTITY_POSITION_AND_ROTATION);
+    PacketWriter packetData(UPDATE_ENTITY_POSITION_AND_ROTATION);
+    packetData.compressionClass = CompressionClass::Movement;
 
     // Entity ID (VarInt)
     writeVarInt(packetData, player->entityID);
@@ -543,13 +556,13 @@ void sendEntityLookAndRelativeMovePacket(const std::shared_ptr<Player>& player,
     // On Ground (Boolean)
     packetData.push_back(player->onGround ? 0x01 : 0x00);
 
-    // Broadcast to all other clients
-    broadcastToOthers(packetData, player->uuidString);
+    // Send to the players tracking the entity
+    entityTracker.broadcast(player->entityID, packetData);
 }
 
 void sendEntityRotationPacket(const std::shared_ptr<Player>& player) {
-    std::vector<uint8_t> packetData;
-    packetData.push_back(UPDATE_ENTITY_ROTATION);
+    PacketWriter packetData(UPDATE_ENTITY_ROTATION);
+    packetData.compressionClass = CompressionClass::Movement;
 
     // Entity ID (VarInt)
     writeVarInt(packetData, player->entityID);
@@ -564,13 +577,13 @@ void sendEntityRotationPacket(const std::shared_ptr<Player>& player) {
     // On Ground (Boolean)
     packetData.push_back(player->onGround ? 0x01 : 0x00);
 
-    // Broadcast to all other clients
-    broadcastToOthers(packetData, player->uuidString);
+    // Send to the players tracking the entity
+    entityTracker.broadcast(player->entityID, packetData);
 }
 
 void sendHeadRotationPacket(const std::shared_ptr<Player>& player) {
-    std::vector<uint8_t> packetData;
-    packetData.push_back(SET_HEAD_ROTATION);
+    PacketWriter packetData(SET_HEAD_ROTATION);
+    packetData.compressionClass = CompressionClass::Movement;
 
     // Entity ID (VarInt)
     writeVarInt(packetData, player->entityID);
@@ -579,13 +592,13 @@ void sendHeadRotationPacket(const std::shared_ptr<Player>& player) {
     auto headYawByte = static_cast<uint8_t>(player->rotation.headYaw / (360.0f / 256.0f));
     packetData.push_back(headYawByte);
 
-    // Broadcast to all other clients
-    broadcastToOthers(packetData, player->uuidString);
+    // Send to the players tracking the entity
+    entityTracker.broadcast(player->entityID, packetData);
 }
 
 void sendEntityTeleportPacket(const std::shared_ptr<Player>& player) {
-    std::vector<uint8_t> packetData;
-    packetData.push_back(TELEPORT_ENTITY);
+    PacketWriter packetData(TELEPORT_ENTITY);
+    packetData.compressionClass = CompressionClass::Movement;
 
     // Entity ID (VarInt)
     writeVarInt(packetData, player->entityID);
@@ -605,64 +618,18 @@ void sendEntityTeleportPacket(const std::shared_ptr<Player>& player) {
     // On Ground (Boolean)
     packetData.push_back(player->onGround ? 0x01 : 0x00);
 
-    // Broadcast to all other clients
-    broadcastToOthers(packetData, player->uuidString);
-}
-
-void sendSpawnEntityPacket(const std::shared_ptr<Entity>& entity) {
-    std::vector<uint8_t> packetData;
-    packetData.push_back(SPAWN_ENTITY);
-
-    // Entity ID (VarInt)
-    writeVarInt(packetData, entity->entityID);
-
-    // Entity UUID (UUID - 16 bytes)
-    packetData.insert(packetData.end(), entity->uuid.begin(), entity->uuid.end());
-
-    // Type (VarInt) - Entity type ID from minecraft:entity_type registry
-    writeVarInt(packetData, static_cast<int32_t>(entity->type));
-
-    // X, Y, Z (Double)
-    writeDouble(packetData, entity->getPositionX());
-    writeDouble(packetData, entity->getPositionY());
-    writeDouble(packetData, entity->getPositionZ());
-
-    // Pitch, Yaw, Head Yaw (Angles as bytes)
-    auto pitch = static_cast<uint8_t>(entity->rotation.pitch / (360.0f / 256.0f));
-    auto yaw = static_cast<uint8_t>(entity->rotation.yaw / (360.0f / 256.0f));
-    auto headYaw = static_cast<uint8_t>(entity->rotation.headYaw / (360.0f / 256.0f));
-
-    packetData.push_back(pitch);
-    packetData.push_back(yaw);
-    packetData.push_back(headYaw);
-
-    // Data - Additional data depending on entity type
-    std::vector<uint8_t> additionalData;
-    entity->serializeAdditionalData(additionalData);
-    writeVarInt(packetData, static_cast<int32_t>(additionalData.size()));
-    packetData.insert(packetData.end(), additionalData.begin(), additionalData.end());
-
-    // Velocity (Fixed-point, scaled by 8000)
-    auto fixedMotionX = static_cast<int16_t>(entity->getMotionX() * 8000);
-    auto fixedMotionY = static_cast<int16_t>(entity->getMotionY() * 8000);
-    auto fixedMotionZ = static_cast<int16_t>(entity->getMotionZ() * 8000);
-    writeShort(packetData, fixedMotionX);
-    writeShort(packetData, fixedMotionY);
-    writeShort(packetData, fixedMotionZ);
-
-    // Build and send the packet with length prefix
-    broadcastToOthers(packetData);
+    // Send to the players tracking the entity
+    entityTracker.broadcast(player->entityID, packetData);
 }
 
 void sendSpawnEntityPacket(ClientConnection& client, const std::shared_ptr<Entity>& entity) {
-    std::vector<uint8_t> packetData;
-    packetData.push_back(SPAWN_ENTITY);
+    PacketWriter packetData(SPAWN_ENTITY);
 
     // Entity ID (VarInt)
     writeVarInt(packetData, entity->entityID);
 
     // Entity UUID (UUID - 16 bytes)
-    packetData.insert(packetData.end(), entity->uuid.begin(), entity->uuid.end());
+    packetData.append(entity->uuid.begin(), entity->uuid.end());
 
     // Type (VarInt) - Entity type ID from minecraft:entity_type registry
     writeVarInt(packetData, static_cast<int32_t>(entity->type));
@@ -685,20 +652,19 @@ void sendSpawnEntityPacket(ClientConnection& client, const std::shared_ptr<Entit
     std::vector<uint8_t> additionalData;
     entity->serializeAdditionalData(additionalData);
     writeVarInt(packetData, static_cast<int32_t>(additionalData.size()));
-    packetData.insert(packetData.end(), additionalData.begin(), additionalData.end());
+    packetData.append(additionalData.begin(), additionalData.end());
 
-    // Velocity X, Y, Z (Short) - set to 0 for now
-    writeShort(packetData, 0); // Velocity X
-    writeShort(packetData, 0); // Velocity Y
-    writeShort(packetData, 0); // Velocity Z
+    // Velocity (Fixed-point, scaled by 8000)
+    writeShort(packetData, static_cast<int16_t>(entity->getMotionX() * 8000));
+    writeShort(packetData, static_cast<int16_t>(entity->getMotionY() * 8000));
+    writeShort(packetData, static_cast<int16_t>(entity->getMotionZ() * 8000));
 
     // Build and send the packet with length prefix
-    sendPacket(client, packetData);
+    sendPacket(client, std::move(packetData));
 }
 
 void sendEntityEventPacket(ClientConnection& client, int32_t entityID, uint8_t entityStatus) {
-    std::vector<uint8_t> packetData;
-    packetData.push_back(ENTITY_EVENT);
+    PacketWriter packetData(ENTITY_EVENT);
 
     // Entity ID (VarInt)
     writeInt(packetData, entityID);
@@ -707,12 +673,11 @@ void sendEntityEventPacket(ClientConnection& client, int32_t entityID, uint8_t e
     writeByte(packetData, entityStatus);
 
     // Build and send the packet
-    sendPacket(client, packetData);
+    sendPacket(client, std::move(packetData));
 }
 
 void sendPlayerInfoUpdate(ClientConnection& targetClient, const std::vector<std::shared_ptr<Player>>& playersToUpdate, uint8_t actions) {
-    std::vector<uint8_t> packetData = { };
-    packetData.push_back(PLAYER_INFO_UPDATE);
+    PacketWriter packetData(PLAYER_INFO_UPDATE);
 
     // Actions Byte
     packetData.push_back(actions);
@@ -722,7 +687,7 @@ void sendPlayerInfoUpdate(ClientConnection& targetClient, const std::vector<std:
 
     for (const auto& player : playersToUpdate) {
         // Append UUID (16 bytes)
-        packetData.insert(packetData.end(), player->uuid.begin(), player->uuid.end());
+        packetData.append(player->uuid.begin(), player->uuid.end());
 
         // Player Actions based on the actions byte
         if (actions & 0x01) { // Add Player
@@ -815,12 +780,11 @@ void sendPlayerInfoUpdate(ClientConnection& targetClient, const std::vector<std:
     }
 
     // Send the packet to the target client
-    sendPacket(targetClient, packetData);
+    sendPacket(targetClient, std::move(packetData));
 }
 
 void sendGameEventPacket(ClientConnection& targetClient, GameEvent event, float value) {
-    std::vector<uint8_t> packetData;
-    packetData.push_back(GAME_EVENT);
+    PacketWriter packetData(GAME_EVENT);
 
     // Event (Unsigned Byte)
     packetData.push_back(static_cast<uint8_t>(event));
@@ -829,12 +793,11 @@ void sendGameEventPacket(ClientConnection& targetClient, GameEvent event, float
     writeFloat(packetData, value);
 
     // Send the packet
-    sendPacket(targetClient, packetData);
+    sendPacket(targetClient, std::move(packetData));
 }
 
 void sendGameEvent(GameEvent event, float value) {
-    std::vector<uint8_t> packetData;
-    packetData.push_back(GAME_EVENT);
+    PacketWriter packetData(GAME_EVENT);
 
     // Event (Unsigned Byte)
     packetData.push_back(static_cast<uint8_t>(event));
@@ -852,8 +815,7 @@ void sendChangeGamemode(ClientConnection& client, const std::shared_ptr<Player>&
     }
 
 void sendRemoveEntitiesPacket(const std::vector<int32_t>& entityIDs) {
-    std::vector<uint8_t> packetData;
-    packetData.push_back(REMOVE_ENTITIES);
+    PacketWriter packetData(REMOVE_ENTITIES);
 
     // Number of Entities (VarInt)
     writeVarInt(packetData, static_cast<int32_t>(entityIDs.size()));
@@ -868,33 +830,29 @@ void sendRemoveEntitiesPacket(const std::vector<int32_t>& entityIDs) {
 }
 
 void sendTranslatedChatMessage(const std::string& key, const bool actionBar, const std::string& color, const std::vector<std::shared_ptr<Player>>* players, bool log, const std::vector<std::string>* args) {
-    std::vector<uint8_t> packetData = { };
-
     if (players == nullptr) {
         for (const auto &player: globalPlayers | std::views::values) {
-            packetData.clear();
-            packetData.push_back(SYSTEM_CHAT_MESSAGE);
+            PacketWriter packetData(SYSTEM_CHAT_MESSAGE);
 
             nbt::tag_compound textCompound = createTextComponent(getTranslation(key, player->lang, *args), color);
             std::vector<uint8_t> textData = serializeNBT(textCompound, true);
-            packetData.insert(packetData.end(), textData.begin(), textData.end());
+            packetData.append(textData.begin(), textData.end());
 
             writeByte(packetData, actionBar);
-            sendPacket(*player->client, packetData);
+            sendPacket(*player->client, std::move(packetData));
         }
     }
     else {
         for (const auto& player : *players) {
             if (player->client != nullptr) {
-                packetData.clear();
-                packetData.push_back(SYSTEM_CHAT_MESSAGE);
+                PacketWriter packetData(SYSTEM_CHAT_MESSAGE);
 
                 nbt::tag_compound textCompound = createTextComponent(getTranslation(key, player->lang, *args), color);
                 std::vector<uint8_t> textData = serializeNBT(textCompound, true);
-                packetData.insert(packetData.end(), textData.begin(), textData.end());
+                packetData.append(textData.begin(), textData.end());
 
                 writeByte(packetData, actionBar);
-                sendPacket(*player->client, packetData);
+                sendPacket(*player->client, std::move(packetData));
             }
         }
     }
@@ -904,12 +862,11 @@ void sendTranslatedChatMessage(const std::string& key, const bool actionBar, con
 }
 
 void sendChatMessage(const std::string& message, const bool actionBar, const std::string& color, const std::vector<std::shared_ptr<Player>>* players, bool log) {
-    std::vector<uint8_t> packetData = { };
-    packetData.push_back(SYSTEM_CHAT_MESSAGE);
+    PacketWriter packetData(SYSTEM_CHAT_MESSAGE);
 
     nbt::tag_compound textCompound = createTextComponent(message, color);
     std::vector<uint8_t> textData = serializeNBT(textCompound, true);
-    packetData.insert(packetData.end(), textData.begin(), textData.end());
+    packetData.append(textData.begin(), textData.end());
 
     writeByte(packetData, actionBar);
 
@@ -917,9 +874,10 @@ void sendChatMessage(const std::string& message, const bool actionBar, const std
         broadcastToOthers(packetData, "");
     }
     else {
+        EncodedPacket encoded(packetData);
         for (const auto& player : *players) {
             if (player->client != nullptr) {
-                sendPacket(*player->client, packetData);
+                sendEncodedPacket(*player->client, encoded);
             }
         }
     }
@@ -936,8 +894,7 @@ void sendChatMessage(const std::string& message, const bool actionBar, const std
 }
 
 void sendSetCenterChunkPacket(ClientConnection& targetClient, int32_t chunkX, int32_t chunkZ) {
-    std::vector<uint8_t> packetData = { };
-    packetData.push_back(SET_CENTER_CHUNK);
+    PacketWriter packetData(SET_CENTER_CHUNK);
 
     // Serialize Chunk X (VarInt)
     writeVarInt(packetData, chunkX);
@@ -946,17 +903,26 @@ void sendSetCenterChunkPacket(ClientConnection& targetClient, int32_t chunkX, in
     writeVarInt(packetData, chunkZ);
 
     // Send the packet to the target client
-   sendPacket(targetClient, packetData);
+    sendPacket(targetClient, std::move(packetData));
+}
+
+void sendUnloadChunkPacket(ClientConnection& targetClient, int32_t chunkX, int32_t chunkZ) {
+    PacketWriter packetData(UNLOAD_CHUNK);
+
+    // Chunk Z comes first (Int)
+    writeInt(packetData, chunkZ);
+    writeInt(packetData, chunkX);
+
+    sendPacket(targetClient, std::move(packetData));
 }
 
 void sendResourcePacks(ClientConnection& client) {
     for (const auto& pack : serverConfig.resourcePacks) {
-        std::vector<uint8_t> packetData;
-        writeVarInt(packetData, ADD_RESOURCE_PACK_PLAY);
+        PacketWriter packetData(ADD_RESOURCE_PACK_PLAY);
 
         // Resource Pack Push Fields
         std::array<uint8_t, 16> uuid = stringUUIDToBytes(pack.uuid);
-        packetData.insert(packetData.end(), uuid.begin(), uuid.end()); // UUID as bytes
+        packetData.append(uuid.begin(), uuid.end()); // UUID as bytes
         writeString(packetData, pack.url);  // URL to resource pack
         writeString(packetData, pack.hash); // SHA-1 hash
         writeByte(packetData, pack.forced ? 0x01 : 0x00); // Forced
@@ -973,13 +939,12 @@ void sendResourcePacks(ClientConnection& client) {
         }
 
         // Send the packet
-        sendPacket(client, packetData);
+        sendPacket(client, std::move(packetData));
     }
 }
 
 void sendRemoveResourcePacks(ClientConnection& client, const std::vector<std::string>& uuidsToRemove) {
-    std::vector<uint8_t> packetData;
-    writeVarInt(packetData, REMOVE_RESOURCE_PACK_CONFIG);
+    PacketWriter packetData(REMOVE_RESOURCE_PACK_CONFIG);
 
     if (uuidsToRemove.empty()) {
         // Remove all resource packs
@@ -993,12 +958,11 @@ void sendRemoveResourcePacks(ClientConnection& client, const std::vector<std::st
     }
 
     // Send the packet
-    sendPacket(client, packetData);
+    sendPacket(client, std::move(packetData));
 }
 
 bool sendKeepAlivePacket(ClientConnection& client) {
-    std::vector<uint8_t> packetData;
-    packetData.push_back(KEEP_ALIVE_PLAY);
+    PacketWriter packetData(KEEP_ALIVE_PLAY);
 
     // Keep Alive ID (Long)
     int64_t keepAliveID = std::chrono::system_clock::now().time_since_epoch().count();
@@ -1006,11 +970,11 @@ bool sendKeepAlivePacket(ClientConnection& client) {
     client.keepAliveID = keepAliveID;
 
     // Build and send the packet
-    return sendPacket(client, packetData);
+    return sendPacket(client, std::move(packetData));
 }
 
 void sendEntityMetadataPacket(const std::vector<MetadataEntry>& metadataEntries, int32_t entityID) {
-    std::vector<uint8_t> packetData = { };
+    PacketWriter packetData;
 
     // Packet ID for Entity Metadata
     packetData.push_back(SET_ENTITY_METADATA);
@@ -1027,18 +991,46 @@ void sendEntityMetadataPacket(const std::vector<MetadataEntry>& metadataEntries,
         writeVarInt(packetData, static_cast<int32_t>(entry.type));
 
         // Value (Varies based on type)
-        packetData.insert(packetData.end(), entry.value.begin(), entry.value.end());
+        packetData.append(entry.value.begin(), entry.value.end());
     }
 
     // Terminating Entry (0xFF)
     packetData.push_back(0xFF);
 
-    // Broadcast the packet to all other clients
-    broadcastToOthers(packetData);
+    // Send to the players tracking the entity
+    entityTracker.broadcast(entityID, packetData);
+}
+
+void sendEntityMetadataPacket(ClientConnection& client, const std::vector<MetadataEntry>& metadataEntries, int32_t entityID) {
+    PacketWriter packetData;
+
+    // Packet ID for Entity Metadata
+    packetData.push_back(SET_ENTITY_METADATA);
+
+    // Entity ID (VarInt)
+    writeVarInt(packetData, entityID);
+
+    // Add each Metadata Entry
+    for (const auto& entry : metadataEntries) {
+        // Index (Unsigned Byte)
+        packetData.push_back(entry.index);
+
+        // Type (VarInt Enum)
+        writeVarInt(packetData, static_cast<int32_t>(entry.type));
+
+        // Value (Varies based on type)
+        packetData.append(entry.value.begin(), entry.value.end());
+    }
+
+    // Terminating Entry (0xFF)
+    packetData.push_back(0xFF);
+
+    // Send the packet
+    sendPacket(client, std::move(packetData));
 }
 
 void sendEntityMetadataPacket(const std::shared_ptr<Player>& player, const std::vector<MetadataEntry>& metadataEntries, int32_t entityID) {
-    std::vector<uint8_t> packetData = { };
+    PacketWriter packetData;
 
     // Packet ID for Entity Metadata
     packetData.push_back(SET_ENTITY_METADATA);
@@ -1055,19 +1047,18 @@ void sendEntityMetadataPacket(const std::shared_ptr<Player>& player, const std::
         writeVarInt(packetData, static_cast<int32_t>(entry.type));
 
         // Value (Varies based on type)
-        packetData.insert(packetData.end(), entry.value.begin(), entry.value.end());
+        packetData.append(entry.value.begin(), entry.value.end());
     }
 
     // Terminating Entry (0xFF)
     packetData.push_back(0xFF);
 
-    // Broadcast the packet to all other clients except the initiating player
-    broadcastToOthers(packetData, player->uuidString);
+    // Send to the players tracking the entity
+    entityTracker.broadcast(entityID, packetData);
 }
 
 void sendEntityAnimation(const std::shared_ptr<Player> & player, EntityAnimation animation) {
-    std::vector<uint8_t> packetData;
-    packetData.push_back(ENTITY_ANIMATION);
+    PacketWriter packetData(ENTITY_ANIMATION);
 
     // Entity ID (VarInt)
     writeVarInt(packetData, player->entityID);
@@ -1075,24 +1066,22 @@ void sendEntityAnimation(const std::shared_ptr<Player> & player, EntityAnimation
     // Animation ID (Unsigned Byte)
     packetData.push_back(static_cast<uint8_t>(animation));
 
-    // Broadcast to all other clients
-    broadcastToOthers(packetData, player->uuidString);
+    // Send to the players tracking the entity
+    entityTracker.broadcast(player->entityID, packetData);
 }
 
 void sendAcknowledgeBlockChange(ClientConnection& client, size_t sequenceID) {
-    std::vector<uint8_t> packetData;
-    packetData.push_back(ACKNOWLEDGE_BLOCK_CHANGE);
+    PacketWriter packetData(ACKNOWLEDGE_BLOCK_CHANGE);
 
     // Sequence ID (VarInt)
     writeVarInt(packetData, static_cast<int32_t>(sequenceID));
 
     // Send the packet
-    sendPacket(client, packetData);
+    sendPacket(client, std::move(packetData));
 }
 
 void sendEquipmentPacket(const std::shared_ptr<Player> & player, int32_t entityID, const EquipmentSlot& slot) {
-    std::vector<uint8_t> packetData;
-    packetData.push_back(SET_EQUIPMENT);
+    PacketWriter packetData(SET_EQUIPMENT);
 
     // Entity ID (VarInt)
     writeVarInt(packetData, entityID);
@@ -1103,16 +1092,15 @@ void sendEquipmentPacket(const std::shared_ptr<Player> & player, int32_t entityI
     // Item (Slot)
     writeSlotSimple(packetData, slot.slotData);
 
-    // Broadcast to all other clients
-    broadcastToOthers(packetData, player->uuidString);
+    // Send to the players tracking the entity
+    entityTracker.broadcast(entityID, packetData);
 }
 
 void broadcastPlayerChatMessage(const std::shared_ptr<Player>& sender, const std::string& message, long timestamp, long salt, const std::vector<uint8_t>* signature, const RegistryManager& registryManager, const std::string& chatTypeIdentifier, const std::string& targetName) {
-    std::vector<uint8_t> packetData;
-    packetData.push_back(PLAYER_CHAT_MESSAGE);
+    PacketWriter packetData(PLAYER_CHAT_MESSAGE);
 
     // Sender UUID
-    packetData.insert(packetData.end(), sender->uuid.begin(), sender->uuid.end());
+    packetData.append(sender->uuid.begin(), sender->uuid.end());
 
     // Index (VarInt) - set to 0 for now
     writeVarInt(packetData, 0);
@@ -1122,7 +1110,7 @@ void broadcastPlayerChatMessage(const std::shared_ptr<Player>& sender, const std
 
     // Message Signature
     if (signature && serverConfig.enableSecureChat) {
-        packetData.insert(packetData.end(), signature->begin(), signature->end());
+        packetData.append(signature->begin(), signature->end());
     }
 
     // Body
@@ -1170,18 +1158,12 @@ void broadcastPlayerChatMessage(const std::shared_ptr<Player>& sender, const std
     }
 
     // Broadcast to all players
-    {
-        std::lock_guard lock(connectedClientsMutex);
-        for (auto &client: connectedClients | std::views::values) {
-            sendPacket(*client, packetData);
-        }
-    }
+    broadcastToOthers(packetData);
     logMessage("<" + sender->name + "> " + message, LOG_RAW);
 }
 
-void sendCommandsPacket(ClientConnection& client) {
-    std::vector<uint8_t> packetData;
-    packetData.push_back(COMMANDS);
+PacketWriter buildCommandsPacket() {
+    PacketWriter packetData(COMMANDS);
 
     // Write the Count (number of nodes)
     writeVarInt(packetData, static_cast<int32_t>(commandGraphNumOfNodes));
@@ -1192,22 +1174,26 @@ void sendCommandsPacket(ClientConnection& client) {
     // Write the Root index
     writeVarInt(packetData, serializedCommandGraph.second);
 
-    sendPacket(client, packetData);
+    return packetData;
+}
+
+void sendCommandsPacket(ClientConnection& client) {
+    if (configurationPackets.commands) {
+        sendCachedPacket(client, *configurationPackets.commands);
+    }
 }
 
 void sendFinishConfigurationPacket(ClientConnection& client) {
-    std::vector<uint8_t> packetData;
-    packetData.push_back(FINISH_CONFIGURATION);
+    PacketWriter packetData(FINISH_CONFIGURATION);
 
     // No fields in this packet
 
     // Build and send the packet
-    sendPacket(client, packetData);
+    sendPacket(client, std::move(packetData));
 }
 
-void sendKnownPacksPacket(ClientConnection& client) {
-    std::vector<uint8_t> packetData;
-    packetData.push_back(CLIENTBOUND_KNOWN_PACKS);
+PacketWriter buildKnownPacksPacket() {
+    PacketWriter packetData(CLIENTBOUND_KNOWN_PACKS);
     // For now, only minecraft:core version 1.21
     writeVarInt(packetData, 1); // Number of packs
 
@@ -1215,20 +1201,60 @@ void sendKnownPacksPacket(ClientConnection& client) {
     writeString(packetData, "core"); // Pack ID
     writeString(packetData, "1.21"); // Pack Version
 
-    sendPacket(client, packetData);
+    return packetData;
+}
+
+void sendKnownPacksPacket(ClientConnection& client) {
+    if (configurationPackets.knownPacks) {
+        sendCachedPacket(client, *configurationPackets.knownPacks);
+    }
+}
+
+bool buildConfigurationPackets() {
+    std::vector<PacketWriter> registryData;
+    std::vector<std::string> chatTypes;
+    bool success = buildRegistryDataPackets(registryData, chatTypes);
+    for (const auto& packet : registryData) {
+        configurationPackets.registryData.emplace_back(packet);
+    }
+    configurationPackets.chatTypes = std::move(chatTypes);
+
+    PacketWriter updateTags;
+    if (buildUpdateTagsPacket(updateTags)) {
+        configurationPackets.updateTags.emplace(updateTags);
+    } else {
+        success = false;
+    }
+
+    configurationPackets.commands.emplace(buildCommandsPacket());
+    configurationPackets.knownPacks.emplace(buildKnownPacksPacket());
+
+    size_t uncompressedSize = 0;
+    size_t compressedSize = 0;
+    auto count = [&](const CachedPacket& packet) {
+        uncompressedSize += packet.frame(false).size();
+        compressedSize += packet.frame(true).size();
+    };
+    std::ranges::for_each(configurationPackets.registryData, count);
+    if (configurationPackets.updateTags) {
+        count(*configurationPackets.updateTags);
+    }
+    count(*configurationPackets.commands);
+    count(*configurationPackets.knownPacks);
+    logMessage("Built configuration packets: " + std::to_string(uncompressedSize) + " bytes, "
+               + std::to_string(compressedSize) + " bytes compressed", LOG_DEBUG);
+    return success;
 }
 
 void sendSetCompressionPacket(ClientConnection& client, int32_t threshold) {
-    std::vector<uint8_t> packetData;
-    packetData.push_back(SET_COMPRESSION);
+    PacketWriter packetData(SET_COMPRESSION);
     writeVarInt(packetData, threshold); // Compression threshold
 
-    sendPacket(client, packetData);
+    sendPacket(client, std::move(packetData));
 }
 
 void sendDisconnectionPacket(ClientConnection& client, const std::string& reason) {
-    std::vector<uint8_t> packetData;
-    packetData.push_back(DISCONNECT);
+    PacketWriter packetData(DISCONNECT);
 
     // Serialize the reason as a JSON text component
     nlohmann::json textComponent = {
@@ -1237,12 +1263,11 @@ void sendDisconnectionPacket(ClientConnection& client, const std::string& reason
     std::string reasonStr = textComponent.dump();
     writeString(packetData, reasonStr);
 
-    sendPacket(client, packetData);
+    sendPacket(client, std::move(packetData));
 }
 
 void sendServerLinksPacket(ClientConnection & client) {
-    std::vector<uint8_t> packetData;
-    packetData.push_back(SERVER_LINKS);
+    PacketWriter packetData(SERVER_LINKS);
 
     writeVarInt(packetData, static_cast<int32_t>(serverConfig.serverLinks.size()));
     for (const auto& link : serverConfig.serverLinks) {
@@ -1253,12 +1278,11 @@ void sendServerLinksPacket(ClientConnection & client) {
         writeString(packetData, link.url);
     }
 
-    sendPacket(client, packetData);
+    sendPacket(client, std::move(packetData));
 }
 
 void sendServerPluginMessages(ClientConnection & client) {
-    std::vector<uint8_t> packetData;
-    packetData.push_back(CLIENTBOUND_PLUGIN_MESSAGE_CONFIG);
+    PacketWriter packetData(CLIENTBOUND_PLUGIN_MESSAGE_CONFIG);
 
     std::string channel = "minecraft:brand";
     writeString(packetData, channel);
@@ -1266,12 +1290,11 @@ void sendServerPluginMessages(ClientConnection & client) {
     std::string brand = "MCpp";
     writeString(packetData, brand);
 
-    sendPacket(client, packetData);
+    sendPacket(client, std::move(packetData));
 }
 
 void sendReInitializeWorldBorder(double x, double z, double size, int64_t speed, int32_t warningBlocks, int32_t warningTime) {
-    std::vector<uint8_t> packet;
-    writeVarInt(packet, INITIALIZE_WORLD_BORDER);
+    PacketWriter packet(INITIALIZE_WORLD_BORDER);
     double oldDiameter = worldBorder.size;
     worldBorder.updateCenter(x, z);
     worldBorder.updateSize(size);
@@ -1308,8 +1331,7 @@ void sendReInitializeWorldBorder(double x, double z, double size, int64_t speed,
 }
 
 void sendInitializeWorldBorder(ClientConnection& client, const WorldBorder& border) {
-    std::vector<uint8_t> packet;
-    writeVarInt(packet, INITIALIZE_WORLD_BORDER);
+    PacketWriter packet(INITIALIZE_WORLD_BORDER);
 
     // Bound To: X (Double) - Center X
     writeDouble(packet, border.centerX);
@@ -1336,12 +1358,11 @@ void sendInitializeWorldBorder(ClientConnection& client, const WorldBorder& bord
     writeVarInt(packet, border.warningTime);
 
     // Send the packet
-    sendPacket(client, packet);
+    sendPacket(client, std::move(packet));
 }
 
 void sendTimeUpdatePacket(ClientConnection& client) {
-    std::vector<uint8_t> packet;
-    writeVarInt(packet, UPDATE_TIME);
+    PacketWriter packet(UPDATE_TIME);
 
     // World Age (Long) - Not changed by server commands
     int64_t currentWorldAge = worldTime.getWorldAge();
@@ -1352,12 +1373,11 @@ void sendTimeUpdatePacket(ClientConnection& client) {
     writeLong(packet, currentTimeOfDay);
 
     // Send the packet
-    sendPacket(client, packet);
+    sendPacket(client, std::move(packet));
 }
 
 void sendSetBorderCenter(double x, double z) {
-    std::vector<uint8_t> packet;
-    writeByte(packet, SET_BORDER_CENTER);
+    PacketWriter packet(SET_BORDER_CENTER);
     worldBorder.updateCenter(x, z);
 
     // Center X (Double)
@@ -1371,8 +1391,7 @@ void sendSetBorderCenter(double x, double z) {
 }
 
 void sendSetBorderLerpSize(double newDiameter, int64_t speed) {
-    std::vector<uint8_t> packet;
-    writeByte(packet, SET_BORDER_LERP_SIZE);
+    PacketWriter packet(SET_BORDER_LERP_SIZE);
     double oldDiameter = worldBorder.size;
     worldBorder.updateSize(newDiameter);
 
@@ -1390,8 +1409,7 @@ void sendSetBorderLerpSize(double newDiameter, int64_t speed) {
 }
 
 void sendSetBorderSize(double newDiameter) {
-    std::vector<uint8_t> packet;
-    writeByte(packet, SET_BORDER_SIZE);
+    PacketWriter packet(SET_BORDER_SIZE);
     worldBorder.updateSize(newDiameter);
 
     // New Diameter (Double)
@@ -1402,8 +1420,7 @@ void sendSetBorderSize(double newDiameter) {
 }
 
 void sendSetBorderWarningDelay(int32_t warningTime) {
-    std::vector<uint8_t> packet;
-    writeByte(packet, SET_BORDER_WARNING_DELAY);
+    PacketWriter packet(SET_BORDER_WARNING_DELAY);
     worldBorder.updateWarningTime(warningTime);
 
     // Warning Time (VarInt)
@@ -1414,8 +1431,7 @@ void sendSetBorderWarningDelay(int32_t warningTime) {
 }
 
 void sendSetBorderWarningDistance(int32_t warningBlocks) {
-    std::vector<uint8_t> packet;
-    writeByte(packet, SET_BORDER_WARNING_DISTANCE);
+    PacketWriter packet(SET_BORDER_WARNING_DISTANCE);
     worldBorder.updateWarningDistance(warningBlocks);
 
     // Warning Blocks (VarInt)
@@ -1426,8 +1442,7 @@ void sendSetBorderWarningDistance(int32_t warningBlocks) {
 }
 
 void sendBossbar(Bossbar& bossbar, int32_t action) {
-    std::vector<uint8_t> packet;
-    writeByte(packet, BOSS_BAR);
+    PacketWriter packet(BOSS_BAR);
     std::array<uint8_t, 16> uuid = bossbar.getUUID();
     std::vector<uint8_t> uuidBytes;
     uuidBytes.insert(uuidBytes.end(), uuid.begin(), uuid.end());
@@ -1480,16 +1495,16 @@ void sendBossbar(Bossbar& bossbar, int32_t action) {
             return;
         }
     }
+    EncodedPacket encoded(packet);
     for (const auto player : bossbar.getPlayers()) {
         if (player->client != nullptr) {
-            sendPacket(*player->client, packet);
+            sendEncodedPacket(*player->client, encoded);
         }
     }
 }
 
 void sendCommandSuggestionsResponse(ClientConnection& client, int32_t transactionID, const std::vector<std::string>& suggestions, int32_t start) {
-    std::vector<uint8_t> packet;
-    writeVarInt(packet, COMMAND_SUGGESTIONS_RESPONSE);
+    PacketWriter packet(COMMAND_SUGGESTIONS_RESPONSE);
     writeVarInt(packet, transactionID);
     writeVarInt(packet, start);
     writeVarInt(packet, 0);
@@ -1498,24 +1513,17 @@ void sendCommandSuggestionsResponse(ClientConnection& client, int32_t transactio
         writeString(packet, suggestion);
         writeByte(packet, 0x00); // No text component
     }
-    sendPacket(client, packet);
-}
-
-void sendBundleDelimiter() {
-    std::vector<uint8_t> packet;
-    writeVarInt(packet, BUNDLE_DELIMITER);
-    broadcastToOthers(packet);
+    sendPacket(client, std::move(packet));
 }
 
 void sendBundleDelimiter(ClientConnection& client) {
-    std::vector<uint8_t> packet;
-    writeVarInt(packet, BUNDLE_DELIMITER);
-    sendPacket(client, packet);
+    PacketWriter packet(BUNDLE_DELIMITER);
+    sendPacket(client, std::move(packet));
 }
 
 void sendEntityVelocity(const std::shared_ptr<Entity>& entity) {
-    std::vector<uint8_t> packet;
-    writeVarInt(packet, SET_ENTITY_VELOCITY);
+    PacketWriter packet(SET_ENTITY_VELOCITY);
+    packet.compressionClass = CompressionClass::Movement;
 
     // Entity ID (VarInt)
     writeVarInt(packet, entity->entityID);
@@ -1529,13 +1537,12 @@ void sendEntityVelocity(const std::shared_ptr<Entity>& entity) {
     // Velocity Z (Short)
     writeShort(packet, static_cast<int16_t>(entity->getMotionZ() * 8000));
 
-    // Broadcast to all clients
-    broadcastToOthers(packet);
+    // Send to the players tracking the entity
+    entityTracker.broadcast(entity->entityID, packet);
 }
 
 void sendPickUpItem(const std::shared_ptr<Entity>& collectedEntity, const std::shared_ptr<Entity>& collectorEntity, int8_t count) {
-    std::vector<uint8_t> packet;
-    writeByte(packet, PICK_UP_ITEM);
+    PacketWriter packet(PICK_UP_ITEM);
 
     // Collected Entity ID (VarInt)
     writeVarInt(packet, collectedEntity->entityID);
@@ -1546,13 +1553,12 @@ void sendPickUpItem(const std::shared_ptr<Entity>& collectedEntity, const std::s
     // Count (VarInt)
     writeVarInt(packet, count);
 
-    // Broadcast to all clients
-    broadcastToOthers(packet);
+    // Send to the players tracking the collected entity
+    entityTracker.broadcast(collectedEntity->entityID, packet);
 }
 
 void SendSetContainerSlot(ClientConnection& client, const int8_t windowID, const int32_t stateID, const uint16_t slotID, const SlotData& slot) {
-    std::vector<uint8_t> packet;
-    writeByte(packet, SET_CONTAINER_SLOT);
+    PacketWriter packet(SET_CONTAINER_SLOT);
 
     // Window ID (Byte)
     writeByte(packet, windowID);
@@ -1566,12 +1572,11 @@ void SendSetContainerSlot(ClientConnection& client, const int8_t windowID, const
     // Slot (Slot)
     writeSlotSimple(packet, slot);
 
-    sendPacket(client, packet);
+    sendPacket(client, std::move(packet));
 }
 
 void sendUpdateRecipes(ClientConnection& client) {
-    std::vector<uint8_t> packet;
-    writeByte(packet, UPDATE_RECIPES);
+    PacketWriter packet(UPDATE_RECIPES);
 
     /*
     writeVarInt(packet, static_cast<int32_t>(craftingRecipes.size()));
@@ -1584,13 +1589,12 @@ void sendUpdateRecipes(ClientConnection& client) {
     writeBytes(packet, craftingRecipes.find(36)->second.serialize(36));
 
 
-    sendPacket(client, packet);
+    sendPacket(client, std::move(packet));
     */
 }
 
 void sendContainerContent(ClientConnection& client, uint8_t windowID, int32_t stateID, Inventory& inventory) {
-    std::vector<uint8_t> packet;
-    writeByte(packet, SET_CONTAINER_CONTENT);
+    PacketWriter packet(SET_CONTAINER_CONTENT);
 
     writeUByte(packet, windowID);
     writeVarInt(packet, stateID);
@@ -1607,24 +1611,22 @@ void sendContainerContent(ClientConnection& client, uint8_t windowID, int32_t st
     }
     writeSlotSimple(packet, inventory.carriedItem);
 
-    sendPacket(client, packet);
+    sendPacket(client, std::move(packet));
 }
 
 void sendOpenScreen(ClientConnection& client, const uint8_t windowID, const uint8_t windowType, const std::string& title) {
-    std::vector<uint8_t> packet;
-    writeByte(packet, OPEN_SCREEN);
+    PacketWriter packet(OPEN_SCREEN);
 
     writeVarInt(packet, windowID);
     writeVarInt(packet, windowType);
     nbt::tag_compound titleTag = createTextComponent(title);
     writeBytes(packet, serializeNBT(titleTag, true));
 
-    sendPacket(client, packet);
+    sendPacket(client, std::move(packet));
 }
 
 void sendBlockDestroyStage(const std::shared_ptr<Player>& player, const Position &blockPos, const int8_t stage) {
-    std::vector<uint8_t> packet;
-    writeByte(packet, BLOCK_DESTROY_STAGE);
+    PacketWriter packet(BLOCK_DESTROY_STAGE);
 
     // Entity ID (VarInt)
     writeVarInt(packet, player->entityID);
@@ -1640,8 +1642,7 @@ void sendBlockDestroyStage(const std::shared_ptr<Player>& player, const Position
 }
 
 void sendUpdateAttributes(ClientConnection& client, const int32_t entityID, const std::vector<Attribute>& attributes) {
-    std::vector<uint8_t> packet;
-    writeByte(packet, UPDATE_ATTRIBUTES);
+    PacketWriter packet(UPDATE_ATTRIBUTES);
 
     // Entity ID (VarInt)
     writeVarInt(packet, entityID);
@@ -1672,12 +1673,11 @@ void sendUpdateAttributes(ClientConnection& client, const int32_t entityID, cons
         */
     }
 
-    sendPacket(client, packet);
+    sendPacket(client, std::move(packet));
 }
 
 void sendPlayerAbilities(ClientConnection& client, const uint8_t flags, const float flyingSpeed, const float fovModifier) {
-    std::vector<uint8_t> packet;
-    writeByte(packet, PLAYER_ABILITIES);
+    PacketWriter packet(PLAYER_ABILITIES);
 
     // Flags (Unsigned Byte)
     writeByte(packet, flags);
@@ -1688,22 +1688,20 @@ void sendPlayerAbilities(ClientConnection& client, const uint8_t flags, const fl
     // Walking Speed (Float)
     writeFloat(packet, fovModifier);
 
-    sendPacket(client, packet);
+    sendPacket(client, std::move(packet));
 }
 
 void sendSetHeldItem(ClientConnection& client, const int8_t slot) {
-    std::vector<uint8_t> packet;
-    writeByte(packet, SET_HELD_ITEM);
+    PacketWriter packet(SET_HELD_ITEM);
 
     // Slot (Byte)
     writeByte(packet, slot);
 
-    sendPacket(client, packet);
+    sendPacket(client, std::move(packet));
 }
 
 void sendFeatureFlags(ClientConnection& client, const std::vector<std::string>& flags) {
-    std::vector<uint8_t> packet;
-    writeByte(packet, FEATURE_FLAGS);
+    PacketWriter packet(FEATURE_FLAGS);
 
     // Flags (Identifier Array)
     writeVarInt(packet, static_cast<int32_t>(flags.size()));
@@ -1711,5 +1709,5 @@ void sendFeatureFlags(ClientConnection& client, const std::vector<std::string>&
         writeString(packet, flag);
     }
 
-    sendPacket(client, packet);
+    sendPacket(client, std::move(packet));
 }
\ No newline at end of file
@@ -21,7 +21,11 @@ enum class GameEvent : uint8_t;
 class Entity;
 struct Position;
 
-void sendRemoveEntityPacket(const int32_t& entityID);
+// Serializes the registry data, tags, commands and known packs packets once, call after the
+// data they are built from is loaded. The send functions for them only encrypt the cached frames.
+bool buildConfigurationPackets();
+
+void sendRemoveEntityPacket(ClientConnection& client, int32_t entityID);
 void sendPlayerInfoRemove(const std::shared_ptr<Player>& player);
 void sendRegistryDataPacket(ClientConnection& client, RegistryManager& registryManager);
 void sendWorldEventPacket(ClientConnection& client, const int& worldEvent, const Position& position, const int& data);
@@ -34,7 +38,6 @@ void sendEntityLookAndRelativeMovePacket(const std::shared_ptr<Player>& player,
 void sendEntityRotationPacket(const std::shared_ptr<Player>& player);
 void sendHeadRotationPacket(const std::shared_ptr<Player>& player);
 void sendEntityTeleportPacket(const std::shared_ptr<Player>& player);
-void sendSpawnEntityPacket(const std::shared_ptr<Entity>& entity);
 void sendSpawnEntityPacket(ClientConnection& client, const std::shared_ptr<Entity>& entity);
 void sendEntityEventPacket(ClientConnection& client, int32_t entityID, uint8_t entityStatus);
 void sendPlayerInfoUpdate(ClientConnection& targetClient, const std::vector<std::shared_ptr<Player>>& playersToUpdate, uint8_t actions);
@@ -49,10 +52,12 @@ void sendEntityEventPacket(ClientConnection& client, int32_t entityID, uint8_t e
 void sendChangeGamemode(ClientConnection& client, const std::shared_ptr<Player>& player, Gamemode gameMode);
 void sendDisconnectionPacket(ClientConnection& client, const std::string& reason);
 void sendSetCenterChunkPacket(ClientConnection& targetClient, int32_t chunkX, int32_t chunkZ);
+void sendUnloadChunkPacket(ClientConnection& targetClient, int32_t chunkX, int32_t chunkZ);
 void sendResourcePacks(ClientConnection& client);
 void sendRemoveResourcePacks(ClientConnection& client, const std::vector<std::string>& uuidsToRemove = {});
 bool sendKeepAlivePacket(ClientConnection& client);
 void sendEntityMetadataPacket(const std::vector<MetadataEntry>& metadataEntries, int32_t entityID);
+void sendEntityMetadataPacket(ClientConnection& client, const std::vector<MetadataEntry>& metadataEntries, int32_t entityID);
 void sendEntityMetadataPacket(const std::shared_ptr<Player>& player, const std::vector<MetadataEntry>& metadataEntries, int32_t entityID);
 void sendEntityAnimation(const std::shared_ptr<Player> & player, EntityAnimation animation);
 void sendAcknowledgeBlockChange(ClientConnection& client, size_t sequenceID);
@@ -75,7 +80,6 @@ void sendSetBorderWarningDistance(int32_t warningBlocks);
 void sendBossbar(Bossbar& bossbar, int32_t action);
 void sendCommandSuggestionsResponse(ClientConnection& client, int32_t transactionID, const std::vector<std::string>& suggestions, int32_t start);
 void sendBundleDelimiter(ClientConnection& client);
-void sendBundleDelimiter();
 void sendEntityVelocity(const std::shared_ptr<Entity>& entity);
 void sendPickUpItem(const std::shared_ptr<Entity>& collectedEntity, const std::shared_ptr<Entity>& collectorEntity, int8_t count);
 void SendSetContainerSlot(ClientConnection& client, int8_t windowID, int32_t stateID, uint16_t slotID, const SlotData& slot);
@@ -90,33 +94,29 @@ void sendFeatureFlags(ClientConnection& client, const std::vector<std::string>&
 
 template<typename... Args>
 void sendTranslatedChatMessage(const std::string& key, const bool actionBar = false, const std::string& color = "white", const std::vector<std::shared_ptr<Player>>* players = nullptr, bool log = true, Args&&... args) {
-    std::vector<uint8_t> packetData = { };
-
     if (players == nullptr) {
         for (const auto &player: globalPlayers | std::views::values) {
-            packetData.clear();
-            packetData.push_back(SYSTEM_CHAT_MESSAGE);
+            PacketWriter packetData(SYSTEM_CHAT_MESSAGE);
 
             nbt::tag_compound textCompound = createTextComponent(getTranslation(key, player->lang, std::forward<Args>(args)...), color);
             std::vector<uint8_t> textData = serializeNBT(textCompound, true);
-            packetData.insert(packetData.end(), textData.begin(), textData.end());
+            packetData.append(textData.begin(), textData.end());
 
             writeByte(packetData, actionBar);
-            sendPacket(*player->client, packetData);
+            sendPacket(*player->client, std::move(packetData));
         }
     }
     else {
         for (const auto& player : *players) {
             if (player->client != nullptr) {
-                packetData.clear();
-                packetData.push_back(SYSTEM_CHAT_MESSAGE);
+                PacketWriter packetData(SYSTEM_CHAT_MESSAGE);
 
                 nbt::tag_compound textCompound = createTextComponent(getTranslation(key, player->lang, std::forward<Args>(args)...), color);
                 std::vector<uint8_t> textData = serializeNBT(textCompound, true);
-                packetData.insert(packetData.end(), textData.begin(), textData.end());
+                packetData.append(textData.begin(), textData.end());
 
                 writeByte(packetData, actionBar);
-                sendPacket(*player->client, packetData);
+                sendPacket(*player->client, std::move(packetData));
             }
         }
     }
@@ -0,0 +1,417 @@
+#include "event_loop.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <ranges>
+#include <cstring>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+#include "client.h"
+#include "core/utils.h"
+#include "utils/thread_pool.h"
+
+namespace {
+    std::vector<std::unique_ptr<EventLoop>> eventLoops;
+    std::atomic<size_t> nextLoop(0);
+}
+
+#ifndef _WIN32
+
+EventLoop::EventLoop() = default;
+
+EventLoop::~EventLoop() {
+    stop();
+}
+
+bool EventLoop::start(const std::string& threadName) {
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd == -1) {
+        logMessage("Failed to create epoll instance: " + std::string(strerror(errno)), LOG_ERROR);
+        return false;
+    }
+
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wakeFd == -1) {
+        logMessage("Failed to create eventfd: " + std::string(strerror(errno)), LOG_ERROR);
+        close(epollFd);
+        epollFd = -1;
+        return false;
+    }
+
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = wakeFd;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event) == -1) {
+        logMessage("Failed to register eventfd: " + std::string(strerror(errno)), LOG_ERROR);
+        close(wakeFd);
+        close(epollFd);
+        wakeFd = epollFd = -1;
+        return false;
+    }
+
+    running = true;
+    thread = std::thread(&EventLoop::run, this);
+    set_thread_name(thread, threadName.c_str());
+    return true;
+}
+
+void EventLoop::stop() {
+    if (!running.exchange(false)) {
+        return;
+    }
+    post([] {});
+    if (thread.joinable()) {
+        thread.join();
+    }
+    close(wakeFd);
+    close(epollFd);
+    wakeFd = epollFd = -1;
+}
+
+void EventLoop::addClient(SocketType clientSocket) {
+    int flags = fcntl(clientSocket, F_GETFL, 0);
+    if (flags == -1 || fcntl(clientSocket, F_SETFL, flags | O_NONBLOCK) == -1) {
+        logMessage("Failed to make client socket non-blocking: " + std::string(strerror(errno)), LOG_ERROR);
+        close(clientSocket);
+        return;
+    }
+    post([this, clientSocket] { registerClient(clientSocket); });
+}
+
+void EventLoop::post(std::function<void()> task) {
+    {
+        std::lock_guard lock(tasksMutex);
+        pendingTasks.emplace_back(std::move(task));
+    }
+    uint64_t one = 1;
+    // The counter only saturates if the loop is stuck, in which case the wakeup is pending anyway
+    [[maybe_unused]] ssize_t written = write(wakeFd, &one, sizeof(one));
+}
+
+void EventLoop::resumeDispatch(const std::shared_ptr<ClientConnection>& client) {
+    client->dispatchPaused = false;
+    auto it = clients.find(client->socket);
+    if (client->connectionClosed || it == clients.end() || it->second != client) {
+        return;
+    }
+    if (!processInbound(*client) || !flushClient(client)) {
+        closeClient(client);
+    }
+}
+
+void EventLoop::requestFlush(const std::shared_ptr<ClientConnection>& client) {
+    post([this, client] {
+        auto it = clients.find(client->socket);
+        if (it == clients.end() || it->second != client) {
+            return;
+        }
+        if (!flushClient(client)) {
+            closeClient(client);
+        }
+    });
+}
+
+void EventLoop::requestFlushAll() {
+    post([this] { flushClients(); });
+}
+
+void EventLoop::closeAfterFlush(const std::shared_ptr<ClientConnection>& client) {
+    // closeClient writes out whatever is still queued before closing the socket
+    post([this, client] { closeClient(client); });
+}
+
+void EventLoop::registerClient(SocketType clientSocket) {
+    auto client = std::make_shared<ClientConnection>();
+    client->socket = clientSocket;
+    client->state = ClientState::Handshake;
+    client->loop = this;
+    client->lastPacketTime = std::chrono::steady_clock::now();
+
+    epoll_event event{};
+    event.events = EPOLLIN | EPOLLRDHUP;
+    event.data.fd = clientSocket;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, clientSocket, &event) == -1) {
+        logMessage("Failed to register client socket: " + std::string(strerror(errno)), LOG_ERROR);
+        close(clientSocket);
+        return;
+    }
+    clients[clientSocket] = std::move(client);
+}
+
+void EventLoop::run() {
+    std::array<epoll_event, 64> events{};
+    auto lastSweep = std::chrono::steady_clock::now();
+
+    while (running) {
+        int count = epoll_wait(epollFd, events.data(), static_cast<int>(events.size()), 1000);
+        if (count == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            logMessage("epoll_wait failed: " + std::string(strerror(errno)), LOG_ERROR);
+            break;
+        }
+
+        for (int i = 0; i < count; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == wakeFd) {
+                uint64_t value;
+                [[maybe_unused]] ssize_t bytesRead = read(wakeFd, &value, sizeof(value));
+                continue;
+            }
+
+            auto it = clients.find(fd);
+            if (it == clients.end()) {
+                continue;
+            }
+            // Copy the pointer, the map entry may be erased while handling the event
+            std::shared_ptr<ClientConnection> client = it->second;
+            if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+                handleReadable(client);
+            }
+            if (events[i].events & EPOLLOUT) {
+                // The socket drained, continue the flush that was blocked (unless the read closed it)
+                it = clients.find(fd);
+                if (it != clients.end() && it->second == client && !flushClient(client)) {
+                    closeClient(client);
+                }
+            }
+        }
+
+        runPendingTasks();
+
+        auto now = std::chrono::steady_clock::now();
+        if (now - lastSweep >= std::chrono::seconds(1)) {
+            sweepIdleClients();
+            lastSweep = now;
+        }
+    }
+
+    // Tear down remaining connections
+    std::vector<std::shared_ptr<ClientConnection>> remaining;
+    for (auto &client: clients | std::views::values) {
+        remaining.push_back(client);
+    }
+    for (const auto& client : remaining) {
+        closeClient(client);
+    }
+}
+
+void EventLoop::handleReadable(const std::shared_ptr<ClientConnection>& client) {
+    // A single large read per wakeup, epoll is level-triggered and reports the socket again if more is pending
+    ssize_t bytesRead = client->receiveBuffer.fill(client->socket);
+    if (bytesRead == 0) {
+        // Orderly shutdown by the peer
+        closeClient(client);
+        return;
+    }
+    if (bytesRead < 0) {
+        if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK) {
+            return;
+        }
+        logMessage("Failed to read from client: " + std::string(strerror(errno)), LOG_DEBUG);
+        closeClient(client);
+        return;
+    }
+
+    // Replies to the packets just handled go out right away instead of waiting for the tick
+    if (!client->receiveBuffer.decryptNew(client->decryptCtx) || !processInbound(*client) || !flushClient(client)) {
+        closeClient(client);
+    }
+}
+
+bool EventLoop::processInbound(ClientConnection& client) {
+    std::vector<uint8_t> payload;
+    std::vector<uint8_t> packetData;
+
+    while (!client.dispatchPaused && !client.connectionClosed) {
+        bool error = false;
+        if (!client.receiveBuffer.nextFrame(payload, error)) {
+            return !error;
+        }
+
+        if (!decodePacketPayload(client, payload, packetData)) {
+            return false;
+        }
+
+        client.lastPacketTime = std::chrono::steady_clock::now();
+        try {
+            if (!handleIncomingPacket(client, packetData)) {
+                return false;
+            }
+        } catch (const std::exception& e) {
+            logMessage("Client disconnected with error: " + std::string(e.what()), LOG_ERROR);
+            return false;
+        }
+    }
+    return true;
+}
+
+void EventLoop::closeClient(const std::shared_ptr<ClientConnection>& client) {
+    auto it = clients.find(client->socket);
+    if (it == clients.end() || it->second != client) {
+        return;
+    }
+    // Best effort, e.g. a disconnect packet queued right before closing
+    client->outbound.flush(client->socket);
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, client->socket, nullptr);
+    clients.erase(it);
+
+    handleConnectionClosed(*client);
+
+    // Senders on other threads check connectionClosed under the send mutex
+    std::lock_guard lock(client->sendMutex);
+    client->connectionClosed = true;
+    close(client->socket);
+}
+
+bool EventLoop::flushClient(const std::shared_ptr<ClientConnection>& client) {
+    client->outbound.flushScheduled = false;
+    OutboundQueue::FlushResult result = client->outbound.flush(client->socket);
+    if (result == OutboundQueue::FlushResult::Error) {
+        logMessage("Failed to send to client: " + std::string(strerror(errno)), LOG_DEBUG);
+        return false;
+    }
+
+    // Wait for EPOLLOUT while the socket buffer is full, stop listening for it once everything is out
+    bool blocked = result == OutboundQueue::FlushResult::Blocked;
+    if (blocked != client->outbound.waitingWritable) {
+        setWritableInterest(*client, blocked);
+    }
+    return true;
+}
+
+void EventLoop::flushClients() {
+    std::vector<std::shared_ptr<ClientConnection>> broken;
+    for (auto &client: clients | std::views::values) {
+        // Clients waiting for EPOLLOUT are flushed as soon as their socket drains
+        if (client->outbound.waitingWritable || client->outbound.queuedPackets() == 0) {
+            continue;
+        }
+        if (!flushClient(client)) {
+            broken.push_back(client);
+        }
+    }
+    for (const auto& client : broken) {
+        closeClient(client);
+    }
+}
+
+void EventLoop::setWritableInterest(ClientConnection& client, bool enabled) {
+    uint32_t events = EPOLLIN | EPOLLRDHUP;
+    if (enabled) {
+        events |= EPOLLOUT;
+    }
+    epoll_event event{};
+    event.events = events;
+    event.data.fd = client.socket;
+    if (epoll_ctl(epollFd, EPOLL_CTL_MOD, client.socket, &event) == -1) {
+        logMessage("Failed to update client socket events: " + std::string(strerror(errno)), LOG_ERROR);
+        return;
+    }
+    client.outbound.waitingWritable = enabled;
+}
+
+void EventLoop::runPendingTasks() {
+    std::vector<std::function<void()>> tasks;
+    {
+        std::lock_guard lock(tasksMutex);
+        tasks.swap(pendingTasks);
+    }
+    for (auto& task : tasks) {
+        try {
+            task();
+        } catch (const std::exception& e) {
+            logMessage("Event loop task failed: " + std::string(e.what()), LOG_ERROR);
+        }
+    }
+}
+
+void EventLoop::sweepIdleClients() {
+    auto now = std::chrono::steady_clock::now();
+    std::vector<std::shared_ptr<ClientConnection>> timedOut;
+    for (auto &client: clients | std::views::values) {
+        // Connections waiting on an asynchronous login step are not idle
+        if (!client->dispatchPaused && now - client->lastPacketTime > std::chrono::seconds(CLIENT_TIMEOUT_SECONDS)) {
+            timedOut.push_back(client);
+        }
+    }
+    for (const auto& client : timedOut) {
+        if (client->player && (client->state == ClientState::Play || client->state == ClientState::AwaitingTeleportConfirm)) {
+            disconnectClient(client->player, "Timed out", true);
+        }
+        closeClient(client);
+    }
+}
+
+void startEventLoops(size_t count) {
+    count = std::max<size_t>(count, 1);
+    for (size_t i = 0; i < count; ++i) {
+        auto loop = std::make_unique<EventLoop>();
+        if (!loop->start("NetworkLoop" + std::to_string(i))) {
+            continue;
+        }
+        eventLoops.emplace_back(std::move(loop));
+    }
+    logMessage("Started " + std::to_string(eventLoops.size()) + " network event loop(s)", LOG_DEBUG);
+}
+
+void stopEventLoops() {
+    for (auto& loop : eventLoops) {
+        loop->stop();
+    }
+    eventLoops.clear();
+}
+
+void dispatchClient(SocketType clientSocket) {
+    if (eventLoops.empty()) {
+        logMessage("No network event loop running, dropping connection", LOG_ERROR);
+        close(clientSocket);
+        return;
+    }
+    eventLoops[nextLoop++ % eventLoops.size()]->addClient(clientSocket);
+}
+
+void flushEventLoops() {
+    for (auto& loop : eventLoops) {
+        loop->requestFlushAll();
+    }
+}
+
+#else
+
+// Windows has no epoll, fall back to one thread per connection.
+// No EventLoop is ever started, ClientConnection::loop stays null and these are never reached.
+
+void EventLoop::post(std::function<void()> task) {
+}
+
+void EventLoop::resumeDispatch(const std::shared_ptr<ClientConnection>& client) {
+}
+
+void EventLoop::requestFlush(const std::shared_ptr<ClientConnection>& client) {
+}
+
+void EventLoop::closeAfterFlush(const std::shared_ptr<ClientConnection>& client) {
+}
+
+void startEventLoops(size_t count) {
+}
+
+void stopEventLoops() {
+}
+
+void dispatchClient(SocketType clientSocket) {
+    std::thread(handleClient, clientSocket).detach();
+}
+
+void flushEventLoops() {
+}
+
+#endif
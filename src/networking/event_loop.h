@@ -0,0 +1,74 @@
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "network.h"
+
+struct ClientConnection;
+
+// Connections that don't send anything for this long are dropped
+constexpr int CLIENT_TIMEOUT_SECONDS = 30;
+
+// Reactor that multiplexes many client sockets on a single thread.
+// All reads, packet dispatch and connection teardown for a socket happen on the
+// loop that owns it; other threads hand work over with post().
+class EventLoop {
+public:
+    EventLoop();
+    ~EventLoop();
+
+    bool start(const std::string& threadName);
+    void stop();
+
+    // Takes ownership of an accepted socket. Safe to call from any thread.
+    void addClient(SocketType clientSocket);
+    // Runs a task on the loop thread. Safe to call from any thread.
+    void post(std::function<void()> task);
+    // Continues dispatching buffered packets after an asynchronous step finished (loop thread only)
+    void resumeDispatch(const std::shared_ptr<ClientConnection>& client);
+    // Flushes the outbound queue of one client / of every client. Safe to call from any thread.
+    void requestFlush(const std::shared_ptr<ClientConnection>& client);
+    void requestFlushAll();
+    // Closes the connection after handing its queued packets to the socket. Safe to call from any thread.
+    void closeAfterFlush(const std::shared_ptr<ClientConnection>& client);
+
+private:
+    void run();
+    void registerClient(SocketType clientSocket);
+    void handleReadable(const std::shared_ptr<ClientConnection>& client);
+    bool processInbound(ClientConnection& client);
+    void closeClient(const std::shared_ptr<ClientConnection>& client);
+    // Returns false if the connection broke
+    bool flushClient(const std::shared_ptr<ClientConnection>& client);
+    void flushClients();
+    void setWritableInterest(ClientConnection& client, bool enabled);
+    void runPendingTasks();
+    void sweepIdleClients();
+
+    int epollFd = -1;
+    int wakeFd = -1;
+    std::thread thread;
+    std::atomic<bool> running{false};
+
+    // Only touched from the loop thread
+    std::unordered_map<SocketType, std::shared_ptr<ClientConnection>> clients;
+
+    std::mutex tasksMutex;
+    std::vector<std::function<void()>> pendingTasks;
+};
+
+void startEventLoops(size_t count);
+void stopEventLoops();
+// Hands an accepted socket to one of the event loops (round-robin)
+void dispatchClient(SocketType clientSocket);
+// Asks every event loop to write out the packets queued during the current tick
+void flushEventLoops();
+
+#endif //EVENT_LOOP_H
@@ -3,11 +3,13 @@
 #include "core/config.h"
 #include "core/utils.h"
 #define CPPHTTPLIB_OPENSSL_SUPPORT
-constexpr int MAX_RETRIES = 3;
-constexpr int RETRY_DELAY_MS = 1000; // 1 second
 
+#include <chrono>
 #include <iostream>
+#include <mutex>
+#include <optional>
 #include <string>
+#include <unordered_map>
 #include <nlohmann/json.hpp>
 #include <nlohmann/json_fwd.hpp>
 #include "cppcodec/base64_rfc4648.hpp"
@@ -22,6 +24,74 @@ std::vector<std::string> ca_paths = {
         "/etc/ssl/cert.pem",                                // Alpine Linux, macOS
 };
 
+namespace {
+    // Upper bound for the profile cache, expired entries are dropped once it is reached
+    constexpr size_t PROFILE_CACHE_SWEEP_SIZE = 4096;
+
+    struct CachedProfile {
+        std::pair<std::string, std::string> textures;
+        std::chrono::steady_clock::time_point expiresAt;
+    };
+
+    std::mutex profileCacheMutex;
+    std::unordered_map<std::string, CachedProfile> profileCache; // Key: UUID without dashes
+
+    std::optional<std::pair<std::string, std::string>> getCachedTextures(const std::string& uuid) {
+        std::lock_guard lock(profileCacheMutex);
+        auto it = profileCache.find(uuid);
+        if (it == profileCache.end() || it->second.expiresAt <= std::chrono::steady_clock::now()) {
+            return std::nullopt;
+        }
+        return it->second.textures;
+    }
+
+    void cacheTextures(const std::string& uuid, const std::pair<std::string, std::string>& textures) {
+        if (serverConfig.profileCacheTTL <= 0 || textures.first.empty()) {
+            return;
+        }
+        auto now = std::chrono::steady_clock::now();
+        std::lock_guard lock(profileCacheMutex);
+        if (profileCache.size() >= PROFILE_CACHE_SWEEP_SIZE) {
+            std::erase_if(profileCache, [now](const auto& entry) { return entry.second.expiresAt <= now; });
+        }
+        profileCache[uuid] = {textures, now + std::chrono::seconds(serverConfig.profileCacheTTL)};
+    }
+
+    void setCACertificates(httplib::Client& client) {
+#ifndef _WIN32
+        bool set_ca_cert = false;
+        for (const auto& path : ca_paths) {
+            if (access(path.c_str(), R_OK) == 0) {
+                client.set_ca_cert_path(path.c_str());
+                set_ca_cert = true;
+                break;
+            }
+        }
+        if (!set_ca_cert) {
+            logMessage("No CA certificates found on system. SSL connections may fail.", LOG_ERROR);
+        }
+        client.enable_server_certificate_verification(true);
+#endif
+    }
+
+    // Connection to the session server owned by the calling thread. It is kept alive between
+    // requests, so the TLS handshake is only paid once per thread instead of once per login.
+    httplib::Client& sessionClient() {
+        thread_local std::unique_ptr<httplib::Client> client;
+        thread_local std::string clientURL;
+        if (!client || clientURL != serverConfig.sessionServerURL) {
+            client = std::make_unique<httplib::Client>(serverConfig.sessionServerURL);
+            clientURL = serverConfig.sessionServerURL;
+            setCACertificates(*client);
+            client->set_keep_alive(true);
+            client->set_follow_location(true);
+            client->set_connection_timeout(5);
+            client->set_read_timeout(10);
+        }
+        return *client;
+    }
+}
+
 std::string httpGet(const std::string& host, const std::string& path) {
     httplib::SSLClient cli(host.c_str());
 
@@ -81,15 +151,18 @@ std::string fetchPlayerUUID(const std::string& name) {
 }
 
 std::pair<std::string, std::string> fetchPlayerSkin(const std::string& uuid) {
-    std::string host = "sessionserver.mojang.com";
-    std::string path = "/session/minecraft/profile/" + uuid + "?unsigned=false";
+    if (auto cached = getCachedTextures(uuid)) {
+        return *cached;
+    }
 
-    std::string response = httpGet(host, path);
+    std::string path = "/session/minecraft/profile/" + uuid + "?unsigned=false";
+    auto res = sessionClient().Get(path.c_str());
 
-    if (response.empty()) {
+    if (!res || res->status != 200) {
         logMessage("Failed to fetch profile for UUID: " + uuid, LOG_ERROR);
         return { "", "" };
     }
+    const std::string& response = res->body;
 
     // Parse JSON response
     nlohmann::json profileJson;
@@ -108,7 +181,9 @@ std::pair<std::string, std::string> fetchPlayerSkin(const std::string& uuid) {
 
     for (const auto& prop : profileJson["properties"]) {
         if (prop["name"] == "textures" && prop.contains("value")) {
-            return { prop["value"], prop["signature"] };
+            std::pair<std::string, std::string> textures = { prop["value"], prop["signature"] };
+            cacheTextures(uuid, textures);
+            return textures;
         }
     }
 
@@ -152,90 +227,71 @@ std::string extractSkinURL(const std::string& texturesBase64) {
 }
 
 bool authenticatePlayer(const std::string& username, const std::string& serverHash, const std::string& ipAddress, std::string& outUUID, std::string& outName, std::pair<std::string, std::string>& skinTexturesPair) {
-    httplib::Client sessionClient("sessionserver.mojang.com");
-
     std::string endpoint = "/session/minecraft/hasJoined?username=" + httplib::detail::encode_query_param(username) + "&serverId=" + httplib::detail::encode_query_param(serverHash);
 
-#ifndef _WIN32
-    bool set_ca_cert = false;
-    for (const auto& path : ca_paths) {
-        if (access(path.c_str(), R_OK) == 0) {
-            sessionClient.set_ca_cert_path(path.c_str());
-            set_ca_cert = true;
-            break;
-        }
-    }
-    if (!set_ca_cert) {
-        logMessage("No CA certificates fouifnd on system. SSL connections may fail.", LOG_ERROR);
-    }
-    sessionClient.enable_server_certificate_verification(true);
-#endif
-    sessionClient.set_follow_location(true);
-
-    for (int tryCount = 0; tryCount < MAX_RETRIES; ++tryCount) {
-        auto res = sessionClient.Get(endpoint.c_str());
+    auto res = sessionClient().Get(endpoint.c_str());
 
-        if (res && res->status == 200) {
-            // Parse JSON response
-            nlohmann::json responseJson;
-            try {
-                responseJson = nlohmann::json::parse(res->body);
-            } catch (const nlohmann::json::parse_error& e) {
-                logMessage("JSON parse error for authentication response: " + std::string(e.what()), LOG_ERROR);
-                return false;
-            }
-
-            if (!responseJson.contains("id") || !responseJson.contains("name")) {
-                logMessage("No UUID or name found in authentication response.", LOG_ERROR);
-                return false;
-            }
-
-            outUUID = responseJson["id"];
-            outName = responseJson["name"];
-
-            for (const auto& prop : responseJson["properties"]) {
-                if (prop["name"] == "textures" && prop.contains("value") && prop.contains("signature")) {
-                    skinTexturesPair = { prop["value"], prop["signature"] };
-                }
-            }
-            return true;
+    if (res && res->status == 200) {
+        // Parse JSON response
+        nlohmann::json responseJson;
+        try {
+            responseJson = nlohmann::json::parse(res->body);
+        } catch (const nlohmann::json::parse_error& e) {
+            logMessage("JSON parse error for authentication response: " + std::string(e.what()), LOG_ERROR);
+            return false;
         }
-        if (res && res->status == 204) {
-            // 204 No Content: Authentication failed
-            logMessage("Authentication failed for player " + username + ": 204 No Content", LOG_ERROR);
-            if (tryCount < MAX_RETRIES - 1) {
-                logMessage("Retrying authentication (" + std::to_string(tryCount + 1) + "/" + std::to_string(MAX_RETRIES) + ")...", LOG_ERROR);
-                std::this_thread::sleep_for(std::chrono::milliseconds(RETRY_DELAY_MS));
-                continue; // Retry the loop
-            }
+
+        if (!responseJson.contains("id") || !responseJson.contains("name")) {
+            logMessage("No UUID or name found in authentication response.", LOG_ERROR);
             return false;
         }
-        if (res && res->status == 403) {
-            // 403 Forbidden: Player has multiplayer disabled or is banned
-            try {
-                auto jsonResponse = nlohmann::json::parse(res->body);
-                logMessage("Authentication Error: " + jsonResponse.at("error").get<std::string>(), LOG_ERROR);
-            } catch (...) {
-                logMessage("Authentication Error: 403 Forbidden", LOG_ERROR);
+
+        outUUID = responseJson["id"];
+        outName = responseJson["name"];
+
+        for (const auto& prop : responseJson["properties"]) {
+            if (prop["name"] == "textures" && prop.contains("value") && prop.contains("signature")) {
+                skinTexturesPair = { prop["value"], prop["signature"] };
             }
-            return false;
         }
-        // Handle other HTTP statuses
-        if (res) {
-            logMessage("Authentication failed for player " + username + ". HTTP Status: " + std::to_string(res->status), LOG_ERROR);
-        } else {
-            logMessage("Authentication request failed: No response from session server.", LOG_ERROR);
+        cacheTextures(outUUID, skinTexturesPair);
+        return true;
+    }
+    if (res && res->status == 204) {
+        // 204 No Content: the player didn't join with this server hash, asking again gives the same answer and would
+        // only keep one of the authentication threads from the other logins
+        logMessage("Authentication failed for player " + username + ": 204 No Content", LOG_ERROR);
+        return false;
+    }
+    if (res && res->status == 403) {
+        // 403 Forbidden: Player has multiplayer disabled or is banned
+        try {
+            auto jsonResponse = nlohmann::json::parse(res->body);
+            logMessage("Authentication Error: " + jsonResponse.at("error").get<std::string>(), LOG_ERROR);
+        } catch (...) {
+            logMessage("Authentication Error: 403 Forbidden", LOG_ERROR);
         }
         return false;
     }
-
-    // If all retries are exhausted
-    logMessage("Authentication failed for player " + username + " after " + std::to_string(MAX_RETRIES) + " attempts.", LOG_ERROR);
+    // Handle other HTTP statuses
+    if (res) {
+        logMessage("Authentication failed for player " + username + ". HTTP Status: " + std::to_string(res->status), LOG_ERROR);
+    } else {
+        logMessage("Authentication request failed: No response from session server.", LOG_ERROR);
+    }
     return false;
 }
 
+void clearProfileCache() {
+    std::lock_guard lock(profileCacheMutex);
+    profileCache.clear();
+}
+
 std::vector<std::string> fetchMojangPublicKeys() {
     httplib::Client cli("https://api.minecraftservices.com");
+    // Retries wait for this on a pool thread, an unresponsive endpoint must not hold it indefinitely
+    cli.set_connection_timeout(5);
+    cli.set_read_timeout(10);
     auto res = cli.Get("/publickeys");
 
     if (!res || res->status != 200) {
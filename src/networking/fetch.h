@@ -13,9 +13,14 @@ struct ParsedURL {
 };
 
 std::string fetchPlayerUUID(const std::string& name);
+// Skin textures (value, signature) of a player, from the profile cache when possible
 std::pair<std::string, std::string> fetchPlayerSkin(const std::string& uuid);
 std::string extractSkinURL(const std::string& texturesBase64);
+// Session server requests reuse a keep-alive connection per thread. The textures returned by a
+// successful authentication are put into the profile cache.
 bool authenticatePlayer(const std::string& username, const std::string& serverHash, const std::string& ipAddress, std::string& outUUID, std::string& outName, std::pair<std::string, std::string>& skinTexturesPair);
+void clearProfileCache();
+// Empty if the request failed, throws if the response is malformed
 std::vector<std::string> fetchMojangPublicKeys();
 bool validateResourcePackURL(const ResourcePack& pack);
 bool downloadResourcePack(const ResourcePack& pack, const std::string& downloadPath);
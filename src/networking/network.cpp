@@ -6,32 +6,13 @@
 #endif
 #include <openssl/err.h>
 #include <openssl/evp.h>
+#include <zlib.h>
 
 #include "client.h"
+#include "event_loop.h"
 #include "core/config.h"
 #include "core/server.h"
 
-int32_t readVarInt(SocketType sock) {
-    int32_t numRead = 0;
-    int32_t result = 0;
-    uint8_t readByte;
-    do {
-        int recvResult = recv(sock, reinterpret_cast<char*>(&readByte), 1, 0);
-        if (recvResult <= 0) {
-            return -1;
-        }
-        int32_t value = (readByte & 0b01111111);
-        result |= (value << (7 * numRead));
-
-        numRead++;
-        if (numRead > 5) {
-            return -1;
-        }
-    } while ((readByte & 0b10000000) != 0);
-
-    return result;
-}
-
 void logicalShiftRightAssign(int32_t& value, int shift) {
     // Cast to unsigned to perform logical shift
     uint32_t unsignedValue = static_cast<uint32_t>(value);
@@ -39,7 +20,18 @@ void logicalShiftRightAssign(int32_t& value, int shift) {
     value = static_cast<int32_t>(unsignedValue);
 }
 
-void writeVarInt(std::vector<uint8_t>& buffer, int32_t value) {
+namespace {
+    void appendBytes(std::vector<uint8_t>& buffer, const uint8_t* bytes, size_t size) {
+        buffer.insert(buffer.end(), bytes, bytes + size);
+    }
+
+    void appendBytes(PacketWriter& buffer, const uint8_t* bytes, size_t size) {
+        buffer.append(bytes, size);
+    }
+}
+
+template <ByteBuffer Buffer>
+void writeVarInt(Buffer& buffer, int32_t value) {
     while (true) {
         if ((value & ~0x7F) == 0) {
             writeByte(buffer, static_cast<uint8_t>(value));
@@ -51,60 +43,66 @@ void writeVarInt(std::vector<uint8_t>& buffer, int32_t value) {
     }
 }
 
-void writeString(std::vector<uint8_t>& buffer, const std::string& str) {
+template <ByteBuffer Buffer>
+void writeString(Buffer& buffer, const std::string& str) {
     writeVarInt(buffer, static_cast<int32_t>(str.size()));
-    buffer.insert(buffer.end(), str.begin(), str.end());
+    appendBytes(buffer, reinterpret_cast<const uint8_t*>(str.data()), str.size());
 }
 
-void writeInt(std::vector<uint8_t>& buffer, int32_t value) {
+template <ByteBuffer Buffer>
+void writeInt(Buffer& buffer, int32_t value) {
     buffer.push_back((value >> 24) & 0xFF);
     buffer.push_back((value >> 16) & 0xFF);
     buffer.push_back((value >> 8) & 0xFF);
     buffer.push_back(value & 0xFF);
 }
 
-void writeLong(std::vector<uint8_t>& buffer, int64_t value) {
+template <ByteBuffer Buffer>
+void writeLong(Buffer& buffer, int64_t value) {
     for (int i = 7; i >= 0; --i) {
         buffer.push_back((value >> (8 * i)) & 0xFF);
     }
 }
 
-void writeDouble(std::vector<uint8_t>& buffer, double value) {
+template <ByteBuffer Buffer>
+void writeDouble(Buffer& buffer, double value) {
     uint64_t data;
     memcpy(&data, &value, sizeof(double));
     writeLong(buffer, data);
 }
 
-void writeFloat(std::vector<uint8_t>& buffer, float value) {
+template <ByteBuffer Buffer>
+void writeFloat(Buffer& buffer, float value) {
     uint32_t data;
     memcpy(&data, &value, sizeof(float));
     writeInt(buffer, data);
 }
 
-void writeBytes(std::vector<uint8_t>& buffer, const std::vector<uint8_t>& data, const size_t length) {
-    if (length != -1) {
-        buffer.insert(buffer.end(), data.begin(), data.begin() + length);
-        return;
-    }
-    buffer.insert(buffer.end(), data.begin(), data.end());
+template <ByteBuffer Buffer>
+void writeBytes(Buffer& buffer, const std::vector<uint8_t>& data, const size_t length) {
+    appendBytes(buffer, data.data(), length != static_cast<size_t>(-1) ? length : data.size());
 }
 
 
-void writeByte(std::vector<uint8_t>& buffer, int8_t value) {
+template <ByteBuffer Buffer>
+void writeByte(Buffer& buffer, int8_t value) {
     buffer.push_back(value);
 }
 
-void writeUByte(std::vector<uint8_t> &buffer, uint8_t value) {
+template <ByteBuffer Buffer>
+void writeUByte(Buffer& buffer, uint8_t value) {
     buffer.push_back(value);
 }
 
 
-void writeShort(std::vector<uint8_t>& buffer, int16_t value) {
+template <ByteBuffer Buffer>
+void writeShort(Buffer& buffer, int16_t value) {
     buffer.push_back(static_cast<uint8_t>((value >> 8) & 0xFF));
     buffer.push_back(static_cast<uint8_t>(value & 0xFF));
 }
 
-void writeVarLong(std::vector<uint8_t>& buffer, uint64_t value) {
+template <ByteBuffer Buffer>
+void writeVarLong(Buffer& buffer, uint64_t value) {
     do {
         uint8_t temp = value & 0b01111111;
         value >>= 7;
@@ -115,7 +113,8 @@ void writeVarLong(std::vector<uint8_t>& buffer, uint64_t value) {
     } while (value != 0);
 }
 
-void writeSlotSimple(std::vector<uint8_t>& buffer, const SlotData& slot) {
+template <ByteBuffer Buffer>
+void writeSlotSimple(Buffer& buffer, const SlotData& slot) {
     writeVarInt(buffer, slot.itemCount);
     if(slot.itemCount == 0) {
         return;
@@ -129,7 +128,8 @@ void writeSlotSimple(std::vector<uint8_t>& buffer, const SlotData& slot) {
     writeVarInt(buffer, 0);
 }
 
-void writeUUID(std::vector<uint8_t>& buffer, const std::array<uint8_t, 16>& uuid) {
+template <ByteBuffer Buffer>
+void writeUUID(Buffer& buffer, const std::array<uint8_t, 16>& uuid) {
     for (int i = 0; i < 16; i += 8) {
         for (int j = 7; j >= 0; --j) {
             buffer.push_back(uuid[i + j]);
@@ -137,6 +137,34 @@ void writeUUID(std::vector<uint8_t>& buffer, const std::array<uint8_t, 16>& uuid
     }
 }
 
+// Every ByteBuffer the helpers are used with
+template void writeVarInt(std::vector<uint8_t>&, int32_t);
+template void writeVarInt(PacketWriter&, int32_t);
+template void writeString(std::vector<uint8_t>&, const std::string&);
+template void writeString(PacketWriter&, const std::string&);
+template void writeInt(std::vector<uint8_t>&, int32_t);
+template void writeInt(PacketWriter&, int32_t);
+template void writeLong(std::vector<uint8_t>&, int64_t);
+template void writeLong(PacketWriter&, int64_t);
+template void writeDouble(std::vector<uint8_t>&, double);
+template void writeDouble(PacketWriter&, double);
+template void writeFloat(std::vector<uint8_t>&, float);
+template void writeFloat(PacketWriter&, float);
+template void writeBytes(std::vector<uint8_t>&, const std::vector<uint8_t>&, const size_t);
+template void writeBytes(PacketWriter&, const std::vector<uint8_t>&, const size_t);
+template void writeByte(std::vector<uint8_t>&, int8_t);
+template void writeByte(PacketWriter&, int8_t);
+template void writeUByte(std::vector<uint8_t>&, uint8_t);
+template void writeUByte(PacketWriter&, uint8_t);
+template void writeShort(std::vector<uint8_t>&, int16_t);
+template void writeShort(PacketWriter&, int16_t);
+template void writeVarLong(std::vector<uint8_t>&, uint64_t);
+template void writeVarLong(PacketWriter&, uint64_t);
+template void writeSlotSimple(std::vector<uint8_t>&, const SlotData&);
+template void writeSlotSimple(PacketWriter&, const SlotData&);
+template void writeUUID(std::vector<uint8_t>&, const std::array<uint8_t, 16>&);
+template void writeUUID(PacketWriter&, const std::array<uint8_t, 16>&);
+
 int32_t parseVarInt(const std::vector<uint8_t>& data, size_t& index) {
     int32_t value = 0;
     int32_t position = 0;
@@ -288,201 +316,88 @@ uint8_t parseByte(const std::vector<uint8_t>& data, size_t& index) {
     return data[index++];
 }
 
-bool readUnencryptedPacket(const ClientConnection& client, std::vector<uint8_t>& packetData) {
-    // Read the length prefix (VarInt)
-    int32_t length = readVarInt(client.socket);
-    if (length == -1) {
-        // Connection closed or error
-        return false;
-    }
+// Blocks until the receive buffer holds a complete frame and extracts it
+bool readFrame(ClientConnection& client, std::vector<uint8_t>& payload) {
+    while (true) {
+        bool error = false;
+        if (client.receiveBuffer.nextFrame(payload, error)) {
+            return true;
+        }
+        if (error) {
+            return false;
+        }
 
-    // Read the packet payload based on the length
-    packetData.resize(length);
-    size_t totalRead = 0;
-    while (totalRead < static_cast<size_t>(length)) {
-        ssize_t bytesRead = recv(client.socket, reinterpret_cast<char*>(packetData.data()) + totalRead, length - totalRead, 0);
+        // One large read usually brings in several packets
+        ssize_t bytesRead = client.receiveBuffer.fill(client.socket);
         if (bytesRead <= 0) {
             // Connection closed or error
             return false;
         }
-        totalRead += bytesRead;
+        if (!client.receiveBuffer.decryptNew(client.decryptCtx)) {
+            return false;
+        }
     }
-
-    return true;
 }
 
-bool readPacketTimeout(const ClientConnection& client, std::vector<uint8_t>& packetData, int timeout, bool unencrypted) {
-    fd_set readSet;
-    FD_ZERO(&readSet);
-    FD_SET(client.socket, &readSet);
-
-    timeval tv;
-    tv.tv_sec = timeout;
-    tv.tv_usec = 0;
-
-    int selectResult = select(client.socket + 1, &readSet, nullptr, nullptr, &tv);
-    if (selectResult == -1) {
-        // Error occurred
-        return false;
-    }
-    if (selectResult == 0) {
-        // Timeout
-        return false;
-    }
-    if (unencrypted) {
-        return readUnencryptedPacket(client, packetData);
-    }
-    return readPacket(client, packetData);
+bool readUnencryptedPacket(ClientConnection& client, std::vector<uint8_t>& packetData) {
+    return readFrame(client, packetData);
 }
 
-bool readPacket(const ClientConnection& client, std::vector<uint8_t>& packetData) {
-    if (serverConfig.enableEncryption && client.decryptCtx) {
-        // Step 1: Read encrypted length prefix (VarInt up to 5 bytes)
-        int32_t length = 0;
-        int32_t numRead = 0;
-        uint8_t decryptedByte;
-        bool lengthRead = false;
-
-        while (numRead < 5 && !lengthRead) {
-            uint8_t encryptedByte;
-            ssize_t bytesRead = recv(client.socket, reinterpret_cast<char*>(&encryptedByte), 1, 0);
-            if (bytesRead <= 0) {
-                // Connection closed or error
-                return false;
-            }
-
-            // Decrypt the byte
-            int outLen = 0;
-            if (EVP_DecryptUpdate(client.decryptCtx, &decryptedByte, &outLen, &encryptedByte, 1) != 1) {
-                logMessage("Failed to decrypt length byte", LOG_ERROR);
-                ERR_print_errors_fp(stderr);
-                return false;
-            }
-
-            if (outLen != 1) {
-                logMessage("Unexpected decrypted length for length byte", LOG_ERROR);
-                return false;
-            }
+bool readPacketTimeout(ClientConnection& client, std::vector<uint8_t>& packetData, int timeout, bool unencrypted) {
+    // A packet that is already buffered doesn't need to wait for the socket
+    if (!client.receiveBuffer.hasFrame()) {
+        fd_set readSet;
+        FD_ZERO(&readSet);
+        FD_SET(client.socket, &readSet);
 
-            // Accumulate the length
-            length |= (decryptedByte & 0x7F) << (7 * numRead);
-            if ((decryptedByte & 0x80) == 0) {
-                lengthRead = true;
-            }
-            numRead++;
-        }
+        timeval tv;
+        tv.tv_sec = timeout;
+        tv.tv_usec = 0;
 
-        if (!lengthRead) {
-            logMessage("VarInt length prefix is too big", LOG_ERROR);
+        int selectResult = select(client.socket + 1, &readSet, nullptr, nullptr, &tv);
+        if (selectResult == -1) {
+            // Error occurred
             return false;
         }
-
-        // Step 2: Read encrypted payload based on the decrypted length
-        std::vector<uint8_t> encryptedPayload(length);
-        size_t totalRead = 0;
-        while (totalRead < static_cast<size_t>(length)) {
-            ssize_t bytesRead = recv(client.socket, reinterpret_cast<char*>(encryptedPayload.data()) + totalRead, length - totalRead, 0);
-            if (bytesRead <= 0) {
-                // Connection closed or error
-                return false;
-            }
-            totalRead += bytesRead;
-        }
-
-        // Step 3: Decrypt the payload
-        std::vector<uint8_t> decryptedPayload(length);
-        int decryptedLen = 0;
-        if (EVP_DecryptUpdate(client.decryptCtx, decryptedPayload.data(), &decryptedLen, encryptedPayload.data(), length) != 1) {
-            logMessage("Failed to decrypt payload", LOG_ERROR);
-            ERR_print_errors_fp(stderr);
+        if (selectResult == 0) {
+            // Timeout
             return false;
         }
-        decryptedPayload.resize(decryptedLen);
-
-        // Assign the decrypted payload to packetData
-        packetData = decryptedPayload;
-
-        // Check for compression
-        if (client.compressionEnabled && serverConfig.enableCompression) {
-            size_t index = 0;
-            // Read the Data Length VarInt
-            int32_t dataLength = parseVarInt(decryptedPayload, index);
-
-            if (dataLength == 0) {
-                // Packet is not compressed
-                packetData = std::vector<uint8_t>(decryptedPayload.begin() + index, decryptedPayload.end());
-            } else {
-                // Packet is compressed
-                // Extract compressed data
-                std::vector<uint8_t> compressedData(decryptedPayload.begin() + index, decryptedPayload.end());
-
-                try {
-                    // Decompress data
-                    std::vector<uint8_t> decompressedData = decompressData(compressedData);
-
-                    // Replace packetData with decompressed data
-                    packetData = decompressedData;
-                } catch (const std::exception& e) {
-                    logMessage("Decompression failed: " + std::string(e.what()), LOG_ERROR);
-                    return false;
-                }
-            }
-        }
-
-        return true;
     }
-    // Existing unencrypted readPacket logic
-    // Read the length prefix (VarInt)
-    int32_t length = 0;
-    int32_t numRead = 0;
-    uint8_t read;
-    do {
-        ssize_t bytesRead = recv(client.socket, reinterpret_cast<char*>(&read), 1, 0);
-        if (bytesRead <= 0) {
-            // Connection closed or error
-            return false;
-        }
-        length |= (read & 0x7F) << (7 * numRead);
-        numRead++;
-        if (numRead > 5) {
-            // VarInt is too big
-            logMessage("VarInt is too big", LOG_ERROR);
-            return false;
-        }
-    } while ((read & 0x80) != 0);
+    if (unencrypted) {
+        return readUnencryptedPacket(client, packetData);
+    }
+    return readPacket(client, packetData);
+}
 
-    // Read the packet payload based on the length
-    std::vector<uint8_t> receivedData(length);
-    size_t totalRead = 0;
-    while (totalRead < static_cast<size_t>(length)) {
-        ssize_t bytesRead = recv(client.socket, reinterpret_cast<char*>(receivedData.data()) + totalRead, length - totalRead, 0);
-        if (bytesRead <= 0) {
-            // Connection closed or error
-            return false;
-        }
-        totalRead += bytesRead;
+bool readPacket(ClientConnection& client, std::vector<uint8_t>& packetData) {
+    std::vector<uint8_t> payload;
+    if (!readFrame(client, payload)) {
+        return false;
     }
+    return decodePacketPayload(client, payload, packetData);
+}
 
+bool decodePacketPayload(const ClientConnection& client, const std::vector<uint8_t>& payload, std::vector<uint8_t>& packetData) {
     // Check for compression
     if (client.compressionEnabled && serverConfig.enableCompression) {
         size_t index = 0;
         // Read the Data Length VarInt
-        int32_t dataLength = parseVarInt(receivedData, index);
+        int32_t dataLength = parseVarInt(payload, index);
 
         if (dataLength == 0) {
             // Packet is not compressed
-            packetData = std::vector<uint8_t>(receivedData.begin() + index, receivedData.end());
+            packetData = std::vector<uint8_t>(payload.begin() + index, payload.end());
         } else {
-            // Packet is compressed
-            // Extract compressed data
-            std::vector<uint8_t> compressedData(receivedData.begin() + index, receivedData.end());
+            // Packet is compressed, Data Length is the size after decompression
+            if (dataLength < 0 || static_cast<size_t>(dataLength) > MAX_UNCOMPRESSED_PACKET_SIZE) {
+                logMessage("Invalid uncompressed packet length: " + std::to_string(dataLength), LOG_ERROR);
+                return false;
+            }
 
             try {
                 // Decompress data
-                std::vector<uint8_t> decompressedData = decompressData(compressedData);
-
-                // Replace packetData with decompressed data
-                packetData = decompressedData;
+                decompressData(payload.data() + index, payload.size() - index, dataLength, packetData);
             } catch (const std::exception& e) {
                 logMessage("Decompression failed: " + std::string(e.what()), LOG_ERROR);
                 return false;
@@ -490,38 +405,23 @@ bool readPacket(const ClientConnection& client, std::vector<uint8_t>& packetData
         }
     } else {
         // No compression; assign received data directly
-        packetData = receivedData;
+        packetData = payload;
     }
 
     return true;
 }
 
-std::vector<uint8_t> buildPacket(const std::vector<uint8_t>& payload) {
-    std::vector<uint8_t> packet;
-    writeVarInt(packet, static_cast<int32_t>(payload.size()));
-    packet.insert(packet.end(), payload.begin(), payload.end());
-    return packet;
-}
-
-std::vector<uint8_t> writeLength(const std::vector<uint8_t>& payload) {
-    std::vector<uint8_t> packet;
-    writeVarInt(packet, static_cast<int32_t>(payload.size()));
-    return packet;
-}
-
-bool sendUnencryptedPacket(ClientConnection& client, const std::vector<uint8_t>& packetData) {
-    if (client.connectionClosed) {
-        return false;
-    }
-    std::lock_guard lock(client.sendMutex);
-    std::vector<uint8_t> dataToSend = buildPacket(packetData);
+// Writes the whole buffer to a blocking socket (connections without an event loop)
+bool sendAll(SocketType socket, const uint8_t* data, size_t size) {
     size_t totalSent = 0;
-    size_t packetSize = dataToSend.size();
-    const char* dataPtr = reinterpret_cast<const char*>(dataToSend.data());
+    const char* dataPtr = reinterpret_cast<const char*>(data);
 
-    while (totalSent < packetSize) {
-        ssize_t sent = send(client.socket, dataPtr + totalSent, packetSize - totalSent, 0);
+    while (totalSent < size) {
+        ssize_t sent = send(socket, dataPtr + totalSent, size - totalSent, MSG_NOSIGNAL);
         if (sent == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
             logMessage("Failed to send packet: " + std::string(strerror(errno)), LOG_DEBUG);
             return false;
         }
@@ -530,80 +430,210 @@ bool sendUnencryptedPacket(ClientConnection& client, const std::vector<uint8_t>&
     return true;
 }
 
-bool sendPacket(ClientConnection& client, const std::vector<uint8_t>& packetData) {
-    if (client.connectionClosed) {
+// Hands a finished frame to the connection's outbound queue. Called with the send mutex held so
+// frames are queued in the order they were encrypted.
+bool queueFrame(ClientConnection& client, std::vector<uint8_t>&& buffer, size_t offset) {
+    if (!client.loop) {
+        return sendAll(client.socket, buffer.data() + offset, buffer.size() - offset);
+    }
+    if (client.outbound.overflowed) {
         return false;
     }
-    std::lock_guard<std::mutex> lock(client.sendMutex);
-    std::vector<uint8_t> dataToSend;
+
+    size_t queued = client.outbound.push(std::move(buffer), offset);
+    if (queued > serverConfig.maxOutboundBacklog) {
+        // The client doesn't keep up, drop it instead of buffering without bound
+        client.outbound.overflowed = true;
+        logMessage("Client exceeded the outbound backlog (" + std::to_string(queued) + " bytes in "
+                   + std::to_string(client.outbound.queuedPackets()) + " packets), disconnecting", LOG_WARNING);
+        client.loop->closeAfterFlush(client.shared_from_this());
+    } else if (queued >= OUTBOUND_FLUSH_THRESHOLD && !client.outbound.flushScheduled.exchange(true)) {
+        client.loop->requestFlush(client.shared_from_this());
+    }
+    return true;
+}
+
+int compressionLevel(CompressionClass compressionClass) {
+    switch (compressionClass) {
+        case CompressionClass::Chunk:
+            return serverConfig.chunkCompressionLevel;
+        case CompressionClass::Movement:
+            return serverConfig.movementCompressionLevel;
+        case CompressionClass::Static:
+            return Z_BEST_COMPRESSION;
+        default:
+            return serverConfig.compressionLevel;
+    }
+}
+
+// Compresses (when over the threshold) and frames the packet. Returns the writer holding the frame,
+// either the packet itself or compressedPacket, or nullptr if compression failed.
+PacketWriter* encodeFrame(PacketWriter& packet, bool compressionEnabled, PacketWriter& compressedPacket) {
+    if (!compressionEnabled) {
+        packet.finishFrame();
+        return &packet;
+    }
 
     // Determine if compression should be applied
     bool shouldCompress = serverConfig.enableCompression &&
-                          packetData.size() >= serverConfig.compressionThreshold;
+                          packet.bodySize() >= static_cast<size_t>(serverConfig.compressionThreshold);
+    if (!shouldCompress) {
+        // No compression: Data Length is 0
+        packet.prependVarInt(0);
+        packet.finishFrame();
+        return &packet;
+    }
+
+    try {
+        // Compress the (Packet ID + Data)
+        compressedPacket.appendWith(compressedSizeBound(packet.bodySize()), [&](uint8_t* out) {
+            return compressData(packet.body(), packet.bodySize(), out, compressedSizeBound(packet.bodySize()),
+                                compressionLevel(packet.compressionClass));
+        });
+    } catch (const std::exception& e) {
+        logMessage("Compression failed: " + std::string(e.what()), LOG_ERROR);
+        return nullptr;
+    }
+    // Data Length (uncompressed size)
+    compressedPacket.prependVarInt(static_cast<int32_t>(packet.bodySize()));
+    compressedPacket.finishFrame();
+    return &compressedPacket;
+}
+
+bool encryptFrame(ClientConnection& client, const uint8_t* input, uint8_t* output, size_t size) {
+    if (!serverConfig.enableEncryption || !client.encryptCtx) {
+        if (input != output) {
+            std::memcpy(output, input, size);
+        }
+        return true;
+    }
+    // CFB8 is a stream mode, input and output may be the same buffer
+    int outLen = 0;
+    if (EVP_EncryptUpdate(client.encryptCtx, output, &outLen, input, static_cast<int>(size)) != 1) {
+        logMessage("Failed to encrypt packet data", LOG_ERROR);
+        ERR_print_errors_fp(stderr);
+        return false;
+    }
+    return true;
+}
 
-    if (shouldCompress && client.compressionEnabled) {
-        try {
-            // Compress the (Packet ID + Data)
-            std::vector<uint8_t> compressedData = compressData(packetData);
+bool sendUnencryptedPacket(ClientConnection& client, PacketWriter&& packet) {
+    std::lock_guard lock(client.sendMutex);
+    if (client.connectionClosed) {
+        return false;
+    }
+    packet.finishFrame();
+    size_t offset = packet.frameOffset();
+    return queueFrame(client, packet.takeBuffer(), offset);
+}
 
-            // Create a new packet with Data Length (uncompressed size) + Compressed Data
-            std::vector<uint8_t> compressedPacket;
-            writeVarInt(compressedPacket, packetData.size()); // Data Length
-            compressedPacket.insert(compressedPacket.end(), compressedData.begin(), compressedData.end());
+bool sendPacket(ClientConnection& client, PacketWriter&& packet) {
+    std::lock_guard<std::mutex> lock(client.sendMutex);
+    if (client.connectionClosed) {
+        return false;
+    }
 
-            dataToSend = buildPacket(compressedPacket);
-        } catch (const std::exception& e) {
-            logMessage("Compression failed: " + std::string(e.what()), LOG_ERROR);
-            return false;
-        }
-    } else if (client.compressionEnabled) {
-        // No compression: Data Length is 0
-        std::vector<uint8_t> uncompressedPacket;
-        writeVarInt(uncompressedPacket, 0); // Data Length = 0
-        uncompressedPacket.insert(uncompressedPacket.end(), packetData.begin(), packetData.end());
+    // Compressed packets need a buffer of their own, everything else is framed in place
+    PacketWriter compressedPacket;
+    PacketWriter* framed = encodeFrame(packet, client.compressionEnabled, compressedPacket);
+    if (!framed) {
+        return false;
+    }
+    std::span<uint8_t> frame = framed->frame();
+    if (!encryptFrame(client, frame.data(), frame.data(), frame.size())) {
+        return false;
+    }
+    size_t offset = framed->frameOffset();
+    return queueFrame(client, framed->takeBuffer(), offset);
+}
 
-        // Build the final packet with length prefix
-        dataToSend = buildPacket(uncompressedPacket);
-    } else {
-        // No compression and compression not enabled
-        dataToSend = buildPacket(packetData);
-    }
-
-    // Handle encryption if enabled
-    if (serverConfig.enableEncryption && client.encryptCtx) {
-        // Encrypt dataToSend
-        std::vector<uint8_t> encryptedData(dataToSend.size() + EVP_CIPHER_block_size(EVP_aes_128_cfb8()));
-        int outLen = 0;
-        if (EVP_EncryptUpdate(client.encryptCtx, encryptedData.data(), &outLen, dataToSend.data(), dataToSend.size()) != 1) {
-            logMessage("Failed to encrypt packet data", LOG_ERROR);
-            ERR_print_errors_fp(stderr);
-            return false;
-        }
-        encryptedData.resize(outLen);
-        dataToSend = encryptedData;
+EncodedPacket::EncodedPacket(const PacketWriter& packet) : packet(packet) {
+}
+
+std::span<const uint8_t> EncodedPacket::frame(bool compressionEnabled) {
+    Variant& variant = compressionEnabled ? compressed : uncompressed;
+    if (!variant.encoded) {
+        variant.encoded = true;
+        variant.body = packet;
+        variant.framed = encodeFrame(variant.body, compressionEnabled, variant.compressedBody);
     }
+    if (!variant.framed) {
+        return {};
+    }
+    return variant.framed->frame();
+}
 
-    // Send the packet
-    size_t totalSent = 0;
-    size_t packetSize = dataToSend.size();
-    const char* dataPtr = reinterpret_cast<const char*>(dataToSend.data());
+// Encrypts a frame shared by several connections into a buffer of the connection's own and queues it.
+// Called with the send mutex held.
+bool queueSharedFrame(ClientConnection& client, std::span<const uint8_t> frame) {
+    if (frame.empty()) {
+        return false;
+    }
+    // The shared frame stays untouched, every recipient encrypts into a buffer of its own
+    std::vector<uint8_t> buffer(frame.size());
+    if (!encryptFrame(client, frame.data(), buffer.data(), frame.size())) {
+        return false;
+    }
+    return queueFrame(client, std::move(buffer), 0);
+}
 
-    while (totalSent < packetSize) {
-        ssize_t sent = send(client.socket, dataPtr + totalSent, packetSize - totalSent, 0);
-        if (sent == -1) {
-            logMessage("Failed to send packet: " + std::string(strerror(errno)), LOG_ERROR);
-            return false;
+bool sendEncodedPacket(ClientConnection& client, EncodedPacket& encoded) {
+    std::lock_guard lock(client.sendMutex);
+    if (client.connectionClosed) {
+        return false;
+    }
+    return queueSharedFrame(client, encoded.frame(client.compressionEnabled));
+}
+
+namespace {
+    void encodeCachedFrame(PacketWriter body, bool compressionEnabled, std::vector<uint8_t>& frame) {
+        PacketWriter compressedBody;
+        if (PacketWriter* framed = encodeFrame(body, compressionEnabled, compressedBody)) {
+            std::span<uint8_t> encoded = framed->frame();
+            frame.assign(encoded.begin(), encoded.end());
         }
-        totalSent += sent;
     }
-    return true;
 }
 
-void broadcastToOthers(const std::vector<uint8_t>& packetData, const std::string& excludeUUID) {
+CachedPacket::CachedPacket(const PacketWriter& packet) {
+    PacketWriter body = packet;
+    body.compressionClass = CompressionClass::Static;
+    encodeCachedFrame(body, true, compressedFrame);
+    encodeCachedFrame(std::move(body), false, uncompressedFrame);
+}
+
+CachedPacket::CachedPacket(const PacketWriter& packet, bool compressionEnabled) {
+    encodeCachedFrame(packet, compressionEnabled, compressionEnabled ? compressedFrame : uncompressedFrame);
+}
+
+bool sendCachedPacket(ClientConnection& client, const CachedPacket& cached) {
+    std::lock_guard lock(client.sendMutex);
+    if (client.connectionClosed) {
+        return false;
+    }
+    return queueSharedFrame(client, cached.frame(client.compressionEnabled));
+}
+
+void broadcastToOthers(const PacketWriter& packet, const std::string& excludeUUID) {
+    // Serialized and compressed once, only the encryption is done per recipient
+    EncodedPacket encoded(packet);
     std::lock_guard lock(connectedClientsMutex);
     for (const auto& [uuid, client] : connectedClients) {
         if (uuid != excludeUUID) {
-            sendPacket(*client, packetData);
+            sendEncodedPacket(*client, encoded);
         }
     }
+}
+
+void closeConnection(ClientConnection& client) {
+    if (client.loop) {
+        client.loop->closeAfterFlush(client.shared_from_this());
+        return;
+    }
+    // Shut the socket down, the thread owning the connection closes it once it sees the EOF
+#ifdef _WIN32
+    shutdown(client.socket, SD_BOTH);
+#else
+    shutdown(client.socket, SHUT_RDWR);
+#endif
 }
\ No newline at end of file
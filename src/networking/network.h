@@ -1,13 +1,19 @@
 #ifndef NETWORK_H
 #define NETWORK_H
+#include <array>
+#include <concepts>
 #include <vector>
 #include <cstdint>
 #include <mutex>
+#include <span>
 #include <string>
 
+#include "packet_writer.h"
+
 #ifdef _WIN32
 #include <winsock2.h>
 typedef SOCKET SocketType;
+#define MSG_NOSIGNAL 0
 #else
 #include <sys/socket.h>
 #include <netinet/in.h>
@@ -20,20 +26,28 @@ typedef int SocketType;
 struct SlotData;
 struct ClientConnection;
 
-int32_t readVarInt(SocketType sock);
-void writeVarInt(std::vector<uint8_t>& buffer, int32_t value);
-void writeString(std::vector<uint8_t>& buffer, const std::string& str);
-void writeInt(std::vector<uint8_t>& buffer, int32_t value);
-void writeLong(std::vector<uint8_t>& buffer, int64_t value);
-void writeDouble(std::vector<uint8_t>& buffer, double value);
-void writeFloat(std::vector<uint8_t>& buffer, float value);
-void writeBytes(std::vector<uint8_t>& buffer, const std::vector<uint8_t>& data, const size_t length = -1);
-void writeByte(std::vector<uint8_t>& buffer, int8_t value);
-void writeUByte(std::vector<uint8_t>& buffer, uint8_t value);
-void writeShort(std::vector<uint8_t>& buffer, int16_t value);
-void writeVarLong(std::vector<uint8_t>& buffer, uint64_t value);
-void writeSlotSimple(std::vector<uint8_t>& buffer, const SlotData& slot);
-void writeUUID(std::vector<uint8_t>& buffer, const std::array<uint8_t, 16>& uuid);
+// Maximum size of a single serverbound packet (3 byte VarInt length prefix)
+constexpr size_t MAX_PACKET_SIZE = 2097151;
+// Largest Data Length accepted for a compressed serverbound packet
+constexpr size_t MAX_UNCOMPRESSED_PACKET_SIZE = 8388608;
+
+// The write* helpers append to plain byte vectors and to packet bodies alike
+template <typename Buffer>
+concept ByteBuffer = std::same_as<Buffer, std::vector<uint8_t>> || std::same_as<Buffer, PacketWriter>;
+
+template <ByteBuffer Buffer> void writeVarInt(Buffer& buffer, int32_t value);
+template <ByteBuffer Buffer> void writeString(Buffer& buffer, const std::string& str);
+template <ByteBuffer Buffer> void writeInt(Buffer& buffer, int32_t value);
+template <ByteBuffer Buffer> void writeLong(Buffer& buffer, int64_t value);
+template <ByteBuffer Buffer> void writeDouble(Buffer& buffer, double value);
+template <ByteBuffer Buffer> void writeFloat(Buffer& buffer, float value);
+template <ByteBuffer Buffer> void writeBytes(Buffer& buffer, const std::vector<uint8_t>& data, const size_t length = -1);
+template <ByteBuffer Buffer> void writeByte(Buffer& buffer, int8_t value);
+template <ByteBuffer Buffer> void writeUByte(Buffer& buffer, uint8_t value);
+template <ByteBuffer Buffer> void writeShort(Buffer& buffer, int16_t value);
+template <ByteBuffer Buffer> void writeVarLong(Buffer& buffer, uint64_t value);
+template <ByteBuffer Buffer> void writeSlotSimple(Buffer& buffer, const SlotData& slot);
+template <ByteBuffer Buffer> void writeUUID(Buffer& buffer, const std::array<uint8_t, 16>& uuid);
 int32_t parseVarInt(const std::vector<uint8_t>& data, size_t& index);
 int64_t parseLong(const std::vector<uint8_t>& data, size_t& index);
 short parseShort(const std::vector<uint8_t>& data, size_t& index);
@@ -44,12 +58,72 @@ std::vector<uint8_t> parseBytes(const std::vector<uint8_t>& data, size_t& index,
 uint8_t parseByte(const std::vector<uint8_t>& data, size_t& index);
 uint64_t parseVarLong(const std::vector<uint8_t>& data, size_t& index);
 SlotData parseSlotData(const std::vector<uint8_t>& data, size_t& index);
-bool readUnencryptedPacket(const ClientConnection& client, std::vector<uint8_t>& packetData);
-bool readPacketTimeout(const ClientConnection& client, std::vector<uint8_t>& packetData, int timeout, bool unencrypted);
-bool readPacket(const ClientConnection& client, std::vector<uint8_t>& packetData);
-bool sendUnencryptedPacket(ClientConnection& client, const std::vector<uint8_t>& packetData);
-bool sendPacket(ClientConnection& client, const std::vector<uint8_t>& packetData);
-void broadcastToOthers(const std::vector<uint8_t>& packetData, const std::string& excludeUUID = "");
+bool readUnencryptedPacket(ClientConnection& client, std::vector<uint8_t>& packetData);
+bool readPacketTimeout(ClientConnection& client, std::vector<uint8_t>& packetData, int timeout, bool unencrypted);
+bool readPacket(ClientConnection& client, std::vector<uint8_t>& packetData);
+bool decodePacketPayload(const ClientConnection& client, const std::vector<uint8_t>& payload, std::vector<uint8_t>& packetData);
+// The packet is framed, compressed and encrypted in place and can't be reused afterwards. A packet that is
+// still needed has to be copied explicitly, one for several recipients goes through EncodedPacket instead.
+// Packets are queued on the connection and written by its event loop, sending never blocks on the socket.
+bool sendUnencryptedPacket(ClientConnection& client, PacketWriter&& packet);
+bool sendUnencryptedPacket(ClientConnection& client, const PacketWriter& packet) = delete;
+bool sendPacket(ClientConnection& client, PacketWriter&& packet);
+bool sendPacket(ClientConnection& client, const PacketWriter& packet) = delete;
+
+// A packet compressed and framed once and shared by several recipients. Only refers to the packet, which has to
+// outlive it.
+class EncodedPacket {
+public:
+    explicit EncodedPacket(const PacketWriter& packet);
+    explicit EncodedPacket(PacketWriter&& packet) = delete;
+
+    // Frame for connections with or without compression enabled, built on first use.
+    // Empty if encoding failed.
+    std::span<const uint8_t> frame(bool compressionEnabled);
+
+private:
+    struct Variant {
+        bool encoded = false;
+        PacketWriter body;
+        PacketWriter compressedBody;
+        PacketWriter* framed = nullptr;
+    };
+
+    const PacketWriter& packet;
+    Variant compressed;
+    Variant uncompressed;
+};
+
+// A packet that is the same for every connection and never changes (e.g. the registry data).
+// The frames with and without compression are both encoded when it is created, sending it only
+// encrypts a copy of one of them. Safe to send from several threads.
+class CachedPacket {
+public:
+    explicit CachedPacket(const PacketWriter& packet);
+    // Only encodes the frame for connections in the given compression state (at the packet's own
+    // compression level), the other frame stays empty. For large packets that are cached a lot.
+    CachedPacket(const PacketWriter& packet, bool compressionEnabled);
+
+    // Empty if encoding failed
+    std::span<const uint8_t> frame(bool compressionEnabled) const {
+        return compressionEnabled ? compressedFrame : uncompressedFrame;
+    }
+
+private:
+    std::vector<uint8_t> compressedFrame;
+    std::vector<uint8_t> uncompressedFrame;
+};
+
+// zlib level configured for the packet class
+int compressionLevel(CompressionClass compressionClass);
+PacketWriter* encodeFrame(PacketWriter& packet, bool compressionEnabled, PacketWriter& compressedPacket);
+// Encrypts a frame for the connection (a plain copy if encryption isn't enabled yet)
+bool encryptFrame(ClientConnection& client, const uint8_t* input, uint8_t* output, size_t size);
+bool sendEncodedPacket(ClientConnection& client, EncodedPacket& encoded);
+bool sendCachedPacket(ClientConnection& client, const CachedPacket& cached);
+void broadcastToOthers(const PacketWriter& packet, const std::string& excludeUUID = "");
+// Closes the connection once the packets queued so far were written
+void closeConnection(ClientConnection& client);
 
 #endif // NETWORK_H
 
@@ -0,0 +1,115 @@
+#include "outbound_queue.h"
+
+#include <array>
+#include <cerrno>
+#ifndef _WIN32
+#include <netinet/tcp.h>
+#include <sys/uio.h>
+#endif
+
+// Frames handed to the kernel per sendmsg call
+constexpr size_t MAX_IOVECS = 64;
+
+size_t OutboundQueue::push(std::vector<uint8_t>&& frame, size_t offset) {
+    size_t length = frame.size() - offset;
+    {
+        std::lock_guard lock(mutex);
+        pending.push_back({std::move(frame), offset});
+    }
+    ++packets;
+    return bytes += length;
+}
+
+void OutboundQueue::consume(size_t written) {
+    bytes -= written;
+    while (written > 0) {
+        Frame& front = writing.front();
+        size_t remaining = front.data.size() - front.offset;
+        if (written < remaining) {
+            front.offset += written;
+            return;
+        }
+        written -= remaining;
+        writing.pop_front();
+        --packets;
+    }
+}
+
+#ifndef _WIN32
+
+static void setCork(SocketType socket, int enabled) {
+    setsockopt(socket, IPPROTO_TCP, TCP_CORK, &enabled, sizeof(enabled));
+}
+
+OutboundQueue::FlushResult OutboundQueue::flush(SocketType socket) {
+    {
+        std::lock_guard lock(mutex);
+        for (auto& frame : pending) {
+            writing.push_back(std::move(frame));
+        }
+        pending.clear();
+    }
+    if (writing.empty()) {
+        return FlushResult::Done;
+    }
+
+    // One call usually covers everything queued during a tick. Bigger backlogs take several calls,
+    // cork the socket meanwhile so the end of one batch and the start of the next share segments.
+    bool corked = writing.size() > MAX_IOVECS;
+    if (corked) {
+        setCork(socket, 1);
+    }
+
+    FlushResult result = FlushResult::Done;
+    std::array<iovec, MAX_IOVECS> parts{};
+    while (!writing.empty()) {
+        size_t count = 0;
+        for (auto it = writing.begin(); it != writing.end() && count < MAX_IOVECS; ++it, ++count) {
+            parts[count].iov_base = it->data.data() + it->offset;
+            parts[count].iov_len = it->data.size() - it->offset;
+        }
+
+        // sendmsg instead of writev for MSG_NOSIGNAL
+        msghdr message{};
+        message.msg_iov = parts.data();
+        message.msg_iovlen = count;
+        ssize_t written = sendmsg(socket, &message, MSG_NOSIGNAL);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            result = (errno == EAGAIN || errno == EWOULDBLOCK) ? FlushResult::Blocked : FlushResult::Error;
+            break;
+        }
+        consume(written);
+    }
+
+    if (corked) {
+        setCork(socket, 0);
+    }
+    return result;
+}
+
+#else
+
+OutboundQueue::FlushResult OutboundQueue::flush(SocketType socket) {
+    {
+        std::lock_guard lock(mutex);
+        for (auto& frame : pending) {
+            writing.push_back(std::move(frame));
+        }
+        pending.clear();
+    }
+    while (!writing.empty()) {
+        Frame& front = writing.front();
+        int written = send(socket, reinterpret_cast<const char*>(front.data.data() + front.offset),
+                           static_cast<int>(front.data.size() - front.offset), 0);
+        if (written == SOCKET_ERROR) {
+            return WSAGetLastError() == WSAEWOULDBLOCK ? FlushResult::Blocked : FlushResult::Error;
+        }
+        consume(written);
+    }
+    return FlushResult::Done;
+}
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef OUTBOUND_QUEUE_H
+#define OUTBOUND_QUEUE_H
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include "network.h"
+
+// Once this many bytes are queued the owning event loop is asked to flush before the next tick
+constexpr size_t OUTBOUND_FLUSH_THRESHOLD = 64 * 1024;
+
+// Per-connection queue of finished (compressed and encrypted) frames.
+// Producers on any thread append without touching the socket, the event loop owning the
+// connection drains the queue with scatter/gather writes once per tick or when it fills up.
+class OutboundQueue {
+public:
+    enum class FlushResult {
+        Done,    // Everything was handed to the kernel
+        Blocked, // The socket buffer is full, wait for it to become writable
+        Error,
+    };
+
+    // Appends a frame whose wire bytes start at offset. Returns the number of bytes queued afterwards.
+    size_t push(std::vector<uint8_t>&& frame, size_t offset);
+    // Writes as much as the socket accepts (owning loop thread only)
+    FlushResult flush(SocketType socket);
+
+    size_t queuedBytes() const { return bytes.load(std::memory_order_relaxed); }
+    size_t queuedPackets() const { return packets.load(std::memory_order_relaxed); }
+
+    // Set while a flush requested by a producer is pending on the loop
+    std::atomic<bool> flushScheduled = false;
+    // Set once the backlog limit was hit, nothing is queued anymore
+    std::atomic<bool> overflowed = false;
+    // Set while the loop waits for the socket to become writable (owning loop thread only)
+    bool waitingWritable = false;
+
+private:
+    struct Frame {
+        std::vector<uint8_t> data;
+        size_t offset;
+    };
+
+    void consume(size_t written);
+
+    std::mutex mutex;
+    // Frames pushed since the last flush
+    std::vector<Frame> pending;
+    // Frames taken by the flusher, the front one may be partially written (owning loop thread only)
+    std::deque<Frame> writing;
+    std::atomic<size_t> bytes = 0;
+    std::atomic<size_t> packets = 0;
+};
+
+#endif //OUTBOUND_QUEUE_H
@@ -6,12 +6,14 @@
 #define DISCONNECT 0x00
 #define SPAWN_ENTITY 0x01
 #define PONG_RESPONSE 0x01
+#define ENCRYPTION_REQUEST 0x01
 #define CLIENTBOUND_PLUGIN_MESSAGE_CONFIG 0x01
 #define LOGIN_SUCCESS 0x02
 #define ENTITY_ANIMATION 0x03
 #define FINISH_CONFIGURATION 0x03
 #define SET_COMPRESSION 0x03
 #define ACKNOWLEDGE_BLOCK_CHANGE 0x05
+#define BLOCK_UPDATE 0x09
 #define REGISTRY_DATA 0x07
 #define REMOVE_RESOURCE_PACK_CONFIG 0x08
 #define UPDATE_TAGS 0x0D
@@ -19,9 +21,11 @@
 #define SERVER_LINKS 0x10
 #define COMMANDS 0x11
 #define ENTITY_EVENT 0x1F
+#define UNLOAD_CHUNK 0x21
 #define GAME_EVENT 0x22
 #define KEEP_ALIVE_PLAY 0x26
 #define WORLD_EVENT 0x28
+#define UPDATE_LIGHT 0x2A
 #define LOGIN 0x2B //(1.21.3 => 0x2C)
 #define UPDATE_ENTITY_POSITION 0x2E
 #define UPDATE_ENTITY_POSITION_AND_ROTATION 0x2F
@@ -33,6 +37,7 @@
 #define REMOVE_ENTITIES 0x42
 #define ADD_RESOURCE_PACK_PLAY 0x46
 #define SET_HEAD_ROTATION 0x48
+#define UPDATE_SECTION_BLOCKS 0x49
 #define SET_CENTER_CHUNK 0x54
 #define SET_ENTITY_METADATA 0x58
 #define SET_EQUIPMENT 0x5B
@@ -65,7 +70,9 @@
 #define ZERO_PACKET 0x00
 #define CLIENT_INFORMATION 0x00
 #define HANDSHAKE 0x00
+#define LOGIN_START 0x00
 #define PING_REQUEST 0x01
+#define ENCRYPTION_RESPONSE 0x01
 #define LOGIN_PLUGIN_RESPONSE 0x02
 #define ACKNOWLEDGE_FINISH_CONFIGURATION 0x03
 #define LOGIN_ACKNOWLEDGE 0x03
@@ -0,0 +1,45 @@
+#include "packet_writer.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "network.h"
+
+PacketWriter::PacketWriter() {
+    buffer.reserve(256);
+    buffer.resize(HEADROOM);
+}
+
+PacketWriter::PacketWriter(int32_t packetID) : PacketWriter() {
+    writeVarInt(*this, packetID);
+}
+
+void PacketWriter::clear() {
+    buffer.resize(HEADROOM);
+    frameStart = HEADROOM;
+}
+
+void PacketWriter::prependVarInt(int32_t value) {
+    uint8_t encoded[5];
+    size_t length = 0;
+    auto remaining = static_cast<uint32_t>(value);
+    do {
+        uint8_t temp = remaining & 0x7F;
+        remaining >>= 7;
+        if (remaining != 0) {
+            temp |= 0x80;
+        }
+        encoded[length++] = temp;
+    } while (remaining != 0);
+
+    if (length > frameStart) {
+        throw std::logic_error("PacketWriter headroom exhausted");
+    }
+    frameStart -= length;
+    std::copy_n(encoded, length, buffer.data() + frameStart);
+}
+
+std::span<uint8_t> PacketWriter::finishFrame() {
+    prependVarInt(static_cast<int32_t>(buffer.size() - frameStart));
+    return frame();
+}
@@ -0,0 +1,74 @@
+#ifndef PACKET_WRITER_H
+#define PACKET_WRITER_H
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Decides which compression level a packet gets, see ServerConfig
+enum class CompressionClass {
+    Default,
+    // Chunk data: large and highly compressible, sent in bursts
+    Chunk,
+    // Entity movement: small, frequent and latency sensitive
+    Movement,
+    // Encoded once and sent many times (see CachedPacket), worth the best compression
+    Static,
+};
+
+// Buffer a clientbound packet is serialized into.
+// The body (packet ID and fields) is appended with the regular write* helpers. The first HEADROOM
+// bytes are kept free so the Packet Length and Data Length VarInts can be written directly in front
+// of the finished body, which lets sendPacket frame and encrypt a packet without copying it.
+// The bytes are only reachable through the append API, so nothing can write into the headroom.
+class PacketWriter {
+public:
+    // Packet Length + Data Length, both VarInts of at most 5 bytes
+    static constexpr size_t HEADROOM = 10;
+
+    PacketWriter();
+    explicit PacketWriter(int32_t packetID);
+
+    void push_back(uint8_t byte) { buffer.push_back(byte); }
+    void append(const uint8_t* bytes, size_t size) { buffer.insert(buffer.end(), bytes, bytes + size); }
+    template <typename Iterator>
+    void append(Iterator first, Iterator last) { buffer.insert(buffer.end(), first, last); }
+    // Appends up to maxSize bytes that write(destination) fills in, write returns how many it used
+    template <typename Write>
+    void appendWith(size_t maxSize, Write write) {
+        size_t start = buffer.size();
+        buffer.resize(start + maxSize);
+        buffer.resize(start + write(buffer.data() + start));
+    }
+    void reserveBody(size_t size) { buffer.reserve(HEADROOM + size); }
+    // Drops the body and the framing but keeps the allocation
+    void clear();
+
+    uint8_t* body() { return buffer.data() + HEADROOM; }
+    const uint8_t* body() const { return buffer.data() + HEADROOM; }
+    size_t bodySize() const { return buffer.size() - HEADROOM; }
+    std::span<const uint8_t> bodyBytes() const { return {body(), bodySize()}; }
+
+    // Writes a VarInt directly in front of the current frame
+    void prependVarInt(int32_t value);
+    // Prefixes the frame with its length, returns the bytes to put on the wire
+    std::span<uint8_t> finishFrame();
+    // The frame built so far
+    std::span<uint8_t> frame() { return {buffer.data() + frameStart, buffer.size() - frameStart}; }
+    size_t frameOffset() const { return frameStart; }
+    // Hands the whole buffer over (the frame starts at frameOffset()), the writer is left empty
+    std::vector<uint8_t> takeBuffer() {
+        std::vector<uint8_t> taken = std::move(buffer);
+        buffer.assign(HEADROOM, 0);
+        frameStart = HEADROOM;
+        return taken;
+    }
+
+    CompressionClass compressionClass = CompressionClass::Default;
+
+private:
+    std::vector<uint8_t> buffer;
+    size_t frameStart = HEADROOM;
+};
+
+#endif //PACKET_WRITER_H
@@ -0,0 +1,160 @@
+#include "receive_buffer.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#ifndef _WIN32
+#include <sys/uio.h>
+#endif
+
+#include "event_loop.h"
+#include "core/utils.h"
+
+// A full frame (3 byte prefix + max payload) plus room for the next read always fits
+constexpr size_t MAX_RECEIVE_BUFFER_SIZE = std::bit_ceil(MAX_PACKET_SIZE + 3) * 2;
+// Don't issue reads smaller than this, grow the buffer instead
+constexpr size_t MIN_READ_SIZE = 4096;
+
+ReceiveBuffer::ReceiveBuffer(size_t initialCapacity)
+    : storage(std::bit_ceil(std::max<size_t>(initialCapacity, MIN_READ_SIZE))), mask(storage.size() - 1) {
+}
+
+void ReceiveBuffer::reserve(size_t minFree) {
+    if (capacity() - size() >= minFree) {
+        return;
+    }
+    size_t newCapacity = std::bit_ceil(size() + minFree);
+    if (newCapacity > MAX_RECEIVE_BUFFER_SIZE) {
+        newCapacity = MAX_RECEIVE_BUFFER_SIZE;
+    }
+    if (newCapacity <= capacity()) {
+        return;
+    }
+
+    // Linearise the live bytes into the new storage
+    std::vector<uint8_t> newStorage(newCapacity);
+    copyOut(head, newStorage.data(), size());
+    processed -= head;
+    tail -= head;
+    head = 0;
+    storage = std::move(newStorage);
+    mask = storage.size() - 1;
+}
+
+ssize_t ReceiveBuffer::fill(SocketType socket) {
+    reserve(MIN_READ_SIZE);
+    size_t freeSpace = capacity() - size();
+    if (freeSpace == 0) {
+        // Buffer is at its limit and still holds no complete frame
+        errno = ENOBUFS;
+        return -1;
+    }
+
+    size_t start = tail & mask;
+    size_t firstLength = std::min(freeSpace, capacity() - start);
+#ifdef _WIN32
+    int received = recv(socket, reinterpret_cast<char*>(storage.data() + start), static_cast<int>(firstLength), 0);
+#else
+    // The free space may wrap around the end of the storage, read both parts with one syscall
+    iovec parts[2];
+    parts[0].iov_base = storage.data() + start;
+    parts[0].iov_len = firstLength;
+    parts[1].iov_base = storage.data();
+    parts[1].iov_len = freeSpace - firstLength;
+    ssize_t received = readv(socket, parts, parts[1].iov_len > 0 ? 2 : 1);
+#endif
+    if (received > 0) {
+        tail += received;
+    }
+    return received;
+}
+
+bool ReceiveBuffer::cryptRange(EVP_CIPHER_CTX* ctx, size_t from, size_t to) {
+    while (from < to) {
+        size_t start = from & mask;
+        size_t length = std::min(to - from, capacity() - start);
+        int outLen = 0;
+        // CFB8 is a stream mode, decrypting in place is fine
+        if (EVP_DecryptUpdate(ctx, storage.data() + start, &outLen, storage.data() + start, static_cast<int>(length)) != 1) {
+            logMessage("Failed to decrypt received data", LOG_ERROR);
+            ERR_print_errors_fp(stderr);
+            return false;
+        }
+        from += length;
+    }
+    return true;
+}
+
+bool ReceiveBuffer::decryptNew(EVP_CIPHER_CTX* ctx) {
+    if (ctx && !cryptRange(ctx, processed, tail)) {
+        return false;
+    }
+    processed = tail;
+    return true;
+}
+
+bool ReceiveBuffer::decryptUnread(EVP_CIPHER_CTX* ctx) {
+    processed = head;
+    return decryptNew(ctx);
+}
+
+bool ReceiveBuffer::peekLength(int32_t& length, size_t& prefixSize, bool& error) const {
+    length = 0;
+    prefixSize = 0;
+    // Serverbound packets are at most 2097151 bytes, so the prefix is at most 3 bytes
+    while (prefixSize < 3 && head + prefixSize < processed) {
+        uint8_t read = storage[(head + prefixSize) & mask];
+        length |= (read & 0x7F) << (7 * prefixSize);
+        prefixSize++;
+        if ((read & 0x80) == 0) {
+            return true;
+        }
+    }
+    if (prefixSize == 3) {
+        logMessage("VarInt length prefix is too big", LOG_ERROR);
+        error = true;
+    }
+    return false;
+}
+
+bool ReceiveBuffer::hasFrame() const {
+    int32_t length;
+    size_t prefixSize;
+    bool error = false;
+    if (!peekLength(length, prefixSize, error)) {
+        return error;
+    }
+    return processed - head - prefixSize >= static_cast<size_t>(length);
+}
+
+void ReceiveBuffer::copyOut(size_t position, uint8_t* destination, size_t length) const {
+    size_t start = position & mask;
+    size_t firstLength = std::min(length, capacity() - start);
+    std::memcpy(destination, storage.data() + start, firstLength);
+    std::memcpy(destination + firstLength, storage.data(), length - firstLength);
+}
+
+bool ReceiveBuffer::nextFrame(std::vector<uint8_t>& payload, bool& error) {
+    error = false;
+    int32_t length;
+    size_t prefixSize;
+    if (!peekLength(length, prefixSize, error)) {
+        return false;
+    }
+    if (processed - head - prefixSize < static_cast<size_t>(length)) {
+        // Wait for the rest of the packet
+        return false;
+    }
+
+    payload.resize(length);
+    copyOut(head + prefixSize, payload.data(), length);
+    head += prefixSize + length;
+
+    if (head == tail) {
+        // Empty, restart at the beginning of the storage to keep reads contiguous
+        head = processed = tail = 0;
+    }
+    return true;
+}
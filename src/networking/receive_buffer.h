@@ -0,0 +1,47 @@
+#ifndef RECEIVE_BUFFER_H
+#define RECEIVE_BUFFER_H
+
+#include <cstdint>
+#include <vector>
+#include <openssl/types.h>
+
+#include "network.h"
+
+// Per-connection receive ring buffer.
+// Bytes are pulled from the socket with as few large reads as possible, decrypted in bulk as they
+// arrive and framed in user space, so many small packets cost a single syscall.
+class ReceiveBuffer {
+public:
+    explicit ReceiveBuffer(size_t initialCapacity = 16384);
+
+    // Reads whatever the socket has (up to the free space). Returns the recv() result.
+    ssize_t fill(SocketType socket);
+    // Decrypts the bytes received since the last call in place (marks them ready when ctx is null)
+    bool decryptNew(EVP_CIPHER_CTX* ctx);
+    // Decrypts every byte that hasn't been framed yet, used when encryption starts mid-stream
+    bool decryptUnread(EVP_CIPHER_CTX* ctx);
+    // Extracts the next length-prefixed frame. Returns false if it isn't complete yet;
+    // error is set when the stream is malformed.
+    bool nextFrame(std::vector<uint8_t>& payload, bool& error);
+
+    size_t size() const { return tail - head; }
+    size_t capacity() const { return storage.size(); }
+    bool hasFrame() const;
+
+private:
+    // Makes room for at least minFree more bytes
+    void reserve(size_t minFree);
+    // Returns the frame length and prefix size at head if the prefix is complete
+    bool peekLength(int32_t& length, size_t& prefixSize, bool& error) const;
+    void copyOut(size_t position, uint8_t* destination, size_t length) const;
+    bool cryptRange(EVP_CIPHER_CTX* ctx, size_t from, size_t to);
+
+    std::vector<uint8_t> storage;
+    size_t mask;
+    // Monotonic positions, wrapped with mask when indexing storage
+    size_t head = 0;      // next byte to frame
+    size_t processed = 0; // bytes before this position are decrypted
+    size_t tail = 0;      // next byte to write
+};
+
+#endif //RECEIVE_BUFFER_H
@@ -0,0 +1,931 @@
+#include "benchmark.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include <openssl/evp.h>
+
+#include "zlib.h"
+#include "io/stream_reader.h"
+#include "core/config.h"
+#include "core/utils.h"
+#include "networking/client.h"
+#include "networking/fetch.h"
+#include "networking/network.h"
+#include "networking/packet_ids.h"
+#include "utils/thread_pool.h"
+#include "world/chunk.h"
+#include "world/light_engine.h"
+#define CPPHTTPLIB_OPENSSL_SUPPORT
+#include "../thirdparty/httplib.h"
+
+namespace {
+    // Runs fn repeatedly for at least minDuration and returns the average time per call in microseconds
+    double measure(const std::function<void()>& fn, std::chrono::milliseconds minDuration = std::chrono::milliseconds(300)) {
+        using namespace std::chrono;
+        // Warm up caches and lazily initialized state
+        fn();
+
+        size_t iterations = 0;
+        auto start = steady_clock::now();
+        auto elapsed = steady_clock::duration::zero();
+        while (elapsed < minDuration) {
+            fn();
+            ++iterations;
+            elapsed = steady_clock::now() - start;
+        }
+        return duration<double, std::micro>(elapsed).count() / static_cast<double>(iterations);
+    }
+
+    std::string formatNumber(double value, int precision = 1) {
+        char buffer[64];
+        std::snprintf(buffer, sizeof(buffer), "%.*f", precision, value);
+        return buffer;
+    }
+
+    // Somewhat compressible bytes, similar to serialized NBT/chunk data
+    std::vector<uint8_t> sampleBytes(size_t size, uint32_t seed) {
+        std::mt19937 rng(seed);
+        std::uniform_int_distribution<int> distribution(0, 15);
+        std::vector<uint8_t> bytes(size);
+        for (auto& byte : bytes) {
+            byte = static_cast<uint8_t>(distribution(rng));
+        }
+        return bytes;
+    }
+
+    // Connections in the state of a joined player: compression and encryption enabled, no socket
+    std::vector<std::unique_ptr<ClientConnection>> makeRecipients(size_t count) {
+        std::vector<std::unique_ptr<ClientConnection>> recipients;
+        for (size_t i = 0; i < count; ++i) {
+            auto client = std::make_unique<ClientConnection>();
+            client->compressionEnabled = true;
+            std::vector<uint8_t> secret = sampleBytes(client->sharedSecret.size(), static_cast<uint32_t>(i));
+            std::ranges::copy(secret, client->sharedSecret.begin());
+            client->encryptCtx = EVP_CIPHER_CTX_new();
+            EVP_EncryptInit_ex(client->encryptCtx, EVP_aes_128_cfb8(), nullptr, client->sharedSecret.data(), client->sharedSecret.data());
+            recipients.push_back(std::move(client));
+        }
+        return recipients;
+    }
+
+    // Broadcast cost against the number of recipients, encoding per recipient (the former
+    // broadcastToOthers) versus encoding once and only encrypting per recipient.
+    // Queueing is left out, it is the same for both.
+    void benchmarkBroadcast() {
+        serverConfig.enableCompression = true;
+        serverConfig.enableEncryption = true;
+
+        struct Sample {
+            std::string name;
+            size_t size;
+        };
+        const std::vector<Sample> samples = {
+            {"entity velocity (8 B)", 8},
+            {"chat message (512 B)", 512},
+            {"chunk-sized (16 KiB)", 16 * 1024},
+        };
+        const std::vector<size_t> recipientCounts = {1, 10, 50, 200, 1000};
+
+        logMessage("broadcast (compression threshold " + std::to_string(serverConfig.compressionThreshold) + " B)", LOG_INFO);
+        for (const auto& sample : samples) {
+            PacketWriter packet(0x5A);
+            std::vector<uint8_t> payload = sampleBytes(sample.size, 42);
+            packet.append(payload.begin(), payload.end());
+
+            for (size_t recipientCount : recipientCounts) {
+                auto recipients = makeRecipients(recipientCount);
+                std::vector<uint8_t> output;
+
+                double perRecipient = measure([&] {
+                    for (const auto& client : recipients) {
+                        PacketWriter copy = packet;
+                        PacketWriter compressedPacket;
+                        PacketWriter* framed = encodeFrame(copy, client->compressionEnabled, compressedPacket);
+                        std::span<uint8_t> frame = framed->frame();
+                        encryptFrame(*client, frame.data(), frame.data(), frame.size());
+                    }
+                });
+
+                double encodeOnce = measure([&] {
+                    EncodedPacket encoded(packet);
+                    for (const auto& client : recipients) {
+                        std::span<const uint8_t> frame = encoded.frame(client->compressionEnabled);
+                        output.resize(frame.size());
+                        encryptFrame(*client, frame.data(), output.data(), frame.size());
+                    }
+                });
+
+                logMessage("  " + sample.name + ", " + std::to_string(recipientCount) + " recipients: per-recipient "
+                           + formatNumber(perRecipient) + " us, encode-once " + formatNumber(encodeOnce) + " us ("
+                           + formatNumber(perRecipient / encodeOnce, 2) + "x)", LOG_INFO);
+            }
+        }
+    }
+
+    // compressData/decompressData as they were before the zlib streams were pooled: a fresh stream per
+    // packet and an output grown in 32 KiB steps. Kept as the baseline for the compression suite.
+    void compressUnpooled(const uint8_t* data, size_t size, std::vector<uint8_t>& out) {
+        z_stream zs = {};
+        deflateInit(&zs, Z_DEFAULT_COMPRESSION);
+        zs.next_in = const_cast<Bytef*>(data);
+        zs.avail_in = size;
+        out.resize(deflateBound(&zs, size));
+        int ret;
+        do {
+            if (zs.total_out == out.size()) {
+                out.resize(out.size() + 32768);
+            }
+            zs.next_out = out.data() + zs.total_out;
+            zs.avail_out = out.size() - zs.total_out;
+            ret = deflate(&zs, Z_FINISH);
+        } while (ret == Z_OK);
+        out.resize(zs.total_out);
+        deflateEnd(&zs);
+    }
+
+    void decompressUnpooled(const std::vector<uint8_t>& data, std::vector<uint8_t>& out) {
+        z_stream zs = {};
+        inflateInit(&zs);
+        zs.next_in = const_cast<Bytef*>(data.data());
+        zs.avail_in = data.size();
+        out.clear();
+        int ret;
+        do {
+            uint8_t buffer[32768];
+            zs.next_out = buffer;
+            zs.avail_out = sizeof(buffer);
+            ret = inflate(&zs, 0);
+            out.insert(out.end(), buffer, buffer + sizeof(buffer) - zs.avail_out);
+        } while (ret == Z_OK);
+        inflateEnd(&zs);
+    }
+
+    void reportRate(const std::string& name, double microsecondsPerPacket, size_t inputBytes, size_t outputBytes) {
+        logMessage("  " + name + ": " + formatNumber(1e6 / microsecondsPerPacket, 0) + " packets/s, "
+                   + formatNumber(microsecondsPerPacket, 2) + " us/packet, ratio "
+                   + formatNumber(static_cast<double>(outputBytes) / static_cast<double>(inputBytes), 3), LOG_INFO);
+    }
+
+    // Packets per second through compressData/decompressData on the chunk data packets the server
+    // actually sends (from world/region when present, generated otherwise) and on small packets
+    void benchmarkCompression() {
+        std::vector<PacketWriter> chunkPackets;
+        for (int32_t chunkX = -3; chunkX <= 3; ++chunkX) {
+            for (int32_t chunkZ = -3; chunkZ <= 3; ++chunkZ) {
+                std::shared_ptr<Chunk> chunk = getOrLoadChunk(chunkX, chunkZ);
+                if (!chunk) {
+                    int highestY;
+                    chunk = generateFlatChunk(flatWorldPresets["overworld"], chunkX, chunkZ, highestY);
+                }
+                chunkPackets.push_back(buildChunkDataPacket(chunk));
+            }
+        }
+
+        std::vector<PacketWriter> smallPackets;
+        for (uint32_t seed = 0; seed < 64; ++seed) {
+            PacketWriter packet(SET_ENTITY_METADATA);
+            std::vector<uint8_t> payload = sampleBytes(static_cast<size_t>(serverConfig.compressionThreshold) + 64, seed);
+            packet.append(payload.begin(), payload.end());
+            smallPackets.push_back(std::move(packet));
+        }
+
+        struct Workload {
+            std::string name;
+            const std::vector<PacketWriter>& packets;
+            int level;
+        };
+        const std::vector<Workload> workloads = {
+            {"chunk data", chunkPackets, serverConfig.chunkCompressionLevel},
+            {"small packets", smallPackets, serverConfig.movementCompressionLevel},
+        };
+
+        std::vector<uint8_t> out;
+        for (const auto& workload : workloads) {
+            size_t inputBytes = 0;
+            for (const auto& packet : workload.packets) {
+                inputBytes += packet.bodySize();
+            }
+            auto perPacket = [&](double total) { return total / static_cast<double>(workload.packets.size()); };
+            size_t outputBytes = 0;
+            auto compressAll = [&](const std::function<void(const PacketWriter&)>& compress) {
+                return perPacket(measure([&] {
+                    outputBytes = 0;
+                    for (const auto& packet : workload.packets) {
+                        compress(packet);
+                        outputBytes += out.size();
+                    }
+                }));
+            };
+
+            logMessage("compression, " + workload.name + " (" + std::to_string(workload.packets.size()) + " packets, "
+                       + std::to_string(inputBytes / workload.packets.size()) + " B average)", LOG_INFO);
+
+            double before = compressAll([&](const PacketWriter& packet) {
+                compressUnpooled(packet.body(), packet.bodySize(), out);
+            });
+            reportRate("deflate, new stream per packet, default level", before, inputBytes, outputBytes);
+
+            double pooled = compressAll([&](const PacketWriter& packet) {
+                out.clear();
+                compressData(packet.body(), packet.bodySize(), out, Z_DEFAULT_COMPRESSION);
+            });
+            reportRate("deflate, pooled stream, default level", pooled, inputBytes, outputBytes);
+
+            double classLevel = compressAll([&](const PacketWriter& packet) {
+                out.clear();
+                compressData(packet.body(), packet.bodySize(), out, workload.level);
+            });
+            reportRate("deflate, pooled stream, level " + std::to_string(workload.level), classLevel, inputBytes, outputBytes);
+
+            std::vector<std::vector<uint8_t>> compressed;
+            for (const auto& packet : workload.packets) {
+                compressed.emplace_back();
+                compressData(packet.body(), packet.bodySize(), compressed.back(), workload.level);
+            }
+            double inflateBefore = perPacket(measure([&] {
+                for (const auto& data : compressed) {
+                    decompressUnpooled(data, out);
+                }
+            }));
+            reportRate("inflate, new stream per packet", inflateBefore, inputBytes, inputBytes);
+
+            double inflateAfter = perPacket(measure([&] {
+                for (size_t i = 0; i < compressed.size(); ++i) {
+                    decompressData(compressed[i].data(), compressed[i].size(), workload.packets[i].bodySize(), out);
+                }
+            }));
+            reportRate("inflate, pooled stream, sized output", inflateAfter, inputBytes, inputBytes);
+        }
+    }
+
+    // Round trip the local session server stand-in adds to every request, roughly a request to Mojang
+    constexpr auto SESSION_SERVER_DELAY = std::chrono::milliseconds(20);
+
+    nlohmann::json sessionProfile(const std::string& name) {
+        // A stable fake UUID per name
+        char uuid[33];
+        std::snprintf(uuid, sizeof(uuid), "%032zx", std::hash<std::string>{}(name));
+        return {
+            {"id", uuid},
+            {"name", name},
+            {"properties", {{{"name", "textures"}, {"value", "e30="}, {"signature", "c2lnbmF0dXJl"}}}},
+        };
+    }
+
+    struct LoginStats {
+        double loginsPerSecond;
+        double p50;
+        double p99;
+        size_t failures;
+    };
+
+    // Submits every login at once, like a reconnect storm after a restart, and measures each login
+    // from submission to completion (queueing included)
+    LoginStats runLoginStorm(size_t logins, size_t concurrency, const std::function<bool(const std::string&)>& login) {
+        using namespace std::chrono;
+        std::vector<double> latencies(logins);
+        std::atomic<size_t> failures = 0;
+        auto start = steady_clock::now();
+        {
+            thread_pool pool(concurrency);
+            std::vector<std::future<void>> done;
+            for (size_t i = 0; i < logins; ++i) {
+                done.push_back(pool.enqueue([&, i] {
+                    if (!login("Player" + std::to_string(i))) {
+                        ++failures;
+                    }
+                    latencies[i] = duration<double, std::milli>(steady_clock::now() - start).count();
+                }));
+            }
+            for (auto& future : done) {
+                future.get();
+            }
+        }
+        double total = duration<double>(steady_clock::now() - start).count();
+        std::ranges::sort(latencies);
+        return {
+            static_cast<double>(logins) / total,
+            latencies[logins / 2],
+            latencies[std::min(logins - 1, logins * 99 / 100)],
+            failures.load(),
+        };
+    }
+
+    void reportLogins(const std::string& name, const LoginStats& stats) {
+        logMessage("  " + name + ": " + formatNumber(stats.loginsPerSecond) + " logins/s, p50 " + formatNumber(stats.p50)
+                   + " ms, p99 " + formatNumber(stats.p99) + " ms" + (stats.failures ? ", " + std::to_string(stats.failures) + " failed" : ""), LOG_INFO);
+    }
+
+    // Login throughput and latency of the session server stage under a reconnect storm, against a
+    // local stand-in for sessionserver.mojang.com (see session_server_url)
+    void benchmarkAuthentication() {
+        httplib::Server server;
+        server.new_task_queue = [] { return new httplib::ThreadPool(64); };
+        server.Get("/session/minecraft/hasJoined", [](const httplib::Request& req, httplib::Response& res) {
+            std::this_thread::sleep_for(SESSION_SERVER_DELAY);
+            res.set_content(sessionProfile(req.get_param_value("username")).dump(), "application/json");
+        });
+        server.Get(R"(/session/minecraft/profile/(\w+))", [](const httplib::Request& req, httplib::Response& res) {
+            std::this_thread::sleep_for(SESSION_SERVER_DELAY);
+            nlohmann::json profile = sessionProfile(req.matches[1]);
+            profile["id"] = req.matches[1];
+            res.set_content(profile.dump(), "application/json");
+        });
+        int port = server.bind_to_any_port("127.0.0.1");
+        std::thread serverThread([&server] { server.listen_after_bind(); });
+        server.wait_until_ready();
+        serverConfig.sessionServerURL = "http://127.0.0.1:" + std::to_string(port);
+
+        const size_t logins = 400;
+        auto authenticate = [](const std::string& name) {
+            std::string uuid;
+            std::string authenticatedName;
+            std::pair<std::string, std::string> textures;
+            return authenticatePlayer(name, "-2c3a8b1f", "127.0.0.1", uuid, authenticatedName, textures);
+        };
+        // The former authenticatePlayer: a new connection for every request
+        auto authenticateUnpooled = [](const std::string& name) {
+            httplib::Client client(serverConfig.sessionServerURL);
+            auto res = client.Get("/session/minecraft/hasJoined?username=" + name + "&serverId=-2c3a8b1f");
+            return res && res->status == 200;
+        };
+
+        logMessage("authentication, " + std::to_string(logins) + " logins at once, session server round trip "
+                   + std::to_string(SESSION_SERVER_DELAY.count()) + " ms", LOG_INFO);
+        for (size_t concurrency : {size_t{1}, static_cast<size_t>(serverConfig.maxConcurrentAuthRequests), size_t{32}}) {
+            reportLogins("new connection per request, " + std::to_string(concurrency) + " concurrent",
+                         runLoginStorm(logins, concurrency, authenticateUnpooled));
+            reportLogins("keep-alive connection, " + std::to_string(concurrency) + " concurrent",
+                         runLoginStorm(logins, concurrency, authenticate));
+        }
+
+        // Offline mode logins only fetch the skin, which the profile cache answers on reconnect
+        auto fetchSkin = [](const std::string& name) {
+            return !fetchPlayerSkin(sessionProfile(name)["id"]).first.empty();
+        };
+        size_t concurrency = serverConfig.maxConcurrentAuthRequests;
+        clearProfileCache();
+        reportLogins("skin lookup, cold profile cache", runLoginStorm(logins, concurrency, fetchSkin));
+        reportLogins("skin lookup, warm profile cache", runLoginStorm(logins, concurrency, fetchSkin));
+
+        server.stop();
+        serverThread.join();
+    }
+
+    // Block access and section serialization on a chunk whose sections hold a mix of block states.
+    // Indices are visited in a shuffled order so the numbers aren't those of a purely sequential scan.
+    void benchmarkSections() {
+        constexpr int STATES_PER_SECTION = 12;
+        Chunk chunk(0, 0);
+        std::mt19937 rng(7);
+        std::uniform_int_distribution<int> stateDistribution(1, STATES_PER_SECTION);
+        for (int y = 0; y < CHUNK_HEIGHT; ++y) {
+            for (int z = 0; z < CHUNK_LENGTH; ++z) {
+                for (int x = 0; x < CHUNK_WIDTH; ++x) {
+                    chunk.setBlock(x, y, z, stateDistribution(rng), true);
+                }
+            }
+        }
+        for (auto& section : chunk.sections) {
+            section->blockCount = SECTION_VOLUME;
+            section->biomePalette.getIndex(0);
+        }
+
+        struct Position {
+            int32_t x, y, z;
+        };
+        std::vector<Position> positions;
+        positions.reserve(SECTION_VOLUME);
+        for (int i = 0; i < SECTION_VOLUME; ++i) {
+            positions.push_back({i & 15, (i >> 8) & 15, (i >> 4) & 15});
+        }
+        std::ranges::shuffle(positions, rng);
+
+        logMessage("sections (" + std::to_string(STATES_PER_SECTION) + " block states per section, "
+                   + std::to_string(chunk.sections[0]->bitsPerEntry) + " bits per entry)", LOG_INFO);
+
+        int64_t checksum = 0;
+        double getBlock = measure([&] {
+            for (const auto& position : positions) {
+                checksum += chunk.getBlock(position.x, position.y + MIN_Y, position.z).blockStateID;
+            }
+        }) / SECTION_VOLUME;
+        logMessage("  getBlock: " + formatNumber(getBlock * 1000.0, 2) + " ns", LOG_INFO);
+
+        double setBlock = measure([&] {
+            int32_t state = 1;
+            for (const auto& position : positions) {
+                chunk.setBlock(position.x, position.y, position.z, state, true);
+                state = state % STATES_PER_SECTION + 1;
+            }
+        }) / SECTION_VOLUME;
+        logMessage("  setBlock: " + formatNumber(setBlock * 1000.0, 2) + " ns", LOG_INFO);
+
+        // A heavily edited section: more states than an indirect palette holds, some later replaced again
+        constexpr int EDITED_STATES = 1024;
+        double setBlockEdited = measure([&] {
+            int32_t state = 1;
+            for (const auto& position : positions) {
+                chunk.setBlock(position.x, position.y + CHUNK_HEIGHT / 2, position.z, state, true);
+                state = state % EDITED_STATES + 1;
+            }
+        }) / SECTION_VOLUME;
+        const auto& edited = chunk.sections[NUM_SECTIONS / 2];
+        logMessage("  setBlock, " + std::to_string(EDITED_STATES) + " states: " + formatNumber(setBlockEdited * 1000.0, 2) + " ns ("
+                   + (edited->palette.direct ? "direct" : std::to_string(edited->palette.size()) + " palette entries") + ", "
+                   + std::to_string(edited->bitsPerEntry) + " bits per entry)", LOG_INFO);
+
+        size_t serializedSize = 0;
+        double serialize = measure([&] {
+            serializedSize = serializeChunkSections(chunk.sections).size();
+        }) / NUM_SECTIONS;
+        logMessage("  serialize: " + formatNumber(serialize, 2) + " us/section, "
+                   + std::to_string(serializedSize / NUM_SECTIONS) + " B/section", LOG_INFO);
+
+        if (checksum == 0) {
+            logMessage("  unexpected all-air chunk", LOG_WARNING);
+        }
+    }
+
+    // Cost of handing a chunk to a viewer with the Chunk Data packet rebuilt for every send (a block
+    // changed in between) versus served from the chunk's packet cache
+    void benchmarkChunkCache() {
+        serverConfig.enableCompression = true;
+        std::vector<std::shared_ptr<Chunk>> chunks;
+        for (int32_t chunkX = -2; chunkX <= 2; ++chunkX) {
+            for (int32_t chunkZ = -2; chunkZ <= 2; ++chunkZ) {
+                int highestY;
+                chunks.push_back(generateFlatChunk(flatWorldPresets["overworld"], chunkX, chunkZ, highestY));
+            }
+        }
+
+        logMessage("chunk packet cache (" + std::to_string(chunks.size()) + " flat chunks)", LOG_INFO);
+        size_t frameBytes = 0;
+        double rebuilt = measure([&] {
+            for (const auto& chunk : chunks) {
+                chunk->version.fetch_add(1);
+                frameBytes = getChunkDataPacket(chunk)->frame(true).size();
+            }
+        }) / static_cast<double>(chunks.size());
+        double cached = measure([&] {
+            for (const auto& chunk : chunks) {
+                frameBytes = getChunkDataPacket(chunk)->frame(true).size();
+            }
+        }) / static_cast<double>(chunks.size());
+        logMessage("  rebuilt: " + formatNumber(rebuilt, 1) + " us/chunk, cached: " + formatNumber(cached, 3)
+                   + " us/chunk (" + formatNumber(rebuilt / cached, 0) + "x), " + std::to_string(frameBytes) + " B/frame", LOG_INFO);
+    }
+
+    // Block lookups from several threads, the way item physics resolves chunks, while a loader thread keeps
+    // inserting chunks: the old single mutex map against the sharded one
+    void benchmarkChunkMap() {
+        constexpr int RADIUS = 32;
+        constexpr size_t LOOKUPS_PER_THREAD = 200000;
+        size_t readers = std::max(2u, std::thread::hardware_concurrency()) - 1;
+
+        struct XorHash {
+            size_t operator()(const ChunkCoordinates& coords) const noexcept {
+                return (std::hash<int32_t>()(coords.chunkX) ^ (std::hash<int32_t>()(coords.chunkZ) << 1)) >> 1;
+            }
+        };
+        std::unordered_map<ChunkCoordinates, std::shared_ptr<Chunk>, XorHash> lockedMap;
+        std::mutex lockedMapMutex;
+        ChunkMap shardedMap;
+        for (int32_t chunkX = -RADIUS; chunkX < RADIUS; ++chunkX) {
+            for (int32_t chunkZ = -RADIUS; chunkZ < RADIUS; ++chunkZ) {
+                auto chunk = std::make_shared<Chunk>(chunkX, chunkZ);
+                lockedMap.try_emplace(ChunkCoordinates{chunkX, chunkZ}, chunk);
+                shardedMap.insert(chunk);
+            }
+        }
+
+        logMessage("chunk map (" + std::to_string(readers) + " reader threads, 1 inserting thread, "
+                   + std::to_string(lockedMap.size()) + " chunks)", LOG_INFO);
+        auto run = [&](const std::function<bool(int32_t, int32_t)>& lookup, const std::function<void(int32_t)>& insert) {
+            using namespace std::chrono;
+            std::atomic<bool> done = false;
+            std::thread loader([&] {
+                for (int32_t i = 0; !done; ++i) {
+                    insert(RADIUS + i % 4096);
+                }
+            });
+            auto start = steady_clock::now();
+            std::vector<std::thread> threads;
+            std::atomic<size_t> found = 0;
+            for (size_t t = 0; t < readers; ++t) {
+                threads.emplace_back([&, t] {
+                    std::mt19937 random(static_cast<uint32_t>(t));
+                    std::uniform_int_distribution<int32_t> coordinate(-RADIUS, RADIUS - 1);
+                    size_t hits = 0;
+                    for (size_t i = 0; i < LOOKUPS_PER_THREAD; ++i) {
+                        hits += lookup(coordinate(random), coordinate(random));
+                    }
+                    found += hits;
+                });
+            }
+            for (auto& thread : threads) {
+                thread.join();
+            }
+            double seconds = duration<double>(steady_clock::now() - start).count();
+            done = true;
+            loader.join();
+            if (found != readers * LOOKUPS_PER_THREAD) {
+                logMessage("  lookups missed loaded chunks", LOG_WARNING);
+            }
+            return static_cast<double>(readers * LOOKUPS_PER_THREAD) / seconds / 1e6;
+        };
+
+        double locked = run([&](int32_t x, int32_t z) {
+            std::lock_guard lock(lockedMapMutex);
+            return lockedMap.contains(ChunkCoordinates{x, z});
+        }, [&](int32_t i) {
+            auto chunk = std::make_shared<Chunk>(i, i);
+            std::lock_guard lock(lockedMapMutex);
+            lockedMap.try_emplace(ChunkCoordinates{i, i}, chunk);
+        });
+        double sharded = run([&](int32_t x, int32_t z) {
+            return shardedMap.find(x, z) != nullptr;
+        }, [&](int32_t i) {
+            shardedMap.insert(std::make_shared<Chunk>(i, i));
+        });
+        logMessage("  single mutex: " + formatNumber(locked, 2) + " M lookups/s, sharded: " + formatNumber(sharded, 2)
+                   + " M lookups/s (" + formatNumber(sharded / locked, 1) + "x)", LOG_INFO);
+    }
+
+    // Save pipeline: NBT conversion, compression at a few zlib levels and region writes with one sync per region
+    // file, into a scratch directory. Every pass rewrites the same chunks, so later passes reuse the freed sectors.
+    void benchmarkSave() {
+        constexpr int32_t CHUNKS_PER_SIDE = 16;
+        std::filesystem::path directory = std::filesystem::temp_directory_path() / "mcppserver-benchmark-regions";
+        std::filesystem::remove_all(directory);
+        RegionFileCache cache(directory);
+
+        std::mt19937 rng(11);
+        std::uniform_int_distribution<int> stateDistribution(1, 12);
+        std::vector<std::shared_ptr<Chunk>> chunks;
+        for (int32_t chunkX = 0; chunkX < CHUNKS_PER_SIDE; ++chunkX) {
+            for (int32_t chunkZ = 0; chunkZ < CHUNKS_PER_SIDE; ++chunkZ) {
+                int highestY;
+                auto chunk = generateFlatChunk(flatWorldPresets["overworld"], chunkX, chunkZ, highestY);
+                // Some player-built noise on top of the flat layers
+                for (int i = 0; i < 2048; ++i) {
+                    chunk->setBlock(i & 15, (i >> 8) + 4, (i >> 4) & 15, stateDistribution(rng), true);
+                }
+                chunks.push_back(std::move(chunk));
+            }
+        }
+
+        logMessage("save (" + std::to_string(chunks.size()) + " chunks, one region file)", LOG_INFO);
+        for (int level : {1, 6, 9}) {
+            serverConfig.regionCompressionLevel = level;
+            for (const auto& chunk : chunks) {
+                chunk->markDirty();
+            }
+            ChunkSaveStats stats = saveChunks(chunks, cache);
+            uint64_t regionBytes = 0;
+            for (const auto& entry : std::filesystem::directory_iterator(directory)) {
+                regionBytes += entry.file_size();
+            }
+            logMessage("  zlib level " + std::to_string(level) + ": " + formatNumber(stats.saved * 1000.0 / stats.milliseconds, 0)
+                       + " chunks/s, region files " + formatNumber(regionBytes / 1024.0, 0) + " KiB"
+                       + (stats.failed ? ", " + std::to_string(stats.failed) + " failed" : ""), LOG_INFO);
+        }
+
+        cache.clear();
+        std::error_code error;
+        std::filesystem::remove_all(directory, error);
+    }
+
+    // Chunk loading as it was before the streaming decoder: the whole NBT parsed into a tag tree first, then walked
+    // by name. Kept as the baseline for the chunk load suite.
+    std::shared_ptr<Chunk> loadChunkFromTagTree(int chunkX, int chunkZ, const ChunkData& chunkData) {
+        std::shared_ptr<Chunk> chunk = std::make_shared<Chunk>(chunkX, chunkZ);
+        if (!chunkData.nbt.has_key("sections")) {
+            return chunk;
+        }
+        for (const auto& sectionTag : chunkData.nbt.at("sections").as<nbt::tag_list>()) {
+            const auto& sectionCompound = sectionTag.as<nbt::tag_compound>();
+            int8_t sectionY = sectionCompound.at("Y").as<nbt::tag_byte>().get();
+            int sectionIndex = sectionY - MIN_Y / SECTION_HEIGHT;
+            if (sectionIndex < 0 || sectionIndex >= NUM_SECTIONS) {
+                continue;
+            }
+
+            MemChunkSection section;
+            section.isEmpty = true;
+            if (sectionCompound.has_key("block_states")) {
+                const auto& blockStatesCompound = sectionCompound.at("block_states").as<nbt::tag_compound>();
+                if (blockStatesCompound.has_key("palette")) {
+                    std::vector<BlockProperty> properties;
+                    for (const auto& paletteEntry : blockStatesCompound.at("palette").as<nbt::tag_list>()) {
+                        const auto& entry = paletteEntry.as<nbt::tag_compound>();
+                        properties.clear();
+                        if (entry.has_key("Properties")) {
+                            for (const auto& [key, value] : entry.at("Properties").as<nbt::tag_compound>()) {
+                                if (value.get_type() == nbt::tag_type::String) {
+                                    properties.emplace_back(key, value.as<nbt::tag_string>().get());
+                                }
+                            }
+                        }
+                        section.palette.add(blockStateIndex.resolve(entry.at("Name").as<nbt::tag_string>().get(), properties));
+                    }
+                }
+                std::vector<uint64_t> data;
+                if (blockStatesCompound.has_key("data")) {
+                    const std::vector<int64_t>& packedData = blockStatesCompound.at("data").as<nbt::tag_long_array>().get();
+                    data.assign(packedData.begin(), packedData.end());
+                }
+                finishBlockStates(section, std::move(data), sectionY);
+            }
+            if (sectionCompound.has_key("biomes")) {
+                const auto& biomesCompound = sectionCompound.at("biomes").as<nbt::tag_compound>();
+                if (biomesCompound.has_key("palette")) {
+                    for (const auto& biomeEntry : biomesCompound.at("palette").as<nbt::tag_list>()) {
+                        auto biome = biomes.find(stripNamespace(biomeEntry.as<nbt::tag_string>().get()));
+                        section.biomePalette.add(biome != biomes.end() ? biome->second.id : 0);
+                    }
+                }
+                std::vector<uint64_t> data;
+                if (biomesCompound.has_key("data")) {
+                    const std::vector<int64_t>& packedData = biomesCompound.at("data").as<nbt::tag_long_array>().get();
+                    data.assign(packedData.begin(), packedData.end());
+                }
+                finishBiomes(section, std::move(data));
+            }
+            if (sectionCompound.has_key("BlockLight")) {
+                const auto& blockLight = sectionCompound.at("BlockLight").as<nbt::tag_byte_array>().get();
+                section.lighting.blockLight.assign(blockLight.begin(), blockLight.end());
+            }
+            if (sectionCompound.has_key("SkyLight")) {
+                const auto& skyLight = sectionCompound.at("SkyLight").as<nbt::tag_byte_array>().get();
+                section.lighting.skyLight.assign(skyLight.begin(), skyLight.end());
+            }
+            chunk->sections[sectionIndex] = std::make_shared<MemChunkSection>(std::move(section));
+        }
+        chunk->heightmaps = computeHeightmaps(chunk->sections);
+        return chunk;
+    }
+
+    // Chunk loading on one core, from the region file to the finished Chunk: the tag tree path against the
+    // streaming decoder, once including the region read and inflate and once for the decoding alone
+    void benchmarkChunkLoad() {
+        constexpr int32_t CHUNKS_PER_SIDE = 16;
+        std::filesystem::path directory = std::filesystem::temp_directory_path() / "mcppserver-benchmark-load";
+        std::filesystem::remove_all(directory);
+        RegionFileCache cache(directory);
+
+        std::mt19937 rng(13);
+        std::uniform_int_distribution<int> stateDistribution(1, 400);
+        std::vector<std::shared_ptr<Chunk>> chunks;
+        for (int32_t chunkX = 0; chunkX < CHUNKS_PER_SIDE; ++chunkX) {
+            for (int32_t chunkZ = 0; chunkZ < CHUNKS_PER_SIDE; ++chunkZ) {
+                int highestY;
+                auto chunk = generateFlatChunk(flatWorldPresets["overworld"], chunkX, chunkZ, highestY);
+                // Varied blocks over a few sections so the palettes aren't trivial
+                for (int i = 0; i < 8192; ++i) {
+                    chunk->setBlock(i & 15, (i >> 8) + 4, (i >> 4) & 15, stateDistribution(rng), true);
+                }
+                chunks.push_back(std::move(chunk));
+            }
+        }
+        saveChunks(chunks, cache);
+        std::shared_ptr<RegionFile> region = cache.get(0, 0, false);
+        if (!region) {
+            logMessage("  could not open the scratch region file", LOG_ERROR);
+            return;
+        }
+
+        std::vector<std::vector<uint8_t>> inflated;
+        for (const auto& chunk : chunks) {
+            inflated.push_back(region->readChunkNBT(chunk->chunkX, chunk->chunkZ).value_or(std::vector<uint8_t>{}));
+        }
+
+        size_t next = 0;
+        auto nextIndex = [&] { return next++ % chunks.size(); };
+        std::atomic<size_t> sections = 0;
+        auto keep = [&](const std::shared_ptr<Chunk>& chunk) {
+            sections += chunk ? std::ranges::count_if(chunk->sections, [](const auto& section) { return section != nullptr; }) : 0;
+        };
+
+        double treeFull = measure([&] {
+            size_t i = nextIndex();
+            auto data = region->loadChunk(chunks[i]->chunkX, chunks[i]->chunkZ, 0, 0);
+            keep(data ? loadChunkFromTagTree(chunks[i]->chunkX, chunks[i]->chunkZ, *data) : nullptr);
+        });
+        double streamFull = measure([&] {
+            size_t i = nextIndex();
+            auto data = region->readChunkNBT(chunks[i]->chunkX, chunks[i]->chunkZ);
+            keep(data ? decodeChunk(chunks[i]->chunkX, chunks[i]->chunkZ, *data) : nullptr);
+        });
+        double treeDecode = measure([&] {
+            size_t i = nextIndex();
+            std::istringstream stream(std::string(inflated[i].begin(), inflated[i].end()), std::ios::binary);
+            ChunkData data;
+            data.nbt = std::move(*nbt::io::read_compound(stream, endian::big).second);
+            keep(loadChunkFromTagTree(chunks[i]->chunkX, chunks[i]->chunkZ, data));
+        });
+        double streamDecode = measure([&] {
+            size_t i = nextIndex();
+            keep(decodeChunk(chunks[i]->chunkX, chunks[i]->chunkZ, inflated[i]));
+        });
+
+        // Saved states have to come back unchanged, properties included
+        size_t mismatches = 0;
+        auto reloaded = decodeChunk(chunks[0]->chunkX, chunks[0]->chunkZ, inflated[0]);
+        for (int i = 0; i < 8192; ++i) {
+            int x = i & 15, y = (i >> 8) + 4, z = (i >> 4) & 15;
+            mismatches += reloaded->getBlock(x, y, z).blockStateID != chunks[0]->getBlock(x, y, z).blockStateID;
+        }
+
+        // Palette entries as vanilla writes them, resolved by name only before and with their properties now
+        std::vector<std::pair<std::string, std::vector<std::pair<std::string, std::string>>>> entries = {
+            {"minecraft:stone", {}},
+            {"minecraft:oak_stairs", {{"facing", "east"}, {"half", "top"}, {"shape", "outer_left"}, {"waterlogged", "false"}}},
+            {"minecraft:oak_log", {{"axis", "x"}}},
+            {"minecraft:smooth_stone_slab", {{"type", "top"}, {"waterlogged", "false"}}},
+            {"minecraft:redstone_wire", {{"east", "side"}, {"north", "none"}, {"power", "7"}, {"south", "up"}, {"west", "none"}}},
+        };
+        std::vector<std::vector<BlockProperty>> entryProperties;
+        for (const auto& [name, properties] : entries) {
+            entryProperties.emplace_back(properties.begin(), properties.end());
+        }
+        int64_t resolved = 0;
+        double byName = measure([&] {
+            for (const auto& [name, properties] : entries) {
+                auto it = blocks.find(stripNamespace(name));
+                resolved += it != blocks.end() ? it->second.defaultState : 0;
+            }
+        });
+        double withProperties = measure([&] {
+            for (size_t i = 0; i < entries.size(); ++i) {
+                resolved += blockStateIndex.resolve(entries[i].first, entryProperties[i]);
+            }
+        });
+
+        logMessage("chunkload (" + std::to_string(chunks.size()) + " chunks, one thread)", LOG_INFO);
+        logMessage("  read + inflate + decode: tag tree " + formatNumber(1e6 / treeFull, 0) + " chunks/s, streaming "
+                   + formatNumber(1e6 / streamFull, 0) + " chunks/s (" + formatNumber(treeFull / streamFull, 1) + "x)", LOG_INFO);
+        logMessage("  decode only: tag tree " + formatNumber(1e6 / treeDecode, 0) + " chunks/s, streaming "
+                   + formatNumber(1e6 / streamDecode, 0) + " chunks/s (" + formatNumber(treeDecode / streamDecode, 1) + "x)", LOG_INFO);
+        logMessage("  palette entries: name lookup " + formatNumber(entries.size() / byName, 1) + " M/s, index with properties "
+                   + formatNumber(entries.size() / withProperties, 1) + " M/s", LOG_INFO);
+        if (sections == 0) {
+            logMessage("  no sections were decoded", LOG_WARNING);
+        }
+        if (resolved == 0) {
+            logMessage("  palette entries resolved to air, is the block data missing?", LOG_WARNING);
+        }
+        if (mismatches > 0) {
+            logMessage("  " + std::to_string(mismatches) + " block states changed in a save and load round trip", LOG_WARNING);
+        }
+
+        region.reset();
+        cache.clear();
+        std::error_code error;
+        std::filesystem::remove_all(directory, error);
+    }
+
+    // Light engine: whole chunks lit from scratch on one thread and on all of them, and the incremental update after
+    // a light source is placed or removed in the middle of 3x3 loaded chunks
+    void benchmarkLight() {
+        constexpr int32_t CHUNKS_PER_SIDE = 8;
+        int32_t air = blockStateIndex.resolve("air");
+        int32_t stone = blockStateIndex.resolve("stone");
+        int32_t glowstone = blockStateIndex.resolve("glowstone");
+        int32_t torch = blockStateIndex.resolve("torch");
+
+        // Flat chunks with stone pillars and a few light sources, each with sections of its own
+        std::mt19937 rng(17);
+        std::uniform_int_distribution<int> position(0, 15);
+        std::vector<std::shared_ptr<Chunk>> chunks;
+        for (int32_t chunkX = 0; chunkX < CHUNKS_PER_SIDE; ++chunkX) {
+            for (int32_t chunkZ = 0; chunkZ < CHUNKS_PER_SIDE; ++chunkZ) {
+                int highestY;
+                auto chunk = generateFlatChunk(flatWorldPresets["overworld"], chunkX, chunkZ, highestY);
+                for (auto& section : chunk->sections) {
+                    section = std::make_shared<MemChunkSection>(*section);
+                }
+                chunk->sharedSections.reset();
+                for (int i = 0; i < 24; ++i) {
+                    int x = position(rng), z = position(rng), height = position(rng);
+                    for (int y = 4; y < 4 + height; ++y) {
+                        chunk->setBlock(x, y, z, stone, true);
+                    }
+                    chunk->setBlock(position(rng), 4, position(rng), i % 2 ? torch : glowstone, true);
+                }
+                chunks.push_back(std::move(chunk));
+            }
+        }
+
+        size_t next = 0;
+        double singleThread = measure([&] {
+            lightEngine.lightSections(chunks[next++ % chunks.size()]->sections);
+        });
+
+        // Every thread lights copies of its own, like the chunk loader threads do
+        unsigned threadCount = std::max(1u, std::thread::hardware_concurrency());
+        std::vector<std::vector<ChunkSections>> copies(threadCount);
+        for (auto& perThread : copies) {
+            for (const auto& chunk : chunks) {
+                ChunkSections sections;
+                for (int i = 0; i < NUM_SECTIONS; ++i) {
+                    sections[i] = std::make_shared<MemChunkSection>(*chunk->sections[i]);
+                }
+                perThread.push_back(std::move(sections));
+            }
+        }
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> threads;
+        for (auto& perThread : copies) {
+            threads.emplace_back([&perThread] {
+                for (auto& sections : perThread) {
+                    lightEngine.lightSections(sections);
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        double parallelSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        // Incremental updates in the loaded world, nobody views these chunks so no packets are sent
+        auto neighbourhood = [&](int i) { return chunks[i / 3 * CHUNKS_PER_SIDE + i % 3]; };
+        for (int i = 0; i < 9; ++i) {
+            globalChunkMap.insert(neighbourhood(i));
+        }
+        auto& center = chunks[CHUNKS_PER_SIDE + 1];
+        bool lit = false;
+        double relight = measure([&] {
+            lit = !lit;
+            {
+                std::lock_guard lock(center->mutex);
+                center->setBlock(8, 0, 8, lit ? glowstone : air, true);
+            }
+            lightEngine.blockChanged(CHUNK_WIDTH + 8, 0, CHUNK_LENGTH + 8);
+            lightEngine.flush();
+        });
+        for (int i = 0; i < 9; ++i) {
+            globalChunkMap.erase(neighbourhood(i));
+        }
+
+        logMessage("light (" + std::to_string(chunks.size()) + " chunks)", LOG_INFO);
+        logMessage("  whole chunks: " + formatNumber(1e6 / singleThread, 0) + " chunks/s on one thread, "
+                   + formatNumber(chunks.size() * threadCount / parallelSeconds, 0) + " chunks/s on "
+                   + std::to_string(threadCount) + " threads", LOG_INFO);
+        logMessage("  placing or removing a light source: " + formatNumber(relight, 1) + " us", LOG_INFO);
+    }
+
+    struct Suite {
+        const char* name;
+        void (*run)();
+    };
+
+    const Suite suites[] = {
+        {"broadcast", benchmarkBroadcast},
+        {"compression", benchmarkCompression},
+        {"auth", benchmarkAuthentication},
+        {"sections", benchmarkSections},
+        {"chunkcache", benchmarkChunkCache},
+        {"chunkmap", benchmarkChunkMap},
+        {"save", benchmarkSave},
+        {"chunkload", benchmarkChunkLoad},
+        {"light", benchmarkLight},
+    };
+}
+
+bool runBenchmark(const std::string& suite) {
+    loadConfig();
+    // Chunks are built, saved and loaded with the real block and biome IDs
+    blocks = loadBlocks("../resources/blocks.json");
+    biomes = loadBiomes("../resources/biomes.json");
+    blockStateIndex.build(blocks);
+    lightEngine.build(blocks);
+
+    bool found = false;
+    for (const auto& entry : suites) {
+        if (suite == "all" || suite == entry.name) {
+            entry.run();
+            found = true;
+        }
+    }
+    if (!found) {
+        std::string available;
+        for (const auto& entry : suites) {
+            available += std::string(" ") + entry.name;
+        }
+        logMessage("Unknown benchmark suite: " + suite + " (available: all" + available + ")", LOG_ERROR);
+    }
+    return found;
+}
@@ -0,0 +1,10 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <string>
+
+// Micro-benchmarks for the server's hot paths, run with `MCppServer --benchmark <suite>`.
+// "all" runs every suite. Returns false for an unknown suite.
+bool runBenchmark(const std::string& suite);
+
+#endif //BENCHMARK_H
@@ -0,0 +1,121 @@
+#include "block_changes.h"
+
+#include <algorithm>
+#include <string>
+
+#include "core/utils.h"
+#include "entities/player.h"
+#include "networking/clientbound_packets.h"
+#include "networking/network.h"
+#include "networking/packet_ids.h"
+
+namespace {
+    struct SectionPacket {
+        ChunkCoordinates coords;
+        PacketWriter packet;
+    };
+
+    // Section position of Update Section Blocks: x in the upper 22 bits, z in the next 22 and y in the lower 20
+    int64_t encodeSectionPosition(int32_t chunkX, int32_t sectionY, int32_t chunkZ) {
+        return static_cast<int64_t>(static_cast<uint64_t>(chunkX & 0x3FFFFF) << 42
+                                    | static_cast<uint64_t>(chunkZ & 0x3FFFFF) << 20
+                                    | static_cast<uint64_t>(sectionY & 0xFFFFF));
+    }
+}
+
+void BlockChangeQueue::blockChanged(const std::shared_ptr<Chunk>& chunk, int32_t x, int32_t y, int32_t z) {
+    if (y < MIN_Y || y >= MIN_Y + CHUNK_HEIGHT) {
+        logMessage("Block change at y " + std::to_string(y) + " is outside of the world", LOG_ERROR);
+        return;
+    }
+    int32_t localX = getLocalCoordinate(x);
+    int32_t localZ = getLocalCoordinate(z);
+    int sectionIndex = (y - MIN_Y) / SECTION_HEIGHT;
+    int localY = (y - MIN_Y) % SECTION_HEIGHT;
+
+    std::lock_guard lock(mutex);
+    PendingChunk& pendingChunk = pending[chunkKey(chunk->chunkX, chunk->chunkZ)];
+    pendingChunk.chunk = chunk;
+    pendingChunk.positions[sectionIndex].push_back(static_cast<uint16_t>(localX << 8 | localZ << 4 | localY));
+}
+
+void BlockChangeQueue::acknowledge(const std::shared_ptr<Player>& player, size_t sequence) {
+    std::lock_guard lock(mutex);
+    size_t& acknowledged = acknowledgements[player];
+    acknowledged = std::max(acknowledged, sequence);
+}
+
+void BlockChangeQueue::flush() {
+    std::unordered_map<uint64_t, PendingChunk, ChunkKeyHash> changed;
+    std::unordered_map<std::shared_ptr<Player>, size_t> acknowledged;
+    {
+        std::lock_guard lock(mutex);
+        changed.swap(pending);
+        acknowledged.swap(acknowledgements);
+    }
+    if (!changed.empty()) {
+        sendChanges(changed);
+    }
+    for (const auto& [player, sequence] : acknowledged) {
+        if (player->client) {
+            sendAcknowledgeBlockChange(*player->client, sequence);
+        }
+    }
+}
+
+void BlockChangeQueue::sendChanges(std::unordered_map<uint64_t, PendingChunk, ChunkKeyHash>& changed) {
+
+    // Build the packets from the current states, the chunk locks are released before the viewers are looked up
+    std::vector<SectionPacket> packets;
+    for (auto& [key, pendingChunk] : changed) {
+        Chunk& chunk = *pendingChunk.chunk;
+        ChunkCoordinates coords{chunk.chunkX, chunk.chunkZ};
+        std::lock_guard lock(chunk.mutex);
+        for (int sectionIndex = 0; sectionIndex < NUM_SECTIONS; ++sectionIndex) {
+            auto& positions = pendingChunk.positions[sectionIndex];
+            if (positions.empty()) {
+                continue;
+            }
+            // A block changed several times in the tick is sent once
+            std::ranges::sort(positions);
+            positions.erase(std::ranges::unique(positions).begin(), positions.end());
+
+            auto stateAt = [&](uint16_t position) {
+                int32_t y = MIN_Y + sectionIndex * SECTION_HEIGHT + (position & 0x0F);
+                return chunk.getBlock(position >> 8, y, position >> 4 & 0x0F).blockStateID;
+            };
+
+            if (positions.size() == 1) {
+                uint16_t position = positions.front();
+                PacketWriter packet(BLOCK_UPDATE);
+                writeLong(packet, static_cast<int64_t>(encodePosition(chunk.chunkX * CHUNK_WIDTH + (position >> 8),
+                                                                      MIN_Y + sectionIndex * SECTION_HEIGHT + (position & 0x0F),
+                                                                      chunk.chunkZ * CHUNK_LENGTH + (position >> 4 & 0x0F))));
+                writeVarInt(packet, stateAt(position));
+                packets.push_back({coords, std::move(packet)});
+                continue;
+            }
+
+            PacketWriter packet(UPDATE_SECTION_BLOCKS);
+            writeLong(packet, encodeSectionPosition(chunk.chunkX, MIN_Y / SECTION_HEIGHT + sectionIndex, chunk.chunkZ));
+            writeVarInt(packet, static_cast<int32_t>(positions.size()));
+            for (uint16_t position : positions) {
+                writeVarLong(packet, static_cast<uint64_t>(stateAt(position)) << 12 | position);
+            }
+            packets.push_back({coords, std::move(packet)});
+        }
+    }
+
+    // Every packet is compressed once for all of its viewers
+    std::lock_guard lock(chunkViewersMutex);
+    for (const auto& [coords, packet] : packets) {
+        auto it = chunkViewersMap.find(coords);
+        if (it == chunkViewersMap.end() || it->second.empty()) {
+            continue;
+        }
+        EncodedPacket encoded(packet);
+        for (const auto& player : it->second) {
+            sendEncodedPacket(*player->client, encoded);
+        }
+    }
+}
@@ -0,0 +1,44 @@
+#ifndef BLOCK_CHANGES_H
+#define BLOCK_CHANGES_H
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "chunk.h"
+#include "chunk_map.h"
+
+// Block changes waiting to be sent to the viewers of their chunks.
+// Changes are collected per section during the tick and sent at its end: a section with a single change gets a
+// Block Update, one with several gets a single Update Section Blocks packet. Every packet is encoded once and the
+// viewers are looked up once per flush, instead of once per changed block.
+class BlockChangeQueue {
+public:
+    // Queues the block at the world position, the state it has when the queue is flushed is sent
+    void blockChanged(const std::shared_ptr<Chunk>& chunk, int32_t x, int32_t y, int32_t z);
+    // Queues acknowledging the player's block change, sent after the changes so the client sees the new state before
+    // it drops its prediction
+    void acknowledge(const std::shared_ptr<Player>& player, size_t sequence);
+    // Sends the changes queued so far to the viewers of their chunks, then the acknowledgements (tick thread)
+    void flush();
+
+private:
+    struct PendingChunk {
+        std::shared_ptr<Chunk> chunk;
+        // Per section the changed blocks as x << 8 | z << 4 | y, like Update Section Blocks encodes them
+        std::array<std::vector<uint16_t>, NUM_SECTIONS> positions;
+    };
+
+    void sendChanges(std::unordered_map<uint64_t, PendingChunk, ChunkKeyHash>& changed);
+
+    std::mutex mutex;
+    std::unordered_map<uint64_t, PendingChunk, ChunkKeyHash> pending;
+    // Highest sequence to acknowledge per player, the client counts every lower one as acknowledged too
+    std::unordered_map<std::shared_ptr<Player>, size_t> acknowledgements;
+};
+
+inline BlockChangeQueue blockChanges;
+
+#endif //BLOCK_CHANGES_H
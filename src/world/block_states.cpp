@@ -1,5 +1,6 @@
 #include "block_states.h"
 
+#include <algorithm>
 #include <iostream>
 #include <nlohmann/json.hpp>
 
@@ -304,3 +305,101 @@ void assignCurrenBlockStates(const BlockData& blockData, const std::shared_ptr<P
         }
     }
 }
+
+std::string_view BlockStateIndex::intern(const std::string& value) {
+    return *strings.insert(value).first;
+}
+
+void BlockStateIndex::build(const std::unordered_map<std::string, BlockData>& blocks) {
+    strings.clear();
+    layouts.clear();
+    layoutsByName.clear();
+    layoutsByState.clear();
+
+    layouts.reserve(blocks.size());
+    for (const auto& [name, block] : blocks) {
+        BlockStateLayout layout{intern(name), block.minStateId, block.maxStateId, block.defaultState, {}};
+        int32_t stride = 1;
+        for (auto it = block.states.rbegin(); it != block.states.rend(); ++it) {
+            BlockStateLayout::Property property;
+            if (auto enumState = std::get_if<EnumState>(&*it)) {
+                property.name = intern(enumState->name);
+                for (const auto& value : enumState->values) {
+                    property.values.push_back(intern(value));
+                }
+            } else if (auto intState = std::get_if<IntState>(&*it)) {
+                property.name = intern(intState->name);
+                for (int value = intState->minValue; value <= intState->maxValue; ++value) {
+                    property.values.push_back(intern(std::to_string(value)));
+                }
+            } else if (auto boolState = std::get_if<BoolState>(&*it)) {
+                property.name = intern(boolState->name);
+                property.values = {intern("true"), intern("false")};
+            }
+            property.stride = stride;
+            property.defaultIndex = property.values.empty() ? 0
+                : (block.defaultState - block.minStateId) / stride % static_cast<int32_t>(property.values.size());
+            stride *= std::max<int32_t>(1, static_cast<int32_t>(property.values.size()));
+            layout.properties.push_back(std::move(property));
+        }
+        std::ranges::sort(layout.properties, {}, &BlockStateLayout::Property::name);
+
+        if (block.maxStateId >= static_cast<int32_t>(layoutsByState.size())) {
+            layoutsByState.resize(block.maxStateId + 1, -1);
+        }
+        for (int32_t state = block.minStateId; state <= block.maxStateId; ++state) {
+            layoutsByState[state] = static_cast<int32_t>(layouts.size());
+        }
+        layoutsByName[layout.name] = layouts.size();
+        layouts.push_back(std::move(layout));
+    }
+
+    const BlockStateLayout* air = find("air");
+    airState = air ? air->defaultState : 0;
+}
+
+const BlockStateLayout* BlockStateIndex::find(std::string_view name) const {
+    size_t colon = name.find(':');
+    if (colon != std::string_view::npos) {
+        name.remove_prefix(colon + 1);
+    }
+    auto it = layoutsByName.find(name);
+    return it != layoutsByName.end() ? &layouts[it->second] : nullptr;
+}
+
+int32_t BlockStateIndex::resolve(std::string_view name, std::span<const BlockProperty> properties) const {
+    const BlockStateLayout* block = find(name);
+    if (!block) {
+        return airState;
+    }
+    int32_t state = block->defaultState;
+    for (const auto& [key, value] : properties) {
+        auto property = std::ranges::lower_bound(block->properties, key, {}, &BlockStateLayout::Property::name);
+        if (property == block->properties.end() || property->name != key) {
+            continue;
+        }
+        auto valueIt = std::ranges::find(property->values, value);
+        if (valueIt == property->values.end()) {
+            continue;
+        }
+        int32_t index = static_cast<int32_t>(valueIt - property->values.begin());
+        state += (index - property->defaultIndex) * property->stride;
+    }
+    // Only a property listed twice gets here
+    return state >= block->minStateId && state <= block->maxStateId ? state : block->defaultState;
+}
+
+const BlockStateLayout* BlockStateIndex::describe(int32_t stateId, std::vector<BlockProperty>& properties) const {
+    properties.clear();
+    if (stateId < 0 || stateId >= static_cast<int32_t>(layoutsByState.size()) || layoutsByState[stateId] < 0) {
+        return nullptr;
+    }
+    const BlockStateLayout& block = layouts[layoutsByState[stateId]];
+    int32_t offset = stateId - block.minStateId;
+    for (const auto& property : block.properties) {
+        if (!property.values.empty()) {
+            properties.emplace_back(property.name, property.values[offset / property.stride % property.values.size()]);
+        }
+    }
+    return &block;
+}
@@ -1,7 +1,11 @@
 #ifndef BLOCK_STATES_H
 #define BLOCK_STATES_H
 #include <memory>
+#include <span>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
 #include <variant>
 #include <vector>
 #include <nlohmann/json.hpp>
@@ -79,4 +83,50 @@ size_t calculateBlockStateID(const BlockData& blockData, std::vector<BlockState>
 std::vector<BlockState> getBlockStates(const nlohmann::basic_json<> & states);
 void assignCurrenBlockStates(const BlockData& blockData, const std::shared_ptr<Player>& player, const Position& pos, Face faceClicked, const Position &cursorPos, std::vector<BlockState>& currentBlockState);
 
+// A property and its value as Anvil stores them in palettes
+using BlockProperty = std::pair<std::string_view, std::string_view>;
+
+// How a block's state IDs are laid out: each property contributes the index of its value times its stride,
+// the last property in blocks.json changes fastest (the same order calculateBlockStateID counts in)
+struct BlockStateLayout {
+    struct Property {
+        std::string_view name;
+        std::vector<std::string_view> values;
+        int32_t stride;
+        int32_t defaultIndex; // Value in the block's default state
+    };
+
+    std::string_view name;
+    int32_t minStateId;
+    int32_t maxStateId;
+    int32_t defaultState;
+    std::vector<Property> properties; // Sorted by name
+};
+
+// Translates between block state IDs and the block name plus properties Anvil uses, built once from the block data.
+// Names and values are interned, so resolving palette entries while loading chunks doesn't allocate.
+class BlockStateIndex {
+public:
+    void build(const std::unordered_map<std::string, BlockData>& blocks);
+
+    // The block with that name, with or without namespace, null if unknown
+    const BlockStateLayout* find(std::string_view name) const;
+    // State ID of the block with the given properties. Properties that are missing or unknown keep their default
+    // value, unknown blocks become air.
+    int32_t resolve(std::string_view name, std::span<const BlockProperty> properties = {}) const;
+    // Block and property values of a state ID, null for IDs no block has
+    const BlockStateLayout* describe(int32_t stateId, std::vector<BlockProperty>& properties) const;
+
+private:
+    std::string_view intern(const std::string& value);
+
+    std::unordered_set<std::string> strings;
+    std::vector<BlockStateLayout> layouts;
+    std::unordered_map<std::string_view, size_t> layoutsByName;
+    std::vector<int32_t> layoutsByState; // Index into layouts, -1 for unused IDs
+    int32_t airState = 0;
+};
+
+inline BlockStateIndex blockStateIndex;
+
 #endif //BLOCK_STATES_H
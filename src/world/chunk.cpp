@@ -1,7 +1,12 @@
 #include "chunk.h"
 
+#include <array>
+#include <bit>
 #include <bitset>
+#include <chrono>
+#include <cstring>
 #include <iostream>
+#include <ranges>
 #include <tag_array.h>
 #include <tag_list.h>
 #include <tag_string.h>
@@ -11,70 +16,205 @@
 #include "core/config.h"
 #include "networking/network.h"
 #include "entities/player.h"
+#include "chunk_loader.h"
 #include "region_file.h"
+#include "block_changes.h"
+#include "light_engine.h"
+#include "nbt_reader.h"
 #include "core/server.h"
 #include "core/utils.h"
 #include "tag_primitive.h"
 
-uint8_t Palette::getIndex(int32_t blockStateID) {
-    // Handle new blockStateID
-    uint8_t newIndex = static_cast<uint8_t>(indexToBlockState.size());
-    blockStateToIndex[blockStateID] = newIndex;
-    indexToBlockState.push_back(blockStateID);
-    return newIndex;
+namespace {
+    // Re-packs count entries from bitsPerEntry to newBitsPerEntry, passing each through map
+    template <typename Map>
+    std::vector<uint64_t> repack(const std::vector<uint64_t>& packed, int bitsPerEntry, int count, int newBitsPerEntry, Map map) {
+        std::vector<uint64_t> repacked(packedLongCount(count, newBitsPerEntry), 0);
+        if (repacked.empty()) return repacked;
+        int entriesPerLong = 64 / newBitsPerEntry;
+        for (int i = 0; i < count; ++i) {
+            uint64_t value = map(unpackEntry(packed, bitsPerEntry, i));
+            repacked[i / entriesPerLong] |= value << ((i % entriesPerLong) * newBitsPerEntry);
+        }
+        return repacked;
+    }
+
+    // Bits needed to tell count values apart
+    int bitsFor(size_t count) {
+        return count <= 1 ? 0 : static_cast<int>(std::bit_width(count - 1));
+    }
+
+    // Switches a biome palette that outgrew the indirect range to global biome IDs
+    void makeBiomesDirect(MemChunkSection& section) {
+        if (section.biomeBitsPerEntry <= MAX_INDIRECT_BIOME_BITS) return;
+        int bits = globalBiomeBits();
+        section.biomeIndices = repack(section.biomeIndices, section.biomeBitsPerEntry, SECTION_BIOMES, bits,
+                                      [&](uint32_t index) { return index < section.biomePalette.size() ? section.biomePalette.valueAt(index) : 0; });
+        section.biomeBitsPerEntry = bits;
+        section.biomePalette.clear();
+        section.biomePalette.direct = true;
+    }
+}
+
+int globalBlockBits() {
+    static const int bits = [] {
+        int maxStateID = 0;
+        for (const auto& block : blocks | std::views::values) {
+            maxStateID = std::max(maxStateID, block.maxStateId);
+        }
+        // 1.21 has just under 2^15 block states, used when the block registry isn't loaded
+        return maxStateID > 0 ? bitsFor(static_cast<size_t>(maxStateID) + 1) : 15;
+    }();
+    return bits;
 }
 
-uint8_t MemChunkSection::getOrAddBlockIndex(int32_t blockStateID) {
-    auto it = std::ranges::find(palette.indexToBlockState, blockStateID);
-    if (it != palette.indexToBlockState.end()) {
-        return std::distance(palette.indexToBlockState.begin(), it);
+int globalBiomeBits() {
+    static const int bits = [] {
+        int maxID = 0;
+        for (const auto& biome : biomes | std::views::values) {
+            maxID = std::max(maxID, biome.id);
+        }
+        return std::max(bitsFor(static_cast<size_t>(maxID) + 1), MAX_INDIRECT_BIOME_BITS + 1);
+    }();
+    return bits;
+}
+
+int32_t Palette::find(int32_t blockStateID) const {
+    if (direct) return blockStateID;
+    if (!blockStateToIndex.empty()) {
+        auto it = blockStateToIndex.find(blockStateID);
+        return it != blockStateToIndex.end() ? static_cast<int32_t>(it->second) : -1;
     }
-    palette.indexToBlockState.push_back(blockStateID);
-    return palette.indexToBlockState.size() - 1;
+    auto it = std::ranges::find(indexToBlockState, blockStateID);
+    return it != indexToBlockState.end() ? static_cast<int32_t>(std::distance(indexToBlockState.begin(), it)) : -1;
+}
+
+uint32_t Palette::getIndex(int32_t blockStateID) {
+    int32_t index = find(blockStateID);
+    return index >= 0 ? static_cast<uint32_t>(index) : add(blockStateID);
+}
+
+uint32_t Palette::add(int32_t blockStateID) {
+    auto newIndex = static_cast<uint32_t>(indexToBlockState.size());
+    indexToBlockState.push_back(blockStateID);
+
+    if (indexToBlockState.size() == (1u << MAX_LINEAR_PALETTE_BITS) + 1) {
+        // Too large for a linear search from now on
+        for (uint32_t i = 0; i < indexToBlockState.size(); ++i) {
+            blockStateToIndex.try_emplace(indexToBlockState[i], i);
+        }
+    } else if (!blockStateToIndex.empty()) {
+        blockStateToIndex.try_emplace(blockStateID, newIndex);
+    }
+    return newIndex;
 }
 
-void MemChunkSection::setBlockIndex(int32_t index, uint8_t paletteIndex) {
-    int bitOffset = index * bitsPerEntry;
-    int byteIndex = bitOffset / 8;
-    int bitStart = bitOffset % 8;
+void Palette::clear() {
+    blockStateToIndex.clear();
+    indexToBlockState.clear();
+    direct = false;
+}
 
-    // Ensure blockIndices has enough bytes
-    size_t totalBits = static_cast<size_t>(index + 1) * bitsPerEntry;
-    size_t totalBytes = (totalBits + 7) / 8;
-    if (blockIndices.size() < totalBytes) {
-        blockIndices.resize(totalBytes, 0);
+uint32_t MemChunkSection::getOrAddBlockIndex(int32_t blockStateID) {
+    int32_t existing = palette.find(blockStateID);
+    if (existing >= 0) {
+        return static_cast<uint32_t>(existing);
     }
 
-    // Clear existing bits
-    for (int i = 0; i < bitsPerEntry; ++i) {
-        blockIndices[byteIndex + (bitStart + i) / 8] &= ~(1 << ((bitStart + i) % 8));
+    // Make room before widening, replaced blocks may have left unused entries behind
+    if (bitsFor(palette.size() + 1) > bitsPerEntry && palette.size() > 1) {
+        compact();
+        existing = palette.find(blockStateID);
+        if (existing >= 0) {
+            return static_cast<uint32_t>(existing);
+        }
     }
 
-    // Set new bits
-    for (int i = 0; i < bitsPerEntry; ++i) {
-        if (paletteIndex & (1 << i)) {
-            blockIndices[byteIndex + (bitStart + i) / 8] |= (1 << ((bitStart + i) % 8));
+    uint32_t index = palette.add(blockStateID);
+    int requiredBits = calculateBitsPerEntry(palette);
+    if (requiredBits > bitsPerEntry) {
+        growBitsPerEntry(requiredBits);
+        if (palette.direct) {
+            return static_cast<uint32_t>(blockStateID);
         }
     }
+    return index;
+}
+
+void MemChunkSection::setBlockIndex(int32_t index, uint32_t paletteIndex) {
+    if (blockIndices.empty()) {
+        blockIndices.resize(packedLongCount(SECTION_VOLUME, bitsPerEntry), 0);
+    }
+
+    int entriesPerLong = 64 / bitsPerEntry;
+    int shift = (index % entriesPerLong) * bitsPerEntry;
+    uint64_t mask = ((1ULL << bitsPerEntry) - 1) << shift;
+    uint64_t& word = blockIndices[index / entriesPerLong];
+    word = (word & ~mask) | ((static_cast<uint64_t>(paletteIndex) << shift) & mask);
 
     isEmpty = false;
 }
 
-uint8_t MemChunkSection::getBlockIndex(int32_t index) const {
-    int bitOffset = index * bitsPerEntry;
-    int byteIndex = bitOffset / 8;
-    int bitStart = bitOffset % 8;
+int32_t MemChunkSection::getBlockState(int32_t index) const {
+    uint32_t paletteIndex = getBlockIndex(index);
+    if (!palette.direct && paletteIndex >= palette.size()) {
+        return blocks["air"].defaultState;
+    }
+    return palette.valueAt(paletteIndex);
+}
 
-    uint8_t value = 0;
-    for (int i = 0; i < bitsPerEntry; ++i) {
-        if (byteIndex + (bitStart + i) / 8 >= blockIndices.size()) {
-            return blocks["air"].defaultState; // Default to air if out of bounds
-        }
-        uint8_t bit = (blockIndices[byteIndex + (bitStart + i) / 8] >> ((bitStart + i) % 8)) & 1;
-        value |= (bit << i);
+void MemChunkSection::growBitsPerEntry(int newBitsPerEntry) {
+    if (newBitsPerEntry > MAX_INDIRECT_BLOCK_BITS) {
+        // Past the indirect range the client expects global state IDs
+        int bits = globalBlockBits();
+        blockIndices = repack(blockIndices, bitsPerEntry, SECTION_VOLUME, bits, [&](uint32_t index) {
+            return static_cast<uint32_t>(index < palette.size() ? palette.valueAt(index) : blocks["air"].defaultState);
+        });
+        palette.clear();
+        palette.direct = true;
+        bitsPerEntry = bits;
+        return;
     }
+    if (!blockIndices.empty()) {
+        blockIndices = repack(blockIndices, bitsPerEntry, SECTION_VOLUME, newBitsPerEntry, [](uint32_t index) { return index; });
+    }
+    bitsPerEntry = newBitsPerEntry;
+}
 
-    return value;
+void MemChunkSection::compact() {
+    editsSinceCompaction = 0;
+    if (!palette.direct && palette.size() <= 1) {
+        return;
+    }
+
+    // Collect the states still in use, in order of first use
+    Palette compacted;
+    std::vector<uint32_t> indices(SECTION_VOLUME);
+    for (int i = 0; i < SECTION_VOLUME; ++i) {
+        indices[i] = compacted.getIndex(getBlockState(i));
+    }
+    if (!palette.direct && compacted.size() == palette.size()) {
+        return;
+    }
+
+    palette = std::move(compacted);
+    if (palette.size() == 1) {
+        // Single-valued
+        bitsPerEntry = 4;
+        blockIndices.clear();
+        return;
+    }
+    bitsPerEntry = calculateBitsPerEntry(palette);
+    if (bitsPerEntry > MAX_INDIRECT_BLOCK_BITS) {
+        // Still too many states for a palette
+        bitsPerEntry = globalBlockBits();
+        for (auto& index : indices) {
+            index = static_cast<uint32_t>(palette.valueAt(index));
+        }
+        palette.clear();
+        palette.direct = true;
+    }
+    blockIndices = packIndices(indices, bitsPerEntry);
 }
 
 void MemChunkSection::addBlock(int32_t blockStateID) {
@@ -82,29 +222,39 @@ void MemChunkSection::addBlock(int32_t blockStateID) {
         isEmpty = false;
     }
     if (!isEmpty) {
-        uint8_t index = palette.getIndex(blockStateID);
-        tempBlockIndices.push_back(index);
+        tempBlockIndices.push_back(palette.getIndex(blockStateID));
     }
 }
 
 void MemChunkSection::addBiome(int32_t biomeID) {
-    uint8_t index = biomePalette.getIndex(biomeID);
-    tempBiomeIndices.push_back(index);
+    tempBiomeIndices.push_back(biomePalette.getIndex(biomeID));
 }
 
 void MemChunkSection::finalize() {
     if (!isEmpty) {
         bitsPerEntry = calculateBitsPerEntry(palette);
-        blockIndices = encodeBlockIndices(tempBlockIndices, bitsPerEntry);
+        if (palette.size() == 1) {
+            bitsPerEntry = 4;
+            blockIndices.clear();
+        } else if (bitsPerEntry > MAX_INDIRECT_BLOCK_BITS) {
+            bitsPerEntry = globalBlockBits();
+            for (auto& index : tempBlockIndices) {
+                index = static_cast<uint32_t>(palette.valueAt(index));
+            }
+            palette.clear();
+            palette.direct = true;
+            blockIndices = packIndices(tempBlockIndices, bitsPerEntry);
+        } else {
+            blockIndices = packIndices(tempBlockIndices, bitsPerEntry);
+        }
         tempBlockIndices.clear();
     }
 
-    // Finalize biome indices
-    if (!biomePalette.indexToBlockState.empty()) {
-        int biomeBitsPerEntry = calculateBitsPerEntry(biomePalette);
-        biomeIndices = encodeBlockIndices(tempBiomeIndices, biomeBitsPerEntry);
-        tempBiomeIndices.clear();
-    }
+    // Finalize biome indices, a single biome needs no data
+    biomeBitsPerEntry = biomePalette.size() > 1 ? calculateBitsPerEntry(biomePalette, 1) : 0;
+    biomeIndices = packIndices(tempBiomeIndices, biomeBitsPerEntry);
+    tempBiomeIndices.clear();
+    makeBiomesDirect(*this);
 }
 
 Block Chunk::getBlock(int32_t x, int32_t y, int32_t z) const {
@@ -121,25 +271,18 @@ Block Chunk::getBlock(int32_t x, int32_t y, int32_t z) const {
         throw std::out_of_range("Y coordinate out of range");
     }
 
-    const auto& sectionOpt = sections[sectionIndex];
-    if (!sectionOpt.has_value() || sectionOpt->isEmpty) {
+    const auto& sectionPtr = sections[sectionIndex];
+    if (!sectionPtr || sectionPtr->isEmpty) {
         return Block{blocks["air"].defaultState};
     }
 
-    const MemChunkSection& section = sectionOpt.value();
+    const MemChunkSection& section = *sectionPtr;
 
     // Calculate block position within the section
     int index = (localY * CHUNK_WIDTH * CHUNK_LENGTH) + (z * CHUNK_WIDTH) + x;
 
-    // Retrieve the palette index
-    uint8_t paletteIndex = section.getBlockIndex(index);
-
-    // Retrieve the blockStateID from the palette
-    if (paletteIndex >= section.palette.indexToBlockState.size()) {
-        return Block{blocks["air"].defaultState};
-    }
-
-    return Block{section.palette.indexToBlockState[paletteIndex]};
+    // Retrieve the blockStateID through the palette
+    return Block{section.getBlockState(index)};
 }
 
 void Chunk::setBlock(int32_t x, int32_t y, int32_t z, int32_t blockStateID, bool adjustY) {
@@ -165,44 +308,53 @@ void Chunk::setBlock(int32_t x, int32_t y, int32_t z, int32_t blockStateID, bool
         throw std::out_of_range("Y coordinate out of range");
     }
 
-    auto& sectionOpt = sections[sectionIndex];
-    if (!sectionOpt.has_value()) {
-        if (blockStateID == blocks["air"].defaultState) return; // No need to store air
-        sections[sectionIndex].emplace();
+    if (!sections[sectionIndex] && blockStateID == blocks["air"].defaultState) {
+        return; // No need to store air
     }
 
-    MemChunkSection& section = sections[sectionIndex].value();
-
-    // Add or retrieve the palette index for the new blockStateID
-    uint8_t paletteIndex = section.getOrAddBlockIndex(blockStateID);
-
-    // If adding a new block increases the palette size beyond current bitsPerEntry, update bitsPerEntry and re-encode blockIndices
-    int requiredBits = calculateBitsPerEntry(section.palette);
-    if (requiredBits > section.bitsPerEntry) {
-        // Re-encode all existing block indices with the new bitsPerEntry
-        // This involves unpacking the existing blockIndices and re-packing them with the updated bitsPerEntry
-        std::vector<uint8_t> currentIndices;
-        currentIndices.reserve(CHUNK_WIDTH * CHUNK_LENGTH * SECTION_HEIGHT);
-
-        // Unpack existing indices
-        for (int i = 0; i < CHUNK_WIDTH * CHUNK_LENGTH * SECTION_HEIGHT; ++i) {
-            currentIndices.push_back(section.getBlockIndex(i));
-        }
-        // Update bitsPerEntry
-        section.bitsPerEntry = requiredBits;
+    MemChunkSection& section = editSection(sectionIndex);
+    int32_t air = blocks["air"].defaultState;
+    if (section.palette.size() == 0 && !section.palette.direct) {
+        // A section that was never written to is all air
+        section.palette.add(air);
+    }
 
-        // Re-pack with new bitsPerEntry
-        section.blockIndices = encodeBlockIndices(currentIndices, section.bitsPerEntry);
+    int index = (localY * CHUNK_WIDTH * CHUNK_LENGTH) + (z * CHUNK_WIDTH) + x;
+    int32_t previousState = section.isEmpty ? air : section.getBlockState(index);
+    if (previousState == blockStateID) {
+        return;
     }
+    section.blockCount += static_cast<int16_t>(isWorldSurface(blockStateID) - isWorldSurface(previousState));
+
+    // Add or retrieve the palette index for the new blockStateID, this widens the storage if needed
+    uint32_t paletteIndex = section.getOrAddBlockIndex(blockStateID);
 
     // Set the new palette index in blockIndices
-    int index = (localY * CHUNK_WIDTH * CHUNK_LENGTH) + (z * CHUNK_WIDTH) + x;
     section.setBlockIndex(index, paletteIndex);
+    updateHeightmaps(x, sectionIndex * SECTION_HEIGHT + localY, z, blockStateID);
 
-    // Mark the chunk as dirty for future serialization
+    // Drop the states edits left unused from time to time so the palette doesn't only ever grow
+    if (++section.editsSinceCompaction >= SECTION_VOLUME) {
+        section.compact();
+    }
+
+    // Mark the chunk as dirty for future serialization, cached packets are outdated now
+    version.fetch_add(1, std::memory_order_release);
     markDirty();
 }
 
+MemChunkSection& Chunk::editSection(int sectionIndex) {
+    auto& section = sections[sectionIndex];
+    if (!section) {
+        section = std::make_shared<MemChunkSection>();
+    } else if (sharedSections.test(sectionIndex)) {
+        // First change to a template section, this chunk gets a copy of its own
+        section = std::make_shared<MemChunkSection>(*section);
+    }
+    sharedSections.reset(sectionIndex);
+    return *section;
+}
+
 void Chunk::markDirty() {
     dirty = true;
 }
@@ -214,72 +366,18 @@ int32_t getLocalCoordinate(int32_t coord) {
 }
 
 int calculateBitsPerEntry(const Palette& palette, int min) {
-    return std::max(static_cast<int>(std::ceil(std::log2(palette.indexToBlockState.size()))), min); // Minimum 4 bits
-}
-
-std::vector<uint8_t> encodePalettedData(const std::vector<uint32_t>& data, int bitsPerEntry, size_t& size) {
-    std::vector<uint64_t> longs;
-    uint64_t currentLong = 0;
-    int bitsFilled = 0;
-
-    for (size_t i = 0; i < data.size(); ++i) {
-        const auto& entry = data[i];
-        if (bitsPerEntry == 0) {
-            // Single-valued palette; no data array needed
-            break;
-        }
-
-        if (bitsFilled + bitsPerEntry > 64) {
-            // Current long is full; push and reset
-            longs.push_back(currentLong);
-            currentLong = 0;
-            bitsFilled = 0;
-        }
-
-        // Insert entry into current long
-        currentLong |= (static_cast<uint64_t>(entry) << bitsFilled);
-        bitsFilled += bitsPerEntry;
-    }
-
-    if (bitsFilled > 0) {
-        longs.push_back(currentLong);
-    }
-
-    size = longs.size();
-
-    // Convert longs to big endian byte order (Minecraft expects big endian for bit-packed data)
-    std::vector<uint8_t> encodedData;
-    encodedData.reserve(longs.size() * 8);
-    for (const auto& l : longs) {
-        for (int i = 7; i >= 0; --i) { // Big endian
-            encodedData.push_back(static_cast<uint8_t>((l >> (i * 8)) & 0xFF));
-        }
-    }
-
-    return encodedData;
+    return std::max(bitsFor(palette.size()), min); // Minimum 4 bits
 }
 
-std::vector<uint8_t> encodeBlockIndices(const std::vector<uint8_t>& indices, int bitsPerEntry) {
-    std::vector<uint8_t> encoded;
-    uint64_t buffer = 0;
-    int bitsFilled = 0;
+std::vector<uint64_t> packIndices(const std::vector<uint32_t>& indices, int bitsPerEntry) {
+    std::vector<uint64_t> packed(packedLongCount(static_cast<int>(indices.size()), bitsPerEntry), 0);
+    if (packed.empty()) return packed;
 
-    for (auto index : indices) {
-        buffer |= (static_cast<uint64_t>(index) << bitsFilled);
-        bitsFilled += bitsPerEntry;
-
-        while (bitsFilled >= 8) {
-            encoded.push_back(static_cast<uint8_t>(buffer & 0xFF));
-            buffer >>= 8;
-            bitsFilled -= 8;
-        }
+    int entriesPerLong = 64 / bitsPerEntry;
+    for (size_t i = 0; i < indices.size(); ++i) {
+        packed[i / entriesPerLong] |= static_cast<uint64_t>(indices[i]) << ((i % entriesPerLong) * bitsPerEntry);
     }
-
-    if (bitsFilled > 0) {
-        encoded.push_back(static_cast<uint8_t>(buffer & 0xFF));
-    }
-
-    return encoded;
+    return packed;
 }
 
 std::vector<ChunkCoordinates> getChunksInView(int32_t centerChunkX, int32_t centerChunkZ, int viewDistance) {
@@ -353,6 +451,12 @@ void updatePlayerChunkView(const std::shared_ptr<Player> & player, int32_t oldCh
             player->currentViewedChunks.emplace(coords);
         }
     }
+
+    // Step 5: Send the chunks that came into view and unload the ones that left it
+    chunkLoader->updatePlayer(player);
+
+    // Step 6: Spawn and remove entities that came into or left the view
+    entityTracker.updateViewer(player);
 }
 
 
@@ -364,33 +468,92 @@ bool isWorldSurface(const short& blockStateID) {
             blockStateID != 12958; // void air
 }
 
-std::vector<int64_t> packHeightmap(const std::vector<int64_t>& heights, int bitsPerEntry) {
-    int totalBits = heights.size() * bitsPerEntry;
-    int numLongs = static_cast<int>(std::ceil(static_cast<float>(totalBits) / 64.0f));
-
-    // Ensure that numLongs is at least 37 to match client expectation
-    if (numLongs < 37) {
-        numLongs = 37;
-    }
-
-    std::vector<int64_t> packed(numLongs, 0);
+bool isMotionBlocking(int32_t blockStateID) {
+    // Solid blocks, fluids and waterlogged blocks, by state ID
+    static const std::vector<bool> motionBlocking = [] {
+        std::vector<bool> table;
+        std::vector<BlockProperty> properties;
+        for (const auto& [name, block] : blocks) {
+            if (block.maxStateId >= static_cast<int>(table.size())) {
+                table.resize(block.maxStateId + 1, false);
+            }
+            bool fluid = name == "water" || name == "lava" || name == "bubble_column";
+            for (int state = block.minStateId; state <= block.maxStateId; ++state) {
+                bool waterlogged = false;
+                if (blockStateIndex.describe(state, properties)) {
+                    waterlogged = std::ranges::find(properties, BlockProperty{"waterlogged", "true"}) != properties.end();
+                }
+                table[state] = block.boundingBox == "block" || fluid || waterlogged;
+            }
+        }
+        return table;
+    }();
+    return blockStateID >= 0 && blockStateID < static_cast<int32_t>(motionBlocking.size()) && motionBlocking[blockStateID];
+}
 
-    for (size_t i = 0; i < heights.size(); ++i) {
-        int bitIndex = i * bitsPerEntry;
-        int longIndex = bitIndex / 64;
-        int bitOffset = bitIndex % 64;
+bool countsForHeightmap(Heightmaps::Type type, int32_t blockStateID) {
+    return type == Heightmaps::MOTION_BLOCKING ? isMotionBlocking(blockStateID) : isWorldSurface(static_cast<short>(blockStateID));
+}
 
-        // Insert the height value into the packed array
-        packed[longIndex] |= (heights[i] & ((1LL << bitsPerEntry) - 1)) << bitOffset;
+Heightmaps computeHeightmaps(const ChunkSections& sections) {
+    constexpr int columns = CHUNK_WIDTH * CHUNK_LENGTH;
+    Heightmaps heightmaps;
+    for (int type = 0; type < Heightmaps::TYPE_COUNT; ++type) {
+        auto heightmapType = static_cast<Heightmaps::Type>(type);
+        heightmaps.packed[type].assign(packedLongCount(columns, Heightmaps::BITS_PER_ENTRY), 0);
+
+        // Walk down layer by layer until every column found its top block
+        std::bitset<columns> found;
+        for (int sectionIndex = NUM_SECTIONS - 1; sectionIndex >= 0 && !found.all(); --sectionIndex) {
+            const auto& section = sections[sectionIndex];
+            if (!section || section->isEmpty) {
+                continue;
+            }
+            for (int localY = SECTION_HEIGHT - 1; localY >= 0 && !found.all(); --localY) {
+                for (int column = 0; column < columns; ++column) {
+                    if (!found.test(column) && countsForHeightmap(heightmapType, section->getBlockState(localY * columns + column))) {
+                        found.set(column);
+                        heightmaps.set(heightmapType, column % CHUNK_WIDTH, column / CHUNK_WIDTH, sectionIndex * SECTION_HEIGHT + localY + 1);
+                    }
+                }
+            }
+        }
+    }
+    return heightmaps;
+}
 
-        // Handle cases where the height value spans two longs
-        if (bitOffset + bitsPerEntry > 64) {
-            int bitsInNextLong = (bitOffset + bitsPerEntry) - 64;
-            packed[longIndex + 1] |= (heights[i] & ((1LL << bitsInNextLong) - 1)) >> (bitsPerEntry - bitsInNextLong);
+void Chunk::updateHeightmaps(int32_t x, int32_t y, int32_t z, int32_t blockStateID) {
+    if (heightmaps.empty()) {
+        heightmaps = computeHeightmaps(sections);
+        return;
+    }
+    for (int type = 0; type < Heightmaps::TYPE_COUNT; ++type) {
+        auto heightmapType = static_cast<Heightmaps::Type>(type);
+        int height = heightmaps.get(heightmapType, x, z);
+        if (countsForHeightmap(heightmapType, blockStateID)) {
+            if (y + 1 > height) {
+                heightmaps.set(heightmapType, x, z, y + 1);
+            }
+        } else if (y + 1 == height) {
+            // The top block went away, only then the column has to be searched
+            heightmaps.set(heightmapType, x, z, scanHeight(heightmapType, x, y, z));
         }
     }
+}
 
-    return packed;
+int Chunk::scanHeight(Heightmaps::Type type, int32_t x, int32_t y, int32_t z) const {
+    for (int height = y - 1; height >= 0; --height) {
+        const auto& section = sections[height / SECTION_HEIGHT];
+        if (!section || section->isEmpty) {
+            height -= height % SECTION_HEIGHT; // Skip the rest of the section
+            continue;
+        }
+        int index = ((height % SECTION_HEIGHT) * CHUNK_LENGTH + z) * CHUNK_WIDTH + x;
+        if (countsForHeightmap(type, section->getBlockState(index))) {
+            return height + 1;
+        }
+    }
+    return 0;
 }
 
 #ifdef _WIN32
@@ -410,67 +573,26 @@ uint64_t htobe64(uint64_t host_64bits) {
 }
 #endif
 
-// Function to unpack bitsPerEntry bits from packedData into separate indices
-std::vector<uint32_t> unpackBits(const std::vector<uint8_t>& packedData, int bitsPerEntry) {
-    // Validate bitsPerEntry
-    if (bitsPerEntry < 1 || bitsPerEntry > 32) {
-        throw std::invalid_argument("bitsPerEntry must be between 1 and 32.");
-    }
-
-    std::vector<uint32_t> unpackedData;
-    size_t totalBits = packedData.size() * 8;
-    size_t totalEntries = totalBits / bitsPerEntry; // Floor division
-    size_t remainingBits = totalBits % bitsPerEntry;
-
-    // Warn if there are remaining bits that don't form a complete entry
-    if (remainingBits != 0) {
-        logMessage("There are " + std::to_string(remainingBits) + " leftover bits that do not form a complete entry and will be ignored.", LOG_WARNING);
-    }
-
-    // Iterate over each entry
-    for (size_t entry = 0; entry < totalEntries; ++entry) {
-        size_t bitIndex = entry * bitsPerEntry;
-        size_t byteIndex = bitIndex / 8;
-        size_t bitOffset = bitIndex % 8;
-
-        uint32_t value = 0;
-
-        if (bitOffset + bitsPerEntry <= 8) {
-            // All bits are within the current byte
-            value = (packedData[byteIndex] >> bitOffset) & ((1u << bitsPerEntry) - 1);
-        } else {
-            // Bits are split between current byte and the next byte
-            size_t bitsInFirstByte = 8 - bitOffset;
-            size_t bitsInSecondByte = bitsPerEntry - bitsInFirstByte;
-
-            // Extract bits from the first byte
-            uint32_t firstPart = (packedData[byteIndex] >> bitOffset) & ((1u << bitsInFirstByte) - 1);
-
-            // Ensure we don't go out of bounds
-            if (byteIndex + 1 >= packedData.size()) {
-                throw std::out_of_range("Attempting to read beyond the end of packedData.");
-            }
-
-            // Extract bits from the second byte
-            uint32_t secondPart = packedData[byteIndex + 1] & ((1u << bitsInSecondByte) - 1);
-
-            // Combine the two parts
-            value = (secondPart << bitsInFirstByte) | firstPart;
-        }
-
-        unpackedData.push_back(value);
+// Appends a packed data array (length prefix and big-endian longs) in one go
+void writePackedLongs(std::vector<uint8_t>& buffer, const std::vector<uint64_t>& longs) {
+    writeVarInt(buffer, static_cast<int32_t>(longs.size()));
+    size_t offset = buffer.size();
+    buffer.resize(offset + longs.size() * sizeof(uint64_t));
+    uint8_t* out = buffer.data() + offset;
+    for (uint64_t value : longs) {
+        uint64_t bigEndian = htobe64(value);
+        std::memcpy(out, &bigEndian, sizeof(bigEndian));
+        out += sizeof(bigEndian);
     }
-
-    return unpackedData;
 }
 
-std::vector<uint8_t> serializeChunkSections(const std::array<std::optional<MemChunkSection>, NUM_SECTIONS>& sections) {
+std::vector<uint8_t> serializeChunkSections(const ChunkSections& sections) {
     std::vector<uint8_t> serializedSections;
-    int count = 0;
+    serializedSections.reserve(NUM_SECTIONS * 64);
     for (const auto& section : sections) {
         // Serialize Block Count (Short, big-endian)
-        if (section.has_value()) {
-            int16_t blockCountBE = htons(section.value().blockCount);
+        if (section) {
+            int16_t blockCountBE = htons(section->blockCount);
             serializedSections.push_back(reinterpret_cast<const uint8_t*>(&blockCountBE)[0]);
             serializedSections.push_back(reinterpret_cast<const uint8_t*>(&blockCountBE)[1]);
         } else {
@@ -479,73 +601,58 @@ std::vector<uint8_t> serializeChunkSections(const std::array<std::optional<MemCh
         }
 
         // 1. Serialize Block States (Paletted Container)
-        if (!section.has_value() || section.value().isEmpty) {
+        if (!section || section->isEmpty) {
             writeByte(serializedSections, 0); // Bits Per Entry
             writeVarInt(serializedSections, blocks["air"].defaultState); // Air
             writeVarInt(serializedSections, 0); // No block states data
-        } else if (section.value().palette.indexToBlockState.size() == 1) {
+        } else if (section->palette.direct) {
+            // Direct palette, the indices are global block state IDs
+            writeByte(serializedSections, static_cast<uint8_t>(section->bitsPerEntry)); // Bits Per Entry
+            writePackedLongs(serializedSections, section->blockIndices);
+        } else if (section->palette.size() == 1) {
             // Single-valued palette
             writeByte(serializedSections, 0); // Bits Per Entry
-            writeVarInt(serializedSections, section.value().palette.indexToBlockState[0]); // Single value
+            writeVarInt(serializedSections, section->palette.indexToBlockState[0]); // Single value
             writeVarInt(serializedSections, 0); // No block states data
         } else {
-            // Indirect palette
-            int bitsPerEntryBlock = std::max(4, calculateBitsPerEntry(section.value().palette));
-            bitsPerEntryBlock = std::min(bitsPerEntryBlock, 32);
-            writeByte(serializedSections, static_cast<uint8_t>(bitsPerEntryBlock)); // Bits Per Entry
+            // Indirect palette, the indices are already stored in the wire layout
+            writeByte(serializedSections, static_cast<uint8_t>(section->bitsPerEntry)); // Bits Per Entry
 
-            writeVarInt(serializedSections, section.value().palette.indexToBlockState.size()); // Palette Length
-            for (const auto& blockID : section.value().palette.indexToBlockState) {
+            writeVarInt(serializedSections, section->palette.size()); // Palette Length
+            for (const auto& blockID : section->palette.indexToBlockState) {
                 writeVarInt(serializedSections, blockID); // Palette entries are blockStateIDs
             }
 
-            // Encoded Block States using blockIndices
-            size_t numberOfLongs;
-            std::vector<uint32_t> unpackedBlockIndices = unpackBits(section.value().blockIndices, bitsPerEntryBlock);
-            if (unpackedBlockIndices.size() != 4096) {
-                logMessage("Unpacked block indices size is not 4096: " + std::to_string(unpackedBlockIndices.size()), LOG_ERROR);
+            if (section->blockIndices.empty()) {
+                // Never written to, every index is 0
+                writePackedLongs(serializedSections, std::vector<uint64_t>(packedLongCount(SECTION_VOLUME, section->bitsPerEntry), 0));
+            } else {
+                writePackedLongs(serializedSections, section->blockIndices);
             }
-            std::vector<uint8_t> encodedBlockData = encodePalettedData(unpackedBlockIndices, bitsPerEntryBlock, numberOfLongs);
-
-            // Serialize Data Array Length (VarInt)
-            writeVarInt(serializedSections, static_cast<int32_t>(numberOfLongs));
-
-            // Serialize the Data Array
-            writeBytes(serializedSections, encodedBlockData);
         }
 
         // 2. Serialize Biomes (Paletted Container)
-        if (section.value().biomePalette.indexToBlockState.size() == 1) {
+        if (!section || section->biomeBitsPerEntry == 0) {
             // Single-valued palette
+            bool hasBiome = section && section->biomePalette.size() > 0;
             writeByte(serializedSections, 0); // Bits Per Entry
-            writeVarInt(serializedSections, section.value().biomePalette.indexToBlockState[0]); // Single value
+            writeVarInt(serializedSections, hasBiome ? section->biomePalette.indexToBlockState[0] : 0); // Single value
             writeVarInt(serializedSections, 0); // No biome data
+        } else if (section->biomePalette.direct) {
+            // Direct palette, the indices are global biome IDs
+            writeByte(serializedSections, static_cast<uint8_t>(section->biomeBitsPerEntry)); // Bits Per Entry
+            writePackedLongs(serializedSections, section->biomeIndices);
         } else {
             // Indirect palette
-            int bitsPerEntryBiome = calculateBitsPerEntry(section.value().biomePalette, 1);
-            bitsPerEntryBiome = std::max(bitsPerEntryBiome, 1); // Ensure minimum 1 bit
-            bitsPerEntryBiome = std::min(bitsPerEntryBiome, 32); // Cap at 32 bits
-
-            writeByte(serializedSections, static_cast<uint8_t>(bitsPerEntryBiome)); // Bits Per Entry
+            writeByte(serializedSections, static_cast<uint8_t>(section->biomeBitsPerEntry)); // Bits Per Entry
 
-            writeVarInt(serializedSections, static_cast<int32_t>(section.value().biomePalette.indexToBlockState.size())); // Palette Length
-            for (const auto& biomeID : section.value().biomePalette.indexToBlockState) {
+            writeVarInt(serializedSections, static_cast<int32_t>(section->biomePalette.size())); // Palette Length
+            for (const auto& biomeID : section->biomePalette.indexToBlockState) {
                 writeVarInt(serializedSections, biomeID); // Palette entries are biomeIDs
             }
 
-            // Encoded Biomes using biomeIndices
-            size_t numberOfLongs;
-            std::vector<uint32_t> unpackedBiomeIndices = unpackBits(section.value().biomeIndices, bitsPerEntryBiome);
-            std::vector<uint8_t> encodedBiomes = encodePalettedData(unpackedBiomeIndices, bitsPerEntryBiome, numberOfLongs);
-
-            // Serialize Data Array Length (VarInt)
-            writeVarInt(serializedSections, static_cast<int32_t>(numberOfLongs));
-
-            // Serialize the Data Array
-            writeBytes(serializedSections, encodedBiomes);
+            writePackedLongs(serializedSections, section->biomeIndices);
         }
-
-        count += 1;
     }
 
     return serializedSections;
@@ -598,114 +705,80 @@ std::vector<uint8_t> serializeBitSet(uint32_t bitMask) {
     return serializedBitSet;
 }
 
-nbt::tag_compound serializeHeightmaps(const std::shared_ptr<Chunk> & chunk) {
-    nbt::tag_compound heightmapsNBT;
-    for (const auto& heightmap : chunk->heightmaps.data) {
-        nbt::tag_long_array heightmapArray;
-        for (auto height : heightmap.second) {
-            heightmapArray.push_back(height);
+// Network NBT of the heightmaps, a nameless compound of long arrays written straight from the packed data
+std::vector<uint8_t> serializeHeightmaps(const Heightmaps& heightmaps) {
+    std::vector<uint8_t> data;
+    writeByte(data, static_cast<int8_t>(nbt::tag_type::Compound));
+    for (int type = 0; type < Heightmaps::TYPE_COUNT; ++type) {
+        const auto& longs = heightmaps.packed[type];
+        if (longs.empty()) {
+            continue;
+        }
+        std::string_view name = Heightmaps::NAMES[type];
+        writeByte(data, static_cast<int8_t>(nbt::tag_type::Long_Array));
+        writeShort(data, static_cast<int16_t>(name.size()));
+        data.insert(data.end(), name.begin(), name.end());
+        writeInt(data, static_cast<int32_t>(longs.size()));
+        for (uint64_t value : longs) {
+            writeLong(data, static_cast<int64_t>(value));
         }
-        heightmapsNBT[heightmap.first] = std::move(heightmapArray);
     }
-    return heightmapsNBT;
-}
-
-// Function to check if a section's light data is all zero
-bool isAllZero(const std::vector<uint8_t>& lightData, int sectionIndex) {
-    constexpr int SECTION_SIZE = 2048; // bytes per section
-    return std::all_of(lightData.begin() + sectionIndex * SECTION_SIZE,
-                       lightData.begin() + (sectionIndex + 1) * SECTION_SIZE,
-                       [](uint8_t byte) { return byte == 0; });
+    writeByte(data, static_cast<int8_t>(nbt::tag_type::End));
+    return data;
 }
 
-std::vector<uint8_t> serializeLighting(const Chunk* chunk) {
-    // Initialize masks
+std::vector<uint8_t> serializeLighting(const Chunk& chunk, uint32_t sectionMask) {
+    // Bit 0 of the masks is the section below the world, bit NUM_SECTIONS + 1 the one above it
     uint32_t skyLightMask = 0;
     uint32_t blockLightMask = 0;
     uint32_t emptySkyLightMask = 0;
     uint32_t emptyBlockLightMask = 0;
-
-    // Iterate through each section to set masks
-    for (size_t i = 0; i < chunk->sections.size(); ++i) {
-        const Lighting& lighting = chunk->sections[i]->lighting;
-
-        // Sky Light Mask
-        bool hasSkyLight = std::ranges::any_of(lighting.skyLight,
-                                               [](uint8_t byte) { return byte != 0; });
-        if (hasSkyLight) {
-            skyLightMask |= (1 << i);
-            if (isAllZero(lighting.skyLight, i)) {
-                emptySkyLightMask |= (1 << i);
-            }
+    auto hasLight = [](const std::vector<uint8_t>& light) {
+        return std::ranges::any_of(light, [](uint8_t byte) { return byte != 0; });
+    };
+    for (int bit = 0; bit < NUM_SECTIONS + 2; ++bit) {
+        if (!(sectionMask & (1u << bit))) {
+            continue;
         }
-
-        // Block Light Mask
-        bool hasBlockLight = std::ranges::any_of(lighting.blockLight,
-                                                 [](uint8_t byte) { return byte != 0; });
-        if (hasBlockLight) {
-            blockLightMask |= (1 << i);
-            if (isAllZero(lighting.blockLight, i)) {
-                emptyBlockLightMask |= (1 << i);
-            }
+        int sectionIndex = bit - 1;
+        const MemChunkSection* section = sectionIndex >= 0 && sectionIndex < NUM_SECTIONS ? chunk.sections[sectionIndex].get() : nullptr;
+        bool above = bit == NUM_SECTIONS + 1;
+        if (above || (section && hasLight(section->lighting.skyLight))) {
+            skyLightMask |= 1u << bit;
+        } else {
+            emptySkyLightMask |= 1u << bit;
+        }
+        if (section && hasLight(section->lighting.blockLight)) {
+            blockLightMask |= 1u << bit;
+        } else {
+            emptyBlockLightMask |= 1u << bit;
         }
     }
 
-    // Serialize Light Masks
-    std::vector<uint8_t> lightMasksData;
-    std::vector<uint8_t> serializedSkyLightMask = serializeBitSet(skyLightMask);
-    lightMasksData.insert(lightMasksData.end(), serializedSkyLightMask.begin(), serializedSkyLightMask.end());
-
-    std::vector<uint8_t> serializedBlockLightMask = serializeBitSet(blockLightMask);
-    lightMasksData.insert(lightMasksData.end(), serializedBlockLightMask.begin(), serializedBlockLightMask.end());
-
-    std::vector<uint8_t> serializedEmptySkyLightMask = serializeBitSet(emptySkyLightMask);
-    lightMasksData.insert(lightMasksData.end(), serializedEmptySkyLightMask.begin(), serializedEmptySkyLightMask.end());
-
-    std::vector<uint8_t> serializedEmptyBlockLightMask = serializeBitSet(emptyBlockLightMask);
-    lightMasksData.insert(lightMasksData.end(), serializedEmptyBlockLightMask.begin(), serializedEmptyBlockLightMask.end());
-
-    // Serialize Sky Light Arrays
-    int32_t skyLightArrayCount = std::bitset<32>(skyLightMask).count();
-    std::vector<uint8_t> skyLightArraysData;
-    writeVarInt(skyLightArraysData, skyLightArrayCount);
-    for (size_t i = 0; i < chunk->sections.size(); ++i) {
-        if (skyLightMask & (1 << i)) {
-            // Extract the sky light data for this section
-            const Lighting& lighting = chunk->sections[i]->lighting;
-            const std::vector<uint8_t>& skyLight = lighting.skyLight;
-
-            // Serialize the sky light array
-            writeVarInt(skyLightArraysData, 2048); // Sky Light array length
-
-            // Append the actual sky light data
-            writeBytes(skyLightArraysData, skyLight);
+    std::vector<uint8_t> serializedData;
+    writeBytes(serializedData, serializeBitSet(skyLightMask));
+    writeBytes(serializedData, serializeBitSet(blockLightMask));
+    writeBytes(serializedData, serializeBitSet(emptySkyLightMask));
+    writeBytes(serializedData, serializeBitSet(emptyBlockLightMask));
+
+    // The arrays in the order of their bits, the sky above the world is always fully lit
+    static const std::vector<uint8_t> fullLight(SECTION_VOLUME / 2, 0xFF);
+    writeVarInt(serializedData, std::popcount(skyLightMask));
+    for (int bit = 0; bit < NUM_SECTIONS + 2; ++bit) {
+        if (skyLightMask & (1u << bit)) {
+            const std::vector<uint8_t>& skyLight = bit == NUM_SECTIONS + 1 ? fullLight : chunk.sections[bit - 1]->lighting.skyLight;
+            writeVarInt(serializedData, static_cast<int32_t>(skyLight.size()));
+            writeBytes(serializedData, skyLight);
         }
     }
-
-    // Serialize Block Light Arrays
-    int32_t blockLightArrayCount = std::bitset<32>(blockLightMask).count();
-    std::vector<uint8_t> blockLightArraysData;
-    writeVarInt(blockLightArraysData, blockLightArrayCount);
-    for (size_t i = 0; i < chunk->sections.size(); ++i) {
-        if (blockLightMask & (1 << i)) {
-            // Extract the block light data for this section
-            const Lighting& lighting = chunk->sections[i]->lighting;
-            const std::vector<uint8_t>& blockLight = lighting.blockLight;
-
-            // Serialize the block light array
-            writeVarInt(blockLightArraysData, 2048); // Block Light array length
-
-            // Append the actual block light data
-            writeBytes(blockLightArraysData, blockLight);
+    writeVarInt(serializedData, std::popcount(blockLightMask));
+    for (int bit = 0; bit < NUM_SECTIONS + 2; ++bit) {
+        if (blockLightMask & (1u << bit)) {
+            const std::vector<uint8_t>& blockLight = chunk.sections[bit - 1]->lighting.blockLight;
+            writeVarInt(serializedData, static_cast<int32_t>(blockLight.size()));
+            writeBytes(serializedData, blockLight);
         }
     }
-
-    // Combine all serialized data
-    std::vector<uint8_t> serializedData;
-    serializedData.insert(serializedData.end(), lightMasksData.begin(), lightMasksData.end());
-    serializedData.insert(serializedData.end(), skyLightArraysData.begin(), skyLightArraysData.end());
-    serializedData.insert(serializedData.end(), blockLightArraysData.begin(), blockLightArraysData.end());
-
     return serializedData;
 }
 
@@ -715,8 +788,7 @@ std::vector<uint8_t> serializeChunkData(
 ) {
 
      // 1. Serialize Heightmaps
-    nbt::tag_compound heightmapsNBT = serializeHeightmaps(chunk);
-    std::vector<uint8_t> serializedHeightmaps = serializeNBT(heightmapsNBT, true);
+    std::vector<uint8_t> serializedHeightmaps = serializeHeightmaps(chunk->heightmaps);
 
     // 2. Serialize Chunk Sections
     std::vector<uint8_t> serializedSections = serializeChunkSections(chunk->sections);
@@ -726,55 +798,7 @@ std::vector<uint8_t> serializeChunkData(
     writeVarInt(blockEntitiesData, 0); // Number of block entities (0 for now)
 
     // 4. Serialize Light Data
-    /*
-     * TODO: Fix
-    std::vector<uint8_t> lightData = serializeLighting(chunk.get());
-    */
-
-    uint32_t skyLightMask = 0;
-    uint32_t blockLightMask = 0;
-    uint32_t emptySkyLightMask = 0;
-    uint32_t emptyBlockLightMask = 0;
-
-    for (int i = 0; i < chunk->sections.size(); ++i) {
-        skyLightMask |= (1 << i);
-        blockLightMask |= (1 << i);
-    }
-
-    // Serialize Sky Light Mask, Block Light Mask, Empty Sky Light Mask, Empty Block Light Mask
-    std::vector<uint8_t> lightMasksData;
-    std::vector<uint8_t> serializedSkyLightMask = serializeBitSet(skyLightMask);
-    lightMasksData.insert(lightMasksData.end(), serializedSkyLightMask.begin(), serializedSkyLightMask.end());
-    std::vector<uint8_t> serializedBlockLightMask = serializeBitSet(blockLightMask);
-    lightMasksData.insert(lightMasksData.end(), serializedBlockLightMask.begin(), serializedBlockLightMask.end());
-    std::vector<uint8_t> serializedEmptySkyLightMask = serializeBitSet(emptySkyLightMask);
-    lightMasksData.insert(lightMasksData.end(), serializedEmptySkyLightMask.begin(), serializedEmptySkyLightMask.end());
-    std::vector<uint8_t> serializedEmptyBlockLightMask = serializeBitSet(emptyBlockLightMask);
-    lightMasksData.insert(lightMasksData.end(), serializedEmptyBlockLightMask.begin(), serializedEmptyBlockLightMask.end());
-
-    // Serialize Sky Light Arrays
-    int32_t skyLightArrayCount = std::bitset<32>(skyLightMask).count();
-    std::vector<uint8_t> skyLightArraysData;
-    writeVarInt(skyLightArraysData, skyLightArrayCount);
-    for (int i = 0; i < skyLightArrayCount; ++i) {
-        std::vector<uint8_t> skyLightArray(2048, 0xFF); // Full light
-        writeVarInt(skyLightArraysData, 2048); // Sky Light array length
-        writeBytes(skyLightArraysData, skyLightArray);
-    }
-
-    // Serialize Block Light Arrays
-    int32_t blockLightArrayCount = std::bitset<32>(blockLightMask).count();
-    std::vector<uint8_t> blockLightArraysData;
-    writeVarInt(blockLightArraysData, blockLightArrayCount);
-    for (int i = 0; i < blockLightArrayCount; ++i) {
-        std::vector<uint8_t> blockLightArray(2048, 0x00); // No light
-        writeVarInt(blockLightArraysData, 2048); // Block Light array length
-        writeBytes(blockLightArraysData, blockLightArray);
-    }
-    std::vector<uint8_t> lightData;
-    lightData.insert(lightData.end(), lightMasksData.begin(), lightMasksData.end());
-    lightData.insert(lightData.end(), skyLightArraysData.begin(), skyLightArraysData.end());
-    lightData.insert(lightData.end(), blockLightArraysData.begin(), blockLightArraysData.end());
+    std::vector<uint8_t> lightData = serializeLighting(*chunk, ALL_LIGHT_SECTIONS);
 
     // 5. Assemble Data Buffer
     std::vector<uint8_t> dataBuffer;
@@ -796,51 +820,21 @@ std::shared_ptr<Chunk> getChunkContainingBlock(int32_t x, int32_t y, int32_t z)
     int32_t chunkX = getChunkCoordinate(x);
     int32_t chunkZ = getChunkCoordinate(z);
 
-    // Access the global chunk map (thread-safe)
-    std::lock_guard lock(chunkMapMutex);
-    auto it = globalChunkMap.find({chunkX, chunkZ});
-    if (it != globalChunkMap.end()) {
-        return it->second;
-    }
-    return nullptr;
+    // Only locks the chunk's shard of the map, and only for reading
+    return globalChunkMap.find(chunkX, chunkZ);
 }
 
 void notifyChunkUpdate(const std::shared_ptr<Chunk>& chunk, int32_t x, int32_t y, int32_t z) {
-    // Construct a Block Change packet
-    std::vector<uint8_t> packetData;
-    packetData.push_back(0x09); // Packet ID for Block Update
-
-    // Block Position (VarLong)
-    int64_t position = encodePosition(x, y, z);
-    writeLong(packetData, position);
+    // The viewers get the change with the others of its section at the end of the tick
+    blockChanges.blockChanged(chunk, x, y, z);
 
-    // Block State ID
-    try {
-        Block block = chunk->getBlock(getLocalCoordinate(x), y, getLocalCoordinate(z));
-        writeVarInt(packetData, block.blockStateID);
-    } catch (const std::out_of_range& e) {
-        logMessage("notifyChunkUpdate: " + std::string(e.what()), LOG_ERROR);
-        writeVarInt(packetData, 0); // Default to air if out of range
-    }
-
-    // Determine which chunks are affected (in this case, only the chunk of the block)
-
-    // Broadcast to all players viewing this chunk
-    {
-        ChunkCoordinates chunkCoords{chunk->chunkX, chunk->chunkZ};
-        std::lock_guard lock(chunkViewersMutex);
-        auto it = chunkViewersMap.find(chunkCoords);
-        if (it != chunkViewersMap.end()) {
-            for (const auto& player : it->second) {
-                sendPacket(*player->client, packetData);
-            }
-        }
-    }
+    // The light around the block is updated at the end of the tick
+    lightEngine.blockChanged(x, y, z);
 }
 
-void sendChunkDataToPlayer(ClientConnection& client, const std::shared_ptr<Chunk>& chunk) {
-    std::vector<uint8_t> packetData;
-    packetData.push_back(0x27); // Packet ID for Chunk Data
+PacketWriter buildChunkDataPacket(const std::shared_ptr<Chunk>& chunk) {
+    PacketWriter packetData(0x27); // Packet ID for Chunk Data
+    packetData.compressionClass = CompressionClass::Chunk;
 
     // Chunk X and Z
     writeInt(packetData, chunk->chunkX);
@@ -849,14 +843,81 @@ void sendChunkDataToPlayer(ClientConnection& client, const std::shared_ptr<Chunk
     // Serialize the chunk data using the updated function
     std::vector<uint8_t> serializedChunkData = serializeChunkData(chunk);
     writeBytes(packetData, serializedChunkData);
+    return packetData;
+}
+
+std::shared_ptr<const CachedPacket> getChunkDataPacket(const std::shared_ptr<Chunk>& chunk) {
+    // Viewers loading the same chunk at once wait for a single build
+    std::lock_guard lock(chunk->packetMutex);
+    uint64_t version = chunk->version.load(std::memory_order_acquire);
+    if (chunk->packet && chunk->packetVersion == version) {
+        chunkPacketCacheStats.hits.fetch_add(1, std::memory_order_relaxed);
+        return chunk->packet;
+    }
+    chunkPacketCacheStats.misses.fetch_add(1, std::memory_order_relaxed);
+
+    PacketWriter packet;
+    {
+        // Keep block changes out while the sections are serialized
+        std::lock_guard chunkLock(chunk->mutex);
+        version = chunk->version.load(std::memory_order_acquire);
+        packet = buildChunkDataPacket(chunk);
+    }
+    // Joined players all have compression enabled if the server uses it, only that frame is kept
+    chunk->packet = std::make_shared<const CachedPacket>(packet, serverConfig.enableCompression);
+    chunk->packetVersion = version;
+    chunk->packetBytes.store(chunk->packet->frame(true).size() + chunk->packet->frame(false).size(), std::memory_order_relaxed);
+    return chunk->packet;
+}
 
-    // Send the packet to the player
-    sendPacket(client, packetData);
+void sendChunkDataToPlayer(ClientConnection& client, const std::shared_ptr<Chunk>& chunk) {
+    std::shared_ptr<const CachedPacket> cached = getChunkDataPacket(chunk);
+    if (cached->frame(client.compressionEnabled).empty()) {
+        // Connection in the other compression state (or encoding failed)
+        sendPacket(client, buildChunkDataPacket(chunk));
+        return;
+    }
+    sendCachedPacket(client, *cached);
 }
 
-std::shared_ptr<Chunk> generateFlatChunk(const FlatWorldSettings& settings, int32_t chunkX, int32_t chunkZ, int& highestY) {
-    // Create a new Chunk object
-    std::shared_ptr<Chunk> flatChunk = std::make_shared<Chunk>(chunkX, chunkZ);
+void reportChunkPacketCache() {
+    static uint64_t lastHits = 0;
+    static uint64_t lastMisses = 0;
+    uint64_t hits = chunkPacketCacheStats.hits.load(std::memory_order_relaxed);
+    uint64_t misses = chunkPacketCacheStats.misses.load(std::memory_order_relaxed);
+    uint64_t requests = (hits - lastHits) + (misses - lastMisses);
+    if (requests > 0) {
+        logMessage("Chunk packet cache: " + std::to_string(requests) + " requests, "
+                   + std::to_string((hits - lastHits) * 100 / requests) + "% hits ("
+                   + std::to_string(hits) + " hits, " + std::to_string(misses) + " misses since startup)", LOG_DEBUG);
+    }
+    lastHits = hits;
+    lastMisses = misses;
+}
+
+namespace {
+    struct FlatTemplate {
+        std::string key;
+        ChunkSections sections;
+        Heightmaps heightmaps;
+        int highestY;
+    };
+    std::mutex flatTemplatesMutex;
+    std::vector<FlatTemplate> flatTemplates;
+
+    // Identifies the chunk a preset generates
+    std::string flatTemplateKey(const FlatWorldSettings& settings) {
+        std::string key = settings.biome;
+        for (const auto& layer : settings.layers) {
+            key += ";" + layer.block + "*" + std::to_string(layer.height);
+        }
+        return key;
+    }
+}
+
+// Builds the sections every chunk of a flat preset shares
+ChunkSections buildFlatSections(const FlatWorldSettings& settings, int& highestY) {
+    ChunkSections sections;
 
     // Initialize variables to track the current height
     int currentHeight = 0;
@@ -864,7 +925,7 @@ std::shared_ptr<Chunk> generateFlatChunk(const FlatWorldSettings& settings, int3
 
     // Initialize all sections as empty initially
     for (int sectionIdx = 0; sectionIdx < NUM_SECTIONS; ++sectionIdx) {
-        flatChunk->sections[sectionIdx].emplace();
+        sections[sectionIdx] = std::make_shared<MemChunkSection>();
     }
 
     // Iterate through each layer in the flat world settings
@@ -893,11 +954,10 @@ std::shared_ptr<Chunk> generateFlatChunk(const FlatWorldSettings& settings, int3
             }
 
             // Get the section or create it if it doesn't exist
-            auto& sectionOpt = flatChunk->sections[sectionIndex];
-            MemChunkSection& section = sectionOpt.value();
+            MemChunkSection& section = *sections[sectionIndex];
 
             // Add the block to the palette and get its palette index
-            uint8_t paletteIndex = section.palette.getIndex(blocks[stripNamespace(layer.block)].defaultState);
+            uint32_t paletteIndex = section.palette.getIndex(blocks[stripNamespace(layer.block)].defaultState);
 
             // Iterate through each block in the X and Z dimensions
             for (int z = 0; z < CHUNK_LENGTH; ++z) {
@@ -920,12 +980,12 @@ std::shared_ptr<Chunk> generateFlatChunk(const FlatWorldSettings& settings, int3
 
     // Finalize each section (e.g., bit-packing, palette finalization)
     for (int sectionIdx = 0; sectionIdx < NUM_SECTIONS; ++sectionIdx) {
-        auto& sectionOpt = flatChunk->sections[sectionIdx];
-        if (!sectionOpt.has_value()) {
+        auto& sectionPtr = sections[sectionIdx];
+        if (!sectionPtr) {
             continue; // Skip empty sections
         }
 
-        MemChunkSection& section = sectionOpt.value();
+        MemChunkSection& section = *sectionPtr;
 
         // Assign biome
         int defaultBiomeID = biomes[stripNamespace(settings.biome)].id;
@@ -941,38 +1001,210 @@ std::shared_ptr<Chunk> generateFlatChunk(const FlatWorldSettings& settings, int3
 
         // Finalize the section
         section.finalize();
+    }
+
+    // Every column is the same, so the light computed for one chunk holds for all of them
+    lightEngine.lightSections(sections);
 
-        // TODO: Calculate lighting
+    return sections;
+}
+
+std::shared_ptr<Chunk> generateFlatChunk(const FlatWorldSettings& settings, int32_t chunkX, int32_t chunkZ, int& highestY) {
+    std::shared_ptr<Chunk> flatChunk = std::make_shared<Chunk>(chunkX, chunkZ);
+    std::string key = flatTemplateKey(settings);
+
+    std::lock_guard lock(flatTemplatesMutex);
+    auto it = std::ranges::find(flatTemplates, key, &FlatTemplate::key);
+    if (it == flatTemplates.end()) {
+        // Every chunk of a preset is the same, it is only generated once
+        FlatTemplate flatTemplate{key, {}, {}, 0};
+        flatTemplate.sections = buildFlatSections(settings, flatTemplate.highestY);
+        flatTemplate.heightmaps = computeHeightmaps(flatTemplate.sections);
+        flatTemplates.push_back(std::move(flatTemplate));
+        it = std::prev(flatTemplates.end());
     }
 
-    // TODO: Calculate heightmaps
+    // The sections are shared until setBlock first changes them
+    flatChunk->sections = it->sections;
+    flatChunk->sharedSections.set();
+    flatChunk->heightmaps = it->heightmaps;
+    highestY = it->highestY;
 
     return flatChunk;
 }
 
-std::vector<int32_t> unpackPackedData(const std::vector<uint64_t>& packedData, int bitsPerEntry, size_t expectedCount) {
-    if (bitsPerEntry > 32) throw std::runtime_error("bitsPerEntry exceeds 32");
+namespace {
+    // Biome palette entries from disk, names the server doesn't know become the first biome
+    int32_t biomeFor(std::string_view name) {
+        auto it = biomes.find(stripNamespace(std::string(name)));
+        return it != biomes.end() ? it->second.id : 0;
+    }
 
-    std::vector<int32_t> indices;
-    indices.reserve(expectedCount);
+    int sectionIndexOf(int sectionY) {
+        int sectionIndex = sectionY - MIN_Y / SECTION_HEIGHT;
+        if (sectionIndex < 0 || sectionIndex >= NUM_SECTIONS) {
+            logMessage("Invalid sectionY: " + std::to_string(sectionY), LOG_ERROR);
+            return -1;
+        }
+        return sectionIndex;
+    }
+}
 
-    // Calculate how many indices can fit into a single 64-bit word
-    int indicesPerWord = 64 / bitsPerEntry;
+void finishBlockStates(MemChunkSection& section, std::vector<uint64_t>&& data, int sectionY) {
+    // Anvil packs the indices exactly like we do, so the long array is taken as is
+    section.bitsPerEntry = calculateBitsPerEntry(section.palette);
+    if (!data.empty()) {
+        if (data.size() == packedLongCount(SECTION_VOLUME, section.bitsPerEntry)) {
+            section.blockIndices = std::move(data);
+        } else {
+            logMessage("Block states of section " + std::to_string(sectionY) + " have " + std::to_string(data.size()) + " longs, ignoring them", LOG_WARNING);
+        }
+    }
 
-    for (const auto& word : packedData) {
-        // Extract only the full indices that fit into the word
-        for (int i = 0; i < indicesPerWord; ++i) {
-            if (indices.size() >= expectedCount) break;
-            int32_t index = (word >> (i * bitsPerEntry)) & ((1ULL << bitsPerEntry) - 1);
-            indices.push_back(index);
+    // Count the non-air blocks, indices outside the palette become the first palette entry
+    const auto& states = section.palette.indexToBlockState;
+    if (!states.empty()) {
+        for (int i = 0; i < SECTION_VOLUME; ++i) {
+            uint32_t index = section.getBlockIndex(i);
+            if (index >= states.size()) {
+                index = 0;
+                section.setBlockIndex(i, index);
+            }
+            if (isWorldSurface(states[index])) {
+                section.blockCount++;
+            }
         }
     }
+    section.isEmpty = section.blockCount == 0;
+
+    // Anvil keeps large palettes, the protocol wants global state IDs instead
+    if (section.bitsPerEntry > MAX_INDIRECT_BLOCK_BITS) {
+        section.growBitsPerEntry(section.bitsPerEntry);
+    }
+}
 
-    if (indices.size() != expectedCount) {
-        throw std::runtime_error("Unpacked data size does not match expected count");
+void finishBiomes(MemChunkSection& section, std::vector<uint64_t>&& data) {
+    section.biomeBitsPerEntry = section.biomePalette.size() > 1 ? calculateBitsPerEntry(section.biomePalette, 1) : 0;
+    if (section.biomeBitsPerEntry > 0 && data.size() == packedLongCount(SECTION_BIOMES, section.biomeBitsPerEntry)) {
+        section.biomeIndices = std::move(data);
+    } else {
+        section.biomeBitsPerEntry = 0; // Fall back to the first biome
     }
+    makeBiomesDirect(section);
+}
 
-    return indices;
+std::shared_ptr<Chunk> decodeChunk(int chunkX, int chunkZ, std::span<const uint8_t> nbtData) {
+    std::shared_ptr<Chunk> chunk = std::make_shared<Chunk>(chunkX, chunkZ);
+    std::bitset<NUM_SECTIONS> storedSections;
+    bool lightValid = true;
+    bool lightOn = false;
+    NbtReader reader(nbtData);
+    reader.readRootCompound();
+
+    // Reads a palette of block_states or biomes together with its data, which may come in either order
+    auto readContainer = [&](Palette& palette, std::vector<uint64_t>& data, bool blockPalette) {
+        reader.readCompound([&](uint8_t type, std::string_view name) {
+            if (name == "palette" && type == TAG_LIST) {
+                reader.readList([&](uint8_t elementType) {
+                    if (!blockPalette && elementType == TAG_STRING) {
+                        palette.add(biomeFor(reader.readString()));
+                    } else if (blockPalette && elementType == TAG_COMPOUND) {
+                        // Name and Properties may come in either order, the properties are views into the buffer
+                        std::string_view blockName;
+                        std::array<BlockProperty, 16> properties;
+                        size_t propertyCount = 0;
+                        reader.readCompound([&](uint8_t entryType, std::string_view entryName) {
+                            if (entryName == "Name" && entryType == TAG_STRING) {
+                                blockName = reader.readString();
+                            } else if (entryName == "Properties" && entryType == TAG_COMPOUND) {
+                                reader.readCompound([&](uint8_t propertyType, std::string_view propertyName) {
+                                    if (propertyType == TAG_STRING && propertyCount < properties.size()) {
+                                        properties[propertyCount++] = {propertyName, reader.readString()};
+                                    } else {
+                                        reader.skip(propertyType);
+                                    }
+                                });
+                            } else {
+                                reader.skip(entryType);
+                            }
+                        });
+                        palette.add(blockStateIndex.resolve(blockName, std::span(properties.data(), propertyCount)));
+                    } else {
+                        reader.skip(elementType);
+                    }
+                });
+            } else if (name == "data" && type == TAG_LONG_ARRAY) {
+                reader.readLongArray(data);
+            } else {
+                reader.skip(type);
+            }
+        });
+    };
+
+    auto readSection = [&] {
+        MemChunkSection section;
+        section.isEmpty = true;
+        int sectionY = 0;
+        bool hasY = false, hasBlocks = false, hasBiomes = false;
+        std::vector<uint64_t> blockData, biomeData;
+
+        reader.readCompound([&](uint8_t type, std::string_view name) {
+            if (name == "Y") {
+                sectionY = static_cast<int>(reader.readInteger(type));
+                hasY = true;
+            } else if (name == "block_states" && type == TAG_COMPOUND) {
+                readContainer(section.palette, blockData, true);
+                hasBlocks = true;
+            } else if (name == "biomes" && type == TAG_COMPOUND) {
+                readContainer(section.biomePalette, biomeData, false);
+                hasBiomes = true;
+            } else if ((name == "BlockLight" || name == "SkyLight") && type == TAG_BYTE_ARRAY) {
+                // Arrays of any other size are not trusted
+                std::span<const uint8_t> stored = reader.readByteArray();
+                if (stored.size() == LIGHT_ARRAY_SIZE) {
+                    (name == "BlockLight" ? section.lighting.blockLight : section.lighting.skyLight).assign(stored.begin(), stored.end());
+                } else {
+                    lightValid = false;
+                }
+            } else {
+                reader.skip(type);
+            }
+        });
+
+        int sectionIndex = hasY ? sectionIndexOf(sectionY) : -1;
+        if (sectionIndex < 0) {
+            return;
+        }
+        if (hasBlocks) {
+            finishBlockStates(section, std::move(blockData), sectionY);
+        }
+        if (hasBiomes) {
+            finishBiomes(section, std::move(biomeData));
+        }
+        storedSections.set(sectionIndex);
+        chunk->sections[sectionIndex] = std::make_shared<MemChunkSection>(std::move(section));
+    };
+
+    reader.readCompound([&](uint8_t type, std::string_view name) {
+        if (name == "sections" && type == TAG_LIST) {
+            reader.readList([&](uint8_t elementType) {
+                if (elementType == TAG_COMPOUND) {
+                    readSection();
+                } else {
+                    reader.skip(elementType);
+                }
+            });
+        } else if (name == "isLightOn" && type == TAG_BYTE) {
+            lightOn = reader.readByte() != 0;
+        } else {
+            // Heightmaps are computed from the blocks instead, the stored ones may be missing or stale
+            reader.skip(type);
+        }
+    });
+    // Light is only used when the chunk says it is complete (the flag vanilla writes too) and no section is missing
+    chunk->lightStored = lightOn && lightValid && storedSections.all();
+    chunk->heightmaps = computeHeightmaps(chunk->sections);
+    return chunk;
 }
 
 std::shared_ptr<Chunk> loadChunkFromDisk(int chunkX, int chunkZ) {
@@ -984,207 +1216,426 @@ std::shared_ptr<Chunk> loadChunkFromDisk(int chunkX, int chunkZ) {
     int localX = chunkX & 31;
     int localZ = chunkZ & 31;
 
-    // Construct the region file path
-    std::filesystem::path regionPath = "world/region/r." + std::to_string(regionX) + "." + std::to_string(regionZ) + ".mca"; // Replace with actual path
-
-    // Check if the region file exists
-    if (!exists(regionPath)) {
+    // The region file stays open for the next chunk of the same region
+    std::shared_ptr<RegionFile> regionFile = regionFiles.get(regionX, regionZ, false);
+    if (!regionFile) {
         return nullptr;
     }
 
-    // Open the region file
-    RegionFile regionFile(regionPath, true);
-
     // Load the chunk
-    std::optional<ChunkData> chunkDataOpt = regionFile.loadChunk(localX, localZ, regionX, regionZ);
-    if (!chunkDataOpt.has_value()) {
+    std::optional<std::vector<uint8_t>> nbtData = regionFile->readChunkNBT(localX, localZ);
+    if (!nbtData.has_value()) {
         logMessage("Chunk (" + std::to_string(chunkX) + ", " + std::to_string(chunkZ) + ") not found in region file.", LOG_WARNING);
         return nullptr;
     }
 
-    // Extract ChunkData
-    ChunkData chunkData = chunkDataOpt.value();
-
-    // Create a new Chunk object
-    std::shared_ptr<Chunk> chunk = std::make_shared<Chunk>(chunkX, chunkZ);
-
-    // Extract Sections from NBT
-    if (chunkData.nbt.has_key("sections")) {
-        const nbt::tag_list& sectionsList = chunkData.nbt["sections"].as<nbt::tag_list>();
-        for (const auto& sectionTag : sectionsList) {
-            const auto& sectionCompound = sectionTag.as<nbt::tag_compound>();
-            int8_t sectionY = sectionCompound.at("Y").as<nbt::tag_byte>().get();
-
-            // Calculate the section index
-            int sectionIndex = sectionY - MIN_Y / SECTION_HEIGHT;
-            if (sectionIndex < 0 || sectionIndex >= NUM_SECTIONS) {
-                logMessage("Invalid sectionY: " + std::to_string(static_cast<int>(sectionY)), LOG_ERROR);
-                continue;
-            }
-
-            MemChunkSection section;
-            section.isEmpty = true;
+    try {
+        return decodeChunk(chunkX, chunkZ, *nbtData);
+    } catch (const std::exception& e) {
+        logMessage("Failed to decode chunk (" + std::to_string(chunkX) + ", " + std::to_string(chunkZ) + "): " + e.what(), LOG_ERROR);
+        return nullptr;
+    }
+}
 
-            // Extract block_states
-            if (sectionCompound.has_key("block_states")) {
-                const auto& blockStatesCompound = sectionCompound.at("block_states").as<nbt::tag_compound>();
+int64_t chunkClock() {
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
 
-                // Extract block palette
-                if (blockStatesCompound.has_key("palette")) {
-                    const auto& paletteList = blockStatesCompound.at("palette").as<nbt::tag_list>();
-                    for (const auto& paletteEntry : paletteList) {
-                        const std::string& blockName = paletteEntry.as<nbt::tag_compound>().at("Name").as<nbt::tag_string>().get();
-                        int32_t blockStateID = blocks[stripNamespace(blockName)].defaultState;
-                        section.palette.getIndex(blockStateID); // Populate the palette
-                    }
-                }
+std::shared_ptr<Chunk> getOrLoadChunk(int32_t chunkX, int32_t chunkZ) {
+    if (std::shared_ptr<Chunk> chunk = globalChunkMap.find(chunkX, chunkZ)) {
+        chunk->lastUsed.store(chunkClock(), std::memory_order_relaxed);
+        return chunk;
+    }
 
-                // Extract block states data
-                if (blockStatesCompound.has_key("data")) {
-                    const auto& dataTag = blockStatesCompound.at("data").as<nbt::tag_long_array>();
-                    const std::vector<int64_t>& packedData = dataTag.get();
+    ChunkCoordinates coords{chunkX, chunkZ};
+    {
+        std::lock_guard lock(chunksBeingSavedMutex);
+        // It may have been loaded or revived while we waited for the lock
+        if (std::shared_ptr<Chunk> chunk = globalChunkMap.find(chunkX, chunkZ)) {
+            chunk->lastUsed.store(chunkClock(), std::memory_order_relaxed);
+            return chunk;
+        }
+        // Unloaded but not written yet, the copy on disk would be stale
+        auto saving = chunksBeingSaved.find(coords);
+        if (saving != chunksBeingSaved.end()) {
+            std::shared_ptr<Chunk> chunk = saving->second;
+            chunksBeingSaved.erase(saving);
+            chunk->lastUsed.store(chunkClock(), std::memory_order_relaxed);
+            return globalChunkMap.insert(chunk);
+        }
+    }
 
-                    // Convert packedData from signed chars to uint64_t
-                    std::vector<uint64_t> packedData64;
-                    packedData64.reserve(packedData.size());
-                    for (const auto& val : packedData) {
-                        packedData64.push_back(static_cast<uint64_t>(val));
-                    }
+    // Load or generate the chunk without holding any lock to prevent blocking other threads
+    std::shared_ptr<Chunk> chunk = loadChunkFromDisk(chunkX, chunkZ);
+    bool fromDisk = chunk != nullptr;
+    if (chunk) {
+        // Chunks saved without complete light are lit by the loader thread, on their own
+        if (!chunk->lightStored) {
+            lightEngine.lightSections(chunk->sections);
+        }
+    } else {
+        if (serverConfig.worldType == "flat") {
+            int highestY;
+            const FlatWorldSettings& settings = flatWorldPresets[serverConfig.flatWorldPreset];
+            chunk = generateFlatChunk(settings, chunkX, chunkZ, highestY);
+        }
+    }
+    if (!chunk) {
+        return nullptr;
+    }
+    chunk->lastUsed.store(chunkClock(), std::memory_order_relaxed);
+
+    // Another thread may have loaded it meanwhile, everyone has to use the same instance
+    std::shared_ptr<Chunk> loaded = globalChunkMap.insert(chunk);
+    if (loaded == chunk && fromDisk) {
+        // Its light and that of the loaded neighbours spread into each other at the end of the tick. Generated flat
+        // chunks are all lit alike, their edges already match.
+        lightEngine.chunkLoaded(chunkX, chunkZ);
+    }
+    return loaded;
+}
 
-                    // Determine bits per entry
-                    int bitsPerEntry = calculateBitsPerEntry(section.palette);
+bool sendCurrentChunkToPlayer(ClientConnection& client, int chunkX, int chunkZ) {
+    auto currentChunk = getOrLoadChunk(chunkX, chunkZ);
+    if (!currentChunk) {
+        logMessage("Failed to load or generate current chunk for player.", LOG_ERROR);
+        return false;
+    }
 
-                    // Unpack block states
-                    std::vector<int32_t> blockStates = unpackPackedData(packedData64, bitsPerEntry, CHUNK_WIDTH * CHUNK_LENGTH * SECTION_HEIGHT);
+    // Serialize and send the current chunk
+    sendChunkDataToPlayer(client, currentChunk);
+    return true;
+}
 
-                    // Assign blockStateIDs to the section
-                    for (const auto& index : blockStates) {
-                        if (index >= section.palette.indexToBlockState.size()) {
-                            section.tempBlockIndices.push_back(0); // Air
-                        } else {
-                            if (isWorldSurface(section.palette.indexToBlockState[index])) {
-                                section.blockCount++;
-                                section.isEmpty = false;
-                            }
-                            section.tempBlockIndices.push_back(static_cast<uint8_t>(index));
+size_t Chunk::memoryUsage() {
+    size_t bytes = sizeof(Chunk) + packetBytes.load(std::memory_order_relaxed);
+    std::lock_guard lock(mutex);
+    for (size_t i = 0; i < sections.size(); ++i) {
+        const auto& section = sections[i];
+        if (!section || sharedSections.test(i)) {
+            continue; // Template sections belong to no chunk in particular
+        }
+        bytes += sizeof(MemChunkSection)
+                 + (section->blockIndices.capacity() + section->biomeIndices.capacity()) * sizeof(uint64_t)
+                 + (section->palette.indexToBlockState.capacity() + section->biomePalette.indexToBlockState.capacity()) * sizeof(int32_t)
+                 + section->palette.blockStateToIndex.size() * 32
+                 + section->lighting.blockLight.capacity() + section->lighting.skyLight.capacity();
+    }
+    for (const auto& heightmap : heightmaps.packed) {
+        bytes += heightmap.capacity() * sizeof(uint64_t);
+    }
+    return bytes;
+}
 
-                        }
-                    }
+namespace {
+    // Names of the biomes by ID, for writing palettes to disk
+    const std::vector<const std::string*>& biomeNames() {
+        static const std::vector<const std::string*> names = [] {
+            std::vector<const std::string*> result;
+            for (const auto& [name, biome] : biomes) {
+                if (biome.id >= static_cast<int>(result.size())) {
+                    result.resize(biome.id + 1, nullptr);
                 }
+                result[biome.id] = &name;
             }
+            return result;
+        }();
+        return names;
+    }
 
+    std::string namespacedName(const std::vector<const std::string*>& names, int32_t id, const std::string& fallback) {
+        if (id >= 0 && id < static_cast<int32_t>(names.size()) && names[id]) {
+            return "minecraft:" + *names[id];
+        }
+        return "minecraft:" + fallback;
+    }
 
-            // Extract Biomes (if stored per section; otherwise, handle separately)
-            if (sectionCompound.has_key("biomes")) {
-                const auto& biomesCompound = sectionCompound.at("biomes").as<nbt::tag_compound>();
+    // Palette and data in Anvil's layout: always a palette, at least minBits per entry
+    void toAnvilContainer(const Palette& palette, const std::vector<uint64_t>& packed, int bitsPerEntry, int count, int minBits,
+                          std::vector<int32_t>& values, std::vector<uint64_t>& data) {
+        if (!palette.direct && calculateBitsPerEntry(palette, minBits) == bitsPerEntry) {
+            values = palette.indexToBlockState;
+            data = packed;
+            if (data.empty() && values.size() > 1) {
+                data.assign(packedLongCount(count, bitsPerEntry), 0);
+            }
+            return;
+        }
+        Palette compacted;
+        std::vector<uint32_t> indices(count);
+        for (int i = 0; i < count; ++i) {
+            uint32_t index = unpackEntry(packed, bitsPerEntry, i);
+            bool valid = palette.direct || index < palette.size();
+            indices[i] = compacted.getIndex(valid ? palette.valueAt(index) : palette.valueAt(0));
+        }
+        values = compacted.indexToBlockState;
+        if (values.size() > 1) {
+            data = packIndices(indices, calculateBitsPerEntry(compacted, minBits));
+        } else {
+            data.clear();
+        }
+    }
+}
 
-                // Extract biome palette
-                if (biomesCompound.has_key("palette")) {
-                    const auto& biomePaletteList = biomesCompound.at("palette").as<nbt::tag_list>();
-                    for (const auto& biomeEntry : biomePaletteList) {
-                        const std::string& biomeName = biomeEntry.as<nbt::tag_string>().get();
-                        int32_t biomeID = biomes[stripNamespace(biomeName)].id;
-                        section.biomePalette.getIndex(biomeID); // Populate the biome palette
-                    }
+nbt::tag_compound serializeChunkNBT(const Chunk& chunk) {
+    const std::string air = "air";
+    nbt::tag_compound root;
+    root["DataVersion"] = nbt::tag_int(ANVIL_DATA_VERSION);
+    root["xPos"] = nbt::tag_int(chunk.chunkX);
+    root["zPos"] = nbt::tag_int(chunk.chunkZ);
+    root["yPos"] = nbt::tag_int(MIN_Y / SECTION_HEIGHT);
+    root["Status"] = nbt::tag_string("minecraft:full");
+    root["LastUpdate"] = nbt::tag_long(0);
+    root["InhabitedTime"] = nbt::tag_long(0);
+    // Every section is stored with its light, it is read back instead of computed again
+    root["isLightOn"] = nbt::tag_byte(1);
+
+    nbt::tag_list sectionsList(nbt::tag_type::Compound);
+    for (int i = 0; i < NUM_SECTIONS; ++i) {
+        const auto& section = chunk.sections[i];
+        if (!section) {
+            continue;
+        }
+        nbt::tag_compound sectionCompound;
+        sectionCompound["Y"] = nbt::tag_byte(static_cast<int8_t>(i + MIN_Y / SECTION_HEIGHT));
+
+        // Block states by name and properties
+        std::vector<int32_t> states;
+        std::vector<uint64_t> data;
+        if (section->palette.size() == 0 && !section->palette.direct) {
+            states = {blocks[air].defaultState};
+        } else {
+            toAnvilContainer(section->palette, section->blockIndices, section->bitsPerEntry, SECTION_VOLUME, 4, states, data);
+        }
+        nbt::tag_compound blockStates;
+        nbt::tag_list blockPalette(nbt::tag_type::Compound);
+        std::vector<BlockProperty> properties;
+        for (int32_t state : states) {
+            nbt::tag_compound entry;
+            const BlockStateLayout* block = blockStateIndex.describe(state, properties);
+            entry["Name"] = nbt::tag_string("minecraft:" + std::string(block ? block->name : air));
+            if (!properties.empty()) {
+                nbt::tag_compound propertyCompound;
+                for (const auto& [key, value] : properties) {
+                    propertyCompound[std::string(key)] = nbt::tag_string(std::string(value));
                 }
+                entry["Properties"] = std::move(propertyCompound);
+            }
+            blockPalette.push_back(std::move(entry));
+        }
+        blockStates["palette"] = std::move(blockPalette);
+        if (!data.empty()) {
+            blockStates["data"] = nbt::tag_long_array(std::vector<int64_t>(data.begin(), data.end()));
+        }
+        sectionCompound["block_states"] = std::move(blockStates);
 
-                // Extract biomes data
-                if (biomesCompound.has_key("data")) {
-                    const auto& dataTag = biomesCompound.at("data").as<nbt::tag_long_array>();
-                    const std::vector<int64_t>& packedData = dataTag.get();
-
-                    // Convert packedData from signed chars to uint64_t
-                    std::vector<uint64_t> packedData64;
-                    packedData64.reserve(packedData.size());
-                    for (const auto& val : packedData) {
-                        packedData64.push_back(static_cast<uint64_t>(val));
-                    }
-
-                    // Determine bits per entry
-                    int bitsPerEntryBiome = calculateBitsPerEntry(section.biomePalette, 1);
+        // Biomes
+        std::vector<int32_t> biomeIDs;
+        std::vector<uint64_t> biomeData;
+        if (section->biomeBitsPerEntry == 0) {
+            biomeIDs = {section->biomePalette.size() > 0 ? section->biomePalette.valueAt(0) : 0};
+        } else {
+            toAnvilContainer(section->biomePalette, section->biomeIndices, section->biomeBitsPerEntry, SECTION_BIOMES, 1, biomeIDs, biomeData);
+        }
+        nbt::tag_compound biomesCompound;
+        nbt::tag_list biomePalette(nbt::tag_type::String);
+        for (int32_t biome : biomeIDs) {
+            biomePalette.push_back(nbt::tag_string(namespacedName(biomeNames(), biome, "plains")));
+        }
+        biomesCompound["palette"] = std::move(biomePalette);
+        if (!biomeData.empty()) {
+            biomesCompound["data"] = nbt::tag_long_array(std::vector<int64_t>(biomeData.begin(), biomeData.end()));
+        }
+        sectionCompound["biomes"] = std::move(biomesCompound);
 
-                    // Unpack biomes
-                    std::vector<int32_t> biomeIndices = unpackPackedData(packedData64, bitsPerEntryBiome, CHUNK_WIDTH / 4 * CHUNK_LENGTH / 4 * CHUNK_LENGTH / 4);
+        // Lighting
+        const Lighting& lighting = section->lighting;
+        if (!lighting.blockLight.empty()) {
+            sectionCompound["BlockLight"] = nbt::tag_byte_array(std::vector<int8_t>(lighting.blockLight.begin(), lighting.blockLight.end()));
+        }
+        if (!lighting.skyLight.empty()) {
+            sectionCompound["SkyLight"] = nbt::tag_byte_array(std::vector<int8_t>(lighting.skyLight.begin(), lighting.skyLight.end()));
+        }
+        sectionsList.push_back(std::move(sectionCompound));
+    }
+    root["sections"] = std::move(sectionsList);
 
-                    // Assign biome indices to the section
-                    for (const auto& index : biomeIndices) {
-                        if (index >= section.biomePalette.indexToBlockState.size()) {
-                            section.tempBiomeIndices.push_back(0); // Default biome ID
-                        } else {
-                            section.tempBiomeIndices.push_back(static_cast<uint8_t>(index));
-                        }
-                    }
-                } else {
-                    // 1 biome fills the entire section
-                    section.tempBiomeIndices.push_back(section.biomePalette.indexToBlockState[0]);
-                }
-            }
+    nbt::tag_compound heightmapsCompound;
+    for (int type = 0; type < Heightmaps::TYPE_COUNT; ++type) {
+        const auto& longs = chunk.heightmaps.packed[type];
+        if (!longs.empty()) {
+            heightmapsCompound[Heightmaps::NAMES[type]] = nbt::tag_long_array(std::vector<int64_t>(longs.begin(), longs.end()));
+        }
+    }
+    root["Heightmaps"] = std::move(heightmapsCompound);
+    root["block_entities"] = nbt::tag_list(nbt::tag_type::Compound);
+    return root;
+}
 
-            // Extract Lighting
-            Lighting lighting;
-            if (sectionCompound.has_key("BlockLight")) {
-                const auto& blockLightTag = sectionCompound.at("BlockLight").as<nbt::tag_byte_array>();
-                lighting.blockLight = std::vector<uint8_t>(blockLightTag.get().begin(), blockLightTag.get().end());
-            }
-            if (sectionCompound.has_key("SkyLight")) {
-                const auto& skyLightTag = sectionCompound.at("SkyLight").as<nbt::tag_byte_array>();
-                lighting.skyLight = std::vector<uint8_t>(skyLightTag.get().begin(), skyLightTag.get().end());
+ChunkSaveStats saveChunks(const std::vector<std::shared_ptr<Chunk>>& chunks, RegionFileCache& cache) {
+    auto start = std::chrono::steady_clock::now();
+    ChunkSaveStats stats;
+
+    // Chunks written to each region file, they only count as saved once the file is synced
+    std::vector<std::pair<std::shared_ptr<RegionFile>, std::vector<std::shared_ptr<Chunk>>>> written;
+    for (const auto& chunk : chunks) {
+        ChunkData chunkData;
+        {
+            // Block changes wait while the chunk is converted, later ones mark it dirty again
+            std::lock_guard lock(chunk->mutex);
+            if (!chunk->dirty) {
+                continue;
             }
-            section.lighting = lighting;
-
-            // Finalize indices
-            section.finalize();
+            chunkData.nbt = serializeChunkNBT(*chunk);
+            chunk->dirty = false;
+            chunk->savesInFlight.fetch_add(1);
+        }
 
-            // Assign Blocks to Chunk
-            chunk->sections[sectionIndex] = section;
+        int regionX = chunk->chunkX >> 5;
+        int regionZ = chunk->chunkZ >> 5;
+        std::shared_ptr<RegionFile> regionFile = cache.get(regionX, regionZ, true);
+        if (!regionFile || !regionFile->saveChunk(chunk->chunkX & 31, chunk->chunkZ & 31, regionX, regionZ, chunkData)) {
+            logMessage("Failed to save chunk (" + std::to_string(chunk->chunkX) + ", " + std::to_string(chunk->chunkZ) + ")", LOG_ERROR);
+            chunk->markDirty();
+            chunk->savesInFlight.fetch_sub(1);
+            ++stats.failed;
+            continue;
         }
+        auto region = std::ranges::find(written, regionFile, &decltype(written)::value_type::first);
+        if (region == written.end()) {
+            written.emplace_back(regionFile, std::vector<std::shared_ptr<Chunk>>{});
+            region = std::prev(written.end());
+        }
+        region->second.push_back(chunk);
     }
 
-    // Assign Heightmaps
-    chunk->heightmaps = chunkData.heightmaps;
-
-    return chunk;
+    for (auto& [regionFile, regionChunks] : written) {
+        bool flushed = regionFile->flush();
+        for (const auto& chunk : regionChunks) {
+            if (!flushed) {
+                chunk->markDirty();
+            }
+            chunk->savesInFlight.fetch_sub(1);
+        }
+        if (flushed) {
+            stats.saved += regionChunks.size();
+            stats.savedChunks.insert(stats.savedChunks.end(), regionChunks.begin(), regionChunks.end());
+        } else {
+            stats.failed += regionChunks.size();
+        }
+    }
+    stats.regions = written.size();
+    stats.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return stats;
 }
 
-std::shared_ptr<Chunk> getOrLoadChunk(int32_t chunkX, int32_t chunkZ) {
-    ChunkCoordinates coords{chunkX, chunkZ};
-    {
-        std::lock_guard lock(chunkMapMutex);
-        auto it = globalChunkMap.find(coords);
-        if (it != globalChunkMap.end()) {
-            return it->second;
+namespace {
+    // Drops the unloaded chunks whose save reached the disk. A chunk changed again meanwhile, or still being written
+    // by another save, stays until that save is done.
+    void forgetSavedChunks(const std::vector<std::shared_ptr<Chunk>>& savedChunks) {
+        std::lock_guard lock(chunksBeingSavedMutex);
+        for (const auto& chunk : savedChunks) {
+            auto it = chunksBeingSaved.find(ChunkCoordinates{chunk->chunkX, chunk->chunkZ});
+            if (it != chunksBeingSaved.end() && it->second == chunk && !chunk->dirty && chunk->savesInFlight.load() == 0) {
+                chunksBeingSaved.erase(it);
+            }
         }
     }
+}
 
-    // Load or generate the chunk outside the lock to prevent blocking other threads
-    std::shared_ptr<Chunk> chunk = loadChunkFromDisk(chunkX, chunkZ);
-    if (!chunk) {
-        if (serverConfig.worldType == "flat") {
-            int highestY;
-            FlatWorldSettings settings = flatWorldPresets[serverConfig.flatWorldPreset];
-            chunk = generateFlatChunk(settings, chunkX, chunkZ, highestY);
+ChunkSaveStats saveDirtyChunks() {
+    std::vector<std::shared_ptr<Chunk>> dirtyChunks;
+    for (auto& chunk : globalChunkMap.snapshot()) {
+        if (chunk->dirty) {
+            dirtyChunks.push_back(std::move(chunk));
         }
     }
-
+    // Unloaded ones whose save failed or is still queued
+    std::vector<std::shared_ptr<Chunk>> unloaded;
     {
-        std::lock_guard lock(chunkMapMutex);
-        globalChunkMap[coords] = chunk;
+        std::lock_guard lock(chunksBeingSavedMutex);
+        for (const auto& chunk : chunksBeingSaved | std::views::values) {
+            unloaded.push_back(chunk);
+        }
     }
+    dirtyChunks.insert(dirtyChunks.end(), unloaded.begin(), unloaded.end());
 
-    return chunk;
+    // An unload batch may be writing some of them at the same time, only the ones written here are known to be on disk
+    ChunkSaveStats stats = saveChunks(dirtyChunks);
+    forgetSavedChunks(stats.savedChunks);
+    return stats;
 }
 
-bool sendCurrentChunkToPlayer(ClientConnection& client, int chunkX, int chunkZ) {
-    auto currentChunk = getOrLoadChunk(chunkX, chunkZ);
-    if (!currentChunk) {
-        logMessage("Failed to load or generate current chunk for player.", LOG_ERROR);
-        return false;
+void unloadChunks() {
+    int64_t now = chunkClock();
+    int64_t unloadDelay = static_cast<int64_t>(serverConfig.chunkUnloadDelay) * 1000;
+
+    struct Candidate {
+        std::shared_ptr<Chunk> chunk;
+        int64_t lastUsed;
+        size_t bytes;
+    };
+    std::vector<Candidate> candidates;
+    std::vector<std::shared_ptr<Chunk>> toSave;
+    size_t unloaded = 0;
+
+    // Measured before the global locks are taken, each chunk is only locked while its own size is added up
+    std::vector<std::pair<std::shared_ptr<Chunk>, size_t>> loaded;
+    size_t totalBytes = 0;
+    for (auto& chunk : globalChunkMap.snapshot()) {
+        size_t bytes = chunk->memoryUsage();
+        totalBytes += bytes;
+        loaded.emplace_back(std::move(chunk), bytes);
     }
+    {
+        std::lock_guard viewersLock(chunkViewersMutex);
+        std::lock_guard savingLock(chunksBeingSavedMutex);
+
+        for (auto& [chunk, bytes] : loaded) {
+            // Chunks in a player's view stay, the unload delay starts once the last viewer left
+            ChunkCoordinates coords{chunk->chunkX, chunk->chunkZ};
+            auto viewers = chunkViewersMap.find(coords);
+            if (viewers != chunkViewersMap.end() && !viewers->second.empty()) {
+                chunk->lastUsed.store(now, std::memory_order_relaxed);
+                continue;
+            }
+            int64_t lastUsed = chunk->lastUsed.load(std::memory_order_relaxed);
+            candidates.push_back({std::move(chunk), lastUsed, bytes});
+        }
 
-    // Serialize and send the current chunk
-    sendChunkDataToPlayer(client, currentChunk);
+        // Least recently used first: expired chunks go anyway, the others only while over the memory budget
+        std::ranges::sort(candidates, {}, &Candidate::lastUsed);
+        for (const auto& candidate : candidates) {
+            bool expired = now - candidate.lastUsed >= unloadDelay;
+            if (!expired && totalBytes <= serverConfig.chunkMemoryBudget) {
+                break;
+            }
+            if (!globalChunkMap.erase(candidate.chunk)) {
+                continue;
+            }
+            ChunkCoordinates coords{candidate.chunk->chunkX, candidate.chunk->chunkZ};
+            chunkViewersMap.erase(coords);
+            totalBytes -= candidate.bytes;
+            ++unloaded;
+            if (candidate.chunk->dirty || candidate.chunk->savesInFlight.load() > 0) {
+                // A clean chunk an autosave is still writing stays too, that save drops it once it is on disk
+                chunksBeingSaved.insert_or_assign(coords, candidate.chunk);
+                toSave.push_back(candidate.chunk);
+            }
+        }
+    }
 
-    globalChunkMap[ChunkCoordinates{chunkX, chunkZ}] = currentChunk;
-    return true;
-}
+    if (unloaded > 0) {
+        logMessage("Unloaded " + std::to_string(unloaded) + " chunks, " + std::to_string(toSave.size()) + " of them are being saved", LOG_DEBUG);
+    }
 
+    // Write the changed ones back off the tick thread in one batch, until then getOrLoadChunk revives them from chunksBeingSaved
+    if (toSave.empty()) {
+        return;
+    }
+    threadPool.enqueue([toSave = std::move(toSave)] {
+        // Chunks that failed stay until the next autosave retries them, the ones an autosave is writing until it is done
+        forgetSavedChunks(saveChunks(toSave).savedChunks);
+    });
+}
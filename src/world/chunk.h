@@ -1,11 +1,16 @@
 #ifndef CHUNK_H
 #define CHUNK_H
+#include <array>
+#include <atomic>
+#include <bitset>
 #include <cstdint>
 #include <memory>
+#include <span>
 #include <string>
 #include <vector>
 
 #include "block_states.h"
+#include "chunk_map.h"
 #include "flatworld.h"
 #include "networking/network.h"
 #include "region_file.h"
@@ -18,6 +23,8 @@ constexpr int CHUNK_HEIGHT = 384;
 constexpr int CHUNK_LENGTH = 16;
 constexpr int SECTION_HEIGHT = 16;
 constexpr int NUM_SECTIONS = CHUNK_HEIGHT / SECTION_HEIGHT;
+// Data version written to saved chunks (1.21)
+constexpr int ANVIL_DATA_VERSION = 3953;
 
 
 struct Block {
@@ -30,52 +37,151 @@ struct Block {
     explicit Block(int state) : blockStateID(state) {}
 };
 
+constexpr int SECTION_VOLUME = CHUNK_WIDTH * CHUNK_LENGTH * SECTION_HEIGHT;
+constexpr int SECTION_BIOMES = SECTION_VOLUME / 64; // One biome per 4x4x4 cell
+
+// Palette sizes at which the protocol (and vanilla) switch representation: block palettes are searched
+// linearly up to 4 bits, hashed up to 8 bits and replaced by global state IDs beyond, biome palettes
+// go global beyond 3 bits.
+constexpr int MAX_LINEAR_PALETTE_BITS = 4;
+constexpr int MAX_INDIRECT_BLOCK_BITS = 8;
+constexpr int MAX_INDIRECT_BIOME_BITS = 3;
+
 struct Palette {
-    std::unordered_map<int32_t, uint8_t> blockStateToIndex;
+    std::unordered_map<int32_t, uint32_t> blockStateToIndex; // Only kept once the palette is too large for a linear search
     std::vector<int32_t> indexToBlockState;
+    bool direct = false; // Indices are global IDs, the palette holds no entries
+
+    // Index of a value, -1 if it isn't in the palette
+    int32_t find(int32_t blockStateID) const;
+    // Index of a value, adding it if needed
+    uint32_t getIndex(int32_t blockStateID);
+    // Appends a value even if it is already present (palettes read from disk keep their positions)
+    uint32_t add(int32_t blockStateID);
+    int32_t valueAt(uint32_t index) const { return direct ? static_cast<int32_t>(index) : indexToBlockState[index]; }
+    size_t size() const { return indexToBlockState.size(); }
+    void clear();
+};
+
+// Number of longs needed to store count entries of bitsPerEntry bits, entries never span two longs
+constexpr size_t packedLongCount(int count, int bitsPerEntry) {
+    if (bitsPerEntry == 0) return 0;
+    int entriesPerLong = 64 / bitsPerEntry;
+    return static_cast<size_t>((count + entriesPerLong - 1) / entriesPerLong);
+}
+
+// Reads one entry of a packed array, an empty array reads as all zero
+inline uint32_t unpackEntry(const std::vector<uint64_t>& packed, int bitsPerEntry, int index) {
+    if (packed.empty()) return 0;
+    int entriesPerLong = 64 / bitsPerEntry;
+    uint64_t word = packed[index / entriesPerLong];
+    return static_cast<uint32_t>((word >> ((index % entriesPerLong) * bitsPerEntry)) & ((1ULL << bitsPerEntry) - 1));
+}
+
+// Per column the height just above the highest block that counts for the heightmap, from the bottom of the world
+// (0 for a column without any). Kept packed the way the protocol and Anvil store them: 9 bits per column with
+// x changing fastest, no entry spanning two longs.
+struct Heightmaps {
+    enum Type { MOTION_BLOCKING, WORLD_SURFACE, TYPE_COUNT };
+    static constexpr int BITS_PER_ENTRY = 9; // Heights 0-384
+    static constexpr const char* NAMES[TYPE_COUNT] = {"MOTION_BLOCKING", "WORLD_SURFACE"};
+
+    std::array<std::vector<uint64_t>, TYPE_COUNT> packed; // Empty until computed
 
-    uint8_t getIndex(int32_t blockStateID);
+    bool empty() const { return packed[MOTION_BLOCKING].empty(); }
+    int get(Type type, int x, int z) const {
+        return static_cast<int>(unpackEntry(packed[type], BITS_PER_ENTRY, z * 16 + x));
+    }
+    void set(Type type, int x, int z, int height) {
+        constexpr int entriesPerLong = 64 / BITS_PER_ENTRY;
+        constexpr uint64_t mask = (1ULL << BITS_PER_ENTRY) - 1;
+        int index = z * 16 + x;
+        int shift = index % entriesPerLong * BITS_PER_ENTRY;
+        uint64_t& word = packed[type][index / entriesPerLong];
+        word = (word & ~(mask << shift)) | static_cast<uint64_t>(height) << shift;
+    }
 };
 
 struct MemChunkSection {
     bool isEmpty = true; // True if the entire section is air
     int bitsPerEntry = 4;
     int16_t blockCount = 0;
-    Palette palette; // Mapping of blockStateIDs to palette indices
-    std::vector<uint8_t> blockIndices; // Bit-packed indices referencing the palette
-    std::vector<uint8_t> tempBlockIndices; // Temporary buffer to store block indices before bit-packing
+    // Mapping of blockStateIDs to palette indices. A single entry with no blockIndices is a single-valued
+    // section, a direct palette stores the block state IDs themselves in blockIndices.
+    Palette palette;
+    // Palette indices packed the way the protocol and Anvil store them: 64 / bitsPerEntry entries per long,
+    // starting at the least significant bit, with no entry spanning two longs. Empty means every index is 0.
+    std::vector<uint64_t> blockIndices;
+    std::vector<uint32_t> tempBlockIndices; // Temporary buffer to store block indices before bit-packing
+    uint16_t editsSinceCompaction = 0;
 
     // Biome data
     Palette biomePalette; // Mapping of biomeIDs to palette indices
-    std::vector<uint8_t> biomeIndices; // Bit-packed indices referencing the biome palette
-    std::vector<uint8_t> tempBiomeIndices; // Temporary buffer before bit-packing
+    int biomeBitsPerEntry = 0; // 0 while the section has a single biome
+    std::vector<uint64_t> biomeIndices; // Packed like blockIndices
+    std::vector<uint32_t> tempBiomeIndices; // Temporary buffer before bit-packing
 
     Lighting lighting;
 
-    // Method to add a block to the palette and return its index
-    uint8_t getOrAddBlockIndex(int32_t blockStateID);
+    // Returns the palette index for a block state, adding it to the palette and widening (or compacting)
+    // the storage when the palette is full
+    uint32_t getOrAddBlockIndex(int32_t blockStateID);
     // Method to set a block's palette index in blockIndices
-    void setBlockIndex(int32_t index, uint8_t paletteIndex);
+    void setBlockIndex(int32_t index, uint32_t paletteIndex);
     // Method to get a block's palette index from blockIndices
-    uint8_t getBlockIndex(int32_t index) const;
+    uint32_t getBlockIndex(int32_t index) const {
+        return unpackEntry(blockIndices, bitsPerEntry, index);
+    }
+    int32_t getBlockState(int32_t index) const;
+    // Re-packs blockIndices with more bits per entry, switching to global state IDs past the indirect range
+    void growBitsPerEntry(int newBitsPerEntry);
+    // Drops palette entries no block uses anymore and shrinks the storage (back to a palette if it was direct)
+    void compact();
     void addBlock(int32_t blockStateID);
     void addBiome(int32_t biomeID);
     void finalize();
 };
 
+using ChunkSections = std::array<std::shared_ptr<MemChunkSection>, NUM_SECTIONS>;
+
 struct Chunk {
     int32_t chunkX;
     int32_t chunkZ;
-    std::array<std::optional<MemChunkSection>, NUM_SECTIONS> sections;
+    ChunkSections sections; // Null for sections that were never written to
+    // Sections still shared with other chunks (flat world templates), copied before their first change
+    std::bitset<NUM_SECTIONS> sharedSections;
     std::mutex mutex;
-    bool dirty;
+    std::atomic<bool> dirty; // Changed since it was last saved
+    // Saves that converted the chunk but haven't synced it to disk yet, the copy on disk is stale until then
+    std::atomic<int> savesInFlight = 0;
+    // Steady clock milliseconds of the last access or tick with viewers, unviewed chunks are unloaded by age
+    std::atomic<int64_t> lastUsed = 0;
     Heightmaps heightmaps;
+    // Set on loading when the stored light covers every section, so it doesn't have to be computed again
+    bool lightStored = false;
+    // Bumped by every block change, packets built from an older version are stale
+    std::atomic<uint64_t> version = 0;
+
+    // Chunk Data packet shared by every viewer, valid while packetVersion matches version
+    std::mutex packetMutex;
+    std::shared_ptr<const CachedPacket> packet;
+    uint64_t packetVersion = 0;
+    // Size of the frames of packet, readable without packetMutex
+    std::atomic<size_t> packetBytes = 0;
 
     Chunk(int32_t x, int32_t z) : chunkX(x), chunkZ(z), dirty(false) {}
 
     Block getBlock(int32_t x, int32_t y, int32_t z) const;
     void setBlock(int32_t x, int32_t y, int32_t z, int32_t blockStateID, bool adjustY = false);
+    // The section for writing: created if missing, copied first if it is shared
+    MemChunkSection& editSection(int sectionIndex);
     void markDirty();
+    // Keeps the heightmaps up to date after the block at y (counted from the bottom of the world) changed
+    void updateHeightmaps(int32_t x, int32_t y, int32_t z, int32_t blockStateID);
+    // Height the column would have if the blocks from y (counted from the bottom of the world) up were removed
+    int scanHeight(Heightmaps::Type type, int32_t x, int32_t y, int32_t z) const;
+    // Rough number of bytes the chunk keeps alive, sections shared with other chunks not included. Locks the chunk.
+    size_t memoryUsage();
 };
 
 struct ChunkCoordinates {
@@ -93,28 +199,83 @@ struct ChunkCoordinates {
 template <>
 struct std::hash<ChunkCoordinates> {
     std::size_t operator()(const ChunkCoordinates& coords) const noexcept {
-        return ((std::hash<int32_t>()(coords.chunkX) ^ (std::hash<int32_t>()(coords.chunkZ) << 1)) >> 1);
+        return static_cast<std::size_t>(mixChunkKey(chunkKey(coords.chunkX, coords.chunkZ)));
     }
 };
 
-inline std::unordered_map<ChunkCoordinates, std::shared_ptr<Chunk>, std::hash<ChunkCoordinates>> globalChunkMap;
-inline std::mutex chunkMapMutex;
+// Hits and misses of the per-chunk packet cache since startup
+struct ChunkPacketCacheStats {
+    std::atomic<uint64_t> hits = 0;
+    std::atomic<uint64_t> misses = 0;
+};
+inline ChunkPacketCacheStats chunkPacketCacheStats;
+
+inline ChunkMap globalChunkMap;
+// Chunks already unloaded whose save is still pending. Chunks only move between this and globalChunkMap
+// with the mutex held, so a chunk missing from both is safe to read from disk.
+inline std::unordered_map<ChunkCoordinates, std::shared_ptr<Chunk>, std::hash<ChunkCoordinates>> chunksBeingSaved;
+inline std::mutex chunksBeingSavedMutex;
 
 // Global map from ChunkCoordinates to players viewing them
 inline std::unordered_map<ChunkCoordinates, std::vector<std::shared_ptr<Player>>, std::hash<ChunkCoordinates>> chunkViewersMap;
 inline std::mutex chunkViewersMutex;
 
 int32_t getLocalCoordinate(int32_t coord);
+bool isWorldSurface(const short& blockStateID);
+// Blocks with a collision box, and fluids, count for MOTION_BLOCKING
+bool isMotionBlocking(int32_t blockStateID);
+bool countsForHeightmap(Heightmaps::Type type, int32_t blockStateID);
+// Both heightmaps of a chunk with these sections, scanned from the top
+Heightmaps computeHeightmaps(const ChunkSections& sections);
 int calculateBitsPerEntry(const Palette& palette, int min = 4);
-std::vector<uint8_t> encodeBlockIndices(const std::vector<uint8_t>& indices, int bitsPerEntry);
+std::vector<uint64_t> packIndices(const std::vector<uint32_t>& indices, int bitsPerEntry);
+// Bits per entry the client expects for global block state and biome IDs
+int globalBlockBits();
+int globalBiomeBits();
+std::vector<uint8_t> serializeChunkSections(const ChunkSections& sections);
+// Every bit of the light masks: the sections of the chunk plus the ones below and above the world
+constexpr uint32_t ALL_LIGHT_SECTIONS = (1u << (NUM_SECTIONS + 2)) - 1;
+// Light masks and arrays of the Chunk Data and Update Light packets, for the sections whose bits are set
+// (bit 0 is the section below the world)
+std::vector<uint8_t> serializeLighting(const Chunk& chunk, uint32_t sectionMask);
 std::shared_ptr<Chunk> getChunkContainingBlock(int32_t x, int32_t y, int32_t z);
 void notifyChunkUpdate(const std::shared_ptr<Chunk> & chunk, int32_t x, int32_t y, int32_t z);
 void updatePlayerChunkView(const std::shared_ptr<Player> & player, int32_t oldChunkX, int32_t oldChunkZ, int32_t newChunkX, int32_t newChunkZ);
 std::shared_ptr<Chunk> loadChunkFromDisk(int chunkX, int chunkZ);
+// Builds a chunk from its uncompressed Anvil NBT in one pass, without a tag tree. Throws on malformed data.
+std::shared_ptr<Chunk> decodeChunk(int chunkX, int chunkZ, std::span<const uint8_t> nbtData);
+// Takes over the packed block states read from disk for a section whose palette is filled, data may be empty
+void finishBlockStates(MemChunkSection& section, std::vector<uint64_t>&& data, int sectionY);
+// Same for the biomes, a single biome has no data
+void finishBiomes(MemChunkSection& section, std::vector<uint64_t>&& data);
 std::shared_ptr<Chunk> generateFlatChunk(const FlatWorldSettings& settings, int32_t chunkX, int32_t chunkZ, int& highestY);
+PacketWriter buildChunkDataPacket(const std::shared_ptr<Chunk>& chunk);
+// The chunk's Chunk Data packet encoded for connections in the play state, built once per chunk version
+std::shared_ptr<const CachedPacket> getChunkDataPacket(const std::shared_ptr<Chunk>& chunk);
+// Logs the packet cache hit rate since the last report
+void reportChunkPacketCache();
 void sendChunkDataToPlayer(ClientConnection& client, const std::shared_ptr<Chunk>& chunk);
 std::shared_ptr<Chunk> getOrLoadChunk(int32_t chunkX, int32_t chunkZ);
 bool sendCurrentChunkToPlayer(ClientConnection& client, int chunkX, int chunkZ);
+// The chunk in Anvil's NBT layout
+nbt::tag_compound serializeChunkNBT(const Chunk& chunk);
+// Outcome of writing a batch of chunks
+struct ChunkSaveStats {
+    size_t saved = 0;
+    size_t failed = 0;
+    // The saved chunks, written and synced by this call. Chunks skipped as clean may still be in flight elsewhere.
+    std::vector<std::shared_ptr<Chunk>> savedChunks;
+    size_t regions = 0; // Region files written, each synced once
+    double milliseconds = 0;
+};
+// Converts the changed chunks to NBT and writes them to their region files, syncing every region file once at
+// the end. Chunks that aren't dirty (anymore) are skipped. Failed chunks stay dirty.
+ChunkSaveStats saveChunks(const std::vector<std::shared_ptr<Chunk>>& chunks, RegionFileCache& cache = regionFiles);
+// Saves every loaded chunk that changed since it was last saved
+ChunkSaveStats saveDirtyChunks();
+// Unloads chunks nobody viewed for the configured delay, and the least recently used unviewed ones while
+// over the memory budget. Changed chunks are saved first. Called once a second by the ticking system.
+void unloadChunks();
 std::vector<ChunkCoordinates> getChunksInView(int32_t centerChunkX, int32_t centerChunkZ, int viewDistance);
 
 #endif //CHUNK_H
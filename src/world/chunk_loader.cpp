@@ -0,0 +1,191 @@
+#include "chunk_loader.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+#include <string>
+
+#include "core/utils.h"
+#include "entities/player.h"
+#include "networking/clientbound_packets.h"
+#include "utils/thread_pool.h"
+
+ChunkLoader::ChunkLoader(size_t numThreads) {
+    for (size_t i = 0; i < numThreads; ++i) {
+        workers.emplace_back([this] { worker(); });
+        std::string threadName = "ChunkLdr:" + std::to_string(i);
+        set_thread_name(workers.back(), threadName.data());
+    }
+}
+
+ChunkLoader::~ChunkLoader() {
+    stop();
+}
+
+void ChunkLoader::stop() {
+    {
+        std::lock_guard lock(mutex);
+        stopping = true;
+    }
+    condition.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+}
+
+bool ChunkLoader::wants(const Player& player, const ChunkCoordinates& coords) {
+    if (player.client == nullptr || player.client->connectionClosed) {
+        return false;
+    }
+    int viewDistance = player.effectiveViewDistance();
+    return std::abs(coords.chunkX - player.currentChunkX) <= viewDistance &&
+           std::abs(coords.chunkZ - player.currentChunkZ) <= viewDistance;
+}
+
+int64_t ChunkLoader::distanceTo(const Player& player, const ChunkCoordinates& coords) {
+    int64_t dx = coords.chunkX - player.currentChunkX;
+    int64_t dz = coords.chunkZ - player.currentChunkZ;
+    return dx * dx + dz * dz;
+}
+
+void ChunkLoader::updatePlayer(const std::shared_ptr<Player>& player) {
+    std::vector<ChunkCoordinates> inView = getChunksInView(player->currentChunkX, player->currentChunkZ, player->effectiveViewDistance());
+    {
+        std::lock_guard lock(mutex);
+
+        // Let the client drop what it left behind, the chunks are sent again if it comes back
+        for (auto it = player->loadedChunks.begin(); it != player->loadedChunks.end();) {
+            if (wants(*player, *it)) {
+                ++it;
+                continue;
+            }
+            if (player->client) {
+                sendUnloadChunkPacket(*player->client, it->chunkX, it->chunkZ);
+            }
+            it = player->loadedChunks.erase(it);
+        }
+
+        // Cancel the requests the player no longer needs
+        for (auto it = pending.begin(); it != pending.end();) {
+            auto& requesters = it->second.requesters;
+            if (!wants(*player, it->first)) {
+                std::erase(requesters, player);
+            }
+            if (requesters.empty() && !it->second.loading) {
+                it = pending.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        // And request the new ones, queueing those that are closer to this player than to anyone before
+        for (const auto& coords : inView) {
+            if (player->loadedChunks.contains(coords)) {
+                continue;
+            }
+            PendingChunk& chunk = pending[coords];
+            if (std::ranges::find(chunk.requesters, player) == chunk.requesters.end()) {
+                chunk.requesters.push_back(player);
+            }
+            int64_t distance = distanceTo(*player, coords);
+            if (!chunk.loading && distance < chunk.distance) {
+                chunk.distance = distance;
+                queue.push({distance, coords});
+            }
+        }
+    }
+    condition.notify_all();
+}
+
+void ChunkLoader::removePlayer(const std::shared_ptr<Player>& player) {
+    std::lock_guard lock(mutex);
+    for (auto it = pending.begin(); it != pending.end();) {
+        std::erase(it->second.requesters, player);
+        if (it->second.requesters.empty() && !it->second.loading) {
+            it = pending.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    player->loadedChunks.clear();
+}
+
+size_t ChunkLoader::getQueuedCount() {
+    std::lock_guard lock(mutex);
+    return pending.size();
+}
+
+int64_t ChunkLoader::nearestDistance(const ChunkCoordinates& coords, const PendingChunk& chunk) {
+    int64_t distance = std::numeric_limits<int64_t>::max();
+    for (const auto& requester : chunk.requesters) {
+        distance = std::min(distance, distanceTo(*requester, coords));
+    }
+    return distance;
+}
+
+void ChunkLoader::worker() {
+    while (true) {
+        ChunkCoordinates coords{0, 0};
+        {
+            std::unique_lock lock(mutex);
+            condition.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (stopping) {
+                return;
+            }
+            QueueEntry entry = queue.top();
+            queue.pop();
+            coords = entry.coords;
+
+            // Cancelled, already taken by another worker, or queued again since
+            auto it = pending.find(coords);
+            if (it == pending.end() || it->second.loading || it->second.distance != entry.distance) {
+                continue;
+            }
+            // The requesters that were this close moved away, it waits behind what is closer now
+            int64_t distance = nearestDistance(coords, it->second);
+            if (distance > entry.distance) {
+                it->second.distance = distance;
+                queue.push({distance, coords});
+                continue;
+            }
+            it->second.loading = true;
+        }
+
+        // Load and encode the chunk before anyone waits on the lock, sending it is only queuing the frame
+        std::shared_ptr<Chunk> chunk = getOrLoadChunk(coords.chunkX, coords.chunkZ);
+        if (chunk) {
+            getChunkDataPacket(chunk);
+        } else {
+            logMessage("Failed to load or generate chunk (" + std::to_string(coords.chunkX) + ", " + std::to_string(coords.chunkZ) + ")", LOG_ERROR);
+        }
+
+        std::vector<std::shared_ptr<Player>> recipients;
+        {
+            std::lock_guard lock(mutex);
+            auto node = pending.extract(coords);
+            if (!chunk || node.empty()) {
+                continue;
+            }
+            for (const auto& requester : node.mapped().requesters) {
+                // Requesters that moved away in the meantime don't get it
+                if (wants(*requester, coords) && requester->loadedChunks.insert(coords).second) {
+                    recipients.push_back(requester);
+                }
+            }
+        }
+
+        // Every recipient encrypts a copy of the whole frame, the other workers and updatePlayer don't wait for that
+        for (const auto& recipient : recipients) {
+            sendChunkDataToPlayer(*recipient->client, chunk);
+        }
+
+        // A recipient that moved on meanwhile may have been sent the Unload Chunk before the data, unload it again
+        std::lock_guard lock(mutex);
+        for (const auto& recipient : recipients) {
+            if (!recipient->loadedChunks.contains(coords) && recipient->client) {
+                sendUnloadChunkPacket(*recipient->client, coords.chunkX, coords.chunkZ);
+            }
+        }
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef CHUNK_LOADER_H
+#define CHUNK_LOADER_H
+#include <condition_variable>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "chunk.h"
+
+// Loads the chunks players need and streams each one to them as soon as it is ready.
+// Requests from all players share one queue ordered by the distance to the nearest requesting player,
+// so everyone's surroundings arrive from the inside out. A chunk wanted by several players is loaded
+// once, and chunks a player walked away from before they were loaded are dropped from the queue.
+// The loader owns which chunks were sent to a player (Player::loadedChunks), only touch those through it.
+class ChunkLoader {
+public:
+    // Starts the worker threads
+    explicit ChunkLoader(size_t numThreads);
+    ~ChunkLoader();
+
+    // Lets the workers finish the chunk they are on and joins them, nothing is loaded afterwards
+    void stop();
+
+    // Queues the chunks in the player's view it doesn't have yet, cancels the ones outside of it and tells
+    // the client to drop the chunks it left behind. Call whenever the player's center chunk or view distance changed.
+    void updatePlayer(const std::shared_ptr<Player>& player);
+    // Cancels everything queued for a disconnected player, nothing is sent to it afterwards
+    void removePlayer(const std::shared_ptr<Player>& player);
+
+    size_t getQueuedCount();
+
+private:
+    struct PendingChunk {
+        std::vector<std::shared_ptr<Player>> requesters;
+        bool loading = false; // Taken by a worker, late requesters are served when it finishes
+        // Distance of the newest queue entry, older entries with another distance are stale
+        int64_t distance = std::numeric_limits<int64_t>::max();
+    };
+
+    // Entries aren't removed when requests change, workers skip the stale ones and queue chunks whose
+    // requesters moved away again with their new distance
+    struct QueueEntry {
+        int64_t distance; // Squared distance in chunks to the nearest requester when it was queued
+        ChunkCoordinates coords;
+
+        bool operator>(const QueueEntry& other) const { return distance > other.distance; }
+    };
+
+    static bool wants(const Player& player, const ChunkCoordinates& coords);
+    static int64_t distanceTo(const Player& player, const ChunkCoordinates& coords);
+    static int64_t nearestDistance(const ChunkCoordinates& coords, const PendingChunk& chunk);
+    void worker();
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool stopping = false;
+    std::unordered_map<ChunkCoordinates, PendingChunk> pending;
+    std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<>> queue;
+    std::vector<std::thread> workers;
+};
+
+// Created by runServer once the config is loaded, stopped before the world is saved on shutdown
+inline std::unique_ptr<ChunkLoader> chunkLoader;
+
+#endif //CHUNK_LOADER_H
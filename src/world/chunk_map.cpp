@@ -0,0 +1,52 @@
+#include "chunk_map.h"
+
+#include <mutex>
+
+#include "chunk.h"
+
+std::shared_ptr<Chunk> ChunkMap::find(int32_t chunkX, int32_t chunkZ) const {
+    uint64_t key = chunkKey(chunkX, chunkZ);
+    const Shard& shard = shardFor(key);
+    std::shared_lock lock(shard.mutex);
+    auto it = shard.chunks.find(key);
+    return it != shard.chunks.end() ? it->second : nullptr;
+}
+
+std::shared_ptr<Chunk> ChunkMap::insert(const std::shared_ptr<Chunk>& chunk) {
+    uint64_t key = chunkKey(chunk->chunkX, chunk->chunkZ);
+    Shard& shard = shardFor(key);
+    std::unique_lock lock(shard.mutex);
+    return shard.chunks.try_emplace(key, chunk).first->second;
+}
+
+bool ChunkMap::erase(const std::shared_ptr<Chunk>& chunk) {
+    uint64_t key = chunkKey(chunk->chunkX, chunk->chunkZ);
+    Shard& shard = shardFor(key);
+    std::unique_lock lock(shard.mutex);
+    auto it = shard.chunks.find(key);
+    if (it == shard.chunks.end() || it->second != chunk) {
+        return false;
+    }
+    shard.chunks.erase(it);
+    return true;
+}
+
+size_t ChunkMap::size() const {
+    size_t count = 0;
+    for (const Shard& shard : shards) {
+        std::shared_lock lock(shard.mutex);
+        count += shard.chunks.size();
+    }
+    return count;
+}
+
+std::vector<std::shared_ptr<Chunk>> ChunkMap::snapshot() const {
+    std::vector<std::shared_ptr<Chunk>> result;
+    for (const Shard& shard : shards) {
+        std::shared_lock lock(shard.mutex);
+        for (const auto& [key, chunk] : shard.chunks) {
+            result.push_back(chunk);
+        }
+    }
+    return result;
+}
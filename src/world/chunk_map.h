@@ -0,0 +1,61 @@
+#ifndef CHUNK_MAP_H
+#define CHUNK_MAP_H
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+
+struct Chunk;
+
+// Both chunk coordinates in one integer, x in the upper half
+constexpr uint64_t chunkKey(int32_t chunkX, int32_t chunkZ) {
+    return static_cast<uint64_t>(static_cast<uint32_t>(chunkX)) << 32 | static_cast<uint32_t>(chunkZ);
+}
+
+// Finalizer of MurmurHash3: neighbouring chunks, which only differ in the low bits of either half,
+// end up spread over all 64 bits
+constexpr uint64_t mixChunkKey(uint64_t key) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return key;
+}
+
+struct ChunkKeyHash {
+    size_t operator()(uint64_t key) const noexcept { return static_cast<size_t>(mixChunkKey(key)); }
+};
+
+// The loaded chunks, split into shards that are locked independently.
+// Lookups only take their shard's lock in shared mode, so the physics and packet paths run in parallel
+// with each other and only wait for a loader that inserts into the same shard at the same moment.
+class ChunkMap {
+public:
+    std::shared_ptr<Chunk> find(int32_t chunkX, int32_t chunkZ) const;
+    // Adds the chunk unless its position is taken, returns the chunk that is in the map afterwards
+    std::shared_ptr<Chunk> insert(const std::shared_ptr<Chunk>& chunk);
+    // Removes the chunk at its position if it is still the one in the map
+    bool erase(const std::shared_ptr<Chunk>& chunk);
+    size_t size() const;
+    // The chunks currently in the map, each shard is locked only while it is copied
+    std::vector<std::shared_ptr<Chunk>> snapshot() const;
+
+private:
+    static constexpr size_t SHARD_COUNT = 64;
+
+    struct Shard {
+        mutable std::shared_mutex mutex;
+        std::unordered_map<uint64_t, std::shared_ptr<Chunk>, ChunkKeyHash> chunks;
+    };
+
+    // The inner maps use the low bits of the same hash, the shard is picked from the high ones
+    Shard& shardFor(uint64_t key) { return shards[mixChunkKey(key) >> 58]; }
+    const Shard& shardFor(uint64_t key) const { return shards[mixChunkKey(key) >> 58]; }
+
+    std::array<Shard, SHARD_COUNT> shards;
+};
+
+#endif //CHUNK_MAP_H
@@ -0,0 +1,419 @@
+#include "light_engine.h"
+
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <ranges>
+
+#include "entities/player.h"
+#include "networking/network.h"
+#include "networking/packet_ids.h"
+
+namespace {
+    constexpr int COLUMN_HEIGHT = NUM_SECTIONS * SECTION_HEIGHT;
+    constexpr int MAX_Y = MIN_Y + COLUMN_HEIGHT - 1;
+    // Cells of a whole chunk, indexed like the blocks of a section with the sections stacked: (y * 16 + z) * 16 + x
+    constexpr int CHUNK_CELLS = SECTION_VOLUME * NUM_SECTIONS;
+    constexpr int LAYER_CELLS = CHUNK_WIDTH * CHUNK_LENGTH;
+
+    // Level in a neighbour of a cell with the given level. Sky light keeps its full level while it falls straight
+    // down through transparent blocks, otherwise every block takes at least one level away.
+    int spreadLevel(int level, uint8_t opacity, bool sky, bool down) {
+        if (sky && down && level == 15 && opacity == 0) return 15;
+        return level - std::max<int>(1, opacity);
+    }
+
+    // Packs one section of unpacked levels into nibbles, leaving the array empty if they are all 0
+    void packSection(const std::vector<uint8_t>& levels, int sectionIndex, std::vector<uint8_t>& light) {
+        const uint8_t* begin = levels.data() + sectionIndex * SECTION_VOLUME;
+        if (std::all_of(begin, begin + SECTION_VOLUME, [](uint8_t level) { return level == 0; })) {
+            light.clear();
+            light.shrink_to_fit();
+            return;
+        }
+        light.resize(LIGHT_ARRAY_SIZE);
+        for (int i = 0; i < LIGHT_ARRAY_SIZE; ++i) {
+            light[i] = static_cast<uint8_t>(begin[2 * i] | begin[2 * i + 1] << 4);
+        }
+    }
+
+    struct Direction {
+        int dx, dy, dz;
+    };
+    constexpr std::array<Direction, 6> DIRECTIONS = {{{-1, 0, 0}, {1, 0, 0}, {0, 0, -1}, {0, 0, 1}, {0, -1, 0}, {0, 1, 0}}};
+
+    // Chunks whose light changed, with the light mask bits of the changed sections
+    using ChangedSections = std::unordered_map<std::shared_ptr<Chunk>, uint32_t>;
+
+    // Blocks and light of the loaded chunks around an update. Light spreads at most 15 blocks, so an update never
+    // leaves the chunk it starts in and its 8 neighbours; those are locked once, in address order, for the whole
+    // update instead of once per cell. Nothing else ever holds two chunk locks, so the order can't deadlock.
+    class WorldLight {
+    public:
+        WorldLight(const LightEngine& engine, int32_t chunkX, int32_t chunkZ, ChangedSections& changed)
+            : engine(engine), originX(chunkX - 1), originZ(chunkZ - 1), changed(changed) {
+            for (int i = 0; i < 9; ++i) {
+                chunks[i] = globalChunkMap.find(originX + i % 3, originZ + i / 3);
+            }
+            std::array<Chunk*, 9> order;
+            std::ranges::transform(chunks, order.begin(), [](const auto& chunk) { return chunk.get(); });
+            std::ranges::sort(order, std::less<>());
+            for (Chunk* chunk : order) {
+                if (chunk) {
+                    locks.emplace_back(chunk->mutex);
+                }
+            }
+        }
+
+        uint8_t opacityAt(int32_t x, int32_t y, int32_t z) const {
+            Chunk* chunk = chunkAt(x, z);
+            if (!chunk) {
+                return 15; // Light doesn't spread into unloaded chunks
+            }
+            const auto& section = chunk->sections[sectionOf(y)];
+            return section && !section->isEmpty ? engine.opacityOf(section->getBlockState(indexOf(x, y, z))) : 0;
+        }
+
+        uint8_t emissionAt(int32_t x, int32_t y, int32_t z) const {
+            Chunk* chunk = chunkAt(x, z);
+            if (!chunk) {
+                return 0;
+            }
+            const auto& section = chunk->sections[sectionOf(y)];
+            return section && !section->isEmpty ? engine.emissionOf(section->getBlockState(indexOf(x, y, z))) : 0;
+        }
+
+        uint8_t lightAt(int32_t x, int32_t y, int32_t z, bool sky) const {
+            if (y > MAX_Y) {
+                return sky ? 15 : 0;
+            }
+            Chunk* chunk = y >= MIN_Y ? chunkAt(x, z) : nullptr;
+            if (!chunk) {
+                return 0;
+            }
+            const auto& section = chunk->sections[sectionOf(y)];
+            if (!section) {
+                return 0;
+            }
+            return getLightLevel(sky ? section->lighting.skyLight : section->lighting.blockLight, indexOf(x, y, z));
+        }
+
+        void setLight(int32_t x, int32_t y, int32_t z, bool sky, uint8_t level) {
+            int index = chunkIndex(x, z);
+            if (index < 0 || !chunks[index]) {
+                return;
+            }
+            int sectionIndex = sectionOf(y);
+            Lighting& lighting = chunks[index]->editSection(sectionIndex).lighting;
+            setLightLevel(sky ? lighting.skyLight : lighting.blockLight, indexOf(x, y, z), level);
+            changed[chunks[index]] |= 1u << (sectionIndex + 1);
+        }
+
+    private:
+        static int sectionOf(int32_t y) { return (y - MIN_Y) / SECTION_HEIGHT; }
+        static int indexOf(int32_t x, int32_t y, int32_t z) {
+            return ((y - MIN_Y) % SECTION_HEIGHT * CHUNK_LENGTH + (z & 15)) * CHUNK_WIDTH + (x & 15);
+        }
+
+        // Index into chunks, -1 outside of the neighbourhood
+        int chunkIndex(int32_t x, int32_t z) const {
+            int32_t dx = (x >> 4) - originX;
+            int32_t dz = (z >> 4) - originZ;
+            return dx >= 0 && dx < 3 && dz >= 0 && dz < 3 ? dz * 3 + dx : -1;
+        }
+
+        Chunk* chunkAt(int32_t x, int32_t z) const {
+            int index = chunkIndex(x, z);
+            return index >= 0 ? chunks[index].get() : nullptr;
+        }
+
+        const LightEngine& engine;
+        int32_t originX, originZ; // Chunk with the lowest coordinates of the neighbourhood
+        // Unloaded chunks as null, holding them keeps them alive while they are locked
+        std::array<std::shared_ptr<Chunk>, 9> chunks;
+        std::vector<std::unique_lock<std::mutex>> locks;
+        ChangedSections& changed;
+    };
+
+    struct Cell {
+        int32_t x, y, z;
+    };
+
+    // Spreads the light of the sources breadth first into every neighbour that is darker than it would be lit
+    void spreadLight(WorldLight& world, std::vector<Cell>& sources, bool sky) {
+        for (size_t i = 0; i < sources.size(); ++i) {
+            Cell cell = sources[i];
+            if (cell.y < MIN_Y || cell.y > MAX_Y) {
+                continue;
+            }
+            uint8_t level = world.lightAt(cell.x, cell.y, cell.z, sky);
+            if (level <= 1) {
+                continue;
+            }
+            for (const auto& [dx, dy, dz] : DIRECTIONS) {
+                Cell neighbor{cell.x + dx, cell.y + dy, cell.z + dz};
+                if (neighbor.y < MIN_Y || neighbor.y > MAX_Y) {
+                    continue;
+                }
+                int next = spreadLevel(level, world.opacityAt(neighbor.x, neighbor.y, neighbor.z), sky, dy < 0);
+                if (next > world.lightAt(neighbor.x, neighbor.y, neighbor.z, sky)) {
+                    world.setLight(neighbor.x, neighbor.y, neighbor.z, sky, static_cast<uint8_t>(next));
+                    sources.push_back(neighbor);
+                }
+            }
+        }
+    }
+
+    // Removes the light that came through the changed block, then spreads what is left back into the dark area
+    void relight(WorldLight& world, const Cell& changed, bool sky) {
+        std::vector<std::pair<Cell, uint8_t>> darkened;
+        std::vector<Cell> sources;
+
+        if (uint8_t level = world.lightAt(changed.x, changed.y, changed.z, sky)) {
+            world.setLight(changed.x, changed.y, changed.z, sky, 0);
+            darkened.emplace_back(changed, level);
+        }
+        for (size_t i = 0; i < darkened.size(); ++i) {
+            auto [cell, level] = darkened[i];
+            for (const auto& [dx, dy, dz] : DIRECTIONS) {
+                Cell neighbor{cell.x + dx, cell.y + dy, cell.z + dz};
+                if (neighbor.y < MIN_Y || neighbor.y > MAX_Y) {
+                    continue;
+                }
+                uint8_t neighborLevel = world.lightAt(neighbor.x, neighbor.y, neighbor.z, sky);
+                if (neighborLevel == 0) {
+                    continue;
+                }
+                // Dimmer neighbours, and direct sky light below, got their light from here
+                if (neighborLevel < level || (sky && dy < 0 && level == 15 && neighborLevel == 15)) {
+                    world.setLight(neighbor.x, neighbor.y, neighbor.z, sky, 0);
+                    darkened.emplace_back(neighbor, neighborLevel);
+                } else {
+                    sources.push_back(neighbor); // Lit from elsewhere, it fills the dark area again
+                }
+            }
+        }
+
+        // Light entering the changed block from around it, from the sky above the world, and from emitters
+        for (const auto& [dx, dy, dz] : DIRECTIONS) {
+            sources.push_back({changed.x + dx, changed.y + dy, changed.z + dz});
+        }
+        if (sky && changed.y == MAX_Y) {
+            int level = spreadLevel(15, world.opacityAt(changed.x, changed.y, changed.z), true, true);
+            if (level > world.lightAt(changed.x, changed.y, changed.z, true)) {
+                world.setLight(changed.x, changed.y, changed.z, true, static_cast<uint8_t>(level));
+                sources.push_back(changed);
+            }
+        }
+        if (!sky) {
+            darkened.emplace_back(changed, 0);
+            for (const auto& [cell, level] : darkened) {
+                uint8_t emitted = world.emissionAt(cell.x, cell.y, cell.z);
+                if (emitted > world.lightAt(cell.x, cell.y, cell.z, false)) {
+                    world.setLight(cell.x, cell.y, cell.z, false, emitted);
+                    sources.push_back(cell);
+                }
+            }
+        }
+
+        spreadLight(world, sources, sky);
+    }
+
+    // Light of a chunk that was lit on its own, or loaded with stored light, against its loaded neighbours: every
+    // cell on either side of the chunk's edges that is brighter than the cell across spreads into it
+    void spreadAcrossEdges(WorldLight& world, int32_t chunkX, int32_t chunkZ, bool sky) {
+        int32_t minX = chunkX * CHUNK_WIDTH;
+        int32_t minZ = chunkZ * CHUNK_LENGTH;
+        std::vector<Cell> sources;
+        auto compare = [&](const Cell& inside, const Cell& outside) {
+            uint8_t insideLevel = world.lightAt(inside.x, inside.y, inside.z, sky);
+            uint8_t outsideLevel = world.lightAt(outside.x, outside.y, outside.z, sky);
+            if (insideLevel > outsideLevel + 1) {
+                sources.push_back(inside);
+            } else if (outsideLevel > insideLevel + 1) {
+                sources.push_back(outside);
+            }
+        };
+        for (int32_t y = MIN_Y; y <= MAX_Y; ++y) {
+            for (int i = 0; i < CHUNK_WIDTH; ++i) {
+                compare({minX + i, y, minZ}, {minX + i, y, minZ - 1});
+                compare({minX + i, y, minZ + CHUNK_LENGTH - 1}, {minX + i, y, minZ + CHUNK_LENGTH});
+                compare({minX, y, minZ + i}, {minX - 1, y, minZ + i});
+                compare({minX + CHUNK_WIDTH - 1, y, minZ + i}, {minX + CHUNK_WIDTH, y, minZ + i});
+            }
+        }
+        spreadLight(world, sources, sky);
+    }
+}
+
+void LightEngine::build(const std::unordered_map<std::string, BlockData>& blocks) {
+    opacity.clear();
+    emission.clear();
+    for (const auto& block : blocks | std::views::values) {
+        if (block.maxStateId >= static_cast<int>(opacity.size())) {
+            opacity.resize(block.maxStateId + 1, 15);
+            emission.resize(block.maxStateId + 1, 0);
+        }
+        for (int state = block.minStateId; state <= block.maxStateId; ++state) {
+            opacity[state] = static_cast<uint8_t>(std::clamp(block.filterLight, 0, 15));
+            emission[state] = static_cast<uint8_t>(std::clamp(block.emitLight, 0, 15));
+        }
+    }
+}
+
+void LightEngine::lightSections(ChunkSections& sections) const {
+    std::vector<uint8_t> cellOpacity(CHUNK_CELLS, 0);
+    std::vector<uint8_t> skyLight(CHUNK_CELLS, 0);
+    std::vector<uint8_t> blockLight(CHUNK_CELLS, 0);
+    std::vector<int32_t> queue;
+
+    // Spreads the light of the queued cells breadth first, each step a level lower
+    auto spread = [&](std::vector<uint8_t>& light, bool sky) {
+        for (size_t head = 0; head < queue.size(); ++head) {
+            int cell = queue[head];
+            int level = light[cell];
+            if (level <= 1) {
+                continue;
+            }
+            int x = cell & 15;
+            int z = (cell >> 4) & 15;
+            int y = cell / LAYER_CELLS;
+            auto visit = [&](int neighbor, bool down) {
+                int next = spreadLevel(level, cellOpacity[neighbor], sky, down);
+                if (next > light[neighbor]) {
+                    light[neighbor] = static_cast<uint8_t>(next);
+                    queue.push_back(neighbor);
+                }
+            };
+            if (x > 0) visit(cell - 1, false);
+            if (x < CHUNK_WIDTH - 1) visit(cell + 1, false);
+            if (z > 0) visit(cell - CHUNK_WIDTH, false);
+            if (z < CHUNK_LENGTH - 1) visit(cell + CHUNK_WIDTH, false);
+            if (y > 0) visit(cell - LAYER_CELLS, true);
+            if (y < COLUMN_HEIGHT - 1) visit(cell + LAYER_CELLS, false);
+        }
+        queue.clear();
+    };
+
+    // Block light from the emitting blocks
+    for (int sectionIndex = 0; sectionIndex < NUM_SECTIONS; ++sectionIndex) {
+        auto& section = sections[sectionIndex];
+        if (!section) {
+            section = std::make_shared<MemChunkSection>(); // Somewhere to keep the light
+        }
+        if (section->isEmpty) {
+            continue;
+        }
+        int base = sectionIndex * SECTION_VOLUME;
+        for (int i = 0; i < SECTION_VOLUME; ++i) {
+            int32_t state = section->getBlockState(i);
+            cellOpacity[base + i] = opacityOf(state);
+            if (uint8_t level = emissionOf(state)) {
+                blockLight[base + i] = level;
+                queue.push_back(base + i);
+            }
+        }
+    }
+    spread(blockLight, false);
+
+    // Sky light falls down every column until something takes it away, below that it spreads like block light
+    std::array<int, LAYER_CELLS> fullFrom{}; // Lowest y of the column that is still fully lit
+    for (int column = 0; column < LAYER_CELLS; ++column) {
+        int level = 15;
+        fullFrom[column] = COLUMN_HEIGHT;
+        for (int y = COLUMN_HEIGHT - 1; y >= 0; --y) {
+            int cell = y * LAYER_CELLS + column;
+            level = spreadLevel(level, cellOpacity[cell], true, true);
+            if (level <= 0) {
+                break;
+            }
+            skyLight[cell] = static_cast<uint8_t>(level);
+            if (level == 15) {
+                fullFrom[column] = y;
+            } else {
+                queue.push_back(cell);
+            }
+        }
+    }
+    // Fully lit cells only spread sideways at the heights where a neighbouring column is darker
+    for (int column = 0; column < LAYER_CELLS; ++column) {
+        int x = column & 15;
+        int z = column >> 4;
+        int darkerBelow = fullFrom[column];
+        if (x > 0) darkerBelow = std::max(darkerBelow, fullFrom[column - 1]);
+        if (x < CHUNK_WIDTH - 1) darkerBelow = std::max(darkerBelow, fullFrom[column + 1]);
+        if (z > 0) darkerBelow = std::max(darkerBelow, fullFrom[column - CHUNK_WIDTH]);
+        if (z < CHUNK_LENGTH - 1) darkerBelow = std::max(darkerBelow, fullFrom[column + CHUNK_WIDTH]);
+        for (int y = fullFrom[column]; y < darkerBelow; ++y) {
+            queue.push_back(y * LAYER_CELLS + column);
+        }
+    }
+    spread(skyLight, true);
+
+    for (int sectionIndex = 0; sectionIndex < NUM_SECTIONS; ++sectionIndex) {
+        Lighting& lighting = sections[sectionIndex]->lighting;
+        packSection(skyLight, sectionIndex, lighting.skyLight);
+        packSection(blockLight, sectionIndex, lighting.blockLight);
+    }
+}
+
+void LightEngine::blockChanged(int32_t x, int32_t y, int32_t z) {
+    std::lock_guard lock(queueMutex);
+    queue.push_back({x, y, z});
+}
+
+void LightEngine::chunkLoaded(int32_t chunkX, int32_t chunkZ) {
+    std::lock_guard lock(queueMutex);
+    loadedChunks.push_back({chunkX, chunkZ});
+}
+
+void LightEngine::flush() {
+    std::vector<BlockPosition> changedBlocks;
+    std::vector<ChunkCoordinates> newChunks;
+    {
+        std::lock_guard lock(queueMutex);
+        changedBlocks.swap(queue);
+        newChunks.swap(loadedChunks);
+    }
+    if (changedBlocks.empty() && newChunks.empty()) {
+        return;
+    }
+
+    ChangedSections changed;
+    for (const auto& [chunkX, chunkZ] : newChunks) {
+        WorldLight world(*this, chunkX, chunkZ, changed);
+        spreadAcrossEdges(world, chunkX, chunkZ, true);
+        spreadAcrossEdges(world, chunkX, chunkZ, false);
+    }
+    for (const auto& [x, y, z] : changedBlocks) {
+        if (y < MIN_Y || y > MAX_Y) {
+            continue;
+        }
+        WorldLight world(*this, x >> 4, z >> 4, changed);
+        relight(world, {x, y, z}, true);
+        relight(world, {x, y, z}, false);
+    }
+
+    for (const auto& [chunk, sectionMask] : changed) {
+        // Chunk Data packets built before are outdated
+        chunk->version.fetch_add(1, std::memory_order_release);
+
+        PacketWriter packet(UPDATE_LIGHT);
+        writeVarInt(packet, chunk->chunkX);
+        writeVarInt(packet, chunk->chunkZ);
+        {
+            std::lock_guard lock(chunk->mutex);
+            writeBytes(packet, serializeLighting(*chunk, sectionMask));
+        }
+
+        // Compressed once for all of the chunk's viewers
+        std::lock_guard lock(chunkViewersMutex);
+        auto it = chunkViewersMap.find(ChunkCoordinates{chunk->chunkX, chunk->chunkZ});
+        if (it != chunkViewersMap.end() && !it->second.empty()) {
+            EncodedPacket encoded(packet);
+            for (const auto& player : it->second) {
+                sendEncodedPacket(*player->client, encoded);
+            }
+        }
+    }
+}
@@ -0,0 +1,71 @@
+#ifndef LIGHT_ENGINE_H
+#define LIGHT_ENGINE_H
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "chunk.h"
+
+// Light levels are nibbles, two per byte with the lower half first, in the order of the block indices
+// ((y * 16 + z) * 16 + x). An empty array reads as all 0.
+constexpr int LIGHT_ARRAY_SIZE = SECTION_VOLUME / 2;
+
+inline uint8_t getLightLevel(const std::vector<uint8_t>& light, int index) {
+    if (light.empty()) return 0;
+    return (light[index >> 1] >> ((index & 1) * 4)) & 0x0F;
+}
+
+inline void setLightLevel(std::vector<uint8_t>& light, int index, uint8_t level) {
+    if (light.empty()) {
+        if (level == 0) return;
+        light.assign(LIGHT_ARRAY_SIZE, 0);
+    }
+    int shift = (index & 1) * 4;
+    light[index >> 1] = static_cast<uint8_t>((light[index >> 1] & ~(0x0F << shift)) | (level << shift));
+}
+
+// Sky and block light, spread breadth first from the sky and from light emitting blocks.
+// Whole chunks are lit from scratch on the thread that generates them, or when they are loaded without stored light.
+// Block changes and the edges of loaded chunks are queued and relit incrementally at the end of the tick, across
+// the borders of loaded chunks, and the viewers get Update Light packets for the sections whose light changed.
+class LightEngine {
+public:
+    // Opacity and emitted light of every block state, from the block data
+    void build(const std::unordered_map<std::string, BlockData>& blocks);
+
+    // Computes the light of the sections from scratch, creating the missing ones. Light stays within the sections,
+    // neighbouring chunks aren't looked at. Nothing else may use the sections meanwhile.
+    void lightSections(ChunkSections& sections) const;
+
+    // Queues relighting around a block of a loaded chunk that changed
+    void blockChanged(int32_t x, int32_t y, int32_t z);
+    // Queues spreading the light of a chunk that was just loaded into its loaded neighbours, and theirs into it
+    void chunkLoaded(int32_t chunkX, int32_t chunkZ);
+    // Relights around the queued blocks and chunks and sends the changed sections to their viewers (tick thread)
+    void flush();
+
+    uint8_t opacityOf(int32_t stateId) const {
+        return stateId >= 0 && stateId < static_cast<int32_t>(opacity.size()) ? opacity[stateId] : 15;
+    }
+    uint8_t emissionOf(int32_t stateId) const {
+        return stateId >= 0 && stateId < static_cast<int32_t>(emission.size()) ? emission[stateId] : 0;
+    }
+
+private:
+    struct BlockPosition {
+        int32_t x, y, z;
+    };
+
+    std::vector<uint8_t> opacity; // Light levels taken away when passing through, by state ID (15 is opaque)
+    std::vector<uint8_t> emission;
+
+    std::mutex queueMutex;
+    std::vector<BlockPosition> queue;
+    std::vector<ChunkCoordinates> loadedChunks;
+};
+
+inline LightEngine lightEngine;
+
+#endif //LIGHT_ENGINE_H
@@ -0,0 +1,84 @@
+#include "nbt_reader.h"
+
+#include <string>
+
+namespace {
+    // Deeper nesting than vanilla ever writes, anything past it is treated as malformed
+    constexpr int MAX_DEPTH = 512;
+}
+
+std::string_view NbtReader::readRootCompound() {
+    if (readByte() != TAG_COMPOUND) {
+        throw std::runtime_error("NBT root is not a compound");
+    }
+    return readString();
+}
+
+std::string_view NbtReader::readString() {
+    auto length = static_cast<uint16_t>(readShort());
+    std::span<const uint8_t> bytes = take(length);
+    return {reinterpret_cast<const char*>(bytes.data()), bytes.size()};
+}
+
+size_t NbtReader::readLength() {
+    int32_t length = readInt();
+    if (length < 0) {
+        throw std::runtime_error("Negative NBT array length");
+    }
+    return static_cast<size_t>(length);
+}
+
+std::span<const uint8_t> NbtReader::readByteArray() {
+    return take(readLength());
+}
+
+void NbtReader::readLongArray(std::vector<uint64_t>& out) {
+    size_t length = readLength();
+    std::span<const uint8_t> bytes = take(length * sizeof(uint64_t));
+    out.resize(length);
+    std::memcpy(out.data(), bytes.data(), bytes.size());
+    if constexpr (std::endian::native == std::endian::little) {
+        for (uint64_t& value : out) {
+            value = byteswap64(value);
+        }
+    }
+}
+
+int64_t NbtReader::readInteger(uint8_t type) {
+    switch (type) {
+        case TAG_BYTE: return static_cast<int8_t>(readByte());
+        case TAG_SHORT: return readShort();
+        case TAG_INT: return readInt();
+        case TAG_LONG: return readLong();
+        default: throw std::runtime_error("Expected an integer NBT tag, got type " + std::to_string(type));
+    }
+}
+
+void NbtReader::skip(uint8_t type) {
+    switch (type) {
+        case TAG_BYTE: take(1); break;
+        case TAG_SHORT: take(2); break;
+        case TAG_INT:
+        case TAG_FLOAT: take(4); break;
+        case TAG_LONG:
+        case TAG_DOUBLE: take(8); break;
+        case TAG_BYTE_ARRAY: take(readLength()); break;
+        case TAG_STRING: take(static_cast<uint16_t>(readShort())); break;
+        case TAG_INT_ARRAY: take(readLength() * 4); break;
+        case TAG_LONG_ARRAY: take(readLength() * 8); break;
+        case TAG_LIST:
+        case TAG_COMPOUND:
+            if (++depth > MAX_DEPTH) {
+                throw std::runtime_error("NBT nested too deeply");
+            }
+            if (type == TAG_LIST) {
+                readList([this](uint8_t elementType) { skip(elementType); });
+            } else {
+                readCompound([this](uint8_t entryType, std::string_view) { skip(entryType); });
+            }
+            --depth;
+            break;
+        case TAG_END: break; // Elements of empty lists
+        default: throw std::runtime_error("Unknown NBT tag type " + std::to_string(type));
+    }
+}
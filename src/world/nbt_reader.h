@@ -0,0 +1,109 @@
+#ifndef NBT_READER_H
+#define NBT_READER_H
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "utils/le32toh.h"
+
+// Tag type IDs of the NBT format
+enum NbtTagType : uint8_t {
+    TAG_END = 0,
+    TAG_BYTE = 1,
+    TAG_SHORT = 2,
+    TAG_INT = 3,
+    TAG_LONG = 4,
+    TAG_FLOAT = 5,
+    TAG_DOUBLE = 6,
+    TAG_BYTE_ARRAY = 7,
+    TAG_STRING = 8,
+    TAG_LIST = 9,
+    TAG_COMPOUND = 10,
+    TAG_INT_ARRAY = 11,
+    TAG_LONG_ARRAY = 12,
+};
+
+// Pull-style reader over uncompressed big-endian NBT, for decoding straight into the structures that need the
+// data instead of building a tag tree first. Strings and byte arrays are views into the buffer.
+// Malformed or truncated input throws std::runtime_error.
+class NbtReader {
+public:
+    explicit NbtReader(std::span<const uint8_t> data) : data(data) {}
+
+    // Reads the type and name of the root tag, which must be a compound
+    std::string_view readRootCompound();
+
+    // Calls entry(type, name) for every entry of the compound being read, entry must consume or skip the payload
+    template <typename Entry>
+    void readCompound(Entry entry) {
+        while (true) {
+            uint8_t type = readByte();
+            if (type == TAG_END) {
+                return;
+            }
+            std::string_view name = readString();
+            entry(type, name);
+        }
+    }
+
+    // Calls element(type) count times for the elements of the list being read
+    template <typename Element>
+    void readList(Element element) {
+        uint8_t type = readByte();
+        int32_t count = readInt();
+        // Every element but TAG_END takes at least a byte, a larger count can't be real and would only spin
+        if (count > 0 && (type == TAG_END || static_cast<size_t>(count) > data.size() - position)) {
+            throw std::runtime_error("NBT list of " + std::to_string(count) + " elements doesn't fit the data");
+        }
+        for (int32_t i = 0; i < count; ++i) {
+            element(type);
+        }
+    }
+
+    uint8_t readByte() { return take(1)[0]; }
+    int16_t readShort() { return static_cast<int16_t>(readBigEndian<uint16_t>()); }
+    int32_t readInt() { return static_cast<int32_t>(readBigEndian<uint32_t>()); }
+    int64_t readLong() { return static_cast<int64_t>(readBigEndian<uint64_t>()); }
+    std::string_view readString();
+    std::span<const uint8_t> readByteArray();
+    // Reads a long array into out, replacing its contents
+    void readLongArray(std::vector<uint64_t>& out);
+    // Reads any integer tag as an int, for fields whose type varies between versions
+    int64_t readInteger(uint8_t type);
+
+    // Skips the payload of a tag of the given type
+    void skip(uint8_t type);
+
+private:
+    std::span<const uint8_t> take(size_t size) {
+        if (size > data.size() - position) {
+            throw std::runtime_error("NBT data ends early");
+        }
+        std::span<const uint8_t> bytes = data.subspan(position, size);
+        position += size;
+        return bytes;
+    }
+
+    template <typename T>
+    T readBigEndian() {
+        T value;
+        std::memcpy(&value, take(sizeof(T)).data(), sizeof(T));
+        if constexpr (std::endian::native == std::endian::big) return value;
+        else if constexpr (sizeof(T) == 2) return byteswap16(value);
+        else if constexpr (sizeof(T) == 4) return byteswap32(value);
+        else return byteswap64(value);
+    }
+
+    size_t readLength();
+
+    std::span<const uint8_t> data;
+    size_t position = 0;
+    int depth = 0; // Nesting of skipped compounds and lists, limited to stop malicious input
+};
+
+#endif //NBT_READER_H
@@ -1,124 +1,261 @@
 #include "region_file.h"
 
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 #include <tag_array.h>
 #include <cstring>
-
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+#include "core/config.h"
 #include "core/utils.h"
-#include "zlib.h"
 #include "io/stream_reader.h"
 
-RegionFile::RegionFile(const std::filesystem::path& filepath, bool readOnly) : filepath(filepath) {
-    // Open the file in binary read/write mode
-    if (readOnly) {
-        fileStream.open(filepath, std::ios::in | std::ios::binary);
-    } else {
-        fileStream.open(filepath, std::ios::in | std::ios::out | std::ios::binary);
-    }
-
-    // If the file doesn't exist, create it and initialize header
-    if(!readOnly) {
-        if (!fileStream.is_open()) {
-            fileStream.clear();
-            fileStream.open(filepath, std::ios::out | std::ios::binary);
-            if (!fileStream) {
-                logMessage("Failed to create/open region file: " + filepath.string(), LOG_ERROR);
-                return;
-            }
-
-            // Initialize header with zeros
-            std::array<uint8_t, 8192> emptyHeader = {0};
-            fileStream.write(reinterpret_cast<const char*>(emptyHeader.data()), emptyHeader.size());
-            fileStream.close();
-            // Reopen in read/write mode
-            fileStream.open(filepath, std::ios::in | std::ios::out | std::ios::binary);
-            if (!fileStream) {
-                logMessage("Failed to reopen region file after creation: " + filepath.string(), LOG_ERROR);
-                return;
-            }
-        }
-    } else {
-        if (!fileStream.is_open()) {
-            logMessage("Failed to open region file: " + filepath.string(), LOG_ERROR);
-        }
+RegionFile::RegionFile(const std::filesystem::path& filepath, bool readOnly) : filepath(filepath), readOnly(readOnly) {
+    // One native handle for positional reads and writes, created if it doesn't exist
+#ifdef _WIN32
+    DWORD access = readOnly ? GENERIC_READ : GENERIC_READ | GENERIC_WRITE;
+    HANDLE file = CreateFileW(filepath.c_str(), access, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                              readOnly ? OPEN_EXISTING : OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE && !readOnly && std::filesystem::exists(filepath)) {
+        file = CreateFileW(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        this->readOnly = true;
+    }
+    handle = file == INVALID_HANDLE_VALUE ? -1 : reinterpret_cast<std::intptr_t>(file);
+#else
+    handle = open(filepath.c_str(), readOnly ? O_RDONLY | O_CLOEXEC : O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (handle == -1 && !readOnly && std::filesystem::exists(filepath)) {
+        handle = open(filepath.c_str(), O_RDONLY | O_CLOEXEC);
+        this->readOnly = true;
+    }
+#endif
+    if (handle == -1) {
+        logMessage("Failed to create/open region file: " + filepath.string(), LOG_ERROR);
+        return;
+    }
+    if (this->readOnly && !readOnly) {
+        logMessage("Region file is not writable, opening it read-only: " + filepath.string(), LOG_WARNING);
     }
 
-    // Load the header
-    if (!loadHeader()) {
+    // Load the header, a new file gets an empty one
+    if (fileSize() == 0 && !this->readOnly) {
+        usedSectors.assign(2, true);
+        headerDirty = true;
+        if (!flush()) {
+            logMessage("Failed to initialize region file: " + filepath.string(), LOG_ERROR);
+        }
+    } else if (!loadHeader()) {
         logMessage("Failed to load header for region file: " + filepath.string(), LOG_ERROR);
     }
 }
 
 RegionFile::~RegionFile() {
-    if (fileStream.is_open()) {
-        // Write the header back before closing
-        writeHeader();
-        fileStream.close();
+    if (handle == -1) {
+        return;
+    }
+    // Normally done by the last save batch already
+    if (headerDirty) {
+        flush();
+    }
+#ifdef _WIN32
+    CloseHandle(reinterpret_cast<HANDLE>(handle));
+#else
+    close(static_cast<int>(handle));
+#endif
+}
+
+uint64_t RegionFile::fileSize() const {
+#ifdef _WIN32
+    LARGE_INTEGER size;
+    return GetFileSizeEx(reinterpret_cast<HANDLE>(handle), &size) ? static_cast<uint64_t>(size.QuadPart) : 0;
+#else
+    struct stat status{};
+    return fstat(static_cast<int>(handle), &status) == 0 ? static_cast<uint64_t>(status.st_size) : 0;
+#endif
+}
+
+bool RegionFile::readAt(uint64_t offset, void* buffer, size_t size) const {
+    auto* out = static_cast<char*>(buffer);
+    while (size > 0) {
+#ifdef _WIN32
+        OVERLAPPED overlapped = {};
+        overlapped.Offset = static_cast<DWORD>(offset);
+        overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+        DWORD read = 0;
+        DWORD request = static_cast<DWORD>(std::min<size_t>(size, 1 << 30));
+        if (!ReadFile(reinterpret_cast<HANDLE>(handle), out, request, &read, &overlapped) || read == 0) {
+            return false;
+        }
+#else
+        ssize_t read = pread(static_cast<int>(handle), out, size, static_cast<off_t>(offset));
+        if (read < 0 && errno == EINTR) {
+            continue;
+        }
+        if (read <= 0) {
+            return false;
+        }
+#endif
+        out += read;
+        offset += read;
+        size -= read;
+    }
+    return true;
+}
+
+bool RegionFile::writeAt(uint64_t offset, const void* buffer, size_t size) {
+    auto* in = static_cast<const char*>(buffer);
+    while (size > 0) {
+#ifdef _WIN32
+        OVERLAPPED overlapped = {};
+        overlapped.Offset = static_cast<DWORD>(offset);
+        overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+        DWORD written = 0;
+        DWORD request = static_cast<DWORD>(std::min<size_t>(size, 1 << 30));
+        if (!WriteFile(reinterpret_cast<HANDLE>(handle), in, request, &written, &overlapped) || written == 0) {
+            return false;
+        }
+#else
+        ssize_t written = pwrite(static_cast<int>(handle), in, size, static_cast<off_t>(offset));
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+#endif
+        in += written;
+        offset += written;
+        size -= written;
     }
+    return true;
 }
 
 bool RegionFile::loadHeader() {
-    if (!fileStream.is_open()) {
+    if (handle == -1) {
         logMessage("Region file not open: " + filepath.string(), LOG_ERROR);
         return false;
     }
 
-    // Read the first 4,096 bytes for chunk offset table
-    fileStream.seekg(0, std::ios::beg);
+    // 4,096 bytes of chunk locations followed by 4,096 bytes of timestamps, all big-endian
+    std::array<uint8_t, 8192> header{};
+    if (!readAt(0, header.data(), header.size())) {
+        return false;
+    }
     for (size_t i = 0; i < 1024; ++i) {
-        uint32_t offset = 0;
-        fileStream.read(reinterpret_cast<char*>(&offset), 4);
-        // Convert from big-endian to host byte order
-        offset = ((offset & 0xFF) << 16) | ((offset & 0xFF00) << 8) | ((offset & 0xFF0000) >> 8);
-        chunkOffsetTable[i] = offset;
+        const uint8_t* location = header.data() + i * 4;
+        const uint8_t* timestamp = header.data() + 4096 + i * 4;
+        // Kept as (sector offset << 8) | sector count
+        chunkOffsetTable[i] = static_cast<uint32_t>(location[0]) << 24 | location[1] << 16 | location[2] << 8 | location[3];
+        chunkTimestampTable[i] = static_cast<uint32_t>(timestamp[0]) << 24 | timestamp[1] << 16 | timestamp[2] << 8 | timestamp[3];
     }
 
-    // Read the next 4,096 bytes for chunk timestamp table
+    // Every sector no chunk points at is free, the header itself always takes the first two
+    usedSectors.assign(std::max<uint64_t>(2, (fileSize() + 4095) / 4096), false);
+    markSectors(0, 2, true);
     for (size_t i = 0; i < 1024; ++i) {
-        uint32_t timestamp = 0;
-        fileStream.read(reinterpret_cast<char*>(&timestamp), 4);
-        // Convert from big-endian to host byte order
-        timestamp = ((timestamp & 0xFF) << 24) | ((timestamp & 0xFF00) << 8) |
-                    ((timestamp & 0xFF0000) >> 8) | ((timestamp & 0xFF000000) >> 24);
-        chunkTimestampTable[i] = timestamp;
+        uint32_t offset = chunkOffsetTable[i] >> 8;
+        uint32_t sectorCount = chunkOffsetTable[i] & 0xFF;
+        // A chunk takes at least one sector, an entry without any is as good as absent
+        if (offset < 2 || sectorCount == 0 || offset + sectorCount > usedSectors.size()) {
+            if (chunkOffsetTable[i] != 0) {
+                logMessage("Ignoring chunk " + std::to_string(i) + " outside of region file " + filepath.string(), LOG_WARNING);
+                chunkOffsetTable[i] = 0;
+            }
+            continue;
+        }
+        markSectors(offset, sectorCount, true);
     }
 
     return true;
 }
 
 bool RegionFile::writeHeader() {
-    if (!fileStream.is_open()) {
-        logMessage("Region file not open: " + filepath.string(), LOG_ERROR);
+    if (handle == -1 || readOnly) {
+        logMessage("Region file not open for writing: " + filepath.string(), LOG_ERROR);
         return false;
     }
 
-    // Write the chunk offset table
-    fileStream.seekp(0, std::ios::beg);
+    // The location is 3 bytes of sector offset and 1 byte of sector count, big-endian
+    std::array<uint8_t, 8192> header{};
     for (size_t i = 0; i < 1024; ++i) {
         uint32_t offset = chunkOffsetTable[i];
-        // Convert to big-endian
-        uint32_t beOffset = ((offset & 0xFF0000) >> 8) |
-							((offset & 0xFF00) << 8) |
-							((offset & 0xFF) << 16);
-        fileStream.write(reinterpret_cast<const char*>(&beOffset), 4);
+        uint32_t timestamp = chunkTimestampTable[i];
+        for (int byte = 0; byte < 4; ++byte) {
+            header[i * 4 + byte] = static_cast<uint8_t>(offset >> (24 - byte * 8));
+            header[4096 + i * 4 + byte] = static_cast<uint8_t>(timestamp >> (24 - byte * 8));
+        }
     }
+    return writeAt(0, header.data(), header.size());
+}
 
-    // Write the chunk timestamp table
-    for (size_t i = 0; i < 1024; ++i) {
-        uint32_t timestamp = chunkTimestampTable[i];
-        // Convert to big-endian
-        uint32_t beTimestamp = ((timestamp & 0xFF000000) >> 24) |
-                               ((timestamp & 0xFF0000) >> 8) |
-                               ((timestamp & 0xFF00) << 8) |
-                               ((timestamp & 0xFF) << 24);
-        fileStream.write(reinterpret_cast<const char*>(&beTimestamp), 4);
+bool RegionFile::syncFile(bool dataOnly) {
+#ifdef _WIN32
+    (void)dataOnly;
+    return FlushFileBuffers(reinterpret_cast<HANDLE>(handle)) != 0;
+#elif defined(__linux__)
+    // fdatasync skips metadata the data does not need, like the modification time
+    return (dataOnly ? fdatasync(static_cast<int>(handle)) : fsync(static_cast<int>(handle))) == 0;
+#else
+    (void)dataOnly;
+    return fsync(static_cast<int>(handle)) == 0;
+#endif
+}
+
+bool RegionFile::flush() {
+    std::unique_lock lock(mutex);
+    if (!headerDirty) {
+        return true;
+    }
+
+    // The chunks saved since the last flush reach the disk before the header that points at them, so a crash in
+    // between leaves the old header and the old copies, which are still intact
+    if (!syncFile(true)) {
+        logMessage("Failed to sync region file: " + filepath.string(), LOG_ERROR);
+        return false;
+    }
+    if (!writeHeader() || !syncFile(false)) {
+        logMessage("Failed to sync region file header: " + filepath.string(), LOG_ERROR);
+        return false;
     }
+    headerDirty = false;
 
-    fileStream.flush();
+    // The old copies of the chunks are unreferenced on disk now, their sectors can be reused
+    for (const auto& [offset, sectorCount] : releasedSectors) {
+        markSectors(offset, sectorCount, false);
+    }
+    releasedSectors.clear();
     return true;
 }
 
+void RegionFile::markSectors(uint32_t offset, uint32_t sectorCount, bool used) {
+    if (offset + sectorCount > usedSectors.size()) {
+        usedSectors.resize(offset + sectorCount, false);
+    }
+    std::fill_n(usedSectors.begin() + offset, sectorCount, used);
+}
+
+uint32_t RegionFile::allocateSectors(uint32_t sectorCount) {
+    // First fit among the free sectors, a free run at the end of the file is extended
+    uint32_t run = 0;
+    for (uint32_t sector = 2; sector < usedSectors.size(); ++sector) {
+        run = usedSectors[sector] ? 0 : run + 1;
+        if (run == sectorCount) {
+            uint32_t offset = sector + 1 - sectorCount;
+            markSectors(offset, sectorCount, true);
+            return offset;
+        }
+    }
+    uint32_t offset = static_cast<uint32_t>(usedSectors.size()) - run;
+    markSectors(offset, sectorCount, true);
+    return offset;
+}
+
 int RegionFile::getChunkIndex(int localX, int localZ) {
     return (localZ * 32) + localX;
 }
@@ -141,91 +278,71 @@ bool RegionFile::setChunkLocation(int localX, int localZ, uint32_t offset, uint8
     return true;
 }
 
-std::optional<ChunkData> RegionFile::loadChunk(int localX, int localZ, int regionX, int regionZ) {
+std::optional<std::vector<uint8_t>> RegionFile::readChunkNBT(int localX, int localZ) {
     if (localX < 0 || localX >= 32 || localZ < 0 || localZ >= 32) {
         logMessage("Local chunk coordinates out of bounds: (" + std::to_string(localX) + ", " + std::to_string(localZ), LOG_ERROR);
         return std::nullopt;
     }
 
     int index = getChunkIndex(localX, localZ);
-    uint32_t offset = chunkOffsetTable[index] >> 8; // The first 3 bytes
-    uint8_t sectorCount = chunkOffsetTable[index] & 0xFF; // The last byte
-
-    if (offset == 0 && sectorCount == 0) {
-        // Chunk not present
-        return std::nullopt;
-    }
-
-    // Calculate byte offset
-    uint64_t byteOffset = static_cast<uint64_t>(offset) * 4096;
-
-    // Read chunk length
-    fileStream.seekg(byteOffset, std::ios::beg);
-    uint32_t length = 0;
-    fileStream.read(reinterpret_cast<char*>(&length), 4);
-    // Convert from big-endian
-    length = ((length & 0xFF) << 24) | ((length & 0xFF00) << 8) |
-             ((length & 0xFF0000) >> 8) | ((length & 0xFF000000) >> 24);
-
-    // Read compression type
-    uint8_t compressionType = 0;
-    fileStream.read(reinterpret_cast<char*>(&compressionType), 1);
-    if (compressionType != 2) { // Only handle zlib compression
-        logMessage("Unsupported compression type: " + static_cast<int>(compressionType), LOG_ERROR);
-        return std::nullopt;
-    }
-
-    // Read compressed data
-    size_t compressedSize = length - 1;
-    std::vector<uint8_t> compressedData(compressedSize);
-    fileStream.read(reinterpret_cast<char*>(compressedData.data()), compressedSize);
-
-    // Decompress using zlib
-    std::vector<uint8_t> decompressedData;
+    std::vector<uint8_t> compressedData;
     {
-        z_stream strm = {};
-        strm.next_in = compressedData.data();
-        strm.avail_in = compressedSize;
+        // A save may not move the chunk while it is read
+        std::shared_lock lock(mutex);
+        uint32_t offset = chunkOffsetTable[index] >> 8; // The first 3 bytes
+        uint8_t sectorCount = chunkOffsetTable[index] & 0xFF; // The last byte
 
-        if (inflateInit(&strm) != Z_OK) {
-            logMessage("Failed to initialize zlib for decompression.", LOG_ERROR);
+        if (offset == 0 || sectorCount == 0) {
+            // Chunk not present, loadHeader drops entries with only one of them
             return std::nullopt;
         }
 
-        constexpr size_t bufferSize = 1024 * 1024; // 1 MiB buffer
-        std::vector<uint8_t> buffer(bufferSize);
-
-        int ret;
-        do {
-            strm.next_out = buffer.data();
-            strm.avail_out = bufferSize;
+        // Calculate byte offset
+        uint64_t byteOffset = static_cast<uint64_t>(offset) * 4096;
 
-            ret = inflate(&strm, Z_NO_FLUSH);
-            if (ret == Z_STREAM_ERROR) {
-                logMessage("Zlib stream error during decompression.", LOG_ERROR);
-                inflateEnd(&strm);
-                return std::nullopt;
-            }
+        // Read chunk length (big-endian) and compression type
+        uint8_t chunkHeader[5];
+        if (!readAt(byteOffset, chunkHeader, sizeof(chunkHeader))) {
+            logMessage("Failed to read chunk (" + std::to_string(localX) + ", " + std::to_string(localZ) + ") from " + filepath.string(), LOG_ERROR);
+            return std::nullopt;
+        }
+        uint32_t length = static_cast<uint32_t>(chunkHeader[0]) << 24 | chunkHeader[1] << 16 | chunkHeader[2] << 8 | chunkHeader[3];
+        uint8_t compressionType = chunkHeader[4];
+        if (compressionType != 2) { // Only handle zlib compression
+            logMessage("Unsupported compression type: " + std::to_string(compressionType), LOG_ERROR);
+            return std::nullopt;
+        }
+        // The chunk can't be larger than the sectors it takes, a corrupt length must not decide the allocation
+        if (length < 1 || length + static_cast<uint64_t>(4) > static_cast<uint64_t>(sectorCount) * 4096) {
+            logMessage("Invalid length " + std::to_string(length) + " of chunk (" + std::to_string(localX) + ", " + std::to_string(localZ) + ") in " + filepath.string(), LOG_ERROR);
+            return std::nullopt;
+        }
 
-            switch (ret) {
-                case Z_NEED_DICT:
-                case Z_DATA_ERROR:
-                case Z_MEM_ERROR:
-                    logMessage("Zlib decompression error: " + ret, LOG_ERROR);
-                    inflateEnd(&strm);
-                    return std::nullopt;
-                default: break;
-            }
+        // Read compressed data
+        compressedData.resize(length - 1);
+        if (!readAt(byteOffset + 5, compressedData.data(), compressedData.size())) {
+            logMessage("Failed to read chunk (" + std::to_string(localX) + ", " + std::to_string(localZ) + ") from " + filepath.string(), LOG_ERROR);
+            return std::nullopt;
+        }
+    }
 
-            size_t have = bufferSize - strm.avail_out;
-            decompressedData.insert(decompressedData.end(), buffer.begin(), buffer.begin() + have);
-        } while (ret != Z_STREAM_END);
+    // Inflated with the thread's pooled stream
+    try {
+        return decompressData(compressedData);
+    } catch (const std::exception& e) {
+        logMessage("Failed to inflate chunk (" + std::to_string(localX) + ", " + std::to_string(localZ) + ") of " + filepath.string() + ": " + e.what(), LOG_ERROR);
+        return std::nullopt;
+    }
+}
 
-        inflateEnd(&strm);
+std::optional<ChunkData> RegionFile::loadChunk(int localX, int localZ, int regionX, int regionZ) {
+    std::optional<std::vector<uint8_t>> decompressedData = readChunkNBT(localX, localZ);
+    if (!decompressedData) {
+        return std::nullopt;
     }
 
     // Parse NBT data
-    std::istringstream nbtStream(std::string(reinterpret_cast<char*>(decompressedData.data()), decompressedData.size()), std::ios::binary);
+    std::istringstream nbtStream(std::string(reinterpret_cast<char*>(decompressedData->data()), decompressedData->size()), std::ios::binary);
     nbt::tag_compound rootCompound;
     try {
         std::pair<std::string, std::unique_ptr<nbt::tag_compound>> nbtData = nbt::io::read_compound(nbtStream, endian::big);
@@ -235,23 +352,9 @@ std::optional<ChunkData> RegionFile::loadChunk(int localX, int localZ, int regio
         return std::nullopt;
     }
 
-    // Extract Heightmaps
-    Heightmaps heightmaps;
-    if (rootCompound.has_key("Heightmaps")) {
-        const nbt::tag_compound& hmTag = rootCompound["Heightmaps"].as<nbt::tag_compound>();
-        for (const auto& [name, tag] : hmTag) {
-            if (tag.get_type() == nbt::tag_type::Long_Array) {
-                const std::vector<int64_t>& longs = tag.as<nbt::tag_long_array>().get();
-                heightmaps.data[name] = longs;
-            }
-        }
-    }
-
     // Populate ChunkData
     ChunkData chunkData;
-    chunkData.nbt = rootCompound;
-    chunkData.heightmaps = heightmaps;
-
+    chunkData.nbt = std::move(rootCompound);
     return chunkData;
 }
 
@@ -262,101 +365,114 @@ bool RegionFile::saveChunk(int localX, int localZ, int regionX, int regionZ, con
     }
 
     int index = getChunkIndex(localX, localZ);
-    uint32_t currentOffset = chunkOffsetTable[index] >> 8;
-    uint8_t currentSectorCount = chunkOffsetTable[index] & 0xFF;
 
-    // Serialize NBT data
-    std::ostringstream nbtStream(std::ios::binary);
+    // Serialize the NBT into a buffer the thread keeps, it is only needed until it is compressed
+    thread_local std::vector<uint8_t> nbtData;
+    nbtData.clear();
     try {
-        auto nbtData = serializeNBT(chunk.nbt, false, "Chunk [" + std::to_string(regionX) + ", " + std::to_string(regionZ) + "]    in world at (" + std::to_string(localX) + ", " + std::to_string(localZ) + ")");
-        nbtStream.write(reinterpret_cast<const char*>(nbtData.data()), nbtData.size());
+        appendNBT(nbtData, chunk.nbt, "Chunk [" + std::to_string(regionX) + ", " + std::to_string(regionZ) + "]    in world at (" + std::to_string(localX) + ", " + std::to_string(localZ) + ")");
     } catch (const std::exception& e) {
         logMessage("Failed to serialize NBT data for chunk (" + std::to_string(localX) + ", " + std::to_string(localZ) + "): " + e.what(), LOG_ERROR);
         return false;
     }
-    std::string nbtDataStr = nbtStream.str();
-    std::vector<uint8_t> nbtData(nbtDataStr.begin(), nbtDataStr.end());
-
-    // Compress NBT data using zlib
-    std::vector<uint8_t> compressedData;
-    {
-        z_stream strm = {};
-        if (deflateInit(&strm, Z_BEST_COMPRESSION) != Z_OK) {
-            logMessage("Failed to initialize zlib for compression.", LOG_ERROR);
-            return false;
-        }
-
-        strm.next_in = nbtData.data();
-        strm.avail_in = nbtData.size();
-
-        constexpr size_t bufferSize = 1024 * 1024; // 1 MiB buffer
-        std::vector<uint8_t> buffer(bufferSize);
-
-        int ret;
-        do {
-            strm.next_out = buffer.data();
-            strm.avail_out = bufferSize;
-
-            ret = deflate(&strm, Z_FINISH);
-            if (ret == Z_STREAM_ERROR) {
-                logMessage("Zlib stream error during compression.", LOG_ERROR);
-                deflateEnd(&strm);
-                return false;
-            }
-
-            size_t have = bufferSize - strm.avail_out;
-            compressedData.insert(compressedData.end(), buffer.begin(), buffer.begin() + have);
-        } while (ret != Z_STREAM_END);
 
-        deflateEnd(&strm);
+    // Compress behind the length and compression type, straight into the buffer that is written
+    std::vector<uint8_t> chunkData(5 + compressedSizeBound(nbtData.size()));
+    size_t compressedSize;
+    try {
+        compressedSize = compressData(nbtData.data(), nbtData.size(), chunkData.data() + 5, chunkData.size() - 5, serverConfig.regionCompressionLevel);
+    } catch (const std::exception& e) {
+        logMessage("Failed to compress chunk (" + std::to_string(localX) + ", " + std::to_string(localZ) + "): " + e.what(), LOG_ERROR);
+        return false;
     }
 
-    // Determine compression type
-    uint8_t compressionType = 2; // zlib
-
-    // Prepare chunk data
-    std::vector<uint8_t> chunkData;
-    uint32_t chunkLength = static_cast<uint32_t>(1 + compressedData.size()); // 1 byte for compression type
-
-    // Convert chunkLength to big-endian
-    uint32_t beChunkLength = ((chunkLength & 0xFF000000) >> 24) |
-                              ((chunkLength & 0x00FF0000) >> 8) |
-                              ((chunkLength & 0x0000FF00) << 8) |
-                              ((chunkLength & 0x000000FF) << 24);
-    chunkData.resize(4 + 1 + compressedData.size());
-    memcpy(chunkData.data(), &beChunkLength, 4);
-    chunkData[4] = compressionType;
-    memcpy(chunkData.data() + 5, compressedData.data(), compressedData.size());
+    // Length (big-endian, counting the compression type) and compression type 2 (zlib)
+    uint32_t chunkLength = static_cast<uint32_t>(1 + compressedSize);
+    for (int byte = 0; byte < 4; ++byte) {
+        chunkData[byte] = static_cast<uint8_t>(chunkLength >> (24 - byte * 8));
+    }
+    chunkData[4] = 2;
+    chunkData.resize(5 + compressedSize);
+
+    // Whole sectors, the rest of the last one is zeroed
+    size_t requiredSectors = (chunkData.size() + 4095) / 4096; // Ceiling division
+    if (requiredSectors > 255) {
+        logMessage("Chunk (" + std::to_string(localX) + ", " + std::to_string(localZ) + ") needs " + std::to_string(requiredSectors)
+                   + " sectors, more than a region file can hold", LOG_ERROR);
+        return false;
+    }
+    chunkData.resize(requiredSectors * 4096, 0);
 
-    // Calculate required sectors
-    size_t totalBytes = chunkData.size();
-    uint8_t requiredSectors = static_cast<uint8_t>((totalBytes + 4095) / 4096); // Ceiling division
+    // Readers of this file wait until the chunk is written
+    std::unique_lock lock(mutex);
+    if (readOnly || handle == -1) {
+        logMessage("Region file not open for writing: " + filepath.string(), LOG_ERROR);
+        return false;
+    }
 
-    // Find a suitable location (for simplicity, append to the end)
-    fileStream.seekp(0, std::ios::end);
-    uint64_t fileSize = fileStream.tellp();
-    uint32_t newOffset = static_cast<uint32_t>((fileSize + 4095) / 4096); // Ceiling division
+    // The new copy never overwrites the old one, which the header on disk still points at until the next flush
+    uint32_t newOffset = allocateSectors(static_cast<uint32_t>(requiredSectors));
+    if (!writeAt(static_cast<uint64_t>(newOffset) * 4096, chunkData.data(), chunkData.size())) {
+        logMessage("Failed to write chunk (" + std::to_string(localX) + ", " + std::to_string(localZ) + ") to " + filepath.string(), LOG_ERROR);
+        markSectors(newOffset, static_cast<uint32_t>(requiredSectors), false);
+        return false;
+    }
 
-    // Update chunk offset table
-    chunkOffsetTable[index] = (newOffset << 8) | requiredSectors;
+    uint32_t oldOffset = chunkOffsetTable[index] >> 8;
+    uint32_t oldSectorCount = chunkOffsetTable[index] & 0xFF;
+    if (oldOffset != 0) {
+        releasedSectors.emplace_back(oldOffset, oldSectorCount);
+    }
 
-    // Update chunk timestamp (current epoch time)
-    uint32_t currentTimestamp = static_cast<uint32_t>(std::time(nullptr));
-    chunkTimestampTable[index] = currentTimestamp;
+    // Update chunk offset table and timestamp (current epoch time)
+    chunkOffsetTable[index] = (newOffset << 8) | static_cast<uint32_t>(requiredSectors);
+    chunkTimestampTable[index] = static_cast<uint32_t>(std::time(nullptr));
+    headerDirty = true;
+    return true;
+}
 
-    // Write chunk data
-    uint64_t byteOffset = static_cast<uint64_t>(newOffset) * 4096;
-    fileStream.seekp(byteOffset, std::ios::beg);
-    fileStream.write(reinterpret_cast<const char*>(chunkData.data()), chunkData.size());
+std::shared_ptr<RegionFile> RegionFileCache::get(int regionX, int regionZ, bool create) {
+    uint64_t key = chunkKey(regionX, regionZ);
+    std::lock_guard lock(mutex);
+    auto it = entries.find(key);
+    if (it != entries.end()) {
+        recentlyUsed.splice(recentlyUsed.begin(), recentlyUsed, it->second);
+        return it->second->second;
+    }
 
-    // Pad the remaining space in the sector with zeros
-    size_t paddingSize = (requiredSectors * 4096) - chunkData.size();
-    if (paddingSize > 0) {
-        std::vector<uint8_t> padding(paddingSize, 0);
-        fileStream.write(reinterpret_cast<const char*>(padding.data()), padding.size());
+    std::filesystem::path path = directory / ("r." + std::to_string(regionX) + "." + std::to_string(regionZ) + ".mca");
+    if (!create && !std::filesystem::exists(path)) {
+        return nullptr;
+    }
+    if (create) {
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
     }
 
-    fileStream.flush();
+    // Opened under the lock so that no two RegionFiles of the same file keep separate headers
+    auto regionFile = std::make_shared<RegionFile>(path, false);
+    recentlyUsed.emplace_front(key, regionFile);
+    entries[key] = recentlyUsed.begin();
+
+    // Files still in use by a load or save stay, a second RegionFile of the same file would overwrite its header
+    for (auto entry = recentlyUsed.end(); entry != recentlyUsed.begin() && recentlyUsed.size() > static_cast<size_t>(serverConfig.regionFileCacheSize);) {
+        --entry;
+        if (entry->second.use_count() == 1) {
+            entries.erase(entry->first);
+            entry = recentlyUsed.erase(entry);
+        }
+    }
+    return regionFile;
+}
 
-    return true;
-}
\ No newline at end of file
+void RegionFileCache::clear() {
+    std::lock_guard lock(mutex);
+    for (auto entry = recentlyUsed.begin(); entry != recentlyUsed.end();) {
+        if (entry->second.use_count() == 1) {
+            entries.erase(entry->first);
+            entry = recentlyUsed.erase(entry);
+        } else {
+            ++entry;
+        }
+    }
+}
@@ -2,18 +2,20 @@
 #define REGION_FILE_H
 #include <array>
 #include <cstdint>
-#include <fstream>
+#include <list>
+#include <memory>
+#include <mutex>
 #include <optional>
+#include <shared_mutex>
 #include <string>
 #include <tag_compound.h>
 #include <unordered_map>
 #include <vector>
 #include <filesystem>
 
-struct Heightmaps {
-    std::unordered_map<std::string, std::vector<int64_t>> data;
-};
+#include "chunk_map.h"
 
+// Light levels of a section as nibbles (see light_engine.h), empty while all of them are 0
 struct Lighting {
     std::vector<uint8_t> blockLight; // 2048 bytes
     std::vector<uint8_t> skyLight;   // 2048 bytes
@@ -21,31 +23,58 @@ struct Lighting {
 
 struct ChunkData {
     nbt::tag_compound nbt;
-    Heightmaps heightmaps;
 };
 
+// One .mca file. The header is read once when the file is opened and kept in memory, saves write the chunk right
+// away and the header with the next flush(). Chunks are read and written with positional I/O, so any number of
+// threads can load from the same file at once; saves take the file exclusively only while they write.
 class RegionFile {
 public:
     RegionFile(const std::filesystem::path &filepath, bool readOnly);
 
     ~RegionFile();
 
-    // Load a chunk at local (x, z) within the region (0-31)
+    // Reads and inflates the chunk at local (x, z) within the region (0-31), returns its uncompressed NBT
+    std::optional<std::vector<uint8_t>> readChunkNBT(int localX, int localZ);
+
+    // Load a chunk at local (x, z) within the region (0-31) as an NBT tree
     std::optional<ChunkData> loadChunk(int localX, int localZ, int regionX, int regionZ);
 
-    // Save a chunk at local (x, z) within the region (0-31)
+    // Save a chunk at local (x, z) within the region (0-31), compressed with region_compression_level.
+    // The chunk goes to free sectors, the sectors of its previous copy are reused after the next flush().
     bool saveChunk(int localX, int localZ, int regionX, int regionZ, const ChunkData &chunk);
 
+    // Writes the header if chunks were saved since the last flush and syncs the file, once for the whole batch
+    bool flush();
+
 private:
     std::filesystem::path filepath;
-    std::fstream fileStream;
+    bool readOnly;
+    std::intptr_t handle = -1; // File descriptor (HANDLE on Windows)
+    // Shared by loads, exclusive while a save writes and updates the header
+    std::shared_mutex mutex;
 
     // Header data
-    std::array<uint32_t, 1024> chunkOffsetTable;
-    std::array<uint32_t, 1024> chunkTimestampTable;
+    std::array<uint32_t, 1024> chunkOffsetTable{};
+    std::array<uint32_t, 1024> chunkTimestampTable{};
+    bool headerDirty = false;
+
+    // Sectors taken by the header and by the chunks the header points at
+    std::vector<bool> usedSectors;
+    // Sectors of replaced chunks (offset, count), free once the header no longer pointing at them is on disk
+    std::vector<std::pair<uint32_t, uint32_t>> releasedSectors;
 
     bool loadHeader();
     bool writeHeader();
+    uint64_t fileSize() const;
+    // Reads or writes size bytes at offset without moving any shared file position
+    bool readAt(uint64_t offset, void* buffer, size_t size) const;
+    bool writeAt(uint64_t offset, const void* buffer, size_t size);
+    // Waits until the writes so far are on disk, with dataOnly the metadata that reading them does not need may lag
+    bool syncFile(bool dataOnly);
+    void markSectors(uint32_t offset, uint32_t sectorCount, bool used);
+    // Finds sectorCount free sectors in a row, growing the file if needed, and marks them used
+    uint32_t allocateSectors(uint32_t sectorCount);
 
     // Utility functions
     static int getChunkIndex(int localX, int localZ);
@@ -53,4 +82,26 @@ private:
     bool setChunkLocation(int localX, int localZ, uint32_t offset, uint8_t sectorCount);
 };
 
+// The most recently used region files, kept open between chunk loads and saves.
+// Files are only opened once: everyone using the same region gets the same RegionFile.
+class RegionFileCache {
+public:
+    explicit RegionFileCache(std::filesystem::path directory) : directory(std::move(directory)) {}
+
+    // The region file, opened if needed. Returns nullptr if it doesn't exist and create is false.
+    std::shared_ptr<RegionFile> get(int regionX, int regionZ, bool create);
+    // Closes every file nobody is using anymore
+    void clear();
+
+private:
+    using Entry = std::pair<uint64_t, std::shared_ptr<RegionFile>>;
+
+    std::filesystem::path directory;
+    std::mutex mutex;
+    std::list<Entry> recentlyUsed; // Most recently used first
+    std::unordered_map<uint64_t, std::list<Entry>::iterator, ChunkKeyHash> entries;
+};
+
+inline RegionFileCache regionFiles("world/region");
+
 #endif //REGION_FILE_H
@@ -4,6 +4,7 @@
 #include <iostream>
 #include <fstream>
 #include <chrono>
+#include <mutex>
 #ifdef _WIN32
 #include <io.h>
 #endif
@@ -221,8 +222,19 @@ bool World::load() {
 }
 
 bool World::save() {
-    // TODO: Implement saving logic
-    return true;
+    // Autosaves and the final save don't interleave their batches
+    static std::mutex saveMutex;
+    std::lock_guard lock(saveMutex);
+
+    ChunkSaveStats stats = saveDirtyChunks();
+    if (stats.saved > 0 || stats.failed > 0) {
+        double chunksPerSecond = stats.milliseconds > 0 ? stats.saved * 1000.0 / stats.milliseconds : 0;
+        logMessage("Saved " + std::to_string(stats.saved) + " chunks to " + std::to_string(stats.regions) + " region files in "
+                   + std::to_string(static_cast<int64_t>(stats.milliseconds)) + " ms (" + std::to_string(static_cast<int64_t>(chunksPerSecond))
+                   + " chunks/s)" + (stats.failed > 0 ? ", " + std::to_string(stats.failed) + " failed" : ""),
+                   stats.failed > 0 ? LOG_WARNING : LOG_INFO);
+    }
+    return stats.failed == 0;
 }
 
 bool World::loadLevelDat() const {